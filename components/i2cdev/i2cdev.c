@@ -11,14 +11,31 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include "i2cdev.h"
+#if HELPER_TARGET_IS_ESP32
+#include <driver/gpio.h>
+#include <esp32/rom/ets_sys.h>
+#endif
 
 static const char *TAG = "I2CDEV";
 
+typedef struct {
+    bool used;
+    i2c_port_t port;
+    uint8_t addr;
+    const i2c_dev_t *dev;
+    i2c_dev_stats_t stats;
+} i2c_dev_entry_t;
+
+static i2c_dev_entry_t devices[CONFIG_I2CDEV_MAX_DEVICES];
+static int64_t stats_since_us;
+
 typedef struct {
     SemaphoreHandle_t lock;
     i2c_config_t config;
     bool installed;
+    uint32_t clk_speed; // Port clock plan, 0 until a device is registered
 } i2c_port_state_t;
 
 static i2c_port_state_t states[I2C_NUM_MAX];
@@ -42,6 +59,8 @@ static i2c_port_state_t states[I2C_NUM_MAX];
 esp_err_t i2cdev_init()
 {
     memset(states, 0, sizeof(states));
+    memset(devices, 0, sizeof(devices));
+    stats_since_us = esp_timer_get_time();
 
     for (int i = 0; i < I2C_NUM_MAX; i++)
     {
@@ -75,6 +94,138 @@ esp_err_t i2cdev_done()
     return ESP_OK;
 }
 
+/* Must be called with the port mutex held */
+static i2c_dev_entry_t *find_entry(i2c_port_t port, uint8_t addr, bool create)
+{
+    i2c_dev_entry_t *free_slot = NULL;
+    for (int i = 0; i < CONFIG_I2CDEV_MAX_DEVICES; i++)
+    {
+        if (!devices[i].used)
+        {
+            if (!free_slot) free_slot = &devices[i];
+            continue;
+        }
+        if (devices[i].port == port && devices[i].addr == addr)
+            return &devices[i];
+    }
+    if (!create || !free_slot) return NULL;
+
+    memset(free_slot, 0, sizeof(i2c_dev_entry_t));
+    free_slot->used = true;
+    free_slot->port = port;
+    free_slot->addr = addr;
+    return free_slot;
+}
+
+static uint8_t latency_bucket(uint32_t us)
+{
+    uint8_t b = 0;
+    while (us > 1 && b < I2CDEV_LATENCY_BUCKETS - 1)
+    {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* Must be called with the port mutex held */
+static esp_err_t i2c_bus_clear(i2c_port_t port)
+{
+    if (!states[port].installed) return ESP_OK;
+
+    i2c_driver_delete(port);
+    states[port].installed = false;
+
+#if HELPER_TARGET_IS_ESP32
+    gpio_num_t scl = states[port].config.scl_io_num;
+    gpio_num_t sda = states[port].config.sda_io_num;
+
+    // A slave holding SDA low is released by clocking out the rest of its byte
+    gpio_set_level(scl, 1);
+    gpio_set_level(sda, 1);
+    gpio_set_direction(scl, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(sda, GPIO_MODE_INPUT_OUTPUT_OD);
+    for (int i = 0; i < 9 && !gpio_get_level(sda); i++)
+    {
+        gpio_set_level(scl, 0);
+        ets_delay_us(5);
+        gpio_set_level(scl, 1);
+        ets_delay_us(5);
+    }
+    // STOP condition
+    gpio_set_level(sda, 0);
+    ets_delay_us(5);
+    gpio_set_level(scl, 1);
+    ets_delay_us(5);
+    gpio_set_level(sda, 1);
+    ets_delay_us(5);
+
+    if (!gpio_get_level(sda))
+        ESP_LOGE(TAG, "SDA still held low on port %d after bus clear", port);
+#endif
+
+    // Force reinstallation on the next transaction
+    memset(&states[port].config, 0, sizeof(i2c_config_t));
+    return ESP_OK;
+}
+
+/* Must be called with the port mutex held */
+static void account_transaction(const i2c_dev_t *dev, esp_err_t res, uint32_t us)
+{
+    i2c_dev_entry_t *e = find_entry(dev->port, dev->addr, true);
+    if (!e) return;
+
+    i2c_dev_stats_t *st = &e->stats;
+    st->transactions++;
+    st->bus_time_us += us;
+    if (us > st->max_us) st->max_us = us;
+    st->latency_hist[latency_bucket(us)]++;
+
+    if (res == ESP_OK)
+    {
+        st->consecutive_fails = 0;
+        return;
+    }
+
+    st->errors++;
+    if (res == ESP_ERR_TIMEOUT)
+        st->timeouts++;
+    else if (res == ESP_FAIL)
+        st->nacks++;
+    st->consecutive_fails++;
+
+#if CONFIG_I2CDEV_RECOVERY_THRESHOLD > 0
+    if (st->consecutive_fails >= CONFIG_I2CDEV_RECOVERY_THRESHOLD)
+    {
+        ESP_LOGW(TAG, "[0x%02x at %d] %u consecutive failures, recovering bus",
+                dev->addr, dev->port, st->consecutive_fails);
+        st->consecutive_fails = 0;
+        st->recoveries++;
+        i2c_bus_clear(dev->port);
+    }
+#endif
+}
+
+#if HELPER_TARGET_IS_ESP32
+/* Must be called with the port mutex held.
+ * The port runs at the highest clock every registered device supports,
+ * so devices with different profiles never force a driver reinstall. */
+static void update_clock_plan(i2c_port_t port)
+{
+    uint32_t clk = CONFIG_I2CDEV_PORT_MAX_FREQ_HZ;
+    for (int i = 0; i < CONFIG_I2CDEV_MAX_DEVICES; i++)
+    {
+        const i2c_dev_t *d = devices[i].dev;
+        if (!devices[i].used || devices[i].port != port || !d) continue;
+        if (d->cfg.master.clk_speed && d->cfg.master.clk_speed < clk)
+            clk = d->cfg.master.clk_speed;
+    }
+    if (clk != states[port].clk_speed)
+        ESP_LOGI(TAG, "Port %d clock plan: %u Hz", port, clk);
+    states[port].clk_speed = clk;
+}
+#endif
+
 esp_err_t i2c_dev_create_mutex(i2c_dev_t *dev)
 {
     if (!dev) return ESP_ERR_INVALID_ARG;
@@ -88,6 +239,20 @@ esp_err_t i2c_dev_create_mutex(i2c_dev_t *dev)
         return ESP_FAIL;
     }
 
+    if (dev->port < I2C_NUM_MAX && states[dev->port].lock)
+    {
+        SEMAPHORE_TAKE(dev->port);
+        i2c_dev_entry_t *e = find_entry(dev->port, dev->addr, true);
+        if (e)
+            e->dev = dev;
+        else
+            ESP_LOGW(TAG, "[0x%02x at %d] Device table full, no statistics", dev->addr, dev->port);
+#if HELPER_TARGET_IS_ESP32
+        update_clock_plan(dev->port);
+#endif
+        SEMAPHORE_GIVE(dev->port);
+    }
+
     return ESP_OK;
 }
 
@@ -98,6 +263,18 @@ esp_err_t i2c_dev_delete_mutex(i2c_dev_t *dev)
     ESP_LOGV(TAG, "[0x%02x at %d] deleting mutex", dev->addr, dev->port);
 
     vSemaphoreDelete(dev->mutex);
+
+    if (dev->port < I2C_NUM_MAX && states[dev->port].lock)
+    {
+        SEMAPHORE_TAKE(dev->port);
+        i2c_dev_entry_t *e = find_entry(dev->port, dev->addr, false);
+        if (e && e->dev == dev)
+            e->dev = NULL;
+#if HELPER_TARGET_IS_ESP32
+        update_clock_plan(dev->port);
+#endif
+        SEMAPHORE_GIVE(dev->port);
+    }
     return ESP_OK;
 }
 
@@ -147,12 +324,17 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev)
     if (dev->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
 
     esp_err_t res;
-    if (!cfg_equal(&dev->cfg, &states[dev->port].config))
+    i2c_config_t temp;
+    memcpy(&temp, &dev->cfg, sizeof(i2c_config_t));
+    temp.mode = I2C_MODE_MASTER;
+#if HELPER_TARGET_IS_ESP32
+    // Devices share the port clock plan instead of their own maximum
+    if (states[dev->port].clk_speed)
+        temp.master.clk_speed = states[dev->port].clk_speed;
+#endif
+    if (!cfg_equal(&temp, &states[dev->port].config))
     {
         ESP_LOGD(TAG, "Reconfiguring I2C driver on port %d", dev->port);
-        i2c_config_t temp;
-        memcpy(&temp, &dev->cfg, sizeof(i2c_config_t));
-        temp.mode = I2C_MODE_MASTER;
 
         // Driver reinstallation
         if (states[dev->port].installed)
@@ -213,11 +395,14 @@ esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_si
         i2c_master_read(cmd, in_data, in_size, I2C_MASTER_LAST_NACK);
         i2c_master_stop(cmd);
 
+        int64_t start = esp_timer_get_time();
         res = i2c_master_cmd_begin(dev->port, cmd, CONFIG_I2CDEV_TIMEOUT / portTICK_RATE_MS);
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not read from device [0x%02x at %d]: %d", dev->addr, dev->port, res);
 
         i2c_cmd_link_delete(cmd);
+        account_transaction(dev, res, elapsed);
     }
 
     SEMAPHORE_GIVE(dev->port);
@@ -240,10 +425,13 @@ esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_re
             i2c_master_write(cmd, (void *)out_reg, out_reg_size, true);
         i2c_master_write(cmd, (void *)out_data, out_size, true);
         i2c_master_stop(cmd);
+        int64_t start = esp_timer_get_time();
         res = i2c_master_cmd_begin(dev->port, cmd, CONFIG_I2CDEV_TIMEOUT / portTICK_RATE_MS);
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
         if (res != ESP_OK)
             ESP_LOGE(TAG, "Could not write to device [0x%02x at %d]: %d", dev->addr, dev->port, res);
         i2c_cmd_link_delete(cmd);
+        account_transaction(dev, res, elapsed);
     }
 
     SEMAPHORE_GIVE(dev->port);
@@ -261,3 +449,173 @@ esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg,
 {
     return i2c_dev_write(dev, &reg, 1, out_data, out_size);
 }
+
+esp_err_t i2c_dev_get_stats(const i2c_dev_t *dev, i2c_dev_stats_t *stats)
+{
+    if (!dev || !stats || dev->port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(dev->port);
+    i2c_dev_entry_t *e = find_entry(dev->port, dev->addr, false);
+    if (e)
+        memcpy(stats, &e->stats, sizeof(i2c_dev_stats_t));
+    SEMAPHORE_GIVE(dev->port);
+
+    return e ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2cdev_get_port_stats(i2c_port_t port, i2c_dev_stats_t *stats)
+{
+    if (!stats || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    memset(stats, 0, sizeof(i2c_dev_stats_t));
+    SEMAPHORE_TAKE(port);
+    for (int i = 0; i < CONFIG_I2CDEV_MAX_DEVICES; i++)
+    {
+        const i2c_dev_entry_t *e = &devices[i];
+        if (!e->used || e->port != port) continue;
+
+        stats->transactions += e->stats.transactions;
+        stats->errors += e->stats.errors;
+        stats->nacks += e->stats.nacks;
+        stats->timeouts += e->stats.timeouts;
+        stats->recoveries += e->stats.recoveries;
+        stats->bus_time_us += e->stats.bus_time_us;
+        if (e->stats.max_us > stats->max_us) stats->max_us = e->stats.max_us;
+        for (int b = 0; b < I2CDEV_LATENCY_BUCKETS; b++)
+            stats->latency_hist[b] += e->stats.latency_hist[b];
+    }
+    SEMAPHORE_GIVE(port);
+
+    return ESP_OK;
+}
+
+uint32_t i2c_dev_stats_percentile(const i2c_dev_stats_t *stats, uint8_t percent)
+{
+    if (!stats || !stats->transactions) return 0;
+
+    uint32_t target = (uint32_t)(((uint64_t)stats->transactions * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (int b = 0; b < I2CDEV_LATENCY_BUCKETS; b++)
+    {
+        seen += stats->latency_hist[b];
+        if (seen >= target)
+            return (2UL << b) - 1; // upper edge of the bucket
+    }
+    return stats->max_us;
+}
+
+esp_err_t i2c_dev_bus_recover(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    SEMAPHORE_TAKE(port);
+    esp_err_t res = i2c_bus_clear(port);
+    SEMAPHORE_GIVE(port);
+    return res;
+}
+
+esp_err_t i2cdev_stats_dump(i2c_port_t port)
+{
+    if (port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    i2c_dev_entry_t snapshot[CONFIG_I2CDEV_MAX_DEVICES];
+    SEMAPHORE_TAKE(port);
+    memcpy(snapshot, devices, sizeof(snapshot));
+    int64_t wall = esp_timer_get_time() - stats_since_us;
+    SEMAPHORE_GIVE(port);
+
+    uint64_t busy = 0;
+    ESP_LOGI(TAG, "Port %d statistics over %u ms", port, (uint32_t)(wall / 1000));
+    ESP_LOGI(TAG, " addr    trans   nack  tmo  rec  avg_us  p50  p90  p99  max_us");
+    for (int i = 0; i < CONFIG_I2CDEV_MAX_DEVICES; i++)
+    {
+        const i2c_dev_entry_t *e = &snapshot[i];
+        if (!e->used || e->port != port) continue;
+
+        const i2c_dev_stats_t *st = &e->stats;
+        busy += st->bus_time_us;
+        ESP_LOGI(TAG, " 0x%02x %8u %6u %4u %4u %7u %4u %4u %4u %7u", e->addr,
+                st->transactions, st->nacks, st->timeouts, st->recoveries,
+                st->transactions ? (uint32_t)(st->bus_time_us / st->transactions) : 0,
+                i2c_dev_stats_percentile(st, 50), i2c_dev_stats_percentile(st, 90),
+                i2c_dev_stats_percentile(st, 99), st->max_us);
+    }
+    if (wall > 0)
+        ESP_LOGI(TAG, "Bus busy %u.%u%% of wall time", (uint32_t)(busy * 100 / wall),
+                (uint32_t)(busy * 1000 / wall % 10));
+
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_stats_reset()
+{
+    for (int p = 0; p < I2C_NUM_MAX; p++)
+    {
+        SEMAPHORE_TAKE(p);
+        for (int i = 0; i < CONFIG_I2CDEV_MAX_DEVICES; i++)
+            if (devices[i].used && devices[i].port == p)
+                memset(&devices[i].stats, 0, sizeof(i2c_dev_stats_t));
+        SEMAPHORE_GIVE(p);
+    }
+    stats_since_us = esp_timer_get_time();
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_throughput_test(const i2c_dev_t *dev, uint8_t reg, size_t len,
+        uint32_t iterations, i2c_dev_throughput_t *result)
+{
+    if (!dev || !result || !len || len > 32 || !iterations) return ESP_ERR_INVALID_ARG;
+
+    uint8_t buf[32];
+    memset(result, 0, sizeof(i2c_dev_throughput_t));
+#if HELPER_TARGET_IS_ESP32
+    result->clk_speed = states[dev->port].clk_speed ? states[dev->port].clk_speed : dev->cfg.master.clk_speed;
+#endif
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        if (i2c_dev_read_reg(dev, reg, buf, len) != ESP_OK)
+            result->errors++;
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    if (elapsed <= 0) elapsed = 1;
+
+    uint32_t ok = iterations - result->errors;
+    result->elapsed_us = (uint32_t)elapsed;
+    result->transactions_per_sec = (uint32_t)((uint64_t)ok * 1000000 / elapsed);
+    result->bytes_per_sec = (uint32_t)((uint64_t)ok * len * 1000000 / elapsed);
+    // Address + register + repeated address on top of the payload
+    result->wire_bytes_per_sec = (uint32_t)((uint64_t)ok * (len + 3) * 1000000 / elapsed);
+
+    return result->errors == iterations ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t i2cdev_throughput_test_all(i2c_port_t port, uint32_t iterations)
+{
+    if (port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+
+    const i2c_dev_t *list[CONFIG_I2CDEV_MAX_DEVICES];
+    int count = 0;
+    SEMAPHORE_TAKE(port);
+    for (int i = 0; i < CONFIG_I2CDEV_MAX_DEVICES; i++)
+        if (devices[i].used && devices[i].port == port && devices[i].dev)
+            list[count++] = devices[i].dev;
+    SEMAPHORE_GIVE(port);
+
+    for (int i = 0; i < count; i++)
+    {
+        i2c_dev_throughput_t r;
+        // Register 0 is readable on every device we drive
+        if (i2c_dev_throughput_test(list[i], 0, 2, iterations, &r) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "[0x%02x at %d] Throughput test failed", list[i]->addr, port);
+            continue;
+        }
+        ESP_LOGI(TAG, "[0x%02x at %d] %u Hz: %u trans/s, %u B/s payload, %u B/s on wire, %u errors",
+                list[i]->addr, port, r.clk_speed, r.transactions_per_sec, r.bytes_per_sec,
+                r.wire_bytes_per_sec, r.errors);
+    }
+    return ESP_OK;
+}
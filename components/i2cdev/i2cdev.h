@@ -35,6 +35,10 @@ extern "C" {
 
 /**
  * I2C device descriptor
+ *
+ * On ESP32 `cfg.master.clk_speed` is the highest clock the device supports.
+ * The port runs at the lowest of these over all devices registered on it,
+ * capped by CONFIG_I2CDEV_PORT_MAX_FREQ_HZ.
  */
 typedef struct
 {
@@ -47,6 +51,25 @@ typedef struct
                                   When this value is 0, I2CDEV_MAX_STRETCH_TIME will be used */
 } i2c_dev_t;
 
+#define I2CDEV_LATENCY_BUCKETS 16 //!< log2 latency buckets, 1us .. 32ms
+
+/**
+ * Per-device bus statistics, kept by the library for every device
+ * registered with i2c_dev_create_mutex()
+ */
+typedef struct
+{
+    uint32_t transactions;      //!< Completed i2c_master_cmd_begin() calls
+    uint32_t errors;            //!< Failed transactions of any kind
+    uint32_t nacks;             //!< Transactions failed with ESP_FAIL (no ACK)
+    uint32_t timeouts;          //!< Transactions failed with ESP_ERR_TIMEOUT
+    uint32_t recoveries;        //!< Automatic bus clear sequences triggered by this device
+    uint32_t consecutive_fails; //!< Failures since the last successful transaction
+    uint64_t bus_time_us;       //!< Total time spent in transactions, microseconds
+    uint32_t max_us;            //!< Longest transaction, microseconds
+    uint32_t latency_hist[I2CDEV_LATENCY_BUCKETS]; //!< Bucket n counts transactions of [2^n, 2^(n+1)) us
+} i2c_dev_stats_t;
+
 /**
  * @brief Init I2Cdev lib
  *
@@ -149,6 +172,97 @@ esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg,
 esp_err_t i2c_dev_write_reg(const i2c_dev_t *dev, uint8_t reg,
         const void *out_data, size_t out_size);
 
+/**
+ * Result of a throughput measurement
+ */
+typedef struct
+{
+    uint32_t clk_speed;            //!< Port clock during the test, Hz
+    uint32_t elapsed_us;           //!< Duration of the test
+    uint32_t errors;               //!< Failed transactions
+    uint32_t transactions_per_sec; //!< Successful transactions per second
+    uint32_t bytes_per_sec;        //!< Payload bytes per second
+    uint32_t wire_bytes_per_sec;   //!< Payload plus address and register bytes per second
+} i2c_dev_throughput_t;
+
+/**
+ * @brief Measure effective throughput of a device
+ *
+ * Reads \p len bytes from register \p reg \p iterations times back to back.
+ * @param[in] dev Device descriptor
+ * @param[in] reg Register address to read
+ * @param[in] len Bytes per read, 1..32
+ * @param[in] iterations Number of reads
+ * @param[out] result Measurement
+ * @return ESP_OK if at least one read succeeded
+ */
+esp_err_t i2c_dev_throughput_test(const i2c_dev_t *dev, uint8_t reg, size_t len,
+        uint32_t iterations, i2c_dev_throughput_t *result);
+
+/**
+ * @brief Measure and log throughput of every device registered on a port
+ *
+ * Each device is read from register 0, two bytes per transaction.
+ * @param[in] port I2C port
+ * @param[in] iterations Reads per device
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_throughput_test_all(i2c_port_t port, uint32_t iterations);
+
+/**
+ * @brief Get a copy of the bus statistics of a device
+ * @param[in] dev Device descriptor
+ * @param[out] stats Statistics
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the device is not registered
+ */
+esp_err_t i2c_dev_get_stats(const i2c_dev_t *dev, i2c_dev_stats_t *stats);
+
+/**
+ * @brief Get the sum of the bus statistics of all devices on a port
+ *
+ * consecutive_fails is not summed, max_us is the maximum of all devices.
+ * @param[in] port I2C port
+ * @param[out] stats Statistics
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_get_port_stats(i2c_port_t port, i2c_dev_stats_t *stats);
+
+/**
+ * @brief Estimate a latency percentile from the statistics histogram
+ * @param[in] stats Statistics
+ * @param[in] percent Percentile, 0..100
+ * @return Upper bound of the latency percentile, microseconds
+ */
+uint32_t i2c_dev_stats_percentile(const i2c_dev_stats_t *stats, uint8_t percent);
+
+/**
+ * @brief Clear a stuck bus
+ *
+ * Uninstalls the driver, clocks SCL until a slave holding SDA low
+ * releases it and generates a STOP condition. The driver is reinstalled
+ * on the next transaction. Called automatically after
+ * CONFIG_I2CDEV_RECOVERY_THRESHOLD consecutive failures of a device.
+ * @param[in] port I2C port
+ * @return ESP_OK on success
+ */
+esp_err_t i2c_dev_bus_recover(i2c_port_t port);
+
+/**
+ * @brief Log statistics of all devices on a port
+ *
+ * Includes the share of wall time the bus was busy since
+ * i2cdev_init() or the last i2cdev_stats_reset().
+ * @param[in] port I2C port
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_stats_dump(i2c_port_t port);
+
+/**
+ * @brief Reset statistics of all devices
+ * @return ESP_OK on success
+ */
+esp_err_t i2cdev_stats_reset();
+
 #define I2C_DEV_TAKE_MUTEX(dev) do { \
         esp_err_t __ = i2c_dev_take_mutex(dev); \
         if (__ != ESP_OK) return __;\
@@ -0,0 +1,140 @@
+//Compares the Q16 conversions of the ADC and INA data drivers with the double
+//arithmetic they replaced, accuracy over all raw codes and time per conversion.
+//The host has a double FPU, on the ESP32 the double path runs in soft-float,
+//so the measured speedup is a lower bound for the target.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "fixed_point.h"
+
+#define ADC_CAL_FACTOR 3410
+#define BENCH_SAMPLES 4096
+#define BENCH_ROUNDS 4000
+
+typedef struct {
+	const char *name;
+	int32_t cal_mv;
+	int32_t raw_zero;
+} bench_adc_t;
+
+static const bench_adc_t bench_adc[] = {
+	{"out24", 24000, 0x0000},
+	{"out5", 5000, 0x1000},
+	{"out33", 3300, 0x2000},
+	{"outvar", 26000, 0x3000},
+};
+
+static double bench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//conversions as the drivers did them before, in V and A
+__attribute__((noinline)) static double adc_double(uint16_t raw, int32_t raw_zero, double calibrate)
+{
+	return (double)(raw - raw_zero) * calibrate / ADC_CAL_FACTOR;
+}
+
+__attribute__((noinline)) static double current_double(uint16_t raw, double current_lsb)
+{
+	return (double)((int16_t)raw) * current_lsb * 1000;
+}
+
+__attribute__((noinline)) static int32_t adc_q16(uint16_t raw, const q16_coef_t *coef)
+{
+	return q16_apply(coef, raw);
+}
+
+__attribute__((noinline)) static int32_t current_q16(uint16_t raw, const q16_coef_t *coef)
+{
+	return q16_apply(coef, (int16_t)raw);
+}
+
+static void bench_accuracy(void)
+{
+	printf("Accuracy over all raw codes\n");
+	printf("  %-8s %12s %12s\n", "value", "max_err", "lsb");
+	for(size_t i = 0; i < sizeof(bench_adc) / sizeof(bench_adc[0]); i++)
+	{
+		const bench_adc_t *adc = &bench_adc[i];
+		q16_coef_t coef = q16_coef((int64_t)adc->cal_mv * 1000, ADC_CAL_FACTOR, adc->raw_zero);
+		double max_err = 0;
+		for(int code = 0; code < 4096; code++)
+		{
+			uint16_t raw = adc->raw_zero + code;
+			double ref_uv = adc_double(raw, adc->raw_zero, adc->cal_mv / 1000.0) * 1e6;
+			double err = fabs(q16_apply(&coef, raw) - ref_uv);
+			if(err > max_err) max_err = err;
+		}
+		printf("  %-8s %9.3f uV %9.1f uV\n", adc->name, max_err, adc->cal_mv * 1000.0 / ADC_CAL_FACTOR);
+	}
+
+	//INA220 with 5 A full scale
+	double max_current_a = 5;
+	double current_lsb = max_current_a / 32768.0;
+	q16_coef_t current = q16_coef((int64_t)(max_current_a * 1e6), 32768, 0);
+	q16_coef_t power = q16_coef((int64_t)(max_current_a * 1e6) * 20, 32768, 0);
+	double max_i_err = 0, max_p_err = 0;
+	for(int code = 0; code < 65536; code++)
+	{
+		uint16_t raw = code;
+		double i_err = fabs(q16_apply(&current, (int16_t)raw) - current_double(raw, current_lsb) * 1000);
+		double p_err = fabs(q16_apply(&power, raw) - raw * 20 * current_lsb * 1e6);
+		if(i_err > max_i_err) max_i_err = i_err;
+		if(p_err > max_p_err) max_p_err = p_err;
+	}
+	printf("  %-8s %9.3f uA %9.1f uA\n", "current", max_i_err, current_lsb * 1e6);
+	printf("  %-8s %9.3f uW %9.1f uW\n\n", "power", max_p_err, 20 * current_lsb * 1e6);
+}
+
+static void bench_speed(void)
+{
+	uint16_t *raw = malloc(BENCH_SAMPLES * sizeof(uint16_t));
+	srand(1);
+	for(int i = 0; i < BENCH_SAMPLES; i++) raw[i] = 0x3000 | (rand() & 0x0FFF);
+	q16_coef_t adc = q16_coef(26000LL * 1000, ADC_CAL_FACTOR, 0x3000);
+	q16_coef_t current = q16_coef(5000000, 32768, 0);
+	volatile double sink_double = 0;
+	volatile int32_t sink_int = 0;
+	double calls = (double)BENCH_SAMPLES * BENCH_ROUNDS;
+
+	double start = bench_now_ns();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(int i = 0; i < BENCH_SAMPLES; i++) sink_double = adc_double(raw[i], 0x3000, 26.0);
+	double adc_double_ns = (bench_now_ns() - start) / calls;
+
+	start = bench_now_ns();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(int i = 0; i < BENCH_SAMPLES; i++) sink_int = adc_q16(raw[i], &adc);
+	double adc_q16_ns = (bench_now_ns() - start) / calls;
+
+	start = bench_now_ns();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(int i = 0; i < BENCH_SAMPLES; i++) sink_double = current_double(raw[i], 5.0 / 32768.0);
+	double current_double_ns = (bench_now_ns() - start) / calls;
+
+	start = bench_now_ns();
+	for(int r = 0; r < BENCH_ROUNDS; r++)
+		for(int i = 0; i < BENCH_SAMPLES; i++) sink_int = current_q16(raw[i], &current);
+	double current_q16_ns = (bench_now_ns() - start) / calls;
+
+	(void)sink_double;
+	(void)sink_int;
+	free(raw);
+	printf("Time per conversion on the host\n");
+	printf("  %-8s %10s %10s %8s\n", "value", "double", "q16", "ratio");
+	printf("  %-8s %7.2f ns %7.2f ns %7.2fx\n", "adc", adc_double_ns, adc_q16_ns, adc_double_ns / adc_q16_ns);
+	printf("  %-8s %7.2f ns %7.2f ns %7.2fx\n", "current", current_double_ns, current_q16_ns, current_double_ns / current_q16_ns);
+}
+
+int main(void)
+{
+	bench_accuracy();
+	bench_speed();
+	return 0;
+}
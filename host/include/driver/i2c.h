@@ -0,0 +1,68 @@
+#ifndef HOST_DRIVER_I2C_H_
+#define HOST_DRIVER_I2C_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+typedef int i2c_port_t;
+#define I2C_NUM_0   0
+#define I2C_NUM_1   1
+#define I2C_NUM_MAX 2
+
+typedef enum {
+	I2C_MODE_SLAVE = 0,
+	I2C_MODE_MASTER,
+	I2C_MODE_MAX,
+} i2c_mode_t;
+
+typedef enum {
+	I2C_MASTER_ACK = 0x0,
+	I2C_MASTER_NACK = 0x1,
+	I2C_MASTER_LAST_NACK = 0x2,
+	I2C_MASTER_ACK_MAX,
+} i2c_ack_type_t;
+
+typedef enum {
+	GPIO_PULLUP_DISABLE = 0,
+	GPIO_PULLUP_ENABLE = 1,
+} gpio_pullup_t;
+
+typedef struct {
+	i2c_mode_t mode;
+	int sda_io_num;
+	int scl_io_num;
+	bool sda_pullup_en;
+	bool scl_pullup_en;
+	union {
+		struct {
+			uint32_t clk_speed;
+		} master;
+		struct {
+			uint8_t addr_10bit_en;
+			uint16_t slave_addr;
+		} slave;
+	};
+} i2c_config_t;
+
+typedef void *i2c_cmd_handle_t;
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config);
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags);
+esp_err_t i2c_driver_delete(i2c_port_t port);
+esp_err_t i2c_set_timeout(i2c_port_t port, int timeout);
+esp_err_t i2c_get_timeout(i2c_port_t port, int *timeout);
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef HOST_DRIVER_SPI_MASTER_H_
+#define HOST_DRIVER_SPI_MASTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum {
+	SPI1_HOST = 0,
+	SPI2_HOST = 1,
+	SPI3_HOST = 2,
+} spi_host_device_t;
+#define SPI_HOST    SPI1_HOST
+#define HSPI_HOST   SPI2_HOST
+#define VSPI_HOST   SPI3_HOST
+
+#define SPI_MASTER_FREQ_8M      (80 * 1000 * 1000 / 10)
+#define SPI_MASTER_FREQ_9M      (80 * 1000 * 1000 / 9)
+#define SPI_MASTER_FREQ_10M     (80 * 1000 * 1000 / 8)
+#define SPI_MASTER_FREQ_11M     (80 * 1000 * 1000 / 7)
+#define SPI_MASTER_FREQ_13M     (80 * 1000 * 1000 / 6)
+#define SPI_MASTER_FREQ_16M     (80 * 1000 * 1000 / 5)
+#define SPI_MASTER_FREQ_20M     (80 * 1000 * 1000 / 4)
+#define SPI_MASTER_FREQ_26M     (80 * 1000 * 1000 / 3)
+#define SPI_MASTER_FREQ_40M     (80 * 1000 * 1000 / 2)
+#define SPI_MASTER_FREQ_80M     (80 * 1000 * 1000 / 1)
+
+#define SPI_DEVICE_TXBIT_LSBFIRST   (1 << 0)
+#define SPI_DEVICE_RXBIT_LSBFIRST   (1 << 1)
+#define SPI_DEVICE_3WIRE            (1 << 2)
+#define SPI_DEVICE_POSITIVE_CS      (1 << 3)
+#define SPI_DEVICE_HALFDUPLEX       (1 << 4)
+#define SPI_DEVICE_NO_DUMMY         (1 << 6)
+
+#define SPI_TRANS_USE_RXDATA        (1 << 2)
+#define SPI_TRANS_USE_TXDATA        (1 << 3)
+
+typedef struct {
+	int mosi_io_num;
+	int miso_io_num;
+	int sclk_io_num;
+	int quadwp_io_num;
+	int quadhd_io_num;
+	int max_transfer_sz;
+	uint32_t flags;
+	int intr_flags;
+} spi_bus_config_t;
+
+typedef struct spi_transaction_t spi_transaction_t;
+typedef void (*transaction_cb_t)(spi_transaction_t *trans);
+
+typedef struct {
+	uint8_t command_bits;
+	uint8_t address_bits;
+	uint8_t dummy_bits;
+	uint8_t mode;
+	uint16_t duty_cycle_pos;
+	uint16_t cs_ena_pretrans;
+	uint8_t cs_ena_posttrans;
+	int clock_speed_hz;
+	int input_delay_ns;
+	int spics_io_num;
+	uint32_t flags;
+	int queue_size;
+	transaction_cb_t pre_cb;
+	transaction_cb_t post_cb;
+} spi_device_interface_config_t;
+
+struct spi_transaction_t {
+	uint32_t flags;
+	uint16_t cmd;
+	uint64_t addr;
+	size_t length;
+	size_t rxlength;
+	void *user;
+	union {
+		const void *tx_buffer;
+		uint8_t tx_data[4];
+	};
+	union {
+		void *rx_buffer;
+		uint8_t rx_data[4];
+	};
+};
+
+typedef struct sim_spi_device *spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma_chan);
+esp_err_t spi_bus_free(spi_host_device_t host);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config, spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t timeout);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans, TickType_t timeout);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t spi_device_polling_start(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t timeout);
+esp_err_t spi_device_polling_end(spi_device_handle_t handle, TickType_t timeout);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans);
+esp_err_t spi_device_acquire_bus(spi_device_handle_t handle, TickType_t wait);
+void spi_device_release_bus(spi_device_handle_t handle);
+int spi_get_actual_clock(int fapb, int hz, int duty_cycle);
+
+#endif
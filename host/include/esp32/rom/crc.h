@@ -0,0 +1,9 @@
+#ifndef HOST_ESP32_ROM_CRC_H_
+#define HOST_ESP32_ROM_CRC_H_
+
+#include <stdint.h>
+
+//CRC32 of the ROM, same polynomial and inversion as zlib
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
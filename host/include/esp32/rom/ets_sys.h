@@ -0,0 +1,11 @@
+#ifndef HOST_ETS_SYS_H_
+#define HOST_ETS_SYS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+//busy wait, advances the virtual time of the calling task
+void ets_delay_us(uint32_t us);
+#define ets_printf printf
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef HOST_MINIZ_H_
+#define HOST_MINIZ_H_
+
+//the tinfl subset pngle uses, implemented over the host zlib by sim/sim_miniz.c
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef unsigned char mz_uint8;
+typedef unsigned int mz_uint32;
+typedef unsigned int mz_uint;
+typedef unsigned long mz_ulong;
+
+#define MZ_CRC32_INIT (0)
+mz_ulong mz_crc32(mz_ulong crc, const unsigned char *ptr, size_t buf_len);
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum {
+	TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+	TINFL_FLAG_HAS_MORE_INPUT = 2,
+	TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+	TINFL_FLAG_COMPUTE_ADLER32 = 8,
+};
+
+typedef enum {
+	TINFL_STATUS_BAD_PARAM = -3,
+	TINFL_STATUS_ADLER32_MISMATCH = -2,
+	TINFL_STATUS_FAILED = -1,
+	TINFL_STATUS_DONE = 0,
+	TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+	TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct {
+	void *stream;
+	int done;
+} tinfl_decompressor;
+
+#define tinfl_init(r) sim_tinfl_init(r)
+void sim_tinfl_init(tinfl_decompressor *r);
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *in_buf_next, size_t *in_buf_size,
+	mz_uint8 *out_buf_start, mz_uint8 *out_buf_next, size_t *out_buf_size, const mz_uint32 decomp_flags);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_IDF_VERSION_H_
+#define HOST_ESP_IDF_VERSION_H_
+
+//the simulation provides the 4.x API the firmware is written against
+#define ESP_IDF_VERSION_MAJOR   4
+#define ESP_IDF_VERSION_MINOR   2
+#define ESP_IDF_VERSION_PATCH   0
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) ((major << 16) | (minor << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
+
+#endif
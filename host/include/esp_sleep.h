@@ -0,0 +1,11 @@
+#ifndef HOST_ESP_SLEEP_H_
+#define HOST_ESP_SLEEP_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_uart_wakeup(int uart_num);
+esp_err_t esp_sleep_enable_gpio_wakeup(void);
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_ESP_SPI_FLASH_H_
+#define HOST_ESP_SPI_FLASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef enum {
+	SPI_FLASH_MMAP_DATA,
+	SPI_FLASH_MMAP_INST,
+} spi_flash_mmap_memory_t;
+
+typedef uint32_t spi_flash_mmap_handle_t;
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_VFS_H_
+#define HOST_ESP_VFS_H_
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "esp_err.h"
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_NVS_FLASH_H_
+#define HOST_NVS_FLASH_H_
+
+#include "esp_err.h"
+#include "nvs.h"
+
+//the NVS partition of the simulation is a text file, see --nvs
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+esp_err_t nvs_flash_deinit(void);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef HOST_SIM_VFS_H_
+#define HOST_SIM_VFS_H_
+
+//forced include of the firmware sources: paths below a mounted base path
+//(/spiffs) are redirected to the image directory of the simulation
+
+#include <stdio.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+FILE *sim_fopen(const char *path, const char *mode);
+DIR *sim_opendir(const char *path);
+int sim_stat(const char *path, struct stat *st);
+int sim_unlink(const char *path);
+int sim_rename(const char *from, const char *to);
+
+#define fopen(path, mode)   sim_fopen(path, mode)
+#define opendir(path)       sim_opendir(path)
+#define stat(path, st)      sim_stat(path, st)
+#define unlink(path)        sim_unlink(path)
+#define rename(from, to)    sim_rename(from, to)
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_SOC_GPIO_REG_H_
+#define HOST_SOC_GPIO_REG_H_
+
+#define GPIO_IN_REG     0x3FF4403C
+#define GPIO_IN1_REG    0x3FF44040
+
+#endif
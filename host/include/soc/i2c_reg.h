@@ -0,0 +1,6 @@
+#ifndef HOST_SOC_I2C_REG_H_
+#define HOST_SOC_I2C_REG_H_
+
+#define I2C_TIME_OUT_REG_V  0xFFFFF
+
+#endif
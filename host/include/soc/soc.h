@@ -0,0 +1,12 @@
+#ifndef HOST_SOC_H_
+#define HOST_SOC_H_
+
+#include <stdint.h>
+
+#define APB_CLK_FREQ (80 * 1000 * 1000)
+
+//register reads of the simulated peripherals
+uint32_t sim_reg_read(uint32_t reg);
+#define REG_READ(reg) sim_reg_read(reg)
+
+#endif
@@ -0,0 +1,23 @@
+# Generates sdkconfig.h of the host simulation from the sdkconfig of the firmware.
+# Usage: cmake -DSDKCONFIG=<sdkconfig> -DOUTPUT=<sdkconfig.h> -P sdkconfig.cmake
+
+file(STRINGS "${SDKCONFIG}" lines REGEX "^CONFIG_[A-Za-z0-9_]+=")
+set(header "// generated from ${SDKCONFIG}, do not edit\n#pragma once\n\n")
+foreach(line IN LISTS lines)
+    string(REGEX MATCH "^(CONFIG_[A-Za-z0-9_]+)=(.*)$" match "${line}")
+    set(name "${CMAKE_MATCH_1}")
+    set(value "${CMAKE_MATCH_2}")
+    if(value STREQUAL "y")
+        set(value 1)
+    endif()
+    string(APPEND header "#define ${name} ${value}\n")
+endforeach()
+
+# only write on change, the firmware sources depend on the header
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" old)
+    if(old STREQUAL header)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT}" "${header}")
@@ -0,0 +1,79 @@
+#ifndef HOST_SIM_H_
+#define HOST_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+//no wake time
+#define SIM_NEVER INT64_MAX
+
+//model constants of the bus timing, see sim_config_t
+typedef struct {
+	int64_t duration_us;        //end of the simulation
+	double cpu_scale;           //host cpu time charged to the virtual clock, 0 keeps runs deterministic
+	uint32_t i2c_overhead_us;   //driver overhead of one I2C command link
+	uint32_t spi_overhead_us;   //driver overhead of one SPI transaction
+	uint32_t lcd_frame_gap_us;  //LCD idle time that ends a frame
+	int dump_every;             //dump every n-th frame, 0 only on the dump command
+	bool trace_tasks;           //trace every task switch
+	const char *out_dir;        //frame dumps, trace and report
+	const char *spiffs_dir;     //directory mounted as SPIFFS image
+	const char *assets_path;    //image of the assets partition
+	const char *nvs_path;       //text file backing the NVS partition
+	const char *script_path;    //scripted input and waveforms
+} sim_config_t;
+
+extern sim_config_t sim_config;
+
+//virtual clock
+int64_t sim_now_us(void);
+
+//scheduler
+typedef void (*sim_event_fn_t)(void *arg);
+void sim_schedule(int64_t at_us, sim_event_fn_t fn, void *arg);
+void sim_run(void (*app_main)(void));
+bool sim_in_isr(void);
+void sim_delay_us(int64_t us);
+const char *sim_current_task_name(void);
+void sim_task_report(FILE *out);
+
+//blocking on simulated objects, returns false on timeout
+int64_t sim_deadline(uint32_t ticks);
+bool sim_block(const void *object, int64_t deadline_us);
+void sim_wake(const void *object);
+
+//trace and report
+void sim_trace_open(void);
+void sim_trace(const char *source, const char *event, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void sim_mark(const char *kind, const char *name);
+void sim_report(void);
+void sim_bus_account(const char *bus, const char *device, int64_t start_us, int64_t duration_us, uint32_t bytes);
+
+//peripherals
+void sim_gpio_input(int gpio, int level);
+int sim_gpio_output(int gpio);
+void sim_lcd_dump(const char *name);
+void sim_lcd_frame_done(int64_t start_us, int64_t end_us, uint32_t bytes);
+void sim_uart_feed(const char *line);
+void sim_nvs_load(void);
+void sim_nvs_report(FILE *out);
+void sim_i2c_devices_init(void);
+double sim_ledc_level(int gpio);
+
+//power management and the current estimate
+void sim_pm_panel(bool on);
+void sim_pm_dispatch(void);
+void sim_pm_account(int64_t us, bool busy);
+void sim_pm_mark(const char *name);
+void sim_pm_report(FILE *out);
+
+//waveforms of the simulated sensors
+double sim_signal(const char *name);
+void sim_script_load(const char *path);
+
+//simulated expander inputs
+void sim_expander_set_pins(uint8_t port, uint8_t mask, uint8_t levels);
+
+#endif
@@ -0,0 +1,234 @@
+//ESP-IDF system services of the host simulation: errors, logging, esp_timer, heap and busy waits
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+#include "esp32/rom/ets_sys.h"
+#include "esp32/rom/crc.h"
+#include <zlib.h>
+#include "sim.h"
+
+//the heap is not tracked on the host, report the free heap of a running firmware
+#define SIM_FREE_HEAP 180000
+
+struct sim_esp_timer {
+	esp_timer_cb_t callback;
+	void *arg;
+	const char *name;
+	uint64_t period_us;
+	bool active;
+	uint32_t generation;
+	int64_t expiry_us;
+};
+
+typedef struct {
+	struct sim_esp_timer *timer;
+	uint32_t generation;
+} sim_esp_timer_shot_t;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+	switch(code)
+	{
+		case ESP_OK: return "ESP_OK";
+		case ESP_FAIL: return "ESP_FAIL";
+		case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+		case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+		case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+		case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+		case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+		case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+		case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+		case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+		case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+		case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+		case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+		case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+		case ESP_ERR_NVS_TYPE_MISMATCH: return "ESP_ERR_NVS_TYPE_MISMATCH";
+		case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+		case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+		case ESP_ERR_NVS_NO_FREE_PAGES: return "ESP_ERR_NVS_NO_FREE_PAGES";
+		case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+		default: return "UNKNOWN ERROR";
+	}
+}
+
+//logging, same line format as the ESP-IDF log with the virtual time stamp
+
+static esp_log_level_t sim_log_level = ESP_LOG_VERBOSE;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+	//per tag levels are not kept, the wildcard sets the global level
+	if(tag[0] == '*' && tag[1] == 0) sim_log_level = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+	return (uint32_t)(sim_now_us() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	static const char letters[] = "NEWIDV";
+	if(level > sim_log_level) return;
+	va_list args;
+	va_start(args, format);
+	printf("%c (%u) %s: ", letters[level], esp_log_timestamp(), tag);
+	vprintf(format, args);
+	printf("\n");
+	va_end(args);
+}
+
+//esp_timer, callbacks run like the esp_timer task between the tasks
+
+static void sim_esp_timer_arm(struct sim_esp_timer *timer, int64_t expiry_us);
+
+static void sim_esp_timer_fire(void *arg)
+{
+	sim_esp_timer_shot_t *shot = arg;
+	struct sim_esp_timer *timer = shot->timer;
+	bool current = timer->active && timer->generation == shot->generation;
+	free(shot);
+	if(!current) return;
+	if(timer->period_us) sim_esp_timer_arm(timer, timer->expiry_us + timer->period_us);
+	else timer->active = false;
+	timer->callback(timer->arg);
+}
+
+static void sim_esp_timer_arm(struct sim_esp_timer *timer, int64_t expiry_us)
+{
+	sim_esp_timer_shot_t *shot = malloc(sizeof(sim_esp_timer_shot_t));
+	shot->timer = timer;
+	shot->generation = timer->generation;
+	timer->expiry_us = expiry_us;
+	sim_schedule(expiry_us, sim_esp_timer_fire, shot);
+}
+
+int64_t esp_timer_get_time(void)
+{
+	return sim_now_us();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+	if(args == NULL || args->callback == NULL || handle == NULL) return ESP_ERR_INVALID_ARG;
+	struct sim_esp_timer *timer = calloc(1, sizeof(struct sim_esp_timer));
+	if(timer == NULL) return ESP_ERR_NO_MEM;
+	timer->callback = args->callback;
+	timer->arg = args->arg;
+	timer->name = args->name;
+	*handle = timer;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+	if(timer->active) return ESP_ERR_INVALID_STATE;
+	timer->active = true;
+	timer->period_us = 0;
+	timer->generation++;
+	sim_esp_timer_arm(timer, sim_now_us() + timeout_us);
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+	if(timer->active) return ESP_ERR_INVALID_STATE;
+	timer->active = true;
+	timer->period_us = period_us ? period_us : 1;
+	timer->generation++;
+	sim_esp_timer_arm(timer, sim_now_us() + timer->period_us);
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+	if(!timer->active) return ESP_ERR_INVALID_STATE;
+	timer->active = false;
+	timer->generation++;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+	if(timer->active) return ESP_ERR_INVALID_STATE;
+	//pending shots still point to the timer, it is kept
+	return ESP_OK;
+}
+
+//system
+
+uint32_t esp_get_free_heap_size(void)
+{
+	return SIM_FREE_HEAP;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+	return SIM_FREE_HEAP;
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+	return SIM_FREE_HEAP;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void)
+{
+	return SIM_FREE_HEAP;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+	return 0;
+}
+
+void esp_restart(void)
+{
+	fprintf(stderr, "sim: esp_restart at %lld us\n", (long long)sim_now_us());
+	sim_report();
+	exit(0);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+	return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+	return calloc(n, size);
+}
+
+void heap_caps_free(void *ptr)
+{
+	free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+	return SIM_FREE_HEAP;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	return SIM_FREE_HEAP / 2;
+}
+
+void ets_delay_us(uint32_t us)
+{
+	sim_delay_us(us);
+}
+
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	return crc32(crc, buf, len);
+}
@@ -0,0 +1,193 @@
+//GPIO matrix of the host simulation
+//
+//Inputs are driven by the script, outputs are traced. Unused pins read high
+//like the pulled up encoder and bus lines of the board.
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "sim.h"
+
+typedef struct {
+	uint8_t level;
+	gpio_mode_t mode;
+	gpio_int_type_t intr_type;
+	bool intr_enabled;
+	gpio_isr_t handler;
+	void *arg;
+} sim_pin_t;
+
+static sim_pin_t sim_pins[GPIO_NUM_MAX];
+static bool sim_gpio_ready = false;
+
+static sim_pin_t *sim_pin(gpio_num_t gpio)
+{
+	if(!sim_gpio_ready)
+	{
+		for(int i = 0; i < GPIO_NUM_MAX; i++) sim_pins[i].level = 1;
+		sim_gpio_ready = true;
+	}
+	if(gpio < 0 || gpio >= GPIO_NUM_MAX) return NULL;
+	return &sim_pins[gpio];
+}
+
+/**
+ * Drives an input pin and runs its interrupt handler on a matching edge.
+ * Called by the script in interrupt context.
+ */
+void sim_gpio_input(int gpio, int level)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return;
+	uint8_t last = pin->level;
+	pin->level = level ? 1 : 0;
+	if(pin->handler == NULL || !pin->intr_enabled) return;
+	bool fire = false;
+	switch(pin->intr_type)
+	{
+		case GPIO_INTR_POSEDGE: fire = !last && pin->level; break;
+		case GPIO_INTR_NEGEDGE: fire = last && !pin->level; break;
+		case GPIO_INTR_ANYEDGE: fire = last != pin->level; break;
+		case GPIO_INTR_LOW_LEVEL: fire = !pin->level; break;
+		case GPIO_INTR_HIGH_LEVEL: fire = pin->level; break;
+		default: break;
+	}
+	if(fire) pin->handler(pin->arg);
+}
+
+int sim_gpio_output(int gpio)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	return pin ? pin->level : 0;
+}
+
+uint32_t sim_reg_read(uint32_t reg)
+{
+	uint32_t value = 0;
+	int base = reg == GPIO_IN1_REG ? 32 : 0;
+	if(reg != GPIO_IN_REG && reg != GPIO_IN1_REG) return 0;
+	for(int i = 0; i < 32 && base + i < GPIO_NUM_MAX; i++)
+	{
+		if(sim_pin(base + i)->level) value |= 1u << i;
+	}
+	return value;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+	for(int i = 0; i < GPIO_NUM_MAX; i++)
+	{
+		if(!(config->pin_bit_mask & (1ULL << i))) continue;
+		sim_pin_t *pin = sim_pin(i);
+		pin->mode = config->mode;
+		pin->intr_type = config->intr_type;
+		pin->intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+	}
+	return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	memset(pin, 0, sizeof(sim_pin_t));
+	pin->level = 1;
+	return ESP_OK;
+}
+
+void gpio_pad_select_gpio(uint8_t gpio)
+{
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	pin->mode = mode;
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	level = level ? 1 : 0;
+	//the LCD data/command line toggles on every transfer and is left out of the trace
+	if(pin->level != level && gpio != CONFIG_DC_GPIO) sim_trace("gpio", "out", "%d=%u", gpio, level);
+	pin->level = level;
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	return pin ? pin->level : 0;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull)
+{
+	return sim_pin(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_pullup_en(gpio_num_t gpio)
+{
+	return sim_pin(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	pin->intr_type = type;
+	pin->intr_enabled = type != GPIO_INTR_DISABLE;
+	return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	pin->intr_enabled = true;
+	return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	pin->intr_enabled = false;
+	return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+	return ESP_OK;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	pin->handler = handler;
+	pin->arg = arg;
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio)
+{
+	sim_pin_t *pin = sim_pin(gpio);
+	if(pin == NULL) return ESP_ERR_INVALID_ARG;
+	pin->handler = NULL;
+	return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio, gpio_int_type_t type)
+{
+	return sim_pin(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,439 @@
+//I2C master driver of the host simulation with register models of the board devices
+//
+//A command link is executed byte by byte against the device models. The first
+//byte written after the address sets the register pointer, further bytes are
+//register data. The calling task is blocked for the time the transfer takes on
+//the bus: 9 clocks per byte plus start and stop, plus the driver overhead.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sdkconfig.h"
+#include "driver/i2c.h"
+#include "sim.h"
+
+typedef enum {
+	SIM_I2C_START,
+	SIM_I2C_STOP,
+	SIM_I2C_WRITE,
+	SIM_I2C_READ,
+} sim_i2c_op_type_t;
+
+typedef struct sim_i2c_op {
+	sim_i2c_op_type_t type;
+	uint8_t *data;
+	size_t length;
+	bool copied;
+	struct sim_i2c_op *next;
+} sim_i2c_op_t;
+
+typedef struct {
+	sim_i2c_op_t *first;
+	sim_i2c_op_t *last;
+} sim_i2c_link_t;
+
+typedef struct sim_i2c_device {
+	uint8_t addr;
+	const char *name;
+	uint8_t pointer;
+	uint8_t (*read_byte)(struct sim_i2c_device *dev, uint8_t reg, size_t index);
+	void (*write_byte)(struct sim_i2c_device *dev, uint8_t reg, size_t index, uint8_t value);
+	void *state;
+} sim_i2c_device_t;
+
+typedef struct {
+	uint32_t clk_speed;
+	int timeout;
+	bool installed;
+	int64_t busy_until_us;
+} sim_i2c_port_t;
+
+static sim_i2c_port_t sim_i2c_ports[I2C_NUM_MAX];
+
+#define SIM_I2C_MAX_DEVICES 8
+static sim_i2c_device_t sim_i2c_devices[SIM_I2C_MAX_DEVICES];
+static int sim_i2c_device_count = 0;
+
+static sim_i2c_device_t *sim_i2c_find(uint8_t addr)
+{
+	for(int i = 0; i < sim_i2c_device_count; i++)
+	{
+		if(sim_i2c_devices[i].addr == addr) return &sim_i2c_devices[i];
+	}
+	return NULL;
+}
+
+static void sim_i2c_add(uint8_t addr, const char *name, void *state,
+	uint8_t (*read_byte)(sim_i2c_device_t *, uint8_t, size_t),
+	void (*write_byte)(sim_i2c_device_t *, uint8_t, size_t, uint8_t))
+{
+	sim_i2c_device_t *dev = &sim_i2c_devices[sim_i2c_device_count++];
+	dev->addr = addr;
+	dev->name = name;
+	dev->state = state;
+	dev->read_byte = read_byte;
+	dev->write_byte = write_byte;
+}
+
+//INA220 current monitor, shunt and bus voltage come from the waveforms <name>.shunt_mv and <name>.bus_mv
+
+typedef struct {
+	const char *signal_shunt;
+	const char *signal_bus;
+	uint16_t config;
+	uint16_t calibration;
+	uint8_t pending;
+} sim_ina_t;
+
+static int16_t sim_ina_shunt(sim_ina_t *ina)
+{
+	double raw = round(sim_signal(ina->signal_shunt) * 100);
+	if(raw > 32000) raw = 32000;
+	if(raw < -32000) raw = -32000;
+	return (int16_t)raw;
+}
+
+static uint16_t sim_ina_register(sim_ina_t *ina, uint8_t reg)
+{
+	int16_t shunt = sim_ina_shunt(ina);
+	double bus_mv = sim_signal(ina->signal_bus);
+	uint16_t bus = bus_mv <= 0 ? 0 : (uint16_t)fmin(bus_mv / 4, 8000);
+	int32_t current = (int32_t)shunt * ina->calibration / 4096;
+	switch(reg)
+	{
+		case 0: return ina->config;
+		case 1: return (uint16_t)shunt;
+		//conversion ready, no overflow
+		case 2: return (uint16_t)(bus << 3) | 0x02;
+		case 3: return (uint16_t)(labs(current) * bus / 5000);
+		case 4: return (uint16_t)(int16_t)current;
+		case 5: return ina->calibration;
+		default: return 0;
+	}
+}
+
+static uint8_t sim_ina_read(sim_i2c_device_t *dev, uint8_t reg, size_t index)
+{
+	uint16_t value = sim_ina_register(dev->state, reg);
+	return index & 1 ? value & 0xFF : value >> 8;
+}
+
+static void sim_ina_write(sim_i2c_device_t *dev, uint8_t reg, size_t index, uint8_t value)
+{
+	sim_ina_t *ina = dev->state;
+	if(!(index & 1))
+	{
+		ina->pending = value;
+		return;
+	}
+	uint16_t word = (ina->pending << 8) | value;
+	if(reg == 0)
+	{
+		//reset bit restores the power on state
+		if(word & 0x8000)
+		{
+			ina->config = 0x399F;
+			ina->calibration = 0;
+		}
+		else ina->config = word;
+	}
+	else if(reg == 5) ina->calibration = word & 0xFFFE;
+}
+
+static sim_ina_t sim_ina1 = {"ina1.shunt_mv", "ina1.bus_mv", 0x399F, 0, 0};
+static sim_ina_t sim_ina2 = {"ina2.shunt_mv", "ina2.bus_mv", 0x399F, 0, 0};
+
+//AD7998 like ADC, converts the channel selected in the config register.
+//The channels are scaled to 3410 counts at the nominal rail voltage.
+
+typedef struct {
+	uint8_t regs[16][2];
+} sim_adc_t;
+
+static const char *sim_adc_signals[] = {"adc.out24", "adc.out5", "adc.out33", "adc.outvar", "adc.ch5", "adc.ch6", "adc.ch7", "adc.ch8"};
+static const double sim_adc_nominal[] = {24, 5, 3.3, 26, 1, 1, 1, 1};
+
+static uint16_t sim_adc_convert(sim_adc_t *adc)
+{
+	uint16_t config = (adc->regs[2][0] << 8) | adc->regs[2][1];
+	int channel = 0;
+	for(int i = 0; i < 8; i++)
+	{
+		if(config & (0x10 << i))
+		{
+			channel = i;
+			break;
+		}
+	}
+	double counts = round(sim_signal(sim_adc_signals[channel]) / sim_adc_nominal[channel] * 3410);
+	if(counts < 0) counts = 0;
+	if(counts > 4095) counts = 4095;
+	return (uint16_t)((channel << 12) | (uint16_t)counts);
+}
+
+static uint8_t sim_adc_read(sim_i2c_device_t *dev, uint8_t reg, size_t index)
+{
+	sim_adc_t *adc = dev->state;
+	if(reg == 0)
+	{
+		uint16_t value = sim_adc_convert(adc);
+		return index & 1 ? value & 0xFF : value >> 8;
+	}
+	return adc->regs[reg & 0x0F][index & 1];
+}
+
+static void sim_adc_write(sim_i2c_device_t *dev, uint8_t reg, size_t index, uint8_t value)
+{
+	sim_adc_t *adc = dev->state;
+	adc->regs[reg & 0x0F][index & 1] = value;
+}
+
+static sim_adc_t sim_adc;
+
+//PCAL9555A expander, inputs are driven by the script, the outputs of port 1 are traced
+
+typedef struct {
+	uint8_t regs[0x50];
+	uint8_t pins[2];
+	uint8_t last_read[2];
+	uint8_t int_status[2];
+} sim_expander_t;
+
+static sim_expander_t sim_expander;
+
+static void sim_expander_int_update(void)
+{
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+	bool active = ((sim_expander.int_status[0] & ~sim_expander.regs[0x4A]) | (sim_expander.int_status[1] & ~sim_expander.regs[0x4B])) != 0;
+	sim_gpio_input(CONFIG_EXPANDER_INT_GPIO, active ? 0 : 1);
+#endif
+}
+
+/**
+ * Drives input pins of the expander, changed pins raise the interrupt.
+ */
+void sim_expander_set_pins(uint8_t port, uint8_t mask, uint8_t levels)
+{
+	port &= 1;
+	uint8_t pins = (sim_expander.pins[port] & ~mask) | (levels & mask);
+	sim_expander.int_status[port] |= pins ^ sim_expander.last_read[port];
+	sim_expander.pins[port] = pins;
+	sim_expander_int_update();
+}
+
+static uint8_t sim_expander_read(sim_i2c_device_t *dev, uint8_t reg, size_t index)
+{
+	//register pairs of port 0 and port 1 are read alternately
+	uint8_t r = reg ^ (index & 1);
+	if(r < 0x02)
+	{
+		uint8_t port = r & 1;
+		//reading the input port clears the interrupt of the port
+		sim_expander.last_read[port] = sim_expander.pins[port];
+		sim_expander.int_status[port] = 0;
+		sim_expander_int_update();
+		return sim_expander.pins[port] ^ sim_expander.regs[0x04 + port];
+	}
+	if(r == 0x4C || r == 0x4D) return sim_expander.int_status[r & 1];
+	return r < sizeof(sim_expander.regs) ? sim_expander.regs[r] : 0;
+}
+
+static void sim_expander_write(sim_i2c_device_t *dev, uint8_t reg, size_t index, uint8_t value)
+{
+	uint8_t r = reg ^ (index & 1);
+	if(r >= sizeof(sim_expander.regs)) return;
+	if((r == 0x02 || r == 0x03) && sim_expander.regs[r] != value)
+	{
+		sim_trace("expander", "out", "port%u=0x%02x", r - 0x02, value);
+	}
+	sim_expander.regs[r] = value;
+}
+
+/**
+ * Registers the device models of the board on port 0.
+ */
+void sim_i2c_devices_init(void)
+{
+	sim_expander.pins[0] = 0xFF;
+	sim_expander.pins[1] = 0xFF;
+	sim_expander.last_read[0] = 0xFF;
+	sim_expander.last_read[1] = 0xFF;
+	memset(sim_expander.regs + 0x06, 0xFF, 2);
+	sim_i2c_add(0x40, "ina1", &sim_ina1, sim_ina_read, sim_ina_write);
+	sim_i2c_add(0x41, "ina2", &sim_ina2, sim_ina_read, sim_ina_write);
+	sim_i2c_add(0x23, "adc", &sim_adc, sim_adc_read, sim_adc_write);
+	sim_i2c_add(0x20, "expander", &sim_expander, sim_expander_read, sim_expander_write);
+}
+
+//driver
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config)
+{
+	if(port < 0 || port >= I2C_NUM_MAX || config == NULL) return ESP_ERR_INVALID_ARG;
+	sim_i2c_ports[port].clk_speed = config->master.clk_speed;
+	return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+	if(port < 0 || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	if(sim_i2c_ports[port].installed) return ESP_FAIL;
+	sim_i2c_ports[port].installed = true;
+	return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t port)
+{
+	if(port < 0 || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	sim_i2c_ports[port].installed = false;
+	return ESP_OK;
+}
+
+esp_err_t i2c_set_timeout(i2c_port_t port, int timeout)
+{
+	if(port < 0 || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	sim_i2c_ports[port].timeout = timeout;
+	return ESP_OK;
+}
+
+esp_err_t i2c_get_timeout(i2c_port_t port, int *timeout)
+{
+	if(port < 0 || port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	*timeout = sim_i2c_ports[port].timeout;
+	return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+	return calloc(1, sizeof(sim_i2c_link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+	sim_i2c_link_t *link = cmd;
+	if(link == NULL) return;
+	sim_i2c_op_t *op = link->first;
+	while(op)
+	{
+		sim_i2c_op_t *next = op->next;
+		if(op->copied) free(op->data);
+		free(op);
+		op = next;
+	}
+	free(link);
+}
+
+static esp_err_t sim_i2c_append(i2c_cmd_handle_t cmd, sim_i2c_op_type_t type, uint8_t *data, size_t length, bool copy)
+{
+	sim_i2c_link_t *link = cmd;
+	sim_i2c_op_t *op = calloc(1, sizeof(sim_i2c_op_t));
+	if(op == NULL) return ESP_ERR_NO_MEM;
+	op->type = type;
+	op->length = length;
+	op->copied = copy;
+	if(copy)
+	{
+		op->data = malloc(length);
+		memcpy(op->data, data, length);
+	}
+	else op->data = data;
+	if(link->last) link->last->next = op;
+	else link->first = op;
+	link->last = op;
+	return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+	return sim_i2c_append(cmd, SIM_I2C_START, NULL, 0, false);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+	return sim_i2c_append(cmd, SIM_I2C_STOP, NULL, 0, false);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+{
+	return sim_i2c_append(cmd, SIM_I2C_WRITE, &data, 1, true);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t data_len, bool ack_en)
+{
+	return sim_i2c_append(cmd, SIM_I2C_WRITE, (uint8_t *)data, data_len, true);
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack)
+{
+	return sim_i2c_append(cmd, SIM_I2C_READ, data, 1, false);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+	return sim_i2c_append(cmd, SIM_I2C_READ, data, data_len, false);
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait)
+{
+	if(port < 0 || port >= I2C_NUM_MAX || !sim_i2c_ports[port].installed) return ESP_ERR_INVALID_STATE;
+	sim_i2c_link_t *link = cmd;
+	sim_i2c_device_t *dev = NULL;
+	bool expect_addr = false;
+	bool nack = false;
+	size_t index = 0;
+	size_t write_count = 0;
+	uint32_t bytes = 0;
+	uint32_t bits = 0;
+
+	for(sim_i2c_op_t *op = link->first; op && !nack; op = op->next)
+	{
+		switch(op->type)
+		{
+			case SIM_I2C_START:
+				expect_addr = true;
+				bits++;
+				break;
+			case SIM_I2C_STOP:
+				bits++;
+				break;
+			case SIM_I2C_WRITE:
+				for(size_t i = 0; i < op->length && !nack; i++)
+				{
+					uint8_t byte = op->data[i];
+					bytes++;
+					bits += 9;
+					if(expect_addr)
+					{
+						expect_addr = false;
+						dev = sim_i2c_find(byte >> 1);
+						nack = dev == NULL;
+						index = 0;
+						write_count = 0;
+						continue;
+					}
+					if(dev == NULL) continue;
+					if(write_count++ == 0) dev->pointer = byte;
+					else dev->write_byte(dev, dev->pointer, index++, byte);
+				}
+				break;
+			case SIM_I2C_READ:
+				for(size_t i = 0; i < op->length; i++)
+				{
+					bytes++;
+					bits += 9;
+					op->data[i] = dev ? dev->read_byte(dev, dev->pointer, index++) : 0xFF;
+				}
+				break;
+		}
+	}
+
+	//the transfer starts when the port is free, bus time blocks the calling task
+	uint32_t clk = sim_i2c_ports[port].clk_speed ? sim_i2c_ports[port].clk_speed : 100000;
+	int64_t start = sim_now_us();
+	if(sim_i2c_ports[port].busy_until_us > start) start = sim_i2c_ports[port].busy_until_us;
+	int64_t duration = (int64_t)bits * 1000000 / clk + sim_config.i2c_overhead_us;
+	sim_i2c_ports[port].busy_until_us = start + duration;
+	sim_bus_account("i2c", dev ? dev->name : "none", start, duration, bytes);
+	sim_delay_us(start + duration - sim_now_us());
+	return nack ? ESP_FAIL : ESP_OK;
+}
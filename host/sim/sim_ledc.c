@@ -0,0 +1,113 @@
+//LEDC PWM driver of the host simulation, duty and frequency changes are traced
+
+#include "driver/ledc.h"
+#include "sim.h"
+
+typedef struct {
+	int gpio;
+	ledc_timer_t timer;
+	uint32_t duty;
+	uint32_t pending_duty;
+} sim_ledc_channel_t;
+
+static uint32_t sim_ledc_freq[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+static ledc_timer_bit_t sim_ledc_resolution[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+static sim_ledc_channel_t sim_ledc_channels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *config)
+{
+	if(config->speed_mode >= LEDC_SPEED_MODE_MAX || config->timer_num >= LEDC_TIMER_MAX) return ESP_ERR_INVALID_ARG;
+	sim_ledc_freq[config->speed_mode][config->timer_num] = config->freq_hz;
+	sim_ledc_resolution[config->speed_mode][config->timer_num] = config->duty_resolution;
+	return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *config)
+{
+	if(config->speed_mode >= LEDC_SPEED_MODE_MAX || config->channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+	sim_ledc_channel_t *ch = &sim_ledc_channels[config->speed_mode][config->channel];
+	ch->gpio = config->gpio_num;
+	ch->timer = config->timer_sel;
+	ch->duty = config->duty;
+	ch->pending_duty = config->duty;
+	return ESP_OK;
+}
+
+esp_err_t ledc_set_freq(ledc_mode_t mode, ledc_timer_t timer, uint32_t freq_hz)
+{
+	if(mode >= LEDC_SPEED_MODE_MAX || timer >= LEDC_TIMER_MAX) return ESP_ERR_INVALID_ARG;
+	if(sim_ledc_freq[mode][timer] != freq_hz) sim_trace("ledc", "freq", "timer%d=%u", timer, freq_hz);
+	sim_ledc_freq[mode][timer] = freq_hz;
+	return ESP_OK;
+}
+
+uint32_t ledc_get_freq(ledc_mode_t mode, ledc_timer_t timer)
+{
+	return sim_ledc_freq[mode][timer];
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+	if(mode >= LEDC_SPEED_MODE_MAX || channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+	sim_ledc_channels[mode][channel].pending_duty = duty;
+	return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+	return sim_ledc_channels[mode][channel].duty;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+	if(mode >= LEDC_SPEED_MODE_MAX || channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+	sim_ledc_channel_t *ch = &sim_ledc_channels[mode][channel];
+	if(ch->duty != ch->pending_duty) sim_trace("ledc", "duty", "gpio%d=%u", ch->gpio, ch->pending_duty);
+	ch->duty = ch->pending_duty;
+	return ESP_OK;
+}
+
+esp_err_t ledc_stop(ledc_mode_t mode, ledc_channel_t channel, uint32_t idle_level)
+{
+	ledc_set_duty(mode, channel, 0);
+	return ledc_update_duty(mode, channel);
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags)
+{
+	return ESP_OK;
+}
+
+void ledc_fade_func_uninstall(void)
+{
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t channel, uint32_t target_duty, int max_fade_time_ms)
+{
+	//fades end at once on the host
+	return ledc_set_duty(mode, channel, target_duty);
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t mode, ledc_channel_t channel, ledc_fade_mode_t fade_mode)
+{
+	return ledc_update_duty(mode, channel);
+}
+
+/**
+ * Duty of the channel driving a pin, 0 to 1. A pin without a channel is off,
+ * no pin (-1) is wired to the supply and always on.
+ */
+double sim_ledc_level(int gpio)
+{
+	if(gpio < 0) return 1.0;
+	for(int mode = 0; mode < LEDC_SPEED_MODE_MAX; mode++)
+	{
+		for(int channel = 0; channel < LEDC_CHANNEL_MAX; channel++)
+		{
+			sim_ledc_channel_t *ch = &sim_ledc_channels[mode][channel];
+			ledc_timer_bit_t bits = sim_ledc_resolution[mode][ch->timer];
+			if(ch->gpio == gpio && bits > 0) return (double)ch->duty / ((1u << bits) - 1);
+		}
+	}
+	return 0.0;
+}
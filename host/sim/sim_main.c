@@ -0,0 +1,120 @@
+//Entry point of the host simulation, runs app_main of the firmware on the virtual clock
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "sim.h"
+
+#ifndef SIM_DEFAULT_SPIFFS
+#define SIM_DEFAULT_SPIFFS "font"
+#endif
+#ifndef SIM_DEFAULT_ASSETS
+#define SIM_DEFAULT_ASSETS ""
+#endif
+
+void app_main(void);
+
+sim_config_t sim_config = {
+	.duration_us = 10 * 1000000LL,
+	.cpu_scale = 0,
+	.i2c_overhead_us = 30,
+	.spi_overhead_us = 15,
+	.lcd_frame_gap_us = 5000,
+	.dump_every = 0,
+	.trace_tasks = false,
+	.out_dir = "sim_out",
+	.spiffs_dir = SIM_DEFAULT_SPIFFS,
+	.assets_path = SIM_DEFAULT_ASSETS,
+	.nvs_path = NULL,
+	.script_path = NULL,
+};
+
+static void sim_usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+		"Runs the PSU firmware on a virtual clock with simulated peripherals.\n\n"
+		"  -t, --time <ms>          simulated time (default %lld)\n"
+		"  -s, --script <file>      scripted inputs and waveforms, see sim_script.c\n"
+		"  -o, --out <dir>          frame dumps, trace.csv and report.txt (default %s)\n"
+		"  -f, --spiffs <dir>       directory mounted at /spiffs (default %s)\n"
+		"  -a, --assets <file>      image of the assets partition, \"\" for none (default %s)\n"
+		"  -n, --nvs <file>         NVS contents, kept between runs (default in memory)\n"
+		"  -d, --dump-every <n>     dump every n-th LCD frame (default off)\n"
+		"  -g, --frame-gap <us>     LCD idle time that ends a frame (default %u)\n"
+		"      --i2c-overhead <us>  driver time per I2C transfer (default %u)\n"
+		"      --spi-overhead <us>  driver time per SPI transaction (default %u)\n"
+		"      --cpu-scale <x>      charge host CPU time x-fold to the clock, not reproducible (default 0)\n"
+		"      --trace-tasks        trace every task switch\n"
+		"  -h, --help               this text\n",
+		name, (long long)(sim_config.duration_us / 1000), sim_config.out_dir, sim_config.spiffs_dir, sim_config.assets_path,
+		sim_config.lcd_frame_gap_us, sim_config.i2c_overhead_us, sim_config.spi_overhead_us);
+}
+
+int main(int argc, char **argv)
+{
+	enum {
+		OPT_I2C_OVERHEAD = 256,
+		OPT_SPI_OVERHEAD,
+		OPT_CPU_SCALE,
+		OPT_TRACE_TASKS,
+	};
+	static const struct option options[] = {
+		{"time", required_argument, NULL, 't'},
+		{"script", required_argument, NULL, 's'},
+		{"out", required_argument, NULL, 'o'},
+		{"spiffs", required_argument, NULL, 'f'},
+		{"assets", required_argument, NULL, 'a'},
+		{"nvs", required_argument, NULL, 'n'},
+		{"dump-every", required_argument, NULL, 'd'},
+		{"frame-gap", required_argument, NULL, 'g'},
+		{"i2c-overhead", required_argument, NULL, OPT_I2C_OVERHEAD},
+		{"spi-overhead", required_argument, NULL, OPT_SPI_OVERHEAD},
+		{"cpu-scale", required_argument, NULL, OPT_CPU_SCALE},
+		{"trace-tasks", no_argument, NULL, OPT_TRACE_TASKS},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	int opt;
+	while((opt = getopt_long(argc, argv, "t:s:o:f:a:n:d:g:h", options, NULL)) != -1)
+	{
+		switch(opt)
+		{
+			case 't': sim_config.duration_us = (int64_t)(atof(optarg) * 1000); break;
+			case 's': sim_config.script_path = optarg; break;
+			case 'o': sim_config.out_dir = optarg; break;
+			case 'f': sim_config.spiffs_dir = optarg; break;
+			case 'a': sim_config.assets_path = optarg; break;
+			case 'n': sim_config.nvs_path = optarg; break;
+			case 'd': sim_config.dump_every = atoi(optarg); break;
+			case 'g': sim_config.lcd_frame_gap_us = atoi(optarg); break;
+			case OPT_I2C_OVERHEAD: sim_config.i2c_overhead_us = atoi(optarg); break;
+			case OPT_SPI_OVERHEAD: sim_config.spi_overhead_us = atoi(optarg); break;
+			case OPT_CPU_SCALE: sim_config.cpu_scale = atof(optarg); break;
+			case OPT_TRACE_TASKS: sim_config.trace_tasks = true; break;
+			case 'h':
+				sim_usage(argv[0]);
+				return 0;
+			default:
+				sim_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(mkdir(sim_config.out_dir, 0755) != 0 && errno != EEXIST)
+	{
+		fprintf(stderr, "sim: could not create %s\n", sim_config.out_dir);
+		return 1;
+	}
+	//console output is interleaved with the report
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	sim_trace_open();
+	sim_i2c_devices_init();
+	if(sim_config.script_path) sim_script_load(sim_config.script_path);
+	sim_run(app_main);
+	sim_lcd_dump("final");
+	sim_report();
+	return 0;
+}
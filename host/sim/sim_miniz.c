@@ -0,0 +1,67 @@
+//tinfl subset of the ESP32 ROM miniz for pngle, implemented over the host zlib
+
+#include <stdlib.h>
+#include <zlib.h>
+#include "esp32/rom/miniz.h"
+
+mz_ulong mz_crc32(mz_ulong crc, const unsigned char *ptr, size_t buf_len)
+{
+	return crc32(crc, ptr, (uInt)buf_len);
+}
+
+/**
+ * Resets the decompressor. pngle calls this before it frees the decoder,
+ * so the zlib stream is released here and created again on first use.
+ */
+void sim_tinfl_init(tinfl_decompressor *r)
+{
+	if(r->stream)
+	{
+		inflateEnd(r->stream);
+		free(r->stream);
+	}
+	r->stream = NULL;
+	r->done = 0;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *in_buf_next, size_t *in_buf_size,
+	mz_uint8 *out_buf_start, mz_uint8 *out_buf_next, size_t *out_buf_size, const mz_uint32 decomp_flags)
+{
+	if(r->done)
+	{
+		*in_buf_size = 0;
+		*out_buf_size = 0;
+		return TINFL_STATUS_DONE;
+	}
+	if(r->stream == NULL)
+	{
+		z_stream *stream = calloc(1, sizeof(z_stream));
+		if(stream == NULL) return TINFL_STATUS_FAILED;
+		//raw deflate unless the zlib header is parsed
+		if(inflateInit2(stream, (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK)
+		{
+			free(stream);
+			return TINFL_STATUS_FAILED;
+		}
+		r->stream = stream;
+	}
+	z_stream *stream = r->stream;
+	stream->next_in = (Bytef *)in_buf_next;
+	stream->avail_in = (uInt)*in_buf_size;
+	stream->next_out = out_buf_next;
+	stream->avail_out = (uInt)*out_buf_size;
+	int ret = inflate(stream, Z_NO_FLUSH);
+	*in_buf_size -= stream->avail_in;
+	*out_buf_size -= stream->avail_out;
+	switch(ret)
+	{
+		case Z_STREAM_END:
+			r->done = 1;
+			return TINFL_STATUS_DONE;
+		case Z_OK:
+		case Z_BUF_ERROR:
+			return stream->avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+		default:
+			return TINFL_STATUS_FAILED;
+	}
+}
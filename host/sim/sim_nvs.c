@@ -0,0 +1,315 @@
+//NVS of the host simulation, backed by a text file with one entry per line:
+//  <namespace> <key> i32|u32 <value>
+//  <namespace> <key> blob <hex bytes>
+//The file is read by nvs_flash_init and rewritten on every commit. Opens, reads,
+//writes (set and erase, each a flash write on the target) and commits are counted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs_flash.h"
+#include "sim.h"
+
+#define SIM_NVS_MAX_ENTRIES 128
+#define SIM_NVS_MAX_HANDLES 8
+#define SIM_NVS_MAX_BLOB    1024
+
+typedef enum {
+	SIM_NVS_I32,
+	SIM_NVS_U32,
+	SIM_NVS_BLOB,
+} sim_nvs_type_t;
+
+typedef struct {
+	bool used;
+	char space[16];
+	char key[16];
+	sim_nvs_type_t type;
+	int64_t value;
+	uint8_t *blob;
+	size_t length;
+} sim_nvs_entry_t;
+
+typedef struct {
+	bool open;
+	bool writable;
+	char space[16];
+} sim_nvs_handle_t;
+
+static sim_nvs_entry_t sim_nvs_entries[SIM_NVS_MAX_ENTRIES];
+static sim_nvs_handle_t sim_nvs_handles[SIM_NVS_MAX_HANDLES];
+static bool sim_nvs_initialized = false;
+static uint32_t sim_nvs_opens = 0;
+static uint32_t sim_nvs_reads = 0;
+static uint32_t sim_nvs_writes = 0;
+static uint32_t sim_nvs_commits = 0;
+
+static sim_nvs_entry_t *sim_nvs_find(const char *space, const char *key)
+{
+	for(int i = 0; i < SIM_NVS_MAX_ENTRIES; i++)
+	{
+		sim_nvs_entry_t *entry = &sim_nvs_entries[i];
+		if(entry->used && strcmp(entry->space, space) == 0 && strcmp(entry->key, key) == 0) return entry;
+	}
+	return NULL;
+}
+
+static sim_nvs_entry_t *sim_nvs_new(const char *space, const char *key)
+{
+	sim_nvs_entry_t *entry = sim_nvs_find(space, key);
+	if(entry)
+	{
+		free(entry->blob);
+		entry->blob = NULL;
+		return entry;
+	}
+	for(int i = 0; i < SIM_NVS_MAX_ENTRIES; i++)
+	{
+		entry = &sim_nvs_entries[i];
+		if(entry->used) continue;
+		memset(entry, 0, sizeof(sim_nvs_entry_t));
+		entry->used = true;
+		snprintf(entry->space, sizeof(entry->space), "%s", space);
+		snprintf(entry->key, sizeof(entry->key), "%s", key);
+		return entry;
+	}
+	return NULL;
+}
+
+/**
+ * Reads the backing file, a missing file is an erased partition.
+ */
+void sim_nvs_load(void)
+{
+	if(sim_config.nvs_path == NULL) return;
+	FILE *f = fopen(sim_config.nvs_path, "r");
+	if(f == NULL) return;
+	char line[2 * SIM_NVS_MAX_BLOB + 64];
+	while(fgets(line, sizeof(line), f))
+	{
+		char space[16], key[16], type[8], value[2 * SIM_NVS_MAX_BLOB + 1];
+		if(line[0] == '#' || sscanf(line, "%15s %15s %7s %2048s", space, key, type, value) != 4) continue;
+		sim_nvs_entry_t *entry = sim_nvs_new(space, key);
+		if(entry == NULL) break;
+		if(strcmp(type, "blob") == 0)
+		{
+			entry->type = SIM_NVS_BLOB;
+			entry->length = strlen(value) / 2;
+			entry->blob = malloc(entry->length ? entry->length : 1);
+			for(size_t i = 0; i < entry->length; i++) sscanf(value + 2 * i, "%2hhx", &entry->blob[i]);
+		}
+		else
+		{
+			entry->type = strcmp(type, "u32") == 0 ? SIM_NVS_U32 : SIM_NVS_I32;
+			entry->value = strtoll(value, NULL, 0);
+		}
+	}
+	fclose(f);
+}
+
+static esp_err_t sim_nvs_save(void)
+{
+	if(sim_config.nvs_path == NULL) return ESP_OK;
+	FILE *f = fopen(sim_config.nvs_path, "w");
+	if(f == NULL) return ESP_FAIL;
+	for(int i = 0; i < SIM_NVS_MAX_ENTRIES; i++)
+	{
+		sim_nvs_entry_t *entry = &sim_nvs_entries[i];
+		if(!entry->used) continue;
+		if(entry->type == SIM_NVS_BLOB)
+		{
+			fprintf(f, "%s %s blob ", entry->space, entry->key);
+			for(size_t j = 0; j < entry->length; j++) fprintf(f, "%02x", entry->blob[j]);
+			fprintf(f, "\n");
+		}
+		else fprintf(f, "%s %s %s %lld\n", entry->space, entry->key, entry->type == SIM_NVS_U32 ? "u32" : "i32", (long long)entry->value);
+	}
+	fclose(f);
+	return ESP_OK;
+}
+
+static sim_nvs_handle_t *sim_nvs_handle(nvs_handle_t handle)
+{
+	if(handle == 0 || handle > SIM_NVS_MAX_HANDLES || !sim_nvs_handles[handle - 1].open) return NULL;
+	return &sim_nvs_handles[handle - 1];
+}
+
+esp_err_t nvs_flash_init(void)
+{
+	if(!sim_nvs_initialized) sim_nvs_load();
+	sim_nvs_initialized = true;
+	return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+	for(int i = 0; i < SIM_NVS_MAX_ENTRIES; i++)
+	{
+		free(sim_nvs_entries[i].blob);
+		memset(&sim_nvs_entries[i], 0, sizeof(sim_nvs_entry_t));
+	}
+	return sim_nvs_save();
+}
+
+esp_err_t nvs_flash_deinit(void)
+{
+	sim_nvs_initialized = false;
+	return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *handle)
+{
+	if(!sim_nvs_initialized) return ESP_ERR_NVS_NOT_INITIALIZED;
+	if(strlen(name) > 15) return ESP_ERR_NVS_KEY_TOO_LONG;
+	for(int i = 0; i < SIM_NVS_MAX_HANDLES; i++)
+	{
+		if(sim_nvs_handles[i].open) continue;
+		sim_nvs_opens++;
+		sim_nvs_handles[i].open = true;
+		sim_nvs_handles[i].writable = open_mode == NVS_READWRITE;
+		snprintf(sim_nvs_handles[i].space, sizeof(sim_nvs_handles[i].space), "%s", name);
+		*handle = i + 1;
+		return ESP_OK;
+	}
+	return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h) h->open = false;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+	if(sim_nvs_handle(handle) == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	sim_nvs_commits++;
+	sim_trace("nvs", "commit", "%u", sim_nvs_commits);
+	return sim_nvs_save();
+}
+
+static esp_err_t sim_nvs_get(nvs_handle_t handle, const char *key, sim_nvs_type_t type, int64_t *value)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	sim_nvs_reads++;
+	sim_nvs_entry_t *entry = sim_nvs_find(h->space, key);
+	if(entry == NULL) return ESP_ERR_NVS_NOT_FOUND;
+	if(entry->type != type) return ESP_ERR_NVS_TYPE_MISMATCH;
+	*value = entry->value;
+	return ESP_OK;
+}
+
+static esp_err_t sim_nvs_set(nvs_handle_t handle, const char *key, sim_nvs_type_t type, int64_t value)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	if(!h->writable) return ESP_ERR_NVS_READ_ONLY;
+	if(strlen(key) > 15) return ESP_ERR_NVS_KEY_TOO_LONG;
+	sim_nvs_entry_t *entry = sim_nvs_new(h->space, key);
+	if(entry == NULL) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	sim_nvs_writes++;
+	entry->type = type;
+	entry->value = value;
+	return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *value)
+{
+	int64_t v;
+	esp_err_t err = sim_nvs_get(handle, key, SIM_NVS_I32, &v);
+	if(err == ESP_OK) *value = (int32_t)v;
+	return err;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+{
+	return sim_nvs_set(handle, key, SIM_NVS_I32, value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *value)
+{
+	int64_t v;
+	esp_err_t err = sim_nvs_get(handle, key, SIM_NVS_U32, &v);
+	if(err == ESP_OK) *value = (uint32_t)v;
+	return err;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+	return sim_nvs_set(handle, key, SIM_NVS_U32, value);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	sim_nvs_reads++;
+	sim_nvs_entry_t *entry = sim_nvs_find(h->space, key);
+	if(entry == NULL) return ESP_ERR_NVS_NOT_FOUND;
+	if(entry->type != SIM_NVS_BLOB) return ESP_ERR_NVS_TYPE_MISMATCH;
+	//without a buffer only the length is returned
+	if(value == NULL)
+	{
+		*length = entry->length;
+		return ESP_OK;
+	}
+	if(*length < entry->length)
+	{
+		*length = entry->length;
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	}
+	memcpy(value, entry->blob, entry->length);
+	*length = entry->length;
+	return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	if(!h->writable) return ESP_ERR_NVS_READ_ONLY;
+	if(strlen(key) > 15) return ESP_ERR_NVS_KEY_TOO_LONG;
+	if(length > SIM_NVS_MAX_BLOB) return ESP_ERR_NVS_VALUE_TOO_LONG;
+	sim_nvs_entry_t *entry = sim_nvs_new(h->space, key);
+	if(entry == NULL) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	sim_nvs_writes++;
+	entry->type = SIM_NVS_BLOB;
+	entry->length = length;
+	entry->blob = malloc(length ? length : 1);
+	memcpy(entry->blob, value, length);
+	return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	if(!h->writable) return ESP_ERR_NVS_READ_ONLY;
+	sim_nvs_entry_t *entry = sim_nvs_find(h->space, key);
+	if(entry == NULL) return ESP_ERR_NVS_NOT_FOUND;
+	sim_nvs_writes++;
+	free(entry->blob);
+	memset(entry, 0, sizeof(sim_nvs_entry_t));
+	return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+	sim_nvs_handle_t *h = sim_nvs_handle(handle);
+	if(h == NULL) return ESP_ERR_NVS_INVALID_HANDLE;
+	if(!h->writable) return ESP_ERR_NVS_READ_ONLY;
+	for(int i = 0; i < SIM_NVS_MAX_ENTRIES; i++)
+	{
+		sim_nvs_entry_t *entry = &sim_nvs_entries[i];
+		if(!entry->used || strcmp(entry->space, h->space) != 0) continue;
+		free(entry->blob);
+		memset(entry, 0, sizeof(sim_nvs_entry_t));
+	}
+	return ESP_OK;
+}
+
+void sim_nvs_report(FILE *out)
+{
+	fprintf(out, "NVS: %u opens, %u reads, %u writes, %u commits\n\n", sim_nvs_opens, sim_nvs_reads, sim_nvs_writes, sim_nvs_commits);
+}
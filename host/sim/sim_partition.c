@@ -0,0 +1,66 @@
+//Flash partitions of the host simulation, only the assets partition of partitions_example.csv.
+//It is backed by the image of tools/assetpack.py, read once and handed out by esp_partition_mmap.
+//Without an image there is no assets partition and the firmware reads everything from SPIFFS.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "sim.h"
+
+//size of the assets partition in partitions_example.csv
+#define SIM_ASSETS_SIZE 0x40000
+
+static esp_partition_t sim_assets_partition = {
+	.type = ESP_PARTITION_TYPE_DATA,
+	.subtype = 0x40,
+	.address = 0x200000,
+	.size = SIM_ASSETS_SIZE,
+	.label = "assets",
+};
+//contents of the partition, erased flash after the image
+static uint8_t *sim_assets_flash = NULL;
+static int sim_assets_maps = 0;
+
+static bool sim_assets_load(void)
+{
+	if(sim_assets_flash) return true;
+	if(sim_config.assets_path == NULL || sim_config.assets_path[0] == 0) return false;
+	FILE *f = fopen(sim_config.assets_path, "rb");
+	if(f == NULL) return false;
+	sim_assets_flash = malloc(SIM_ASSETS_SIZE);
+	memset(sim_assets_flash, 0xFF, SIM_ASSETS_SIZE);
+	size_t len = fread(sim_assets_flash, 1, SIM_ASSETS_SIZE, f);
+	bool too_big = fgetc(f) != EOF;
+	fclose(f);
+	if(too_big)
+	{
+		fprintf(stderr, "sim: %s does not fit the assets partition\n", sim_config.assets_path);
+		free(sim_assets_flash);
+		sim_assets_flash = NULL;
+		return false;
+	}
+	sim_trace("flash", "assets", "%zu bytes from %s", len, sim_config.assets_path);
+	return true;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	if(type != sim_assets_partition.type) return NULL;
+	if(subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != sim_assets_partition.subtype) return NULL;
+	if(label && strcmp(label, sim_assets_partition.label) != 0) return NULL;
+	return sim_assets_load() ? &sim_assets_partition : NULL;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+	spi_flash_mmap_memory_t memory, const void **out_ptr, spi_flash_mmap_handle_t *out_handle)
+{
+	if(partition != &sim_assets_partition || offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+	*out_ptr = sim_assets_flash + offset;
+	*out_handle = ++sim_assets_maps;
+	return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+}
@@ -0,0 +1,213 @@
+//Power management of the host simulation and a rough estimate of the supply current
+//
+//The time the scheduler has no ready task is split into CPU idle and automatic
+//light sleep: light sleep needs esp_pm_configure with light_sleep_enable, no
+//power management lock and a gap of at least CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP
+//ticks. Bus transfers and busy waits count as active, every dispatch of a task is
+//charged SIM_PM_RUN_US of active CPU time. Panel and backlight add their current
+//from the display commands and the backlight PWM. The currents are datasheet
+//ballpark figures, good for comparing runs, not absolute values.
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "sim.h"
+
+//supply currents in mA
+#define SIM_PM_CPU_ACTIVE_MA    50.0    //240 MHz, tasks running or waiting for a bus
+#define SIM_PM_CPU_IDLE_MA      30.0    //idle task, clocks running
+#define SIM_PM_CPU_SLEEP_MA     0.8     //automatic light sleep
+#define SIM_PM_PANEL_ON_MA      3.0
+#define SIM_PM_PANEL_OFF_MA     1.0     //display off, controller powered
+#define SIM_PM_BACKLIGHT_MA     20.0    //full brightness
+
+//CPU time charged per task dispatch, task code takes no virtual time
+#define SIM_PM_RUN_US 100
+
+#ifndef CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP
+#define CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP 3
+#endif
+
+#define SIM_PM_MAX_MARKS 32
+
+struct sim_pm_lock {
+	esp_pm_lock_type_t type;
+	int count;
+	const char *name;
+};
+
+//accumulated time in us and charge in mA*us
+typedef struct {
+	int64_t active_us;
+	int64_t idle_us;
+	int64_t sleep_us;
+	int64_t panel_on_us;
+	double backlight;
+	double charge;
+	int64_t time_us;
+} sim_pm_totals_t;
+
+typedef struct {
+	char name[32];
+	int64_t time_us;
+	sim_pm_totals_t totals;
+} sim_pm_mark_t;
+
+static bool sim_pm_light_sleep = false;
+static int sim_pm_locks_held = 0;
+static bool sim_pm_panel_on = false;
+static bool sim_pm_dispatched = false;
+static sim_pm_totals_t sim_pm_totals;
+static sim_pm_mark_t sim_pm_marks[SIM_PM_MAX_MARKS];
+static int sim_pm_mark_count = 0;
+
+esp_err_t esp_pm_configure(const void *config)
+{
+	const esp_pm_config_esp32_t *pm = config;
+	if(pm == NULL) return ESP_ERR_INVALID_ARG;
+	sim_pm_light_sleep = pm->light_sleep_enable;
+	sim_trace("pm", "configure", "%d-%d MHz light_sleep=%d", pm->min_freq_mhz, pm->max_freq_mhz, pm->light_sleep_enable);
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+	struct sim_pm_lock *lock = calloc(1, sizeof(struct sim_pm_lock));
+	if(lock == NULL) return ESP_ERR_NO_MEM;
+	lock->type = lock_type;
+	lock->name = name;
+	*out_handle = lock;
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle)
+{
+	if(handle->count) return ESP_ERR_INVALID_STATE;
+	free(handle);
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+	if(handle->count++ == 0) sim_pm_locks_held++;
+	sim_trace("pm", "acquire", "%s", handle->name ? handle->name : "");
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+	if(handle->count == 0) return ESP_ERR_INVALID_STATE;
+	if(--handle->count == 0) sim_pm_locks_held--;
+	sim_trace("pm", "release", "%s", handle->name ? handle->name : "");
+	return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_uart_wakeup(int uart_num)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+	return ESP_OK;
+}
+
+/**
+ * Display on and off commands of the panel.
+ */
+void sim_pm_panel(bool on)
+{
+	sim_pm_panel_on = on;
+}
+
+/**
+ * A task was dispatched, the next gap starts with its run time.
+ */
+void sim_pm_dispatch(void)
+{
+	sim_pm_dispatched = true;
+}
+
+static void sim_pm_add(int64_t us, double cpu_ma)
+{
+	double backlight = sim_ledc_level(CONFIG_BL_GPIO);
+	sim_pm_totals.time_us += us;
+	sim_pm_totals.backlight += backlight * us;
+	if(sim_pm_panel_on) sim_pm_totals.panel_on_us += us;
+	sim_pm_totals.charge += us * (cpu_ma + (sim_pm_panel_on ? SIM_PM_PANEL_ON_MA : SIM_PM_PANEL_OFF_MA) + backlight * SIM_PM_BACKLIGHT_MA);
+}
+
+/**
+ * Accounts the time until the next event of the scheduler.
+ * @param us length of the gap
+ * @param busy a task waits for a bus transfer or busy waits
+ */
+void sim_pm_account(int64_t us, bool busy)
+{
+	if(us <= 0) return;
+	int64_t active = busy ? us : 0;
+	if(!busy && sim_pm_dispatched) active = us < SIM_PM_RUN_US ? us : SIM_PM_RUN_US;
+	sim_pm_dispatched = false;
+	if(active)
+	{
+		sim_pm_totals.active_us += active;
+		sim_pm_add(active, SIM_PM_CPU_ACTIVE_MA);
+		us -= active;
+	}
+	if(us <= 0) return;
+	bool sleep = sim_pm_light_sleep && sim_pm_locks_held == 0 &&
+		us >= CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP * (1000000LL / configTICK_RATE_HZ);
+	if(sleep) sim_pm_totals.sleep_us += us;
+	else sim_pm_totals.idle_us += us;
+	sim_pm_add(us, sleep ? SIM_PM_CPU_SLEEP_MA : SIM_PM_CPU_IDLE_MA);
+}
+
+/**
+ * Ends a measurement window of the power command of the script.
+ */
+void sim_pm_mark(const char *name)
+{
+	if(sim_pm_mark_count >= SIM_PM_MAX_MARKS) return;
+	sim_pm_mark_t *mark = &sim_pm_marks[sim_pm_mark_count++];
+	snprintf(mark->name, sizeof(mark->name), "%s", name);
+	mark->time_us = sim_now_us();
+	mark->totals = sim_pm_totals;
+}
+
+static void sim_pm_report_line(FILE *out, const char *name, const sim_pm_totals_t *from, const sim_pm_totals_t *to)
+{
+	int64_t time = to->time_us - from->time_us;
+	if(time <= 0) return;
+	fprintf(out, "  %-16s %10.1f %7.1f%% %7.1f%% %7.1f%% %7.1f%% %7.1f%% %10.2f\n", name, time / 1000.0,
+		(to->active_us - from->active_us) * 100.0 / time, (to->idle_us - from->idle_us) * 100.0 / time,
+		(to->sleep_us - from->sleep_us) * 100.0 / time, (to->panel_on_us - from->panel_on_us) * 100.0 / time,
+		(to->backlight - from->backlight) * 100.0 / time, (to->charge - from->charge) / time);
+}
+
+/**
+ * Writes the power estimate, per window of the power command and of the whole run.
+ */
+void sim_pm_report(FILE *out)
+{
+	sim_pm_totals_t zero;
+	memset(&zero, 0, sizeof(zero));
+	fprintf(out, "Power estimate (rough model, see sim_pm.c)\n");
+	fprintf(out, "  %-16s %10s %8s %8s %8s %8s %8s %10s\n", "window", "ms", "active", "idle", "sleep", "panel", "bl", "avg_mA");
+	const sim_pm_totals_t *from = &zero;
+	for(int i = 0; i < sim_pm_mark_count; i++)
+	{
+		sim_pm_report_line(out, sim_pm_marks[i].name, from, &sim_pm_marks[i].totals);
+		from = &sim_pm_marks[i].totals;
+	}
+	if(sim_pm_mark_count) sim_pm_report_line(out, "rest", from, &sim_pm_totals);
+	sim_pm_report_line(out, "total", &zero, &sim_pm_totals);
+	fprintf(out, "\n");
+}
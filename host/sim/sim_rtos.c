@@ -0,0 +1,973 @@
+//FreeRTOS API of the host simulation
+//
+//Every task is a pthread, but only one of them runs at a time: the scheduler
+//thread hands the CPU to the ready task with the highest priority and waits
+//until it blocks. Task code takes no virtual time, only blocking calls, bus
+//transfers and busy waits move the clock. When no task is ready the virtual
+//clock jumps to the next timer, script event or wake time. Interrupts and timer
+//callbacks run in the scheduler thread between tasks. Equal inputs therefore
+//give equal runs, independent of the host load.
+//
+//Both ESP32 cores are folded into one virtual CPU; the core argument of
+//xTaskCreatePinnedToCore is only reported. Mutexes have no priority inheritance.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "freertos/timers.h"
+#include "sim.h"
+
+//length of one tick
+#define SIM_TICK_US (1000000LL / configTICK_RATE_HZ)
+
+typedef enum {
+	SIM_READY,
+	SIM_RUNNING,
+	SIM_BLOCKED,
+	SIM_DELETED,
+} sim_task_state_t;
+
+struct sim_task {
+	pthread_t thread;
+	pthread_cond_t cond;
+	bool run;
+	char name[16];
+	UBaseType_t priority;
+	BaseType_t core;
+	uint32_t stack_depth;
+	UBaseType_t number;
+	TaskFunction_t fn;
+	void *arg;
+	sim_task_state_t state;
+	uint64_t ready_seq;
+	int64_t wake_us;
+	const void *wait_object;
+	bool woken;
+	bool busy;
+	uint32_t notify;
+	uint32_t dispatches;
+	int64_t cpu_in_ns;
+	int64_t cpu_charged_us;
+	struct sim_task *next;
+};
+
+struct sim_queue {
+	uint8_t *items;
+	UBaseType_t item_size;
+	UBaseType_t length;
+	UBaseType_t count;
+	UBaseType_t head;
+	bool mutex;
+	struct sim_task *holder;
+	UBaseType_t recursion;
+};
+
+struct sim_event_group {
+	EventBits_t bits;
+};
+
+struct sim_timer {
+	const char *name;
+	TickType_t period;
+	bool auto_reload;
+	void *id;
+	TimerCallbackFunction_t callback;
+	bool active;
+	uint32_t generation;
+	int64_t expiry_us;
+};
+
+typedef struct sim_event {
+	int64_t at_us;
+	uint64_t seq;
+	sim_event_fn_t fn;
+	void *arg;
+	struct sim_event *next;
+} sim_event_t;
+
+//hand over between scheduler and tasks
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_sched_cond = PTHREAD_COND_INITIALIZER;
+
+static struct sim_task *sim_tasks = NULL;
+static struct sim_task *sim_current = NULL;
+static UBaseType_t sim_task_count = 0;
+static uint64_t sim_ready_seq = 0;
+static uint64_t sim_dispatch_count = 0;
+static bool sim_isr = false;
+static int64_t sim_now = 0;
+
+static sim_event_t *sim_events = NULL;
+static uint64_t sim_event_seq = 0;
+
+int64_t sim_now_us(void)
+{
+	return sim_now;
+}
+
+bool sim_in_isr(void)
+{
+	return sim_isr || sim_current == NULL;
+}
+
+const char *sim_current_task_name(void)
+{
+	return sim_current ? sim_current->name : "isr";
+}
+
+/**
+ * Runs fn in interrupt context of the scheduler at the given virtual time.
+ * Events at the same time run in the order they were scheduled.
+ */
+void sim_schedule(int64_t at_us, sim_event_fn_t fn, void *arg)
+{
+	sim_event_t *event = malloc(sizeof(sim_event_t));
+	event->at_us = at_us < sim_now ? sim_now : at_us;
+	event->seq = sim_event_seq++;
+	event->fn = fn;
+	event->arg = arg;
+	sim_event_t **pos = &sim_events;
+	while(*pos && ((*pos)->at_us < event->at_us || ((*pos)->at_us == event->at_us && (*pos)->seq < event->seq))) pos = &(*pos)->next;
+	event->next = *pos;
+	*pos = event;
+}
+
+static int64_t sim_thread_cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct sim_task *sim_self(const char *api)
+{
+	if(sim_current == NULL || sim_isr)
+	{
+		fprintf(stderr, "sim: %s called from interrupt or timer context\n", api);
+		abort();
+	}
+	return sim_current;
+}
+
+static void sim_make_ready(struct sim_task *task)
+{
+	task->state = SIM_READY;
+	task->ready_seq = ++sim_ready_seq;
+	task->wait_object = NULL;
+	task->wake_us = SIM_NEVER;
+}
+
+/**
+ * Gives the CPU back to the scheduler and waits until the task is dispatched again.
+ * The state of the task has to be set before.
+ */
+static void sim_switch_out(struct sim_task *self)
+{
+	if(sim_config.cpu_scale > 0)
+	{
+		int64_t charged = (int64_t)((sim_thread_cpu_ns() - self->cpu_in_ns) * sim_config.cpu_scale / 1000);
+		self->cpu_charged_us += charged;
+		sim_now += charged;
+	}
+	pthread_mutex_lock(&sim_lock);
+	sim_current = NULL;
+	pthread_cond_signal(&sim_sched_cond);
+	while(!self->run) pthread_cond_wait(&self->cond, &sim_lock);
+	self->run = false;
+	pthread_mutex_unlock(&sim_lock);
+	if(sim_config.cpu_scale > 0) self->cpu_in_ns = sim_thread_cpu_ns();
+}
+
+static void sim_dispatch(struct sim_task *task)
+{
+	task->state = SIM_RUNNING;
+	task->dispatches++;
+	sim_dispatch_count++;
+	sim_pm_dispatch();
+	if(sim_config.trace_tasks) sim_trace("sched", "run", "%s", task->name);
+	pthread_mutex_lock(&sim_lock);
+	sim_current = task;
+	task->run = true;
+	pthread_cond_signal(&task->cond);
+	while(sim_current != NULL) pthread_cond_wait(&sim_sched_cond, &sim_lock);
+	pthread_mutex_unlock(&sim_lock);
+}
+
+static struct sim_task *sim_pick_ready(void)
+{
+	struct sim_task *best = NULL;
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state != SIM_READY) continue;
+		if(best == NULL || task->priority > best->priority ||
+		   (task->priority == best->priority && task->ready_seq < best->ready_seq)) best = task;
+	}
+	return best;
+}
+
+/**
+ * Yields if a ready task has a higher priority than the running task.
+ * Does nothing in interrupt context, the scheduler picks the task afterwards.
+ */
+static void sim_preempt_check(void)
+{
+	if(sim_in_isr()) return;
+	struct sim_task *self = sim_current;
+	struct sim_task *best = sim_pick_ready();
+	if(best && best->priority > self->priority)
+	{
+		sim_make_ready(self);
+		sim_switch_out(self);
+	}
+}
+
+int64_t sim_deadline(uint32_t ticks)
+{
+	if(ticks == portMAX_DELAY) return SIM_NEVER;
+	return (sim_now / SIM_TICK_US + ticks) * SIM_TICK_US;
+}
+
+/**
+ * Blocks the running task on an object until sim_wake(object) or the deadline.
+ * @return true if woken by the object, false on timeout
+ */
+bool sim_block(const void *object, int64_t deadline_us)
+{
+	struct sim_task *self = sim_self("blocking call");
+	if(deadline_us <= sim_now) return false;
+	self->state = SIM_BLOCKED;
+	self->wait_object = object;
+	self->wake_us = deadline_us;
+	self->woken = false;
+	sim_switch_out(self);
+	return self->woken;
+}
+
+/**
+ * Makes all tasks blocked on the object ready, they check their condition again.
+ */
+void sim_wake(const void *object)
+{
+	if(object == NULL) return;
+	bool any = false;
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state != SIM_BLOCKED || task->wait_object != object) continue;
+		sim_make_ready(task);
+		task->woken = true;
+		any = true;
+	}
+	if(any) sim_preempt_check();
+}
+
+/**
+ * Blocks the running task for a number of microseconds, used for bus transfers and busy waits.
+ */
+void sim_delay_us(int64_t us)
+{
+	if(us <= 0 || sim_in_isr()) return;
+	struct sim_task *self = sim_current;
+	self->busy = true;
+	sim_block(NULL, sim_now + us);
+	self->busy = false;
+}
+
+static void sim_fire_due(void)
+{
+	while(sim_events && sim_events->at_us <= sim_now)
+	{
+		sim_event_t *event = sim_events;
+		sim_events = event->next;
+		sim_isr = true;
+		event->fn(event->arg);
+		sim_isr = false;
+		free(event);
+	}
+}
+
+static void sim_wake_due(void)
+{
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state == SIM_BLOCKED && task->wake_us <= sim_now)
+		{
+			sim_make_ready(task);
+			task->woken = false;
+		}
+	}
+}
+
+static int64_t sim_next_time(void)
+{
+	int64_t next = sim_events ? sim_events->at_us : SIM_NEVER;
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state == SIM_BLOCKED && task->wake_us < next) next = task->wake_us;
+	}
+	return next;
+}
+
+static void sim_main_task(void *arg)
+{
+	void (*app_main)(void) = (void (*)(void))arg;
+	app_main();
+}
+
+/**
+ * Starts app_main in the main task and runs the scheduler until the end time
+ * or until nothing is left to do.
+ */
+void sim_run(void (*app_main)(void))
+{
+	xTaskCreatePinnedToCore(sim_main_task, "main", 3584, (void *)app_main, 1, NULL, 0);
+	while(1)
+	{
+		sim_fire_due();
+		sim_wake_due();
+		struct sim_task *task = sim_pick_ready();
+		if(task)
+		{
+			sim_dispatch(task);
+			continue;
+		}
+		int64_t next = sim_next_time();
+		if(next == SIM_NEVER)
+		{
+			fprintf(stderr, "sim: all tasks blocked forever at %lld us\n", (long long)sim_now);
+			break;
+		}
+		if(next > sim_config.duration_us)
+		{
+			sim_now = sim_config.duration_us;
+			break;
+		}
+		if(next > sim_now)
+		{
+			bool busy = false;
+			for(struct sim_task *t = sim_tasks; t; t = t->next) busy |= (t->state == SIM_BLOCKED && t->busy);
+			sim_pm_account(next - sim_now, busy);
+			sim_now = next;
+		}
+	}
+}
+
+/**
+ * Writes the scheduling statistics of all tasks.
+ */
+void sim_task_report(FILE *out)
+{
+	static const char *states[] = {"ready", "running", "blocked", "deleted"};
+	fprintf(out, "Tasks (%llu dispatches)\n", (unsigned long long)sim_dispatch_count);
+	fprintf(out, "  %-16s %4s %4s %10s %10s  %s\n", "name", "prio", "core", "dispatches", "cpu_us", "state");
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		fprintf(out, "  %-16s %4u %4d %10u %10lld  %s\n", task->name, task->priority, (int)task->core,
+			task->dispatches, (long long)task->cpu_charged_us, states[task->state]);
+	}
+}
+
+//tasks
+
+static void *sim_task_entry(void *arg)
+{
+	struct sim_task *self = arg;
+	pthread_mutex_lock(&sim_lock);
+	while(!self->run) pthread_cond_wait(&self->cond, &sim_lock);
+	self->run = false;
+	pthread_mutex_unlock(&sim_lock);
+	if(sim_config.cpu_scale > 0) self->cpu_in_ns = sim_thread_cpu_ns();
+	self->fn(self->arg);
+	//returning from a task deletes it
+	vTaskDelete(NULL);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+	UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+	struct sim_task *task = calloc(1, sizeof(struct sim_task));
+	if(task == NULL) return pdFAIL;
+	snprintf(task->name, sizeof(task->name), "%s", name);
+	task->fn = fn;
+	task->arg = arg;
+	task->priority = priority < configMAX_PRIORITIES ? priority : configMAX_PRIORITIES - 1;
+	task->core = core;
+	task->stack_depth = stack_depth;
+	task->number = ++sim_task_count;
+	pthread_cond_init(&task->cond, NULL);
+
+	struct sim_task **tail = &sim_tasks;
+	while(*tail) tail = &(*tail)->next;
+	*tail = task;
+
+	if(handle) *handle = task;
+	sim_make_ready(task);
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&task->thread, &attr, sim_task_entry, task) != 0)
+	{
+		fprintf(stderr, "sim: could not create thread for %s\n", name);
+		abort();
+	}
+	pthread_attr_destroy(&attr);
+	if(sim_config.trace_tasks) sim_trace("sched", "create", "%s prio %u core %d", task->name, task->priority, (int)core);
+	sim_preempt_check();
+	return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+	UBaseType_t priority, TaskHandle_t *handle)
+{
+	return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	if(task == NULL || task == sim_current)
+	{
+		struct sim_task *self = sim_self("vTaskDelete(NULL)");
+		self->state = SIM_DELETED;
+		pthread_mutex_lock(&sim_lock);
+		sim_current = NULL;
+		pthread_cond_signal(&sim_sched_cond);
+		pthread_mutex_unlock(&sim_lock);
+		pthread_exit(NULL);
+	}
+	//the thread of another task stays parked and is never dispatched again
+	task->state = SIM_DELETED;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	if(ticks == 0)
+	{
+		taskYIELD();
+		return;
+	}
+	sim_block(NULL, sim_deadline(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+	TickType_t wake = *previous_wake + increment;
+	*previous_wake = wake;
+	if((int64_t)wake * SIM_TICK_US > sim_now) sim_block(NULL, (int64_t)wake * SIM_TICK_US);
+	else taskYIELD();
+}
+
+void taskYIELD(void)
+{
+	struct sim_task *self = sim_self("taskYIELD");
+	sim_make_ready(self);
+	sim_switch_out(self);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(sim_now / SIM_TICK_US);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+	return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return sim_current;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+	//host stacks are not measured, report the configured depth
+	if(task == NULL) task = sim_current;
+	return task ? task->stack_depth : 0;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+	UBaseType_t count = 0;
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state != SIM_DELETED) count++;
+	}
+	return count;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t count, uint32_t *total_run_time)
+{
+	static const eTaskState states[] = {eReady, eRunning, eBlocked, eDeleted};
+	UBaseType_t n = 0;
+	for(struct sim_task *task = sim_tasks; task && n < count; task = task->next)
+	{
+		if(task->state == SIM_DELETED) continue;
+		status[n].xHandle = task;
+		status[n].pcTaskName = task->name;
+		status[n].xTaskNumber = task->number;
+		status[n].eCurrentState = states[task->state];
+		status[n].uxCurrentPriority = task->priority;
+		status[n].uxBasePriority = task->priority;
+		status[n].ulRunTimeCounter = (uint32_t)task->cpu_charged_us;
+		status[n].pxStackBase = NULL;
+		status[n].usStackHighWaterMark = task->stack_depth;
+		status[n].xCoreID = task->core;
+		n++;
+	}
+	if(total_run_time) *total_run_time = (uint32_t)sim_now;
+	return n;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+	if(task == NULL) task = sim_current;
+	return task ? task->priority : 0;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority)
+{
+	if(task == NULL) task = sim_current;
+	task->priority = priority;
+	sim_preempt_check();
+}
+
+const char *pcTaskGetTaskName(TaskHandle_t task)
+{
+	if(task == NULL) task = sim_current;
+	return task ? task->name : "";
+}
+
+void vTaskList(char *buffer)
+{
+	static const char states[] = "RXBD";
+	buffer[0] = 0;
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state == SIM_DELETED) continue;
+		buffer += sprintf(buffer, "%-16s%c\t%u\t%u\t%u\t%d\n", task->name, states[task->state], task->priority,
+			task->stack_depth, task->number, task->core == tskNO_AFFINITY ? -1 : (int)task->core);
+	}
+}
+
+void vTaskGetRunTimeStats(char *buffer)
+{
+	buffer[0] = 0;
+	for(struct sim_task *task = sim_tasks; task; task = task->next)
+	{
+		if(task->state == SIM_DELETED) continue;
+		buffer += sprintf(buffer, "%-16s%u\t\t%u%%\n", task->name, (uint32_t)task->cpu_charged_us,
+			sim_now ? (uint32_t)(task->cpu_charged_us * 100 / sim_now) : 0);
+	}
+}
+
+void vTaskSuspendAll(void)
+{
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+	return pdFALSE;
+}
+
+//task notifications
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	task->notify++;
+	sim_wake(task);
+	return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+	task->notify++;
+	if(woken && task->state == SIM_BLOCKED && task->wait_object == task) *woken = pdTRUE;
+	sim_wake(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+	struct sim_task *self = sim_self("ulTaskNotifyTake");
+	int64_t deadline = sim_deadline(timeout);
+	while(self->notify == 0)
+	{
+		if(timeout == 0 || !sim_block(self, deadline)) break;
+	}
+	uint32_t value = self->notify;
+	if(value)
+	{
+		if(clear) self->notify = 0;
+		else self->notify--;
+	}
+	return value;
+}
+
+//queues and semaphores
+
+static struct sim_queue *sim_queue_new(UBaseType_t length, UBaseType_t item_size)
+{
+	struct sim_queue *queue = calloc(1, sizeof(struct sim_queue));
+	if(queue == NULL) return NULL;
+	queue->length = length;
+	queue->item_size = item_size;
+	if(item_size) queue->items = calloc(length, item_size);
+	return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+	return sim_queue_new(length, item_size);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+	if(queue == NULL) return;
+	free(queue->items);
+	free(queue);
+}
+
+static bool sim_queue_put(struct sim_queue *queue, const void *item, bool front, bool overwrite)
+{
+	if(queue->count >= queue->length)
+	{
+		if(!overwrite) return false;
+		queue->count--;
+	}
+	if(queue->item_size)
+	{
+		UBaseType_t index;
+		if(front)
+		{
+			queue->head = (queue->head + queue->length - 1) % queue->length;
+			index = queue->head;
+		}
+		else index = (queue->head + queue->count) % queue->length;
+		memcpy(queue->items + index * queue->item_size, item, queue->item_size);
+	}
+	queue->count++;
+	return true;
+}
+
+static bool sim_queue_get(struct sim_queue *queue, void *item, bool peek)
+{
+	if(queue->count == 0) return false;
+	if(queue->item_size && item) memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+	if(!peek)
+	{
+		queue->head = (queue->head + 1) % queue->length;
+		queue->count--;
+	}
+	return true;
+}
+
+static BaseType_t sim_queue_send(QueueHandle_t queue, const void *item, TickType_t timeout, bool front)
+{
+	int64_t deadline = sim_deadline(timeout);
+	while(!sim_queue_put(queue, item, front, false))
+	{
+		if(timeout == 0 || sim_in_isr() || !sim_block(queue, deadline)) return pdFALSE;
+	}
+	sim_wake(queue);
+	return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t timeout)
+{
+	return sim_queue_send(queue, item, timeout, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t timeout)
+{
+	return sim_queue_send(queue, item, timeout, true);
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+	if(!sim_queue_put(queue, item, false, false)) return pdFALSE;
+	if(woken) *woken = pdTRUE;
+	sim_wake(queue);
+	return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+	sim_queue_put(queue, item, false, true);
+	sim_wake(queue);
+	return pdTRUE;
+}
+
+static BaseType_t sim_queue_receive(QueueHandle_t queue, void *item, TickType_t timeout, bool peek)
+{
+	int64_t deadline = sim_deadline(timeout);
+	while(!sim_queue_get(queue, item, peek))
+	{
+		if(timeout == 0 || sim_in_isr() || !sim_block(queue, deadline)) return pdFALSE;
+	}
+	if(!peek) sim_wake(queue);
+	return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout)
+{
+	return sim_queue_receive(queue, item, timeout, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t timeout)
+{
+	return sim_queue_receive(queue, item, timeout, true);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *item, BaseType_t *woken)
+{
+	if(!sim_queue_get(queue, item, false)) return pdFALSE;
+	if(woken) *woken = pdTRUE;
+	sim_wake(queue);
+	return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+	queue->count = 0;
+	queue->head = 0;
+	sim_wake(queue);
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+	return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+	return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	struct sim_queue *sem = sim_queue_new(1, 0);
+	if(sem == NULL) return NULL;
+	sem->mutex = true;
+	sem->count = 1;
+	return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+	return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return sim_queue_new(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+	struct sim_queue *sem = sim_queue_new(max, 0);
+	if(sem) sem->count = initial;
+	return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout)
+{
+	if(sim_queue_receive(sem, NULL, timeout, false) != pdTRUE) return pdFALSE;
+	if(sem->mutex) sem->holder = sim_current;
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+	if(sem->mutex)
+	{
+		if(sem->holder != sim_current) return pdFALSE;
+		sem->holder = NULL;
+	}
+	if(!sim_queue_put(sem, NULL, false, false)) return pdFALSE;
+	sim_wake(sem);
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t timeout)
+{
+	if(sem->holder != NULL && sem->holder == sim_current)
+	{
+		sem->recursion++;
+		return pdTRUE;
+	}
+	return xSemaphoreTake(sem, timeout);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+	if(sem->holder != sim_current) return pdFALSE;
+	if(sem->recursion)
+	{
+		sem->recursion--;
+		return pdTRUE;
+	}
+	return xSemaphoreGive(sem);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+	return xQueueSendToBackFromISR(sem, NULL, woken);
+}
+
+BaseType_t xSemaphoreTakeFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+	return xQueueReceiveFromISR(sem, NULL, woken);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem)
+{
+	return sem->count;
+}
+
+//event groups
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	return calloc(1, sizeof(struct sim_event_group));
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+	free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	group->bits |= bits;
+	EventBits_t value = group->bits;
+	sim_wake(group);
+	return value;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t *woken)
+{
+	xEventGroupSetBits(group, bits);
+	if(woken) *woken = pdTRUE;
+	return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	EventBits_t value = group->bits;
+	group->bits &= ~bits;
+	return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+	return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t wait_all,
+	TickType_t timeout)
+{
+	int64_t deadline = sim_deadline(timeout);
+	while(1)
+	{
+		EventBits_t value = group->bits;
+		bool done = wait_all ? ((value & bits) == bits) : ((value & bits) != 0);
+		if(done)
+		{
+			if(clear) group->bits &= ~bits;
+			return value;
+		}
+		if(timeout == 0 || !sim_block(group, deadline)) return group->bits;
+	}
+}
+
+//software timers, the callbacks run like the timer service task between the tasks
+
+typedef struct {
+	struct sim_timer *timer;
+	uint32_t generation;
+} sim_timer_shot_t;
+
+static void sim_timer_arm(struct sim_timer *timer, int64_t expiry_us);
+
+static void sim_timer_fire(void *arg)
+{
+	sim_timer_shot_t *shot = arg;
+	struct sim_timer *timer = shot->timer;
+	bool current = timer->active && timer->generation == shot->generation;
+	free(shot);
+	if(!current) return;
+	if(timer->auto_reload) sim_timer_arm(timer, timer->expiry_us + (int64_t)timer->period * SIM_TICK_US);
+	else timer->active = false;
+	timer->callback(timer);
+}
+
+static void sim_timer_arm(struct sim_timer *timer, int64_t expiry_us)
+{
+	sim_timer_shot_t *shot = malloc(sizeof(sim_timer_shot_t));
+	shot->timer = timer;
+	shot->generation = timer->generation;
+	timer->expiry_us = expiry_us;
+	sim_schedule(expiry_us, sim_timer_fire, shot);
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+	TimerCallbackFunction_t callback)
+{
+	struct sim_timer *timer = calloc(1, sizeof(struct sim_timer));
+	if(timer == NULL) return NULL;
+	timer->name = name;
+	timer->period = period ? period : 1;
+	timer->auto_reload = auto_reload;
+	timer->id = id;
+	timer->callback = callback;
+	return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t timeout)
+{
+	timer->active = true;
+	timer->generation++;
+	sim_timer_arm(timer, sim_deadline(timer->period));
+	return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t timeout)
+{
+	return xTimerStart(timer, timeout);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t timeout)
+{
+	timer->active = false;
+	timer->generation++;
+	return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t timeout)
+{
+	timer->period = period ? period : 1;
+	return xTimerStart(timer, timeout);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t timeout)
+{
+	//pending shots still point to the timer, keep it and only stop it
+	return xTimerStop(timer, timeout);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer)
+{
+	return timer->active;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+	return timer->id;
+}
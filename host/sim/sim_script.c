@@ -0,0 +1,300 @@
+//Scripted input and sensor waveforms of the host simulation
+//
+//One command per line, '#' starts a comment:
+//  <time> <command> [args]
+//The time is in ms since start, or +ms after the previous line. Commands:
+//  set <signal> <value>                 constant value
+//  ramp <signal> <value> <ms>           linear ramp from the present value
+//  sine <signal> <offset> <amp> <hz>    sine wave
+//  press|release <button>               sel, right, up, down, left
+//  hold <button> <ms>                   press and release after ms
+//  enc <steps> [step_ms]                encoder steps, negative turns left
+//  cmd <line>                           line on the serial console
+//  dump [name]                          write the LCD as PPM
+//  mark <name>                          reference for the response times in the report
+//  power <name>                         ends a window of the current estimate in the report
+//  end                                  stop the simulation, sets the simulated time
+//Signals: ina1.shunt_mv ina1.bus_mv ina2.shunt_mv ina2.bus_mv adc.out24 adc.out5
+//adc.out33 adc.outvar adc.ch5 (rail voltages in V)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sim.h"
+
+//encoder pins of the board
+#define SIM_ENC_CLK 15
+#define SIM_ENC_DT  16
+#define SIM_ENC_STEP_MS 20
+
+typedef enum {
+	SIM_WAVE_CONST,
+	SIM_WAVE_RAMP,
+	SIM_WAVE_SINE,
+} sim_wave_type_t;
+
+typedef struct {
+	char name[24];
+	sim_wave_type_t type;
+	double value;       //constant, ramp start or sine offset
+	double target;      //ramp end or sine amplitude
+	double hz;
+	int64_t start_us;
+	int64_t end_us;
+} sim_wave_t;
+
+#define SIM_MAX_SIGNALS 16
+static sim_wave_t sim_waves[SIM_MAX_SIGNALS] = {
+	{"ina1.shunt_mv", SIM_WAVE_CONST, 5},
+	{"ina1.bus_mv", SIM_WAVE_CONST, 24000},
+	{"ina2.shunt_mv", SIM_WAVE_CONST, 2},
+	{"ina2.bus_mv", SIM_WAVE_CONST, 5000},
+	{"adc.out24", SIM_WAVE_CONST, 24},
+	{"adc.out5", SIM_WAVE_CONST, 5},
+	{"adc.out33", SIM_WAVE_CONST, 3.3},
+	{"adc.outvar", SIM_WAVE_CONST, 12},
+	{"adc.ch5", SIM_WAVE_CONST, 0.5},
+};
+
+typedef struct {
+	const char *name;
+	uint8_t mask;
+} sim_button_t;
+
+static const sim_button_t sim_buttons[] = {
+	{"sel", 0x01},
+	{"right", 0x02},
+	{"up", 0x08},
+	{"down", 0x10},
+	{"left", 0x20},
+};
+
+typedef struct {
+	int line;
+	char text[256];
+} sim_script_line_t;
+
+static sim_wave_t *sim_wave_find(const char *name, bool create)
+{
+	for(int i = 0; i < SIM_MAX_SIGNALS; i++)
+	{
+		if(strcmp(sim_waves[i].name, name) == 0) return &sim_waves[i];
+	}
+	if(!create) return NULL;
+	for(int i = 0; i < SIM_MAX_SIGNALS; i++)
+	{
+		if(sim_waves[i].name[0]) continue;
+		snprintf(sim_waves[i].name, sizeof(sim_waves[i].name), "%s", name);
+		return &sim_waves[i];
+	}
+	return NULL;
+}
+
+static double sim_wave_value(const sim_wave_t *wave, int64_t now)
+{
+	switch(wave->type)
+	{
+		case SIM_WAVE_RAMP:
+			if(now >= wave->end_us) return wave->target;
+			return wave->value + (wave->target - wave->value) * (now - wave->start_us) / (wave->end_us - wave->start_us);
+		case SIM_WAVE_SINE:
+			return wave->value + wave->target * sin(2 * M_PI * wave->hz * (now - wave->start_us) / 1e6);
+		default:
+			return wave->value;
+	}
+}
+
+/**
+ * Value of a waveform at the present virtual time, unknown signals are 0.
+ */
+double sim_signal(const char *name)
+{
+	sim_wave_t *wave = sim_wave_find(name, false);
+	return wave ? sim_wave_value(wave, sim_now_us()) : 0;
+}
+
+//encoder, every step is one CLK edge with DT set before
+
+typedef struct {
+	int remaining;
+	int direction;
+	int64_t step_us;
+} sim_encoder_t;
+
+static void sim_encoder_step(void *arg);
+
+static void sim_encoder_edge(void *arg)
+{
+	sim_encoder_t *enc = arg;
+	sim_gpio_input(SIM_ENC_CLK, !sim_gpio_output(SIM_ENC_CLK));
+	if(--enc->remaining > 0) sim_schedule(sim_now_us() + enc->step_us / 2, sim_encoder_step, enc);
+	else free(enc);
+}
+
+static void sim_encoder_step(void *arg)
+{
+	sim_encoder_t *enc = arg;
+	int clk = sim_gpio_output(SIM_ENC_CLK);
+	//the next CLK level differs from DT for a step right
+	sim_gpio_input(SIM_ENC_DT, enc->direction > 0 ? clk : !clk);
+	sim_schedule(sim_now_us() + enc->step_us / 2, sim_encoder_edge, enc);
+}
+
+static void sim_button_release(void *arg)
+{
+	const sim_button_t *button = arg;
+	sim_expander_set_pins(0, button->mask, 0xFF);
+}
+
+static const sim_button_t *sim_button_find(const char *name)
+{
+	for(size_t i = 0; i < sizeof(sim_buttons) / sizeof(sim_buttons[0]); i++)
+	{
+		if(strcmp(sim_buttons[i].name, name) == 0) return &sim_buttons[i];
+	}
+	return NULL;
+}
+
+static void sim_script_error(const sim_script_line_t *line, const char *message)
+{
+	fprintf(stderr, "sim: script line %d: %s: %s\n", line->line, message, line->text);
+}
+
+static void sim_script_run(void *arg)
+{
+	sim_script_line_t *line = arg;
+	char command[16] = "", a[128] = "", b[32] = "", c[32] = "", d[32] = "";
+	int args = sscanf(line->text, "%15s %127s %31s %31s %31s", command, a, b, c, d);
+	int64_t now = sim_now_us();
+
+	if(strcmp(command, "set") == 0 || strcmp(command, "ramp") == 0 || strcmp(command, "sine") == 0)
+	{
+		sim_wave_t *wave = sim_wave_find(a, true);
+		if(wave == NULL || args < 3) sim_script_error(line, "bad signal");
+		else if(command[0] == 's' && command[1] == 'e')
+		{
+			wave->type = SIM_WAVE_CONST;
+			wave->value = atof(b);
+		}
+		else if(command[0] == 'r')
+		{
+			double from = sim_wave_value(wave, now);
+			wave->type = SIM_WAVE_RAMP;
+			wave->value = from;
+			wave->target = atof(b);
+			wave->start_us = now;
+			wave->end_us = now + (int64_t)(atof(c) * 1000);
+			if(wave->end_us <= now) wave->end_us = now + 1;
+		}
+		else
+		{
+			wave->type = SIM_WAVE_SINE;
+			wave->value = atof(b);
+			wave->target = atof(c);
+			wave->hz = atof(d);
+			wave->start_us = now;
+		}
+		sim_trace("script", command, "%s %s %s %s", a, b, c, d);
+	}
+	else if(strcmp(command, "press") == 0 || strcmp(command, "release") == 0 || strcmp(command, "hold") == 0)
+	{
+		const sim_button_t *button = sim_button_find(a);
+		if(button == NULL) sim_script_error(line, "unknown button");
+		else
+		{
+			bool press = command[0] != 'r';
+			//buttons pull the expander inputs low
+			sim_expander_set_pins(0, button->mask, press ? 0x00 : 0xFF);
+			if(press) sim_mark("input", a);
+			if(command[0] == 'h') sim_schedule(now + (int64_t)(atof(b) * 1000), sim_button_release, (void *)button);
+		}
+	}
+	else if(strcmp(command, "enc") == 0)
+	{
+		int steps = atoi(a);
+		if(steps != 0)
+		{
+			sim_encoder_t *enc = malloc(sizeof(sim_encoder_t));
+			enc->remaining = abs(steps);
+			enc->direction = steps > 0 ? 1 : -1;
+			enc->step_us = (args >= 3 ? atof(b) : SIM_ENC_STEP_MS) * 1000;
+			sim_mark("input", "enc");
+			sim_encoder_step(enc);
+		}
+	}
+	else if(strcmp(command, "cmd") == 0)
+	{
+		const char *text = line->text + strlen("cmd");
+		while(*text == ' ') text++;
+		sim_trace("script", "cmd", "%s", text);
+		sim_uart_feed(text);
+	}
+	else if(strcmp(command, "dump") == 0)
+	{
+		char name[128];
+		if(args >= 2) snprintf(name, sizeof(name), "%s", a);
+		else snprintf(name, sizeof(name), "dump_%lld", (long long)(now / 1000));
+		sim_lcd_dump(name);
+	}
+	else if(strcmp(command, "mark") == 0)
+	{
+		sim_mark("mark", args >= 2 ? a : "");
+	}
+	else if(strcmp(command, "power") == 0)
+	{
+		sim_pm_mark(args >= 2 ? a : "");
+	}
+	else if(strcmp(command, "end") == 0)
+	{
+		sim_config.duration_us = now;
+	}
+	else sim_script_error(line, "unknown command");
+	free(line);
+}
+
+/**
+ * Reads a script and schedules its commands.
+ */
+void sim_script_load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if(f == NULL)
+	{
+		fprintf(stderr, "sim: could not open script %s\n", path);
+		exit(1);
+	}
+	char text[300];
+	int number = 0;
+	double last_ms = 0;
+	while(fgets(text, sizeof(text), f))
+	{
+		number++;
+		char *comment = strchr(text, '#');
+		if(comment) *comment = 0;
+		text[strcspn(text, "\r\n")] = 0;
+		char *p = text;
+		while(*p == ' ' || *p == '\t') p++;
+		if(*p == 0) continue;
+
+		bool relative = *p == '+';
+		char *end;
+		double ms = strtod(relative ? p + 1 : p, &end);
+		if(end == (relative ? p + 1 : p))
+		{
+			fprintf(stderr, "sim: script line %d: missing time\n", number);
+			continue;
+		}
+		last_ms = relative ? last_ms + ms : ms;
+		while(*end == ' ' || *end == '\t') end++;
+
+		//the end of the script sets the simulated time
+		if(strncmp(end, "end", 3) == 0 && (end[3] == 0 || end[3] == ' ')) sim_config.duration_us = (int64_t)(last_ms * 1000);
+
+		sim_script_line_t *line = malloc(sizeof(sim_script_line_t));
+		line->line = number;
+		snprintf(line->text, sizeof(line->text), "%s", end);
+		sim_schedule((int64_t)(last_ms * 1000), sim_script_run, line);
+	}
+	fclose(f);
+}
@@ -0,0 +1,376 @@
+//SPI master driver of the host simulation with the LCD and APA102 models
+//
+//A transaction is decoded by the device model when it is queued; the bus is busy
+//for length / clock plus the driver overhead. Blocking calls keep the task busy
+//until the transfer ends, queued transactions only block on a full queue.
+//The LCD model keeps the controller RAM, frames are detected by an idle bus.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "driver/spi_master.h"
+#include "soc/soc.h"
+#include "sim.h"
+
+//controller RAM of the largest supported panel
+#define SIM_LCD_RAM_WIDTH   240
+#define SIM_LCD_RAM_HEIGHT  320
+#define SIM_APA102_MAX_LEDS 16
+
+typedef enum {
+	SIM_SPI_LCD,
+	SIM_SPI_APA102,
+} sim_spi_model_t;
+
+typedef struct {
+	spi_transaction_t *trans;
+	int64_t done_us;
+} sim_spi_result_t;
+
+struct sim_spi_device {
+	spi_host_device_t host;
+	spi_device_interface_config_t config;
+	sim_spi_model_t model;
+	const char *name;
+	sim_spi_result_t *results;
+	int result_head;
+	int result_count;
+	int64_t *in_flight;
+	int64_t polling_done_us;
+};
+
+typedef struct {
+	bool initialized;
+	int64_t busy_until_us;
+} sim_spi_host_t;
+
+static sim_spi_host_t sim_spi_hosts[3];
+
+//LCD controller state
+
+static uint16_t sim_lcd_ram[SIM_LCD_RAM_HEIGHT][SIM_LCD_RAM_WIDTH];
+static uint8_t sim_lcd_cmd = 0;
+static uint8_t sim_lcd_params[4];
+static int sim_lcd_param_count = 0;
+static uint16_t sim_lcd_xs, sim_lcd_xe, sim_lcd_ys, sim_lcd_ye;
+static uint16_t sim_lcd_x, sim_lcd_y;
+static uint8_t sim_lcd_pixel_high;
+static bool sim_lcd_pixel_odd = false;
+static bool sim_lcd_in_frame = false;
+static int64_t sim_lcd_frame_start_us = 0;
+static int64_t sim_lcd_last_write_us = 0;
+static uint32_t sim_lcd_frame_bytes = 0;
+
+static uint8_t sim_apa102_leds[SIM_APA102_MAX_LEDS][4];
+
+/**
+ * Writes the visible part of the controller RAM as binary PPM to the output directory.
+ */
+void sim_lcd_dump(const char *name)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s.ppm", sim_config.out_dir, name);
+	FILE *f = fopen(path, "wb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "sim: could not write %s\n", path);
+		return;
+	}
+	fprintf(f, "P6\n%d %d\n255\n", CONFIG_WIDTH, CONFIG_HEIGHT);
+	for(int y = CONFIG_OFFSETY; y < CONFIG_OFFSETY + CONFIG_HEIGHT; y++)
+	{
+		for(int x = CONFIG_OFFSETX; x < CONFIG_OFFSETX + CONFIG_WIDTH; x++)
+		{
+			uint16_t c = sim_lcd_ram[y][x];
+			uint8_t rgb[3] = {(uint8_t)((c >> 11) << 3), (uint8_t)(((c >> 5) & 0x3F) << 2), (uint8_t)((c & 0x1F) << 3)};
+			fwrite(rgb, 1, 3, f);
+		}
+	}
+	fclose(f);
+	sim_trace("lcd", "dump", "%s", name);
+}
+
+static void sim_lcd_idle_check(void *arg)
+{
+	if(!sim_lcd_in_frame) return;
+	int64_t end = sim_lcd_last_write_us + sim_config.lcd_frame_gap_us;
+	if(sim_now_us() < end)
+	{
+		sim_schedule(end, sim_lcd_idle_check, NULL);
+		return;
+	}
+	sim_lcd_in_frame = false;
+	sim_lcd_frame_done(sim_lcd_frame_start_us, sim_lcd_last_write_us, sim_lcd_frame_bytes);
+}
+
+static void sim_lcd_pixel(uint16_t color)
+{
+	if(sim_lcd_x < SIM_LCD_RAM_WIDTH && sim_lcd_y < SIM_LCD_RAM_HEIGHT) sim_lcd_ram[sim_lcd_y][sim_lcd_x] = color;
+	if(++sim_lcd_x > sim_lcd_xe)
+	{
+		sim_lcd_x = sim_lcd_xs;
+		if(++sim_lcd_y > sim_lcd_ye) sim_lcd_y = sim_lcd_ys;
+	}
+}
+
+static void sim_lcd_command(uint8_t cmd)
+{
+	sim_lcd_cmd = cmd;
+	sim_lcd_param_count = 0;
+	sim_lcd_pixel_odd = false;
+	switch(cmd)
+	{
+		case 0x10: sim_trace("lcd", "sleep", "in"); break;
+		case 0x11: sim_trace("lcd", "sleep", "out"); break;
+		case 0x28: sim_trace("lcd", "display", "off"); sim_pm_panel(false); break;
+		case 0x29: sim_trace("lcd", "display", "on"); sim_pm_panel(true); break;
+		case 0x2C:
+			sim_lcd_x = sim_lcd_xs;
+			sim_lcd_y = sim_lcd_ys;
+			break;
+		default: break;
+	}
+}
+
+static void sim_lcd_data(uint8_t data)
+{
+	if(sim_lcd_cmd == 0x2C)
+	{
+		if(sim_lcd_pixel_odd) sim_lcd_pixel((sim_lcd_pixel_high << 8) | data);
+		else sim_lcd_pixel_high = data;
+		sim_lcd_pixel_odd = !sim_lcd_pixel_odd;
+		return;
+	}
+	if(sim_lcd_param_count < 4) sim_lcd_params[sim_lcd_param_count] = data;
+	sim_lcd_param_count++;
+	if(sim_lcd_param_count != 4) return;
+	uint16_t start = (sim_lcd_params[0] << 8) | sim_lcd_params[1];
+	uint16_t end = (sim_lcd_params[2] << 8) | sim_lcd_params[3];
+	if(sim_lcd_cmd == 0x2A)
+	{
+		sim_lcd_xs = start;
+		sim_lcd_xe = end;
+	}
+	else if(sim_lcd_cmd == 0x2B)
+	{
+		sim_lcd_ys = start;
+		sim_lcd_ye = end;
+	}
+}
+
+static void sim_lcd_decode(const uint8_t *data, size_t bytes, int64_t start_us, int64_t end_us)
+{
+	bool dc = sim_gpio_output(CONFIG_DC_GPIO);
+	if(!sim_lcd_in_frame)
+	{
+		sim_lcd_in_frame = true;
+		sim_lcd_frame_start_us = start_us;
+		sim_lcd_frame_bytes = 0;
+		sim_schedule(end_us + sim_config.lcd_frame_gap_us, sim_lcd_idle_check, NULL);
+	}
+	sim_lcd_last_write_us = end_us;
+	sim_lcd_frame_bytes += bytes;
+	for(size_t i = 0; i < bytes; i++)
+	{
+		if(dc) sim_lcd_data(data[i]);
+		else sim_lcd_command(data[i]);
+	}
+}
+
+//APA102 LED strip: start frame of zeros, 4 bytes per LED, end frame of ones
+
+static void sim_apa102_decode(const uint8_t *data, size_t bytes)
+{
+	if(bytes < 8) return;
+	size_t count = (bytes - 4) / 4;
+	if(count > SIM_APA102_MAX_LEDS) count = SIM_APA102_MAX_LEDS;
+	for(size_t i = 0; i < count; i++)
+	{
+		const uint8_t *led = data + 4 + i * 4;
+		if(memcmp(sim_apa102_leds[i], led, 4) == 0) continue;
+		memcpy(sim_apa102_leds[i], led, 4);
+		//red, green, blue and the 5 bit brightness
+		sim_trace("led", "set", "%zu=%02x%02x%02x/%u", i, led[3], led[2], led[1], led[0] & 0x1F);
+	}
+}
+
+//driver
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma_chan)
+{
+	if(host < SPI1_HOST || host > SPI3_HOST) return ESP_ERR_INVALID_ARG;
+	if(sim_spi_hosts[host].initialized) return ESP_ERR_INVALID_STATE;
+	sim_spi_hosts[host].initialized = true;
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+	sim_spi_hosts[host].initialized = false;
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config, spi_device_handle_t *handle)
+{
+	if(host < SPI1_HOST || host > SPI3_HOST || !sim_spi_hosts[host].initialized) return ESP_ERR_INVALID_STATE;
+	if(config->clock_speed_hz <= 0) return ESP_ERR_INVALID_ARG;
+	struct sim_spi_device *dev = calloc(1, sizeof(struct sim_spi_device));
+	if(dev == NULL) return ESP_ERR_NO_MEM;
+	dev->host = host;
+	dev->config = *config;
+	if(dev->config.queue_size < 1) dev->config.queue_size = 1;
+	//the LCD is on HSPI, the LED strip on VSPI
+	dev->model = host == HSPI_HOST ? SIM_SPI_LCD : SIM_SPI_APA102;
+	dev->name = dev->model == SIM_SPI_LCD ? "lcd" : "apa102";
+	dev->results = calloc(dev->config.queue_size, sizeof(sim_spi_result_t));
+	dev->in_flight = calloc(dev->config.queue_size, sizeof(int64_t));
+	*handle = dev;
+	return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+	free(handle->results);
+	free(handle->in_flight);
+	free(handle);
+	return ESP_OK;
+}
+
+int spi_get_actual_clock(int fapb, int hz, int duty_cycle)
+{
+	//nearest divider like the driver, SPI_MASTER_FREQ_26M is 80 MHz / 3
+	int div = (fapb + hz / 2) / hz;
+	return fapb / (div ? div : 1);
+}
+
+/**
+ * Runs the callbacks and the device model, returns when the transfer ends on the bus.
+ */
+static int64_t sim_spi_execute(spi_device_handle_t dev, spi_transaction_t *trans)
+{
+	if(dev->config.pre_cb) dev->config.pre_cb(trans);
+	const uint8_t *data = (trans->flags & SPI_TRANS_USE_TXDATA) ? trans->tx_data : trans->tx_buffer;
+	size_t bytes = (trans->length + 7) / 8;
+	int clock = spi_get_actual_clock(APB_CLK_FREQ, dev->config.clock_speed_hz, 128);
+	sim_spi_host_t *host = &sim_spi_hosts[dev->host];
+	int64_t start = sim_now_us();
+	if(host->busy_until_us > start) start = host->busy_until_us;
+	int64_t duration = (int64_t)trans->length * 1000000 / clock + sim_config.spi_overhead_us;
+	host->busy_until_us = start + duration;
+	sim_bus_account("spi", dev->name, start, duration, bytes);
+	if(data && bytes)
+	{
+		if(dev->model == SIM_SPI_LCD) sim_lcd_decode(data, bytes, start, start + duration);
+		else sim_apa102_decode(data, bytes);
+	}
+	if(dev->config.post_cb) dev->config.post_cb(trans);
+	return start + duration;
+}
+
+static int sim_spi_in_flight(spi_device_handle_t dev, int64_t *earliest)
+{
+	int count = 0;
+	*earliest = SIM_NEVER;
+	for(int i = 0; i < dev->config.queue_size; i++)
+	{
+		if(dev->in_flight[i] <= sim_now_us()) continue;
+		count++;
+		if(dev->in_flight[i] < *earliest) *earliest = dev->in_flight[i];
+	}
+	return count;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t timeout)
+{
+	if(trans->length > 0 && trans->tx_buffer == NULL && !(trans->flags & SPI_TRANS_USE_TXDATA)) return ESP_ERR_INVALID_ARG;
+	//wait for a free slot in the transaction queue
+	int64_t deadline = sim_deadline(timeout);
+	int64_t earliest;
+	while(sim_spi_in_flight(handle, &earliest) >= handle->config.queue_size)
+	{
+		if(earliest > deadline) return ESP_ERR_TIMEOUT;
+		sim_delay_us(earliest - sim_now_us());
+	}
+	int64_t done = sim_spi_execute(handle, trans);
+	for(int i = 0; i < handle->config.queue_size; i++)
+	{
+		if(handle->in_flight[i] > sim_now_us()) continue;
+		handle->in_flight[i] = done;
+		break;
+	}
+	//results that are never fetched overwrite the oldest one, like a full return queue drops them
+	int size = handle->config.queue_size;
+	if(handle->result_count == size)
+	{
+		handle->result_head = (handle->result_head + 1) % size;
+		handle->result_count--;
+	}
+	sim_spi_result_t *result = &handle->results[(handle->result_head + handle->result_count) % size];
+	result->trans = trans;
+	result->done_us = done;
+	handle->result_count++;
+	return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans, TickType_t timeout)
+{
+	if(handle->result_count == 0)
+	{
+		//nothing queued, only the timeout passes
+		if(timeout != portMAX_DELAY) sim_delay_us(sim_deadline(timeout) - sim_now_us());
+		return ESP_ERR_TIMEOUT;
+	}
+	sim_spi_result_t *result = &handle->results[handle->result_head];
+	int64_t deadline = sim_deadline(timeout);
+	if(result->done_us > deadline)
+	{
+		sim_delay_us(deadline - sim_now_us());
+		return ESP_ERR_TIMEOUT;
+	}
+	sim_delay_us(result->done_us - sim_now_us());
+	*trans = result->trans;
+	handle->result_head = (handle->result_head + 1) % handle->config.queue_size;
+	handle->result_count--;
+	return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+	spi_transaction_t *done;
+	esp_err_t ret = spi_device_queue_trans(handle, trans, portMAX_DELAY);
+	if(ret != ESP_OK) return ret;
+	//fetch results up to this transaction, like the driver requires for a blocking call
+	do
+	{
+		ret = spi_device_get_trans_result(handle, &done, portMAX_DELAY);
+	} while(ret == ESP_OK && done != trans);
+	return ret;
+}
+
+esp_err_t spi_device_polling_start(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t timeout)
+{
+	handle->polling_done_us = sim_spi_execute(handle, trans);
+	return ESP_OK;
+}
+
+esp_err_t spi_device_polling_end(spi_device_handle_t handle, TickType_t timeout)
+{
+	sim_delay_us(handle->polling_done_us - sim_now_us());
+	return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+	spi_device_polling_start(handle, trans, portMAX_DELAY);
+	return spi_device_polling_end(handle, portMAX_DELAY);
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t handle, TickType_t wait)
+{
+	return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t handle)
+{
+}
@@ -0,0 +1,224 @@
+//Trace and report of the host simulation
+//
+//Every output change is written to trace.csv. Marks of the script (inputs and
+//named marks) are matched with the first following frame, buzzer, LED and GPIO
+//change, which gives the input latency and the response time of the protection.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "sim.h"
+
+#define SIM_MAX_MARKS   256
+#define SIM_MAX_BUS     8
+
+typedef struct {
+	int64_t time_us;
+	char kind[8];
+	char name[24];
+	int64_t frame_us;
+	int64_t buzzer_us;
+	int64_t led_us;
+	int64_t gpio_us;
+} sim_mark_t;
+
+typedef struct {
+	char bus[4];
+	char device[12];
+	int64_t busy_us;
+	uint64_t bytes;
+	uint32_t transfers;
+} sim_bus_t;
+
+static FILE *sim_trace_file = NULL;
+static sim_mark_t sim_marks[SIM_MAX_MARKS];
+static int sim_mark_count = 0;
+static sim_bus_t sim_buses[SIM_MAX_BUS];
+static int sim_bus_count = 0;
+
+static uint32_t sim_frames = 0;
+static int64_t sim_frame_first_us = -1;
+static int64_t sim_frame_last_us = 0;
+static int64_t sim_frame_time_sum = 0;
+static int64_t sim_frame_time_min = SIM_NEVER;
+static int64_t sim_frame_time_max = 0;
+static uint64_t sim_frame_bytes = 0;
+
+void sim_trace_open(void)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/trace.csv", sim_config.out_dir);
+	sim_trace_file = fopen(path, "w");
+	if(sim_trace_file == NULL)
+	{
+		fprintf(stderr, "sim: could not write %s\n", path);
+		exit(1);
+	}
+	fprintf(sim_trace_file, "time_us,task,source,event,detail\n");
+}
+
+static void sim_trace_marks(const char *source, const char *event, const char *detail)
+{
+	int64_t now = sim_now_us();
+	bool buzzer = strcmp(source, "ledc") == 0 && strcmp(event, "duty") == 0;
+	bool led = strcmp(source, "led") == 0;
+	bool gpio = strcmp(source, "gpio") == 0 || strcmp(source, "expander") == 0;
+	if(!buzzer && !led && !gpio) return;
+	for(int i = 0; i < sim_mark_count; i++)
+	{
+		sim_mark_t *mark = &sim_marks[i];
+		if(mark->time_us > now) continue;
+		if(buzzer && mark->buzzer_us < 0) mark->buzzer_us = now;
+		if(led && mark->led_us < 0) mark->led_us = now;
+		if(gpio && mark->gpio_us < 0) mark->gpio_us = now;
+	}
+}
+
+void sim_trace(const char *source, const char *event, const char *format, ...)
+{
+	char detail[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(detail, sizeof(detail), format, args);
+	va_end(args);
+	sim_trace_marks(source, event, detail);
+	if(sim_trace_file == NULL) return;
+	fprintf(sim_trace_file, "%lld,%s,%s,%s,%s\n", (long long)sim_now_us(), sim_current_task_name(), source, event, detail);
+}
+
+/**
+ * Records a reference time of the script for the response times in the report.
+ */
+void sim_mark(const char *kind, const char *name)
+{
+	sim_trace("mark", kind, "%s", name);
+	if(sim_mark_count == SIM_MAX_MARKS) return;
+	sim_mark_t *mark = &sim_marks[sim_mark_count++];
+	mark->time_us = sim_now_us();
+	snprintf(mark->kind, sizeof(mark->kind), "%s", kind);
+	snprintf(mark->name, sizeof(mark->name), "%s", name);
+	mark->frame_us = -1;
+	mark->buzzer_us = -1;
+	mark->led_us = -1;
+	mark->gpio_us = -1;
+}
+
+void sim_bus_account(const char *bus, const char *device, int64_t start_us, int64_t duration_us, uint32_t bytes)
+{
+	sim_bus_t *entry = NULL;
+	for(int i = 0; i < sim_bus_count; i++)
+	{
+		if(strcmp(sim_buses[i].bus, bus) == 0 && strcmp(sim_buses[i].device, device) == 0) entry = &sim_buses[i];
+	}
+	if(entry == NULL)
+	{
+		if(sim_bus_count == SIM_MAX_BUS) return;
+		entry = &sim_buses[sim_bus_count++];
+		snprintf(entry->bus, sizeof(entry->bus), "%s", bus);
+		snprintf(entry->device, sizeof(entry->device), "%s", device);
+	}
+	entry->busy_us += duration_us;
+	entry->bytes += bytes;
+	entry->transfers++;
+}
+
+/**
+ * Called by the LCD model when the bus was idle for the frame gap after a burst of writes.
+ */
+void sim_lcd_frame_done(int64_t start_us, int64_t end_us, uint32_t bytes)
+{
+	sim_frames++;
+	if(sim_frame_first_us < 0) sim_frame_first_us = end_us;
+	sim_frame_last_us = end_us;
+	int64_t duration = end_us - start_us;
+	sim_frame_time_sum += duration;
+	if(duration < sim_frame_time_min) sim_frame_time_min = duration;
+	if(duration > sim_frame_time_max) sim_frame_time_max = duration;
+	sim_frame_bytes += bytes;
+	sim_trace("lcd", "frame", "%u bytes in %lld us", bytes, (long long)duration);
+	//only frames started after the mark can show its effect
+	for(int i = 0; i < sim_mark_count; i++)
+	{
+		if(sim_marks[i].frame_us < 0 && start_us >= sim_marks[i].time_us) sim_marks[i].frame_us = end_us;
+	}
+	if(sim_config.dump_every > 0 && sim_frames % sim_config.dump_every == 0)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "frame_%05u", sim_frames);
+		sim_lcd_dump(name);
+	}
+}
+
+static void sim_report_latency(FILE *out, int64_t from, int64_t to)
+{
+	if(to < 0) fprintf(out, " %10s", "-");
+	else fprintf(out, " %10.1f", (to - from) / 1000.0);
+}
+
+static void sim_report_write(FILE *out)
+{
+	int64_t now = sim_now_us();
+	fprintf(out, "Simulated time: %.3f s\n\n", now / 1e6);
+
+	fprintf(out, "LCD frames: %u\n", sim_frames);
+	if(sim_frames > 1)
+	{
+		fprintf(out, "  rate: %.2f fps\n", (sim_frames - 1) * 1e6 / (sim_frame_last_us - sim_frame_first_us));
+	}
+	if(sim_frames > 0)
+	{
+		fprintf(out, "  transfer time: min %.2f / avg %.2f / max %.2f ms\n", sim_frame_time_min / 1000.0,
+			sim_frame_time_sum / 1000.0 / sim_frames, sim_frame_time_max / 1000.0);
+		fprintf(out, "  bytes per frame: %llu\n", (unsigned long long)(sim_frame_bytes / sim_frames));
+	}
+	fprintf(out, "\n");
+
+	if(sim_mark_count)
+	{
+		fprintf(out, "Response times after the script marks in ms\n");
+		fprintf(out, "  %10s %-6s %-16s %10s %10s %10s %10s\n", "time_ms", "kind", "name", "frame", "buzzer", "led", "output");
+		for(int i = 0; i < sim_mark_count; i++)
+		{
+			sim_mark_t *mark = &sim_marks[i];
+			fprintf(out, "  %10.1f %-6s %-16s", mark->time_us / 1000.0, mark->kind, mark->name);
+			sim_report_latency(out, mark->time_us, mark->frame_us);
+			sim_report_latency(out, mark->time_us, mark->buzzer_us);
+			sim_report_latency(out, mark->time_us, mark->led_us);
+			sim_report_latency(out, mark->time_us, mark->gpio_us);
+			fprintf(out, "\n");
+		}
+		fprintf(out, "\n");
+	}
+
+	fprintf(out, "Bus load\n");
+	fprintf(out, "  %-4s %-10s %10s %10s %10s %8s\n", "bus", "device", "transfers", "bytes", "busy_ms", "load");
+	for(int i = 0; i < sim_bus_count; i++)
+	{
+		sim_bus_t *bus = &sim_buses[i];
+		fprintf(out, "  %-4s %-10s %10u %10llu %10.1f %7.2f%%\n", bus->bus, bus->device, bus->transfers,
+			(unsigned long long)bus->bytes, bus->busy_us / 1000.0, now ? bus->busy_us * 100.0 / now : 0);
+	}
+	fprintf(out, "\n");
+	sim_nvs_report(out);
+	sim_pm_report(out);
+	sim_task_report(out);
+}
+
+/**
+ * Writes report.txt to the output directory and prints it.
+ */
+void sim_report(void)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/report.txt", sim_config.out_dir);
+	FILE *out = fopen(path, "w");
+	if(out)
+	{
+		sim_report_write(out);
+		fclose(out);
+	}
+	if(sim_trace_file) fflush(sim_trace_file);
+	printf("\n");
+	sim_report_write(stdout);
+}
@@ -0,0 +1,78 @@
+//UART driver of the host simulation, the receive buffer is filled by the cmd command of the script
+
+#include <string.h>
+#include "driver/uart.h"
+#include "sim.h"
+
+#define SIM_UART_RX_SIZE 1024
+
+typedef struct {
+	bool installed;
+	uint8_t rx[SIM_UART_RX_SIZE];
+	size_t head;
+	size_t count;
+} sim_uart_t;
+
+static sim_uart_t sim_uarts[UART_NUM_MAX];
+
+/**
+ * Feeds a line to the console UART, a line end is appended.
+ */
+void sim_uart_feed(const char *line)
+{
+	sim_uart_t *uart = &sim_uarts[UART_NUM_0];
+	size_t length = strlen(line);
+	for(size_t i = 0; i <= length && uart->count < SIM_UART_RX_SIZE; i++)
+	{
+		uart->rx[(uart->head + uart->count) % SIM_UART_RX_SIZE] = i < length ? line[i] : '\n';
+		uart->count++;
+	}
+	sim_wake(uart);
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size, int queue_size,
+	QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+	if(port < 0 || port >= UART_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	sim_uarts[port].installed = true;
+	return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t port)
+{
+	if(port < 0 || port >= UART_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	sim_uarts[port].installed = false;
+	return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+	if(port < 0 || port >= UART_NUM_MAX || !sim_uarts[port].installed) return -1;
+	sim_uart_t *uart = &sim_uarts[port];
+	uint8_t *out = buf;
+	uint32_t read = 0;
+	int64_t deadline = sim_deadline(ticks_to_wait);
+	while(read < length)
+	{
+		if(uart->count == 0)
+		{
+			if(ticks_to_wait == 0 || !sim_block(uart, deadline)) break;
+			continue;
+		}
+		out[read++] = uart->rx[uart->head];
+		uart->head = (uart->head + 1) % SIM_UART_RX_SIZE;
+		uart->count--;
+	}
+	return read;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size)
+{
+	return fwrite(src, 1, size, stdout);
+}
+
+esp_err_t uart_set_wakeup_threshold(uart_port_t port, int wakeup_threshold)
+{
+	if(port < 0 || port >= UART_NUM_MAX) return ESP_ERR_INVALID_ARG;
+	return ESP_OK;
+}
@@ -0,0 +1,102 @@
+//SPIFFS of the host simulation: a directory of the host is mounted at the base path
+//
+//The firmware sources are compiled with sim_vfs.h as forced include, which
+//routes their file calls through the functions below. This file itself calls
+//the host functions.
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "esp_spiffs.h"
+#include "sim.h"
+
+//size of the storage partition in partitions_example.csv
+#define SIM_SPIFFS_SIZE 0xF0000
+
+static char sim_vfs_base[32] = "";
+
+/**
+ * Maps a firmware path below the base path into the image directory.
+ * @return the host path, or the unchanged path if it is not below the base path
+ */
+static const char *sim_vfs_path(const char *path, char *buffer, size_t size)
+{
+	size_t base = strlen(sim_vfs_base);
+	if(base == 0 || strncmp(path, sim_vfs_base, base) != 0 || (path[base] != '/' && path[base] != 0)) return path;
+	snprintf(buffer, size, "%s%s", sim_config.spiffs_dir, path + base);
+	return buffer;
+}
+
+FILE *sim_fopen(const char *path, const char *mode)
+{
+	char buffer[512];
+	return fopen(sim_vfs_path(path, buffer, sizeof(buffer)), mode);
+}
+
+DIR *sim_opendir(const char *path)
+{
+	char buffer[512];
+	return opendir(sim_vfs_path(path, buffer, sizeof(buffer)));
+}
+
+int sim_stat(const char *path, struct stat *st)
+{
+	char buffer[512];
+	return stat(sim_vfs_path(path, buffer, sizeof(buffer)), st);
+}
+
+int sim_unlink(const char *path)
+{
+	char buffer[512];
+	return unlink(sim_vfs_path(path, buffer, sizeof(buffer)));
+}
+
+int sim_rename(const char *from, const char *to)
+{
+	char buffer_from[512], buffer_to[512];
+	return rename(sim_vfs_path(from, buffer_from, sizeof(buffer_from)), sim_vfs_path(to, buffer_to, sizeof(buffer_to)));
+}
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf)
+{
+	if(conf == NULL || conf->base_path == NULL) return ESP_ERR_INVALID_ARG;
+	if(sim_vfs_base[0]) return ESP_ERR_INVALID_STATE;
+	struct stat st;
+	if(stat(sim_config.spiffs_dir, &st) != 0 || !S_ISDIR(st.st_mode)) return ESP_ERR_NOT_FOUND;
+	snprintf(sim_vfs_base, sizeof(sim_vfs_base), "%s", conf->base_path);
+	return ESP_OK;
+}
+
+esp_err_t esp_vfs_spiffs_unregister(const char *partition_label)
+{
+	if(sim_vfs_base[0] == 0) return ESP_ERR_INVALID_STATE;
+	sim_vfs_base[0] = 0;
+	return ESP_OK;
+}
+
+bool esp_spiffs_mounted(const char *partition_label)
+{
+	return sim_vfs_base[0] != 0;
+}
+
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes)
+{
+	if(sim_vfs_base[0] == 0) return ESP_ERR_INVALID_STATE;
+	DIR *dir = opendir(sim_config.spiffs_dir);
+	if(dir == NULL) return ESP_FAIL;
+	size_t used = 0;
+	struct dirent *entry;
+	while((entry = readdir(dir)) != NULL)
+	{
+		char path[512];
+		struct stat st;
+		snprintf(path, sizeof(path), "%s/%s", sim_config.spiffs_dir, entry->d_name);
+		if(stat(path, &st) == 0 && S_ISREG(st.st_mode)) used += st.st_size;
+	}
+	closedir(dir);
+	*total_bytes = SIM_SPIFFS_SIZE;
+	*used_bytes = used;
+	return ESP_OK;
+}
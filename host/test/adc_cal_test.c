@@ -0,0 +1,172 @@
+//Calibration tables of the ADC rails: points are sorted in by ADCD_cal_insert
+//like ADCD_cal_capture does on the calibrate page, a point that makes one of the
+//segments too steep for the Q16 coefficients must be rejected without changing
+//the table, and ADCD_cal_valid must refuse a stored table with such a segment.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sim.h"
+#include "fixed_point.h"
+#include "ADC_data_driver.h"
+
+sim_config_t sim_config = {
+	.out_dir = ".",
+	.spiffs_dir = ".",
+	.assets_path = "",
+};
+
+static int failures = 0;
+
+#define CHECK(name, cond) do { if(!(cond)) { printf("FAIL %s: %s\n", name, #cond); failures++; } } while(0)
+#define CHECK_ERR(name, got, want) do { if((got) != (want)) { printf("FAIL %s: error %d, expected %d\n", name, (int)(got), (int)(want)); failures++; } } while(0)
+
+//a single point like ADCD_cal_clear leaves it, the nominal scale continues from it
+static void table_zero(ADC_cal_table_t *table)
+{
+	memset(table, 0, sizeof(*table));
+	table->count = 1;
+}
+
+//every segment of the table must convert its two points exactly
+static void check_segments(const char *name, const ADC_cal_table_t *table)
+{
+	for(int i = 1; i < table->count; i++)
+	{
+		q16_coef_t coef = q16_segment(table->raw[i - 1], table->uV[i - 1], table->raw[i], table->uV[i]);
+		int32_t low = q16_apply(&coef, table->raw[i - 1]);
+		int32_t high = q16_apply(&coef, table->raw[i]);
+		if(low < table->uV[i - 1] - 1 || low > table->uV[i - 1] + 1 || high < table->uV[i] - 1 || high > table->uV[i] + 1)
+		{
+			printf("FAIL %s: segment %d gives %d..%d uV, expected %d..%d uV\n", name, i, (int)low, (int)high, (int)table->uV[i - 1], (int)table->uV[i]);
+			failures++;
+		}
+	}
+}
+
+static void test_steep_rejected(void)
+{
+	ADC_cal_table_t table;
+	ADC_cal_table_t before;
+
+	//24 V captured 20 counts above the zero point, the scale wrapped to 1333788672 before
+	table_zero(&table);
+	before = table;
+	CHECK_ERR("steep insert", ADCD_cal_insert(&table, 20, 24000000), ESP_ERR_INVALID_ARG);
+	CHECK("steep insert", memcmp(&table, &before, sizeof(table)) == 0);
+
+	//steep towards the next point when inserted below it
+	table_zero(&table);
+	CHECK_ERR("steep below", ADCD_cal_insert(&table, 3410, 24000000), ESP_OK);
+	before = table;
+	CHECK_ERR("steep below", ADCD_cal_insert(&table, 3380, 0), ESP_ERR_INVALID_ARG);
+	CHECK("steep below", memcmp(&table, &before, sizeof(table)) == 0);
+
+	//the largest scale is still accepted, one microvolt more is not
+	table_zero(&table);
+	CHECK_ERR("scale limit", ADCD_cal_insert(&table, 100, 100 * Q16_SCALE_MAX), ESP_OK);
+	table_zero(&table);
+	CHECK_ERR("scale limit", ADCD_cal_insert(&table, 100, 100 * Q16_SCALE_MAX + 100), ESP_ERR_INVALID_ARG);
+}
+
+static void test_merge_rejected(void)
+{
+	ADC_cal_table_t table;
+	ADC_cal_table_t before;
+
+	table_zero(&table);
+	CHECK_ERR("merge", ADCD_cal_insert(&table, 1000, 7000000), ESP_OK);
+	CHECK_ERR("merge", ADCD_cal_insert(&table, 1200, 8400000), ESP_OK);
+	CHECK("merge", table.count == 3);
+	//replacing the middle point with the output off makes the upper segment too steep
+	before = table;
+	CHECK_ERR("merge steep", ADCD_cal_insert(&table, 1010, 0), ESP_ERR_INVALID_ARG);
+	CHECK("merge steep", memcmp(&table, &before, sizeof(table)) == 0);
+	//a sensible replacement is still merged
+	CHECK_ERR("merge", ADCD_cal_insert(&table, 1010, 7100000), ESP_OK);
+	CHECK("merge", table.count == 3 && table.raw[1] == 1010 && table.uV[1] == 7100000);
+	check_segments("merge", &table);
+}
+
+static void test_accepted(void)
+{
+	static const int32_t raw[] = {3410, 1705, 500, 2900, 3900};
+	ADC_cal_table_t table;
+
+	table_zero(&table);
+	for(int i = 0; i < (int)(sizeof(raw) / sizeof(raw[0])); i++)
+	{
+		//slightly bent 24 V rail
+		int32_t uV = (int32_t)((int64_t)raw[i] * 24000000 / 3410 + (raw[i] > 2000 ? 20000 : 0));
+		CHECK_ERR("accepted", ADCD_cal_insert(&table, raw[i], uV), ESP_OK);
+	}
+	CHECK("accepted", table.count == 6);
+	for(int i = 1; i < table.count; i++) CHECK("accepted sorted", table.raw[i] > table.raw[i - 1]);
+	CHECK("accepted", ADCD_cal_valid(&table));
+	check_segments("accepted", &table);
+
+	CHECK_ERR("full", ADCD_cal_insert(&table, 3000, 21000000), ESP_OK);
+	CHECK_ERR("full", ADCD_cal_insert(&table, 3100, 21800000), ESP_OK);
+	CHECK("full", table.count == ADC_CAL_MAX_POINTS);
+	CHECK_ERR("full", ADCD_cal_insert(&table, 3200, 22500000), ESP_ERR_NO_MEM);
+}
+
+static void test_stored_tables(void)
+{
+	ADC_cal_t cal;
+	ADC_cal_table_t table;
+
+	//nominal tables of ADCD_cal_default
+	ADCD_cal_default(&cal);
+	for(int rail = 0; rail < ADC_CAL_RAILS; rail++)
+	{
+		CHECK("default", ADCD_cal_valid(&cal.rail[rail]));
+		check_segments("default", &cal.rail[rail]);
+	}
+
+	//a table stored before the check, its scale wrapped around
+	table_zero(&table);
+	table.count = 2;
+	table.raw[1] = 20;
+	table.uV[1] = 24000000;
+	CHECK("stored steep", !ADCD_cal_valid(&table));
+	table.raw[1] = 3410;
+	CHECK("stored", ADCD_cal_valid(&table));
+	//falling voltage
+	table.uV[1] = -24000000;
+	CHECK("stored falling", ADCD_cal_valid(&table));
+	table.raw[1] = 20;
+	CHECK("stored falling steep", !ADCD_cal_valid(&table));
+	//unsorted
+	table.raw[1] = 0;
+	table.uV[1] = 0;
+	CHECK("stored unsorted", !ADCD_cal_valid(&table));
+}
+
+static void test_q16(void)
+{
+	q16_coef_t coef;
+
+	CHECK("q16 fits", q16_scale_fits(24000000, 3410));
+	CHECK("q16 fits", q16_scale_fits(-24000000, 3410));
+	CHECK("q16 fits", !q16_scale_fits(24000000, 20));
+	CHECK("q16 fits", !q16_scale_fits(24000000, 0));
+	CHECK("q16 fits", !q16_scale_fits(24000000, -20));
+	//saturated instead of wrapped, the sign stays right
+	coef = q16_coef(24000000, 20, 0);
+	CHECK("q16 saturate", coef.scale == INT32_MAX);
+	coef = q16_coef(-24000000, 20, 0);
+	CHECK("q16 saturate", coef.scale == INT32_MIN);
+}
+
+int main(void)
+{
+	test_steep_rejected();
+	test_merge_rejected();
+	test_accepted();
+	test_stored_tables();
+	test_q16();
+	printf("adc_cal_test: %s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+//Model of the encoder decoder: synthetic quadrature edge streams are fed through
+//IO_ENC_decode like the CLK interrupt of IO_driver.c sees them, and the net
+//counts are checked against the steps of the stream.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "IO_driver.h"
+
+//how the CLK interrupt sees an edge
+typedef enum {
+	ISR_NOW,	//runs before the next line change
+	ISR_LATE,	//latched, runs at the next enc_service
+	ISR_DROP,	//edge not seen at all
+} isr_mode_t;
+
+typedef struct {
+	int phase;			//0..3, CW order CLK/DT 00 10 11 01
+	uint8_t clk;
+	uint8_t dt;
+	volatile uint8_t clk_last;
+	bool pending;
+	int32_t count;
+	int32_t min_step;	//smallest single step the ISR produced
+	int32_t max_step;
+} enc_model_t;
+
+static const uint8_t phase_clk[4] = {0, 1, 1, 0};
+static const uint8_t phase_dt[4] = {0, 0, 1, 1};
+
+static int failures = 0;
+
+#define CHECK(name, cond) do { if(!(cond)) { printf("FAIL %s: %s\n", name, #cond); failures++; } } while(0)
+#define CHECK_COUNT(name, got, want) do { if((got) != (want)) { printf("FAIL %s: count %d, expected %d\n", name, (int)(got), (int)(want)); failures++; } } while(0)
+
+static void enc_reset(enc_model_t *enc)
+{
+	enc->phase = 0;
+	enc->clk = 0;
+	enc->dt = 0;
+	enc->clk_last = 0;
+	enc->pending = false;
+	enc->count = 0;
+	enc->min_step = 0;
+	enc->max_step = 0;
+}
+
+//the interrupt handler: sample both lines, decode
+static void enc_service(enc_model_t *enc)
+{
+	if(!enc->pending) return;
+	enc->pending = false;
+	int step = IO_ENC_decode(&enc->clk_last, enc->clk, enc->dt);
+	enc->count += step;
+	if(step < enc->min_step) enc->min_step = step;
+	if(step > enc->max_step) enc->max_step = step;
+}
+
+static void enc_lines(enc_model_t *enc, uint8_t clk, uint8_t dt, isr_mode_t mode)
+{
+	bool edge = clk != enc->clk;
+	enc->clk = clk;
+	enc->dt = dt;
+	if(!edge || mode == ISR_DROP) return;
+	enc->pending = true;
+	if(mode == ISR_NOW) enc_service(enc);
+}
+
+//one quarter step, dir +1 CW or -1 CCW
+static void enc_quarter(enc_model_t *enc, int dir, isr_mode_t mode)
+{
+	enc->phase = (enc->phase + dir + 4) & 3;
+	enc_lines(enc, phase_clk[enc->phase], phase_dt[enc->phase], mode);
+}
+
+//full quadrature cycles, two CLK edges each
+static void enc_cycles(enc_model_t *enc, int cycles, int dir)
+{
+	for(int i = 0; i < cycles * 4; i++) enc_quarter(enc, dir, ISR_NOW);
+}
+
+static void test_direction(void)
+{
+	enc_model_t enc;
+	enc_reset(&enc);
+	enc_cycles(&enc, 100, 1);
+	CHECK_COUNT("cw", enc.count, 200);
+	CHECK("cw", enc.min_step == 0);
+
+	enc_reset(&enc);
+	enc_cycles(&enc, 100, -1);
+	CHECK_COUNT("ccw", enc.count, -200);
+	CHECK("ccw", enc.max_step == 0);
+
+	//reversal in the middle of a cycle
+	enc_reset(&enc);
+	enc_cycles(&enc, 50, 1);
+	for(int i = 0; i < 3; i++) enc_quarter(&enc, 1, ISR_NOW);
+	for(int i = 0; i < 3; i++) enc_quarter(&enc, -1, ISR_NOW);
+	enc_cycles(&enc, 30, -1);
+	CHECK_COUNT("reverse", enc.count, 40);
+}
+
+//CLK bounces after every edge, each bounce a pair of opposite edges
+static void test_bounce(void)
+{
+	enc_model_t enc;
+	for(int bounces = 1; bounces <= 4; bounces++)
+	{
+		enc_reset(&enc);
+		for(int i = 0; i < 100 * 4; i++)
+		{
+			enc_quarter(&enc, 1, ISR_NOW);
+			if(phase_clk[enc.phase] == phase_clk[(enc.phase + 3) & 3]) continue;
+			for(int b = 0; b < bounces; b++)
+			{
+				enc_lines(&enc, !enc.clk, enc.dt, ISR_NOW);
+				enc_lines(&enc, !enc.clk, enc.dt, ISR_NOW);
+			}
+		}
+		CHECK_COUNT("bounce", enc.count, 200);
+	}
+
+	//bounce settled before the interrupt ran, only the final level is seen
+	enc_reset(&enc);
+	for(int i = 0; i < 100 * 4; i++)
+	{
+		enc_quarter(&enc, -1, ISR_LATE);
+		if(!enc.pending) continue;
+		enc_lines(&enc, !enc.clk, enc.dt, ISR_LATE);
+		enc_lines(&enc, !enc.clk, enc.dt, ISR_LATE);
+		enc_service(&enc);
+	}
+	CHECK_COUNT("bounce settled", enc.count, -200);
+}
+
+//long spins with reversals, every CLK edge serviced before DT moves
+static void test_fast_spin(void)
+{
+	enc_model_t enc;
+	enc_reset(&enc);
+	uint32_t seed = 12345;
+	int32_t expected = 0;
+	int dir = 1;
+	for(int i = 0; i < 100000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		if((seed >> 16) % 97 == 0) dir = -dir;
+		int clk = enc.clk;
+		enc_quarter(&enc, dir, ISR_NOW);
+		if(enc.clk != clk) expected += dir;
+	}
+	CHECK_COUNT("fast spin", enc.count, expected);
+
+	//two CLK edges latched into one interrupt, the pair is lost but never counted backwards
+	enc_reset(&enc);
+	for(int i = 0; i < 100; i++)
+	{
+		enc_quarter(&enc, 1, ISR_LATE);
+		enc_quarter(&enc, 1, ISR_LATE);
+		enc_quarter(&enc, 1, ISR_LATE);
+		enc_service(&enc);
+		enc_quarter(&enc, 1, ISR_NOW);
+	}
+	CHECK_COUNT("coalesced", enc.count, 0);
+	CHECK("coalesced", enc.min_step == 0);
+}
+
+//a missed CLK edge costs that step and the following one, then the decoder is back in sync
+static void test_dropped(void)
+{
+	enc_model_t enc;
+	enc_reset(&enc);
+	int edge = 0;
+	int drops = 0;
+	for(int i = 0; i < 100 * 4; i++)
+	{
+		int next = (enc.phase + 1) & 3;
+		bool clk_edge = phase_clk[next] != enc.clk;
+		isr_mode_t mode = ISR_NOW;
+		if(clk_edge && ++edge % 10 == 5)
+		{
+			mode = ISR_DROP;
+			drops++;
+		}
+		enc_quarter(&enc, 1, mode);
+	}
+	CHECK_COUNT("dropped", enc.count, 200 - 2 * drops);
+	CHECK("dropped", enc.min_step == 0);
+	enc_cycles(&enc, 10, 1);
+	CHECK_COUNT("dropped resync", enc.count, 200 - 2 * drops + 20);
+}
+
+int main(void)
+{
+	test_direction();
+	test_bounce();
+	test_fast_spin();
+	test_dropped();
+	printf("encoder_test: %s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
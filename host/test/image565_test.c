@@ -0,0 +1,262 @@
+//Round trip of the image pipeline: the pattern converted by tools/png2rgb565.py,
+//raw and RLE, is blitted by DF_print_image565 and compared with the pngle decode
+//of the same PNG by DF_print_png. Positions at the screen border check the
+//clipping, damaged images must be rejected without writing outside the image.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sim.h"
+#include "dfuncs.h"
+#include "image565.h"
+
+#define SCREEN_W 128
+#define SCREEN_H 160
+//never produced by the pattern
+#define SENTINEL 0xA5A5
+
+extern uint16_t vscreen[SCREEN_W][SCREEN_H];
+
+sim_config_t sim_config = {
+	.out_dir = ".",
+	.spiffs_dir = ".",
+	.assets_path = "",
+};
+
+typedef struct {
+	uint8_t *data;
+	size_t size;
+	image565_header_t header;
+} test_image_t;
+
+static int failures = 0;
+static uint16_t *reference;	//pngle decode, column major like the images
+static uint16_t ref_w;
+static uint16_t ref_h;
+
+#define CHECK(name, cond) do { if(!(cond)) { printf("FAIL %s: %s\n", name, #cond); failures++; } } while(0)
+
+static bool load_image(const char *path, test_image_t *image)
+{
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL) return false;
+	fseek(fp, 0, SEEK_END);
+	image->size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	image->data = malloc(image->size);
+	bool ok = image->data != NULL && fread(image->data, 1, image->size, fp) == image->size && image->size >= sizeof(image565_header_t);
+	fclose(fp);
+	if(ok) memcpy(&image->header, image->data, sizeof(image565_header_t));
+	return ok;
+}
+
+static void screen_fill(void)
+{
+	for(int x = 0; x < SCREEN_W; x++)
+		for(int y = 0; y < SCREEN_H; y++) vscreen[x][y] = SENTINEL;
+}
+
+//the screen must hold the reference at x0/y0 clipped at the border, the sentinel elsewhere
+static bool screen_matches(const char *name, int x0, int y0)
+{
+	for(int x = 0; x < SCREEN_W; x++)
+	{
+		for(int y = 0; y < SCREEN_H; y++)
+		{
+			bool inside = x >= x0 && x < x0 + ref_w && y >= y0 && y < y0 + ref_h;
+			uint16_t want = inside ? reference[(x - x0) * ref_h + (y - y0)] : SENTINEL;
+			if(vscreen[x][y] != want)
+			{
+				printf("FAIL %s at %d/%d: pixel %d/%d is 0x%04x, expected 0x%04x\n", name, x0, y0, x, y, vscreen[x][y], want);
+				failures++;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//pixels outside the image rectangle must be untouched, inside anything may have been drawn
+static bool outside_untouched(const char *name, int x0, int y0)
+{
+	for(int x = 0; x < SCREEN_W; x++)
+	{
+		for(int y = 0; y < SCREEN_H; y++)
+		{
+			bool inside = x >= x0 && x < x0 + ref_w && y >= y0 && y < y0 + ref_h;
+			if(!inside && vscreen[x][y] != SENTINEL)
+			{
+				printf("FAIL %s: pixel %d/%d outside the image written\n", name, x, y);
+				failures++;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool decode_reference(const char *png)
+{
+	TFT_t dev;
+	memset(&dev, 0, sizeof(dev));
+	screen_fill();
+	DF_print_png(&dev, (char *)png, SCREEN_W, SCREEN_H);
+	reference = malloc(ref_w * ref_h * sizeof(uint16_t));
+	int decoded = 0;
+	for(int x = 0; x < ref_w; x++)
+	{
+		for(int y = 0; y < ref_h; y++)
+		{
+			reference[x * ref_h + y] = vscreen[x][y];
+			if(vscreen[x][y] != SENTINEL) decoded++;
+		}
+	}
+	CHECK("pngle decode", decoded == ref_w * ref_h);
+	return decoded == ref_w * ref_h && screen_matches("pngle decode", 0, 0);
+}
+
+static void test_round_trip(const char *name, const test_image_t *image)
+{
+	static const int positions[][2] = {
+		{0, 0}, {50, 60},
+		//clipped at the right, bottom and both borders
+		{SCREEN_W - 15, 20}, {10, SCREEN_H - 7}, {SCREEN_W - 1, SCREEN_H - 1},
+		//completely outside
+		{SCREEN_W, 0}, {0, SCREEN_H}, {1000, 1000},
+	};
+	for(size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++)
+	{
+		screen_fill();
+		bool drawn = DF_print_image565(image->data, image->size, positions[i][0], positions[i][1]);
+		CHECK(name, drawn);
+		screen_matches(name, positions[i][0], positions[i][1]);
+	}
+}
+
+static void expect_rejected(const char *name, const uint8_t *data, size_t size)
+{
+	screen_fill();
+	if(DF_print_image565(data, size, 20, 30))
+	{
+		printf("FAIL %s: damaged image accepted\n", name);
+		failures++;
+	}
+	outside_untouched(name, 20, 30);
+}
+
+static void set_header(uint8_t *data, const image565_header_t *header)
+{
+	memcpy(data, header, sizeof(*header));
+}
+
+static void test_rejected(const test_image_t *raw, const test_image_t *rle)
+{
+	const size_t head = sizeof(image565_header_t);
+	uint8_t *copy = malloc(rle->size + raw->size);
+	image565_header_t header;
+
+	//buffer ends early
+	size_t cuts[] = {0, head - 1, head, head + 1, rle->size / 2, rle->size - 2, rle->size - 1};
+	for(size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) expect_rejected("rle truncated buffer", rle->data, cuts[i]);
+	expect_rejected("raw truncated buffer", raw->data, raw->size - 1);
+
+	//header consistent with a stream that ends early
+	for(uint32_t cut = 2; cut <= 64; cut += 2)
+	{
+		memcpy(copy, rle->data, rle->size);
+		header = rle->header;
+		header.data_size -= cut;
+		set_header(copy, &header);
+		expect_rejected("rle truncated stream", copy, head + header.data_size);
+	}
+	memcpy(copy, raw->data, raw->size);
+	header = raw->header;
+	header.data_size -= 2;
+	set_header(copy, &header);
+	expect_rejected("raw short data", copy, head + header.data_size);
+
+	//packet longer than the image
+	memcpy(copy, rle->data, rle->size);
+	copy[head] = 0xFF;
+	copy[head + 1] = 0x7F;
+	expect_rejected("rle literal overflow", copy, rle->size);
+	copy[head + 1] = 0xFF;
+	expect_rejected("rle run overflow", copy, rle->size);
+
+	//run without its pixel, literal without its pixels
+	uint32_t pixels = rle->header.width * rle->header.height;
+	uint8_t packet[][2] = {
+		{pixels & 0xFF, ((pixels >> 8) & 0x7F) | (IMAGE565_RLE_RUN >> 8)},
+		{pixels & 0xFF, (pixels >> 8) & 0x7F},
+	};
+	for(int i = 0; i < 2; i++)
+	{
+		header = rle->header;
+		header.data_size = 2;
+		set_header(copy, &header);
+		memcpy(copy + head, packet[i], 2);
+		expect_rejected(i ? "rle literal missing" : "rle run missing", copy, head + 2);
+	}
+
+	//packets of zero pixels never reach the end of the image
+	memset(copy + head, 0, 64);
+	header = rle->header;
+	header.data_size = 64;
+	set_header(copy, &header);
+	expect_rejected("rle empty packets", copy, head + 64);
+
+	//broken header
+	memcpy(copy, rle->data, rle->size);
+	copy[0] ^= 0x01;
+	expect_rejected("bad magic", copy, rle->size);
+	memcpy(copy, rle->data, rle->size);
+	header = rle->header;
+	header.version++;
+	set_header(copy, &header);
+	expect_rejected("bad version", copy, rle->size);
+	header = rle->header;
+	header.height = 0;
+	set_header(copy, &header);
+	expect_rejected("zero height", copy, rle->size);
+	header = rle->header;
+	header.data_size = rle->size;
+	set_header(copy, &header);
+	expect_rejected("data size beyond buffer", copy, rle->size);
+
+	free(copy);
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 4)
+	{
+		fprintf(stderr, "usage: %s <png> <raw .565> <rle .565>\n", argv[0]);
+		return 2;
+	}
+	test_image_t raw, rle;
+	if(!load_image(argv[2], &raw) || !load_image(argv[3], &rle))
+	{
+		fprintf(stderr, "image565_test: could not read the converted images\n");
+		return 2;
+	}
+	CHECK("raw header", raw.header.magic == IMAGE565_MAGIC && raw.header.version == IMAGE565_VERSION);
+	CHECK("raw header", !(raw.header.flags & IMAGE565_FLAG_RLE));
+	CHECK("raw header", raw.header.data_size == (uint32_t)raw.header.width * raw.header.height * 2);
+	CHECK("rle header", rle.header.flags & IMAGE565_FLAG_RLE);
+	CHECK("rle header", rle.header.width == raw.header.width && rle.header.height == raw.header.height);
+	CHECK("rle header", rle.size < raw.size);
+	ref_w = raw.header.width;
+	ref_h = raw.header.height;
+
+	if(decode_reference(argv[1]))
+	{
+		test_round_trip("raw", &raw);
+		test_round_trip("rle", &rle);
+	}
+	test_rejected(&raw, &rle);
+
+	printf("image565_test: %s\n", failures ? "FAILED" : "passed");
+	return failures ? 1 : 0;
+}
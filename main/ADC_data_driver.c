@@ -10,7 +10,9 @@
 #include "ADC_driver.h"
 #include "esp_log.h"
 #include "ADC_data_driver.h"
-#include "stack_usage_queue_handler.h"
+#include "fixed_point.h"
+#include "metrics.h"
+#include "master_events.h"
 
 static const char *TAG = "ADCD_Data_Driver";
 
@@ -29,12 +31,13 @@ SemaphoreHandle_t xADCD_Semaphore;
 //Initialize ADC I2C Object
 AD_t ADC_dev;
 
-//Initialize Object for stack usage queue
-stack_usage_dataframe_t stack_ADC;
-
 //Initialize Task handle
 TaskHandle_t ADC_task;
 
+//period of the ADC task, slowed down while nothing is displayed
+#define ADC_PERIOD_MS_DEFAULT 50
+static TickType_t ADC_period_ticks = ADC_PERIOD_MS_DEFAULT / portTICK_PERIOD_MS;
+
 //Variables to save values to
 uint16_t ADC1_read = 0x0000;
 uint16_t ADC2_read = 0x0000;
@@ -42,15 +45,56 @@ uint16_t ADC3_read = 0x0000;
 uint16_t ADC4_read = 0x0000;
 uint16_t ADC5_read = 0x0000;
 
-double out24_calibrate = 0;
-double out5_calibrate = 0;
-double out33_calibrate = 0;
-double outvar_calibrate = 0;
+//captured points closer than this replace each other
+#define ADC_CAL_MERGE 16
+
+//piecewise linear conversion of one rail, rebuilt when the calibration changes
+typedef struct
+{
+    int count;                              //segments
+    int32_t start[ADC_CAL_MAX_POINTS - 1];  //raw value where the segment starts
+    q16_coef_t coef[ADC_CAL_MAX_POINTS - 1];
+} ADC_segments_t;
+
+//channel bits of the raw values and nominal voltage at ADC_cal_factor
+static const uint16_t ADC_rail_base[ADC_CAL_RAILS] = {0x0000, 0x1000, 0x2000, 0x3000};
+static const int32_t ADC_rail_nominal_mV[ADC_CAL_RAILS] = {24000, 5000, 3300, 26000};
 
-double out24_value = 0;
-double out5_value = 0;
-double out33_value = 0;
-double outvar_value = 0;
+ADC_segments_t ADC_segments[ADC_CAL_RAILS];
+
+//output voltages in uV
+int32_t out24_value = 0;
+int32_t out5_value = 0;
+int32_t out33_value = 0;
+int32_t outvar_value = 0;
+
+//raw values of the last cycle, used to detect changes
+uint16_t ADC_read_last[5] = {0};
+
+/**
+ * Internal function!!
+ * Converts a raw value with the segments of a rail, a binary search over the
+ * segment starts and one Q16 multiply. The outer segments extrapolate.
+ * 
+ * @param segments segments of the rail
+ * @param raw ADC value without the channel bits
+ * @return voltage in uV
+ * 
+ * \ingroup ADCD
+ * @endcode
+ */
+static inline int32_t ADCD_convert(const ADC_segments_t *segments, int32_t raw)
+{
+	int low = 0;
+	int high = segments->count - 1;
+	while(low < high)
+	{
+		int mid = (low + high + 1) / 2;
+		if(raw >= segments->start[mid]) low = mid;
+		else high = mid - 1;
+	}
+	return q16_apply(&segments->coef[low], raw);
+}
 
 /**
  * Main task of ADC data driver.
@@ -66,6 +110,7 @@ double outvar_value = 0;
  */
 void ADCD_handler(void *pvParameters)
 {
+	metrics_task_register(METRIC_TASK_ADC);
 	while(1)
 	{
 		//If semaphore is initialized
@@ -74,16 +119,30 @@ void ADCD_handler(void *pvParameters)
 			//If able, take semaphore, otherwise try again for 10 Ticks
 			if( xSemaphoreTake( xADCD_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
 		    {
-				ADCD_write_value_16(reg_config, ADC1_config);
-				AD_read_reg_16(&ADC_dev, reg_convert, &ADC1_read);
-				ADCD_write_value_16(reg_config, ADC2_config);
-				AD_read_reg_16(&ADC_dev, reg_convert, &ADC2_read);
-				ADCD_write_value_16(reg_config, ADC3_config);
-				AD_read_reg_16(&ADC_dev, reg_convert, &ADC3_read);
-				ADCD_write_value_16(reg_config, ADC4_config);
-				AD_read_reg_16(&ADC_dev, reg_convert, &ADC4_read);
-				ADCD_write_value_16(reg_config, ADC5_config);
-				AD_read_reg_16(&ADC_dev, reg_convert, &ADC5_read);
+				//a channel keeps its last value if selecting it failed
+				if(ADCD_write_value_16(reg_config, ADC1_config) == ESP_OK) AD_read_reg_16(&ADC_dev, reg_convert, &ADC1_read);
+				if(ADCD_write_value_16(reg_config, ADC2_config) == ESP_OK) AD_read_reg_16(&ADC_dev, reg_convert, &ADC2_read);
+				if(ADCD_write_value_16(reg_config, ADC3_config) == ESP_OK) AD_read_reg_16(&ADC_dev, reg_convert, &ADC3_read);
+				if(ADCD_write_value_16(reg_config, ADC4_config) == ESP_OK) AD_read_reg_16(&ADC_dev, reg_convert, &ADC4_read);
+				if(ADCD_write_value_16(reg_config, ADC5_config) == ESP_OK) AD_read_reg_16(&ADC_dev, reg_convert, &ADC5_read);
+
+				//convert while ADCD_set_calibration cannot swap the segments
+				out24_value = ADCD_convert(&ADC_segments[0], ADC1_read - ADC_rail_base[0]);
+				out5_value = ADCD_convert(&ADC_segments[1], ADC2_read - ADC_rail_base[1]);
+				out33_value = ADCD_convert(&ADC_segments[2], ADC3_read - ADC_rail_base[2]);
+				outvar_value = ADCD_convert(&ADC_segments[3], ADC4_read - ADC_rail_base[3]);
+
+				//only wake the Master_Task if a raw value changed
+				if(ADC1_read != ADC_read_last[0] || ADC2_read != ADC_read_last[1] || ADC3_read != ADC_read_last[2] ||
+				   ADC4_read != ADC_read_last[3] || ADC5_read != ADC_read_last[4])
+				{
+					ADC_read_last[0] = ADC1_read;
+					ADC_read_last[1] = ADC2_read;
+					ADC_read_last[2] = ADC3_read;
+					ADC_read_last[3] = ADC4_read;
+					ADC_read_last[4] = ADC5_read;
+					master_events_set(EVT_ADC_DATA);
+				}
 
 				//Give Semaphore
 				xSemaphoreGive( xADCD_Semaphore );
@@ -92,19 +151,10 @@ void ADCD_handler(void *pvParameters)
 			{
 				ESP_LOGE(TAG, "Could not take Semaphore");
 			}
-			out24_value = (double)ADC1_read * out24_calibrate / ADC_cal_factor;
-			out5_value = (double)(ADC2_read - 0x1000) * out5_calibrate / ADC_cal_factor;
-			out33_value = (double)(ADC3_read - 0x2000) * out33_calibrate / ADC_cal_factor;
-			outvar_value = (double)(ADC4_read - 0x3000) * outvar_calibrate / ADC_cal_factor;
-			
-		}
-		//send free stack of task to queue
-		stack_ADC.size = uxTaskGetStackHighWaterMark(ADC_task);
-		if(stack_usage_queue)
-		{
-			xQueueSendToBack(stack_usage_queue, &stack_ADC, 0);
 		}
-		vTaskDelay(50 / portTICK_PERIOD_MS);
+		//update loop period and free stack of task
+		metrics_task_loop(METRIC_TASK_ADC);
+		vTaskDelay(ADC_period_ticks);
 	}
 }
 
@@ -116,38 +166,248 @@ void ADCD_handler(void *pvParameters)
  * @param I2C_PORT sets I2c_port for ADC init
  * @param SDA_GPIO sets SDA GPIO for ADC init
  * @param SCL_GPIO sets SCL GPIO for ADC init
+ * @param ADC_cal calibration tables of the rails
  *  
  * @endcode
  * \ingroup ADCD
  */
-void ADCD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, ADC_cal_t ADC_cal)
+void ADCD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, const ADC_cal_t *ADC_cal)
 {
-	out24_calibrate = ((double)ADC_cal.OUT24_cal) / 1000;
-	out5_calibrate = ((double)ADC_cal.OUT5_cal) / 1000;
-	out33_calibrate = ((double)ADC_cal.OUT33_cal) / 1000;
-	outvar_calibrate = ((double)ADC_cal.OUTvar_cal) / 1000;
-
 	//ADC Init
 	memset(&ADC_dev, 0, sizeof(AD_t));
 	AD_init_desc(&ADC_dev, AD_addr_low, I2C_PORT, SDA_GPIO, SCL_GPIO);
 	//Create Mutex
 	xADCD_Semaphore = xSemaphoreCreateMutex();
+	ADCD_set_calibration(ADC_cal);
 
-	if(stack_usage_queue)
-	{
-		stack_ADC.task_num = ADC_TASK;
-	}
-
-	//try 5 times to set the config
+	//set the config and the interval, read back to verify
 	ADCD_write_value_16(reg_config, default_config);
-	//try 5 times to set the interval
 	ADCD_write_value_8(reg_cycle_timer, default_interval);
 
 	//Create Handler Task
-	xTaskCreate(ADCD_handler, "ADCD_handler", 1024*4, NULL, 2, ADC_task);
+	xTaskCreatePinnedToCore(ADCD_handler, "ADCD_handler", 1024*4, NULL, CONFIG_PSU_ACQ_PRIORITY, &ADC_task, CONFIG_PSU_ACQ_CORE);
 	ESP_LOGI(TAG, "--> INA220_data_driver initialized successfully");
 }
 
+/**
+ * Checks a calibration table, at least one point, raw values strictly increasing
+ * and every segment within the range of the Q16 conversion.
+ * 
+ * @param table table to check
+ * @return true if the table can be used
+ * 
+ * \ingroup ADCD
+ * @endcode
+ */
+bool ADCD_cal_valid(const ADC_cal_table_t *table)
+{
+	if(table->count < 1 || table->count > ADC_CAL_MAX_POINTS) return false;
+	for(int i = 1; i < table->count; i++)
+	{
+		if(table->raw[i] <= table->raw[i - 1]) return false;
+		//a point captured with the output off gives a slope that wraps the coefficients
+		if(!q16_scale_fits((int64_t)table->uV[i] - table->uV[i - 1], (int64_t)table->raw[i] - table->raw[i - 1])) return false;
+	}
+	return true;
+}
+
+/**
+ * Internal function!!
+ * Builds the segments of one rail. A table with one point uses the nominal scale through that point.
+ * 
+ * @param segments segments to build
+ * @param table calibration table of the rail
+ * @param rail index of the rail
+ * 
+ * \ingroup ADCD
+ * @endcode
+ */
+static void ADCD_build_segments(ADC_segments_t *segments, const ADC_cal_table_t *table, int rail)
+{
+	if(table->count < 2)
+	{
+		int32_t raw0 = table->count ? table->raw[0] : 0;
+		int32_t uV0 = table->count ? table->uV[0] : 0;
+		segments->count = 1;
+		segments->start[0] = raw0;
+		segments->coef[0] = q16_segment(raw0, uV0, raw0 + ADC_cal_factor, uV0 + ADC_rail_nominal_mV[rail] * 1000);
+		return;
+	}
+	segments->count = table->count - 1;
+	for(int i = 0; i < segments->count; i++)
+	{
+		segments->start[i] = table->raw[i];
+		segments->coef[i] = q16_segment(table->raw[i], table->uV[i], table->raw[i + 1], table->uV[i + 1]);
+	}
+}
+
+/**
+ * Changes the period at which the rails are read.
+ * 
+ * @param period_ms period in ms, 0 restores the default of 50 ms
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+void ADCD_set_period(uint32_t period_ms)
+{
+	if(period_ms < ADC_PERIOD_MS_DEFAULT) period_ms = ADC_PERIOD_MS_DEFAULT;
+	ADC_period_ticks = period_ms / portTICK_PERIOD_MS;
+}
+
+/**
+ * Function to rebuild the conversion segments of the outputs.
+ *
+ * Called at init and whenever the calibration changes, the samples are converted
+ * with a binary search over the segments and one integer multiply each.
+ * Invalid tables are replaced by the nominal scale.
+ * 
+ * @param ADC_cal calibration tables of the rails
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+void ADCD_set_calibration(const ADC_cal_t *ADC_cal)
+{
+	ADC_segments_t segments[ADC_CAL_RAILS];
+	ADC_cal_table_t nominal = {0};
+	for(int rail = 0; rail < ADC_CAL_RAILS; rail++)
+	{
+		const ADC_cal_table_t *table = &ADC_cal->rail[rail];
+		if(!ADCD_cal_valid(table))
+		{
+			ESP_LOGE(TAG, "Calibration table of rail %d invalid, nominal scale used", rail);
+			table = &nominal;
+		}
+		ADCD_build_segments(&segments[rail], table, rail);
+	}
+	if( xSemaphoreTake( xADCD_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+	{
+		memcpy(ADC_segments, segments, sizeof(ADC_segments));
+		xSemaphoreGive( xADCD_Semaphore );
+	}
+	else
+	{
+		ESP_LOGE(TAG, "Could not take Semaphore");
+	}
+}
+
+/**
+ * Function to set a single scale factor for a rail, the table before multi point calibration.
+ * 
+ * @param ADC_cal calibration to change
+ * @param rail index of the rail (0-3)
+ * @param scale_mV voltage in mV at the nominal ADC value
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+void ADCD_cal_set_scale(ADC_cal_t *ADC_cal, int rail, int32_t scale_mV)
+{
+	ADC_cal_table_t *table = &ADC_cal->rail[rail];
+	memset(table, 0, sizeof(ADC_cal_table_t));
+	table->count = 2;
+	table->raw[1] = ADC_cal_factor;
+	table->uV[1] = scale_mV * 1000;
+}
+
+/**
+ * Function to set all rails to their nominal scale.
+ * 
+ * @param ADC_cal calibration to change
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+void ADCD_cal_default(ADC_cal_t *ADC_cal)
+{
+	for(int rail = 0; rail < ADC_CAL_RAILS; rail++) ADCD_cal_set_scale(ADC_cal, rail, ADC_rail_nominal_mV[rail]);
+}
+
+/**
+ * Function to remove the points of a rail before a new capture.
+ * Only the zero point is kept, so the first captured point gives a scale through zero.
+ * 
+ * @param ADC_cal calibration to change
+ * @param rail index of the rail (0-3)
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+void ADCD_cal_clear(ADC_cal_t *ADC_cal, int rail)
+{
+	ADC_cal_table_t *table = &ADC_cal->rail[rail];
+	memset(table, 0, sizeof(ADC_cal_table_t));
+	table->count = 1;
+}
+
+/**
+ * Function to capture a calibration point at the present ADC value of a rail.
+ * The point is sorted into the table, a point within ADC_CAL_MERGE counts is replaced.
+ * 
+ * @param ADC_cal calibration to change
+ * @param rail index of the rail (0-3)
+ * @param reference_uV voltage of the rail measured with a reference meter
+ * @return ESP_ERR_NO_MEM if the table is full, ESP_ERR_INVALID_ARG if a segment gets too steep
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+esp_err_t ADCD_cal_capture(ADC_cal_t *ADC_cal, int rail, int32_t reference_uV)
+{
+	int32_t raw = ADCD_get(rail + 1) - ADC_rail_base[rail];
+	if(!ADCD_cal_valid(&ADC_cal->rail[rail])) ADCD_cal_clear(ADC_cal, rail);
+	return ADCD_cal_insert(&ADC_cal->rail[rail], raw, reference_uV);
+}
+
+/**
+ * Function to sort a point into a calibration table, a point within ADC_CAL_MERGE counts is replaced.
+ * The table is only changed if the result is valid, see ADCD_cal_valid.
+ * 
+ * @param ADC_table valid calibration table of a rail
+ * @param raw ADC value without the channel bits
+ * @param reference_uV voltage at the raw value
+ * @return ESP_ERR_NO_MEM if the table is full, ESP_ERR_INVALID_ARG if a segment gets too steep
+ *  
+ * @endcode
+ * \ingroup ADCD
+ */
+esp_err_t ADCD_cal_insert(ADC_cal_table_t *ADC_table, int32_t raw, int32_t reference_uV)
+{
+	ADC_cal_table_t table_new = *ADC_table;
+	ADC_cal_table_t *table = &table_new;
+	int pos = 0;
+
+	while(pos < table->count && table->raw[pos] < raw - ADC_CAL_MERGE) pos++;
+	if(pos < table->count && table->raw[pos] <= raw + ADC_CAL_MERGE)
+	{
+		table->raw[pos] = raw;
+		table->uV[pos] = reference_uV;
+		//a second point in range may now be below the replaced one
+		while(pos + 1 < table->count && table->raw[pos + 1] <= raw)
+		{
+			table->count--;
+			memmove(&table->raw[pos + 1], &table->raw[pos + 2], (table->count - pos - 1) * sizeof(int32_t));
+			memmove(&table->uV[pos + 1], &table->uV[pos + 2], (table->count - pos - 1) * sizeof(int32_t));
+		}
+	}
+	else
+	{
+		if(table->count == ADC_CAL_MAX_POINTS) return ESP_ERR_NO_MEM;
+		for(int i = table->count; i > pos; i--)
+		{
+			table->raw[i] = table->raw[i - 1];
+			table->uV[i] = table->uV[i - 1];
+		}
+		table->raw[pos] = raw;
+		table->uV[pos] = reference_uV;
+		table->count++;
+	}
+	if(!ADCD_cal_valid(table)) return ESP_ERR_INVALID_ARG;
+	*ADC_table = table_new;
+	return ESP_OK;
+}
+
 /**
  * Function used to get voltages from the 5 ADCs. 
  * 
@@ -172,16 +432,16 @@ double ADCD_get_volt(int ADC_num)
 			switch(ADC_num)
 			{
 				case 1:
-					ADCD_return = out24_value;
+					ADCD_return = out24_value / 1000000.0;
 				break;
 				case 2:
-					ADCD_return = out5_value;
+					ADCD_return = out5_value / 1000000.0;
 				break;
 				case 3:
-					ADCD_return = out33_value;
+					ADCD_return = out33_value / 1000000.0;
 				break;
 				case 4:
-					ADCD_return = outvar_value;
+					ADCD_return = outvar_value / 1000000.0;
 				break;
 				case 5:
 					ADCD_return = ADC5_read;
@@ -252,52 +512,46 @@ int ADCD_get(int ADC_num)
 
 /**
  * Internal function!!
- * Function used to try writing a 8bit value 5 times to a register.
+ * Function used to write a 8bit value to a register and read it back.
+ * No retries, i2cdev counts failed transfers and recovers the bus.
  * Writes Could not write to 0x... if it is unable to write
  * 
  * @param reg register to write to
  * @param value value to write to register
+ * @return ESP_OK, the I2C error or ESP_ERR_INVALID_RESPONSE if the read back differs
  * 
  * \ingroup ADCD
  * @endcode
  */
-void ADCD_write_value_8(uint8_t reg, uint8_t value)
+esp_err_t ADCD_write_value_8(uint8_t reg, uint8_t value)
 {
 	uint8_t ADC_read = 0x0000;
-	int counter = 0;
-	while(value != ADC_read && counter < 5)
-	{
-		AD_write_reg_8(&ADC_dev, reg, value);
-		vTaskDelay(1 / portTICK_PERIOD_MS);
-		AD_read_reg_8(&ADC_dev, reg, &ADC_read);
-		vTaskDelay(1 / portTICK_PERIOD_MS);
-		counter++;
-	}
-	if(value != ADC_read) ESP_LOGE(TAG, "COULD NOT WRITE to 0x%x", reg);
+	esp_err_t ret = AD_write_reg_8(&ADC_dev, reg, value);
+	if(ret == ESP_OK) ret = AD_read_reg_8(&ADC_dev, reg, &ADC_read);
+	if(ret == ESP_OK && value != ADC_read) ret = ESP_ERR_INVALID_RESPONSE;
+	if(ret != ESP_OK) ESP_LOGE(TAG, "COULD NOT WRITE to 0x%x (%s)", reg, esp_err_to_name(ret));
+	return ret;
 }
 
 /**
  * Internal function!!
- * Function used to try writing a 16bit value 5 times to a register.
+ * Function used to write a 16bit value to a register and read it back.
+ * No retries, i2cdev counts failed transfers and recovers the bus.
  * Writes Could not write to 0x... if it is unable to write
  * 
  * @param reg register to write to
  * @param value value to write to register
+ * @return ESP_OK, the I2C error or ESP_ERR_INVALID_RESPONSE if the read back differs
  * 
  * \ingroup ADCD
  * @endcode
  */
-void ADCD_write_value_16(uint8_t reg, uint16_t value)
+esp_err_t ADCD_write_value_16(uint8_t reg, uint16_t value)
 {
 	uint16_t ADC_read = 0x0000;
-	int counter = 0;
-	while(value != ADC_read && counter < 3)
-	{
-		AD_write_reg_16(&ADC_dev, reg, value);
-		vTaskDelay(1 / portTICK_PERIOD_MS);
-		AD_read_reg_16(&ADC_dev, reg, &ADC_read);
-		vTaskDelay(1 / portTICK_PERIOD_MS);
-		counter++;
-	}
-	if(value != ADC_read) ESP_LOGE(TAG, "COULD NOT WRITE to 0x%x", reg);
-}
\ No newline at end of file
+	esp_err_t ret = AD_write_reg_16(&ADC_dev, reg, value);
+	if(ret == ESP_OK) ret = AD_read_reg_16(&ADC_dev, reg, &ADC_read);
+	if(ret == ESP_OK && value != ADC_read) ret = ESP_ERR_INVALID_RESPONSE;
+	if(ret != ESP_OK) ESP_LOGE(TAG, "COULD NOT WRITE to 0x%x (%s)", reg, esp_err_to_name(ret));
+	return ret;
+}
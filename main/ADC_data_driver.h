@@ -2,19 +2,37 @@
 #define MAIN_ADC_DATA_DRIVER_H_
 
 #include "ADC_driver.h"
+#include <stdbool.h>
+
+//calibrated rails: 24V, 5V, 3.3V and variable output
+#define ADC_CAL_RAILS 4
+#define ADC_CAL_MAX_POINTS 8
+
+//calibration table of one rail, points sorted by raw value
+typedef struct
+{
+    int32_t count;
+    int32_t raw[ADC_CAL_MAX_POINTS];    //ADC value without the channel bits
+    int32_t uV[ADC_CAL_MAX_POINTS];     //voltage measured at the raw value
+} ADC_cal_table_t;
 
 typedef struct
 {
-    int32_t OUT24_cal;
-    int32_t OUT5_cal;
-    int32_t OUT33_cal;
-    int32_t OUTvar_cal;
+    ADC_cal_table_t rail[ADC_CAL_RAILS];
 } ADC_cal_t;
 
 void ADCD_handler(void *pvParameters);
-void ADCD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, ADC_cal_t ADC_cal);
+void ADCD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, const ADC_cal_t *ADC_cal);
+void ADCD_set_calibration(const ADC_cal_t *ADC_cal);
+void ADCD_set_period(uint32_t period_ms);
+void ADCD_cal_default(ADC_cal_t *ADC_cal);
+void ADCD_cal_set_scale(ADC_cal_t *ADC_cal, int rail, int32_t scale_mV);
+void ADCD_cal_clear(ADC_cal_t *ADC_cal, int rail);
+esp_err_t ADCD_cal_capture(ADC_cal_t *ADC_cal, int rail, int32_t reference_uV);
+esp_err_t ADCD_cal_insert(ADC_cal_table_t *ADC_table, int32_t raw, int32_t reference_uV);
+bool ADCD_cal_valid(const ADC_cal_table_t *table);
 double ADCD_get_volt(int ADC_num);
 int ADCD_get(int ADC_num);
-void ADCD_write_value_8(uint8_t reg, uint8_t value);
-void ADCD_write_value_16(uint8_t reg, uint16_t value);
+esp_err_t ADCD_write_value_8(uint8_t reg, uint8_t value);
+esp_err_t ADCD_write_value_16(uint8_t reg, uint16_t value);
 #endif
\ No newline at end of file
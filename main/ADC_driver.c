@@ -7,9 +7,6 @@
 #include "esp_log.h"
 #include "ADC_driver.h"
 
-//define I2C frequency
-#define I2C_FREQ_HZ 400000
-
 //Tag for ESP_LOG functions
 static const char *TAG = "AD_driver";
 
@@ -139,7 +136,7 @@ esp_err_t AD_init_desc(AD_t *dev, uint8_t addr, i2c_port_t port, gpio_num_t sda_
     dev->i2c_dev.cfg.sda_io_num = sda_gpio;
     dev->i2c_dev.cfg.scl_io_num = scl_gpio;
 #if HELPER_TARGET_IS_ESP32
-    dev->i2c_dev.cfg.master.clk_speed = I2C_FREQ_HZ;
+    dev->i2c_dev.cfg.master.clk_speed = AD_I2C_MAX_FREQ_HZ;
 #endif
 
     return i2c_dev_create_mutex(&dev->i2c_dev);
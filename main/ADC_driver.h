@@ -7,6 +7,9 @@
 //I2C Addresses
 #define AD_addr_low 0x23
 #define AD_addr_high 0x24
+
+//Highest I2C clock the ADC supports without a high-speed master code
+#define AD_I2C_MAX_FREQ_HZ 400000
 #define default_config 0x0010
 #define default_interval 0x01
 
@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <string.h>
 #include "APA102.h"
+#include "esp_timer.h"
+#include "metrics.h"
 
 #define TAG "APA102"
 
@@ -107,6 +109,10 @@ void flush() {
     //transaction.length = sizeof(sendBuffer);
     //transaction.tx_buffer = sendBuffer;
 
+    int64_t start = esp_timer_get_time();
     int ret = spi_device_queue_trans(handle_LED, &transaction_LED, portMAX_DELAY);
     ESP_ERROR_CHECK(ret);
+    metrics_counter_add(METRIC_SPI_LED_TRANSACTIONS, 1);
+    metrics_counter_add(METRIC_SPI_LED_BYTES, transaction_LED.length / 8);
+    metrics_counter_add(METRIC_SPI_LED_BLOCKED_US, (uint32_t)(esp_timer_get_time() - start));
 }
\ No newline at end of file
@@ -3,10 +3,13 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "IO_driver.h"
 #include "Button_driver.h"
-#include "stack_usage_queue_handler.h"
+#include "metrics.h"
+#include "master_events.h"
 
 //Tag for ESP_LOG functions
 static const char *TAG = "Button_driver";
@@ -15,31 +18,59 @@ static const char *TAG = "Button_driver";
 TaskHandle_t button_task;
 
 //defines the time it takes for a long press to be registered
-#define LONG_PRESS_TIME 50 //  1 = 10ms
+#define LONG_PRESS_TIME_US 500000
+
+//number of events the queue can hold between two frames
+#define EVENT_QUEUE_LEN 16
 
 //Create Semaphore
 SemaphoreHandle_t xBTSemaphore;
 
-//Initialize Object for stack usage queue
-stack_usage_dataframe_t stack_button;
+//Event queue read by the page handlers
+QueueHandle_t button_event_queue;
 
 //expander vars
 uint8_t reg_read = 0;
 uint8_t return_value = 0;
-uint8_t reg_write = 0;
+int64_t reg_read_timestamp = 0;
 
 //button vars
 button_states buttons;
 
-//encoder vars
-int DT_state = 0;
-int CLK_state = 0;
-int CLK_state_last = 0;
-int ENC_counter = 0;
-int queue_counter_button = 0;
+//encoder vars, raw count of IO driver at the last set/reset
+static volatile int32_t ENC_offset = 0;
+//raw count of IO driver at the last published encoder event
+static int32_t ENC_published = 0;
 
 /**
- * Main Button Driver Task. Handles long and short press recognition for buttons and converts encoder signals into usable Numbers.
+ * Internal function, do not use!!
+ * Puts an event into the event queue. Drops it if the queue is full.
+ * 
+ * @param type event type
+ * @param button button the event belongs to, unused for encoder events
+ * @param delta encoder steps, unused for button events
+ * @param timestamp_us time the input was read
+ *  
+ * @endcode
+ */
+static void Button_publish(uint8_t type, uint8_t button, int16_t delta, int64_t timestamp_us)
+{
+	button_event_t event = {
+		.type = type,
+		.button = button,
+		.delta = delta,
+		.timestamp_us = timestamp_us,
+	};
+	if(xQueueSendToBack(button_event_queue, &event, 0) != pdTRUE)
+	{
+		ESP_LOGW(TAG, "Event queue full, event dropped");
+	}
+	master_events_set(EVT_INPUT);
+}
+
+/**
+ * Main Button Driver Task. Publishes short press, long press, release and encoder events.
+ * Wakes when the IO driver reads new input or counts an encoder step, and every 10ms while a button is held.
  * 
  * @param pvParameters unused
  *  
@@ -47,30 +78,40 @@ int queue_counter_button = 0;
  */
 void Button_handler(void *pvParameters)
 {
+	bool any_held = false;
+	metrics_task_register(METRIC_TASK_BUTTON);
 	while(1)
 	{
+		//wait for new input, poll while held to time long presses
+		ulTaskNotifyTake(pdTRUE, any_held ? (10 / portTICK_PERIOD_MS) : (100 / portTICK_PERIOD_MS));
+
 		//If semaphore is initialized
 		if( xBTSemaphore != NULL )
 		{
 			//If able, take semaphore, otherwise try again for 10 Ticks
 			if( xSemaphoreTake( xBTSemaphore, ( TickType_t ) 10 ) == pdTRUE )
 		    {
-				//Read Reg 0 and write Reg 1
-				IO_exp_write_reg_1(reg_write);
-				reg_read = IO_exp_read_reg_0();
-								
-				//get states of Encoder Pins
-				DT_state = IO_GPIO_get(ENC_DT);
-				CLK_state = IO_GPIO_get(ENC_CLK);
+				//Read Reg 0
+				reg_read = IO_exp_get_input(&reg_read_timestamp);
 
 				//set button states vars to button states from reg 0 var
 				Button_set_states();
-				//set button press vars from count and states
+				//publish button events from states and press times
 				Button_set_press();
 
+				any_held = false;
+				for(int i = 0; i < 5; i++) any_held |= buttons.state[i];
+
+				//publish encoder steps since the last event
+				int64_t ENC_timestamp = 0;
+				int32_t ENC_raw = IO_ENC_get_count_ts(&ENC_timestamp);
+				if(ENC_raw != ENC_published)
+				{
+					Button_publish(BTN_EVT_ENC, 0, (int16_t)(ENC_raw - ENC_published), ENC_timestamp);
+					ENC_published = ENC_raw;
+				}
+
 				xSemaphoreGive( xBTSemaphore );
-				
-				Button_set_ENC_from_GPIO();
 			}
 			else
 			{
@@ -78,22 +119,8 @@ void Button_handler(void *pvParameters)
 			}
 		}
 
-		//execute every 10th time
-		if(queue_counter_button > 10)
-		{
-			//send free stack of task to queue
-			stack_button.size = uxTaskGetStackHighWaterMark(button_task);
-			if(stack_usage_queue)
-			{
-				xQueueSendToBack(stack_usage_queue, &stack_button, 0);
-			}
-			queue_counter_button = 0;
-		}
-		else
-		{
-			queue_counter_button++;
-		}
-		vTaskDelay(10 / portTICK_PERIOD_MS);	
+		//update loop period and free stack of task
+		metrics_task_loop(METRIC_TASK_BUTTON);
 	}
 }
 
@@ -108,49 +135,21 @@ void Button_handler(void *pvParameters)
  */
 void Button_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO)
 {	
-	//Create Mutex
+	//Create Mutex and event queue
 	xBTSemaphore = xSemaphoreCreateMutex();
+	button_event_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(button_event_t));
 	//Initialize IO_Driver(Expander, GPIO, Buzzer etc.)
 	IO_init(I2C_PORT, SDA_GPIO, SCL_GPIO);
 	//set all values in buttons to 0
 	memset( &buttons, 0, sizeof( button_states ) );
-	//set name of stack queue object
-	if(stack_usage_queue)
-	{
-		stack_button.task_num = BUTTON_TASK;
-	}
 	//Create Main Task
-	xTaskCreate(Button_handler, "Button_handler", 1024*4, NULL, 2, button_task);
+	xTaskCreatePinnedToCore(Button_handler, "Button_handler", 1024*4, NULL, CONFIG_PSU_ACQ_PRIORITY, &button_task, CONFIG_PSU_ACQ_CORE);
+	//get woken by new input and encoder steps
+	IO_set_input_listener(button_task);
 	ESP_LOGI(TAG, "--> Button_driver initialized successfully");
 	
 }
 
-/**
- * Writes Bit Values of Reg1 using a uint8_t Bitmask.
- * 
- * @param write_value value to write to Reg1
- *  
- * @endcode
- */
-void Button_write_reg_1(uint8_t write_value)
-{
-	//If semaphore is initialized
-	if( xBTSemaphore != NULL )
-	{
-		//If able, take semaphore, otherwise try again for 10 Ticks
-		if( xSemaphoreTake( xBTSemaphore, ( TickType_t ) 10 ) == pdTRUE )
-	    {
-			//set Reg1 to Parameter value
-			reg_write = write_value;
-			xSemaphoreGive( xBTSemaphore );
-		}
-		else
-		{
-			ESP_LOGE(TAG, "Could not take Semaphore (write reg1)");
-		}
-	}
-}
-
 /**
  * Reads Reg0 from Expander and returns it as uint8_t.
  * 
@@ -179,28 +178,9 @@ uint8_t Button_read_reg_0()
 	return 0;
 }
 
-/**
- * Internal function, do not use!!
- * Sets ENC counter value from GPIO states.
- * 
- *  
- * @endcode
- */
-void Button_set_ENC_from_GPIO()
-{
-	//Encoder Logic (counter)
-	if(CLK_state != CLK_state_last)
-	{
-		if(!CLK_state && !DT_state) ENC_counter--;
-		if(!CLK_state && DT_state) ENC_counter++;
-		if(CLK_state && !DT_state) ENC_counter++;
-		if(CLK_state && DT_state) ENC_counter--;
-	}
-	CLK_state_last = CLK_state;
-}
-
 /**
  * Returns the value of the encoder counter.
+ * Never blocks, the count is decoded in the encoder interrupt of the IO driver.
  * 
  * @return Returns Counter value as an Intiture
  *  
@@ -208,20 +188,7 @@ void Button_set_ENC_from_GPIO()
  */
 int Button_get_ENC()
 {
-	int ENC_temp = 0;
-	//If semaphore is initialized
-	if( xBTSemaphore != NULL )
-	{
-		//If able, take semaphore, otherwise try again for 10 Ticks
-		if( xSemaphoreTake( xBTSemaphore, ( TickType_t ) 10 ) == pdTRUE )
-	    {
-			ENC_temp = ENC_counter;
-			xSemaphoreGive( xBTSemaphore );
-			return ENC_temp;
-		}
-		ESP_LOGE(TAG, "Could not take Semaphore (ENC get)");
-	}
-	return 0;
+	return IO_ENC_get_count() - ENC_offset;
 }
 
 /**
@@ -233,17 +200,7 @@ int Button_get_ENC()
  */
 void Button_set_ENC(int value)
 {
-	//If semaphore is initialized
-	if( xBTSemaphore != NULL )
-	{
-		//If able, take semaphore, otherwise try again for 10 Ticks
-		if( xSemaphoreTake( xBTSemaphore, ( TickType_t ) 10 ) == pdTRUE )
-	    {
-			ENC_counter = value;
-			xSemaphoreGive( xBTSemaphore );
-		}
-		ESP_LOGE(TAG, "Could not take Semaphore(ENC set)");
-	}
+	ENC_offset = IO_ENC_get_count() - value;
 }
 
 /**
@@ -270,66 +227,63 @@ void Button_set_states()
 
 /**
  * Internal function, do not use!!
- * Sets press variable of buttons by evaluating the state and count variables
+ * Publishes button events by evaluating the state and press time of every button.
+ * Long presses are published as soon as the button was held long enough.
  *  
  * @endcode
  */
 void Button_set_press()
 {
+	int64_t now = esp_timer_get_time();
 	//do for every Button
 	for(int i = 0; i < 5; i++)
 	{
-		//if button was just released
-		if(!buttons.state[i] && buttons.state_last[i])
+		//if button was just pressed
+		if(buttons.state[i] && !buttons.state_last[i])
 		{
-			//if counter has been counting up for set time
-			if(buttons.count[i] > LONG_PRESS_TIME)
-			{
-				//long press
-				buttons.press[i] = 2;
-			}
-			//else if no other press was detected
-			else if(buttons.press[i] == 0)
-			{
-				//short press
-				buttons.press[i] = 1;
-			}
-			//reset counter
-			buttons.count[i] = 0;
+			buttons.down_us[i] = reg_read_timestamp;
+			buttons.long_sent[i] = 0;
 		}
-		//if button is held down
-		if(buttons.state[i])
+		//if button is held down for set time
+		if(buttons.state[i] && !buttons.long_sent[i] && (now - buttons.down_us[i]) > LONG_PRESS_TIME_US)
 		{
-			//count up
-			buttons.count[i]++;
+			//long press
+			Button_publish(BTN_EVT_LONG, i, 0, now);
+			buttons.long_sent[i] = 1;
 		}
-		//state_last = state for debouncing
+		//if button was just released
+		if(!buttons.state[i] && buttons.state_last[i])
+		{
+			//short press if no long press was published
+			if(!buttons.long_sent[i]) Button_publish(BTN_EVT_SHORT, i, 0, reg_read_timestamp);
+			Button_publish(BTN_EVT_RELEASE, i, 0, reg_read_timestamp);
+		}
+		//state_last = state for edge detection
 		buttons.state_last[i] = buttons.state[i];
 	}
 }
 
 /**
- * get press state of selected button
- * @param button_select Selects which buttons value to return
- * @return returns button state as an int. 0 = no press, 1 = short press, 2 = long press
+ * get next input event
+ * @param event filled with the event
+ * @return returns true if an event was taken from the queue
  * @endcode
  */
-int Button_get_press(int button_select)
+bool Button_get_event(button_event_t *event)
 {
-	//If semaphore is initialized
-	if( xBTSemaphore != NULL )
-	{
-		//If able, take semaphore, otherwise try again for 10 Ticks
-		if( xSemaphoreTake( xBTSemaphore, ( TickType_t ) 10 ) == pdTRUE )
-	    {
-			//return the value press of selected button using temporary var
-			int press_temp = buttons.press[button_select];
-			buttons.press[button_select] = 0;
-			xSemaphoreGive( xBTSemaphore );
-			return press_temp;
-		}
-	}
-	return 0;
+	if(button_event_queue == NULL) return false;
+	return xQueueReceive(button_event_queue, event, 0) == pdTRUE;
+}
+
+/**
+ * get held state of selected button
+ * @param button_select Selects which buttons state to return
+ * @return returns true while the button is held down
+ * @endcode
+ */
+bool Button_is_held(int button_select)
+{
+	return buttons.state[button_select];
 }
 
 /**
@@ -345,15 +299,15 @@ void Button_reset_all_states()
 		//If able, take semaphore, otherwise try again for 10 Ticks
 		if( xSemaphoreTake( xBTSemaphore, ( TickType_t ) 10 ) == pdTRUE )
 	    {
-			//set everything to 0
+			//held buttons must be released before they count again
 			for(int i = 0; i < 5; i++)
 			{
-				buttons.state[i] = 0;
-    			buttons.state_last[i] = 0;
-    			buttons.count[i] = 0;
-    			buttons.press[i] = 0;
+				buttons.long_sent[i] = 1;
 			}
-			ENC_counter = 0;
+			ENC_offset = IO_ENC_get_count();
+			ENC_published = ENC_offset;
+			//drop events meant for the previous screen
+			xQueueReset(button_event_queue);
 			
 			xSemaphoreGive( xBTSemaphore );
 		}
@@ -10,24 +10,37 @@
 #define btn_right   3
 #define btn_sel     4
 
+//input event types
+#define BTN_EVT_SHORT   0
+#define BTN_EVT_LONG    1
+#define BTN_EVT_RELEASE 2
+#define BTN_EVT_ENC     3
+
 //struct for all button variables
 typedef struct {
     bool state[5];
     bool state_last[5];
-    int count[5];
-    int press[5];
+    int64_t down_us[5];
+    bool long_sent[5];
 } button_states;
 
+//input event, timestamp is the time the input was read
+typedef struct {
+    uint8_t type;
+    uint8_t button;
+    int16_t delta;
+    int64_t timestamp_us;
+} button_event_t;
+
 void Button_handler(void *pvParameters);
 void Button_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO);
-void Button_write_reg_1(uint8_t write_value);
 uint8_t Button_read_reg_0();
-void Button_set_ENC_from_GPIO();
 int Button_get_ENC();
 void Button_set_ENC(int value);
 void Button_set_states();
 void Button_set_press();
-int Button_get_press(int button_select);
+bool Button_get_event(button_event_t *event);
+bool Button_is_held(int button_select);
 void Button_reset_all_states();
 
 #endif
\ No newline at end of file
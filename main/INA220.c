@@ -3,7 +3,6 @@
 
 #define TAG "INA220"
 
-#define I2C_FREQ_HZ 400000 // Max 1MHz for esp-idf
 
 #define CHECK(x) do { esp_err_t __; if ((__ = x) != ESP_OK) return __; } while (0)
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
@@ -53,9 +52,11 @@ esp_err_t ina220_init_desc(ina220_t *dev, uint8_t addr, i2c_port_t port, gpio_nu
     dev->i2c_dev.addr = addr;
     dev->i2c_dev.cfg.sda_io_num = sda_gpio;
     dev->i2c_dev.cfg.scl_io_num = scl_gpio;
-    dev->i2c_dev.cfg.master.clk_speed = I2C_FREQ_HZ;
+    dev->i2c_dev.cfg.master.clk_speed = INA220_I2C_MAX_FREQ_HZ;
     dev->currentLSB = 0;
     dev->powerLSB = 0;
+    dev->current_coef = (q16_coef_t){0, 0};
+    dev->power_coef = (q16_coef_t){0, 0};
     CHECK(i2c_dev_create_mutex(&dev->i2c_dev));
     return ESP_OK;
 }
@@ -107,46 +108,40 @@ esp_err_t ina220_init(ina220_t *dev, ina220_params_t *params)
     return ESP_OK;
 }
 
-double ina220_getVShunt_mv(ina220_t *dev, ina220_params_t *params) {
-    double returnValue = 0;
+int32_t ina220_getVShunt_uv(ina220_t *dev, ina220_params_t *params) {
     uint16_t data = 0;
     I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
     read_register16(&dev->i2c_dev, INA220_SHUNTVOLTAGE_ADDR, &data);
     I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
     switch(params->shuntRange) {
         case SHUTVOLTAGEGAIN_320mv:
-            returnValue = (double)((int16_t)data)/100.0;
         break;
         case SHUTVOLTAGEGAIN_160mv:
             data &= 0xBFFF; //Remove additional sign bit at pos 14
-            returnValue = (double)((int16_t)data)/100.0;
         break;
         case SHUTVOLTAGEGAIN_80mv:
             data &= 0xAFFF; //Remove additional sign bit at pos 14 and 13
-            returnValue = (double)((int16_t)data)/100.0;
         break;
         case SHUTVOLTAGEGAIN_40mv:
             data &= 0x8FFF; //Remove additional sign bit at pos 14 to 12
-            returnValue = (double)((int16_t)data)/100.0;
         break;
     }
-    return returnValue;
+    //LSB is 10uV in all ranges
+    return (int32_t)((int16_t)data) * 10;
 }
-double ina220_getVBus_mv(ina220_t *dev, ina220_params_t *params) {
-    double returnValue = 0;
+int32_t ina220_getVBus_uv(ina220_t *dev, ina220_params_t *params) {
     uint16_t data = 0;
     I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
     read_register16(&dev->i2c_dev, INA220_BUSVOLTAGE_ADDR, &data);
     I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
-    switch(params->busRange) {
-        case VOLTAGERANGE_32V:
-            returnValue = (double)(data>>3)*4.0;
-        break;
-        case VOLTAGERANGE_16V:
-            returnValue = (double)(data>>3)*4.0;
-        break;
-    }
-    return returnValue;
+    //LSB is 4mV in both ranges
+    return (int32_t)(data>>3) * 4000;
+}
+double ina220_getVShunt_mv(ina220_t *dev, ina220_params_t *params) {
+    return ina220_getVShunt_uv(dev, params) / 1000.0;
+}
+double ina220_getVBus_mv(ina220_t *dev, ina220_params_t *params) {
+    return ina220_getVBus_uv(dev, params) / 1000.0;
 }
 
 bool ina220_newDataAvailable(ina220_t *dev, ina220_params_t *params) {    
@@ -162,39 +157,53 @@ bool ina220_newDataAvailable(ina220_t *dev, ina220_params_t *params) {
     return false;
 }
 
-double ina220_getPower_mW(ina220_t *dev, ina220_params_t *params) {
-    double returnValue = 0;
+int32_t ina220_getPower_uw(ina220_t *dev, ina220_params_t *params) {
     uint16_t data = 0;
     I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
     read_register16(&dev->i2c_dev, INA220_POWER_ADDR, &data);
     I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
-    returnValue = (double)(data)*dev->powerLSB;
-    returnValue *= 1000;
-    return returnValue;
+    return q16_apply(&dev->power_coef, data);
 }
 
-double ina220_getCurrent_mA(ina220_t *dev, ina220_params_t *params) {
-    double returnValue = 0;
+int32_t ina220_getCurrent_ua(ina220_t *dev, ina220_params_t *params) {
     uint16_t data = 0;
     I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
     read_register16(&dev->i2c_dev, INA220_CURRENT_ADDR, &data);
     I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
-    returnValue = (double)((int16_t)(data))*dev->currentLSB;
-    returnValue *= 1000;
-    return returnValue;
+    return q16_apply(&dev->current_coef, (int16_t)data);
+}
+
+double ina220_getPower_mW(ina220_t *dev, ina220_params_t *params) {
+    return ina220_getPower_uw(dev, params) / 1000.0;
+}
+
+double ina220_getCurrent_mA(ina220_t *dev, ina220_params_t *params) {
+    return ina220_getCurrent_ua(dev, params) / 1000.0;
 }
 
 esp_err_t ina220_setCalibrationData(ina220_t *dev, ina220_params_t *params, double maxCurrent_A, double shuntRes_Ohm) {
     uint16_t calibData = 0;
     double currentLSB = maxCurrent_A/32768.0;
+    if(currentLSB <= 0 || shuntRes_Ohm <= 0) {
+        ESP_LOGE(TAG, "Cant calibrate that!");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(maxCurrent_A > INA220_MAX_CURRENT_A) {
+        ESP_LOGE(TAG, "Cant calibrate that! Maximum current above %.0f A", INA220_MAX_CURRENT_A);
+        return ESP_ERR_INVALID_SIZE;
+    }
     double calData = 0.04096 / (currentLSB * shuntRes_Ohm);
-    if(calData < 0 && calData > 65535.0) {
+    if(calData < 0 || calData > 65535.0) {
         ESP_LOGE(TAG, "Cant calibrate that!");
         return ESP_ERR_INVALID_SIZE;
     }
     calibData = (uint16_t)(calData);
     dev->currentLSB = currentLSB;
     dev->powerLSB = 20 * currentLSB;
+    //integer coefficients for the getters, the LSB is maxCurrent / 32768
+    int64_t maxCurrent_uA = (int64_t)(maxCurrent_A * 1000000.0 + 0.5);
+    dev->current_coef = q16_coef(maxCurrent_uA, 32768, 0);
+    dev->power_coef = q16_coef(20 * maxCurrent_uA, 32768, 0);
     I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
     write_register16(&dev->i2c_dev, INA220_CALIBRATION, calibData);
     I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
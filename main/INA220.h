@@ -5,10 +5,14 @@
 #include <stdbool.h>
 #include <esp_err.h>
 #include <i2cdev.h>
+#include "fixed_point.h"
 
 #define INA220ADDRESSMIN   0x40
 #define INA220ADDRESSMAX   0x4F
 
+// Fast mode; high-speed mode needs a master code the ESP32 cannot send
+#define INA220_I2C_MAX_FREQ_HZ 400000
+
 #define INA220_CONFIGURATION_ADDR       0x00
 #define INA220_SHUNTVOLTAGE_ADDR        0x01
 #define INA220_BUSVOLTAGE_ADDR          0x02
@@ -70,11 +74,18 @@ typedef struct {
     brng_t busRange;
 } ina220_params_t;
 
+//largest maximum current of the calibration. The power register counts 20 * maxCurrent / 32768,
+//above about 53 A the power in uW per count no longer fits the Q16 scale and a full scale
+//reading no longer fits the int32_t of ina220_getPower_uw
+#define INA220_MAX_CURRENT_A 50.0
+
 typedef struct {
     i2c_dev_t   i2c_dev;  //!< I2C device descriptor
     uint16_t    id;       //!< Chip ID
     double      currentLSB;
     double      powerLSB;
+    q16_coef_t  current_coef; //!< uA per count, set with the calibration
+    q16_coef_t  power_coef;   //!< uW per count, set with the calibration
 } ina220_t;
 
 esp_err_t ina220_init_desc(ina220_t *dev, uint8_t addr, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
@@ -82,6 +93,10 @@ esp_err_t ina220_free_desc(ina220_t *dev);
 esp_err_t ina220_init_default_params(ina220_params_t *params);
 esp_err_t ina220_init(ina220_t *dev, ina220_params_t *params);
 
+int32_t ina220_getVShunt_uv(ina220_t *dev, ina220_params_t *params);
+int32_t ina220_getVBus_uv(ina220_t *dev, ina220_params_t *params);
+int32_t ina220_getPower_uw(ina220_t *dev, ina220_params_t *params);
+int32_t ina220_getCurrent_ua(ina220_t *dev, ina220_params_t *params);
 double ina220_getVShunt_mv(ina220_t *dev, ina220_params_t *params);
 double ina220_getVBus_mv(ina220_t *dev, ina220_params_t *params);
 bool ina220_newDataAvailable(ina220_t *dev, ina220_params_t *params);
@@ -6,9 +6,11 @@
 #include "esp_err.h"
 #include "INA220.h"
 #include "math.h"
+#include <stdlib.h>
 #include "esp_log.h"
 #include "INA_data_driver.h"
-#include "stack_usage_queue_handler.h"
+#include "metrics.h"
+#include "master_events.h"
 
 static const char *TAG = "INAD_Data_Driver";
 
@@ -23,18 +25,16 @@ TaskHandle_t INA_task;
 //initialize Mutex Handle
 SemaphoreHandle_t xINAD_Semaphore;
 
-//Initialize Object for stack usage queue
-stack_usage_dataframe_t stack_INA;
-
 //Vars INA1
 #ifdef INA1
     #define I2C_INA1_ADDR 0x40
     ina220_t INA1_dev;
     ina220_params_t INA1_params;
-    double INA1_s_val = 0;
-    double INA1_b_val = 0;
-    double INA1_p_val = 0;
-    double INA1_i_val = 0;
+    //values in uV, uW and uA
+    int32_t INA1_s_val = 0;
+    int32_t INA1_b_val = 0;
+    int32_t INA1_p_val = 0;
+    int32_t INA1_i_val = 0;
     
 #endif
 	double INA1_i_max = 0;
@@ -46,10 +46,10 @@ stack_usage_dataframe_t stack_INA;
     #define I2C_INA2_ADDR 0x41
     ina220_t INA2_dev;
     ina220_params_t INA2_params;
-    double INA2_s_val = 0;
-    double INA2_b_val = 0;
-    double INA2_p_val = 0;
-    double INA2_i_val = 0;
+    int32_t INA2_s_val = 0;
+    int32_t INA2_b_val = 0;
+    int32_t INA2_p_val = 0;
+    int32_t INA2_i_val = 0;
     
 #endif
 	INA_cal_t INA_cal;
@@ -57,12 +57,19 @@ stack_usage_dataframe_t stack_INA;
     double INA2_s_cal = 0;
 	int32_t INA2_i_max_int = 0;
     int32_t INA2_s_cal_int = 0;
-double INAD_return = 0;
+int32_t INAD_return = 0;
+
+//protection limits in uV and uA, 0 disables the check
+int32_t INAD_vshunt_max = 0;
+int32_t INAD_current_max = 0;
 
 void INAD_handler(void *pvParameters)
 {
+	EventBits_t events;
+	metrics_task_register(METRIC_TASK_INA);
 	while(1)
 	{
+		events = 0;
 		//If semaphore is initialized
 		if( xINAD_Semaphore != NULL )
 		{	
@@ -71,43 +78,49 @@ void INAD_handler(void *pvParameters)
 		    {
 #ifdef INA1
 				//get INA1 values
-                INA1_s_val = ina220_getVShunt_mv(&INA1_dev, &INA1_params);
-                INA1_b_val = ina220_getVBus_mv(&INA1_dev, &INA1_params);
-                INA1_p_val = ina220_getPower_mW(&INA1_dev, &INA1_params);
-                INA1_i_val = ina220_getCurrent_mA(&INA1_dev, &INA1_params);
+                int32_t s_last = INA1_s_val;
+                int32_t b_last = INA1_b_val;
+                INA1_s_val = ina220_getVShunt_uv(&INA1_dev, &INA1_params);
+                INA1_b_val = ina220_getVBus_uv(&INA1_dev, &INA1_params);
+                INA1_p_val = ina220_getPower_uw(&INA1_dev, &INA1_params);
+                INA1_i_val = ina220_getCurrent_ua(&INA1_dev, &INA1_params);
+                if(INA1_s_val != s_last || INA1_b_val != b_last) events |= EVT_INA_DATA;
+                if(INAD_vshunt_max > 0 && abs(INA1_s_val) > INAD_vshunt_max) events |= EVT_ALARM;
+                if(INAD_current_max > 0 && abs(INA1_i_val) > INAD_current_max) events |= EVT_ALARM;
 #endif
 
 #ifdef INA2
-				//get INA1 values
-                INA2_s_val = ina220_getVShunt_mv(&INA2_dev, &INA2_params);
-                INA2_b_val = ina220_getVBus_mv(&INA2_dev, &INA2_params);
-                INA2_p_val = ina220_getPower_mW(&INA2_dev, &INA2_params);
-                INA2_i_val = ina220_getCurrent_mA(&INA2_dev, &INA2_params);
+				//get INA2 values
+                int32_t s2_last = INA2_s_val;
+                int32_t b2_last = INA2_b_val;
+                INA2_s_val = ina220_getVShunt_uv(&INA2_dev, &INA2_params);
+                INA2_b_val = ina220_getVBus_uv(&INA2_dev, &INA2_params);
+                INA2_p_val = ina220_getPower_uw(&INA2_dev, &INA2_params);
+                INA2_i_val = ina220_getCurrent_ua(&INA2_dev, &INA2_params);
+                if(INA2_s_val != s2_last || INA2_b_val != b2_last) events |= EVT_INA_DATA;
+                if(INAD_vshunt_max > 0 && abs(INA2_s_val) > INAD_vshunt_max) events |= EVT_ALARM;
+                if(INAD_current_max > 0 && abs(INA2_i_val) > INAD_current_max) events |= EVT_ALARM;
 #endif			
 				//Give Semaphore
 				xSemaphoreGive( xINAD_Semaphore );
+				//wake the Master_Task only on new data or an exceeded limit
+				if(events) master_events_set(events);
 			}
 			else
 			{
 				ESP_LOGE(TAG, "Could not take Semaphore");
 			}
 		}
-		//send free stack of task to queue
-		stack_INA.size = uxTaskGetStackHighWaterMark(INA_task);
-		if(stack_usage_queue)
-		{
-			xQueueSendToBack(stack_usage_queue, &stack_INA, 0);
-		}
+		//update loop period and free stack of task
+		metrics_task_loop(METRIC_TASK_INA);
 		vTaskDelay(50 / portTICK_PERIOD_MS);	
 	}
 }
 
 void INAD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, INA_cal_t INA_cal)
 {
-	INA1_i_max = ((double)INA_cal.INA1_A_val) / 1000;
-	INA1_s_cal = ((double)INA_cal.INA1_S_val) / 1000;
-	INA1_i_max = ((double)INA_cal.INA2_A_val) / 1000;
-	INA1_s_cal = ((double)INA_cal.INA2_S_val) / 1000;
+	//Create Mutex
+	xINAD_Semaphore = xSemaphoreCreateMutex();
 
 	//INA1 Init
 #ifdef INA1
@@ -115,7 +128,6 @@ void INAD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, INA_cal_t INA_cal)
     memset(&INA1_dev, 0, sizeof(ina220_t));
     ina220_init_desc(&INA1_dev, I2C_INA1_ADDR, I2C_PORT, SDA_GPIO, SCL_GPIO);
 	ina220_init(&INA1_dev, &INA1_params);
-	ina220_setCalibrationData(&INA1_dev, &INA1_params, INA1_i_max, INA1_s_cal);
 #endif
 	//INA2 Init
 #ifdef INA2
@@ -123,18 +135,11 @@ void INAD_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO, INA_cal_t INA_cal)
     memset(&INA2_dev, 0, sizeof(ina220_t));
     ina220_init_desc(&INA2_dev, I2C_INA2_ADDR, I2C_PORT, SDA_GPIO, SCL_GPIO);
 	ina220_init(&INA2_dev, &INA2_params);
-	ina220_setCalibrationData(&INA2_dev, &INA2_params, INA2_i_max, INA2_s_cal);
 #endif
+	INAD_set_calibration(INA_cal);
 
-	//set name of stack queue object
-	if(stack_usage_queue)
-	{
-		stack_INA.task_num = INA_TASK;
-	}
-	//Create Mutex
-	xINAD_Semaphore = xSemaphoreCreateMutex();
 	//Create Handler Task
-	xTaskCreate(INAD_handler, "INAD_handler", 1024*4, NULL, 2, INA_task);
+	xTaskCreatePinnedToCore(INAD_handler, "INAD_handler", 1024*4, NULL, CONFIG_PSU_ACQ_PRIORITY, &INA_task, CONFIG_PSU_ACQ_CORE);
 	ESP_LOGI(TAG, "--> INA220_data_driver initialized successfully");
 }
 
@@ -151,7 +156,7 @@ double INAD_getVShunt_mv(int INA)
             if(INA == INA2) INAD_return = INA2_s_val;
 #endif
 			xSemaphoreGive( xINAD_Semaphore );
-            return INAD_return;
+            return INAD_return / 1000.0;
 		}
 		else
 		{
@@ -176,7 +181,7 @@ double INAD_getVBus_mv(int INA)
             if(INA == INA2) INAD_return = INA2_b_val;
 #endif
 			xSemaphoreGive( xINAD_Semaphore );
-            return INAD_return;
+            return INAD_return / 1000.0;
 		}
 		else
 		{
@@ -203,7 +208,7 @@ double INAD_getPower_mW(int INA)
             if(INA == INA2) INAD_return = INA2_p_val;
 #endif
 			xSemaphoreGive( xINAD_Semaphore );
-            return INAD_return;
+            return INAD_return / 1000.0;
 		}
 		else
 		{
@@ -226,7 +231,7 @@ double INAD_getCurrent_mA(int INA)
             if(INA == INA2) INAD_return = INA2_i_val;
 #endif
 			xSemaphoreGive( xINAD_Semaphore );
-            return INAD_return;
+            return INAD_return / 1000.0;
 		}
 		else
 		{
@@ -235,4 +240,59 @@ double INAD_getCurrent_mA(int INA)
 		}
 	}
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * Sets the protection limits checked on every INA sample.
+ * An exceeded limit sets the EVT_ALARM bit, so the Master_Task reacts without waiting for the next refresh.
+ * @param vshunt_max_mV maximum shunt voltage in mV, 0 disables the check
+ * @param current_max_mA maximum current in mA, 0 disables the check
+ * @endcode
+ * \ingroup INA_data_driver
+ */
+void INAD_set_limits(double vshunt_max_mV, double current_max_mA)
+{
+	if( xINAD_Semaphore != NULL )
+	{
+		if( xSemaphoreTake( xINAD_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+	    {
+			INAD_vshunt_max = (int32_t)(vshunt_max_mV * 1000);
+			INAD_current_max = (int32_t)(current_max_mA * 1000);
+			xSemaphoreGive( xINAD_Semaphore );
+		}
+		else
+		{
+			ESP_LOGE(TAG, "Could not take Semaphore");
+		}
+	}
+}
+
+/**
+ * Writes the calibration to the INAs and rebuilds the integer coefficients of the getters.
+ * Called at init and whenever the calibration changes.
+ * @param INA_cal shunt resistance in mOhm and maximum current in mA per INA
+ * @endcode
+ * \ingroup INA_data_driver
+ */
+void INAD_set_calibration(INA_cal_t INA_cal)
+{
+	INA1_i_max = ((double)INA_cal.INA1_A_val) / 1000;
+	INA1_s_cal = ((double)INA_cal.INA1_S_val) / 1000;
+	INA2_i_max = ((double)INA_cal.INA2_A_val) / 1000;
+	INA2_s_cal = ((double)INA_cal.INA2_S_val) / 1000;
+
+	if( xSemaphoreTake( xINAD_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+	{
+#ifdef INA1
+		ina220_setCalibrationData(&INA1_dev, &INA1_params, INA1_i_max, INA1_s_cal);
+#endif
+#ifdef INA2
+		ina220_setCalibrationData(&INA2_dev, &INA2_params, INA2_i_max, INA2_s_cal);
+#endif
+		xSemaphoreGive( xINAD_Semaphore );
+	}
+	else
+	{
+		ESP_LOGE(TAG, "Could not take Semaphore");
+	}
+}
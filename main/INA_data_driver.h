@@ -21,4 +21,6 @@ double INAD_getVShunt_mv(int INA);
 double INAD_getVBus_mv(int INA);
 double INAD_getPower_mW(int INA);
 double INAD_getCurrent_mA(int INA);
+void INAD_set_limits(double vshunt_max_mV, double current_max_mA);
+void INAD_set_calibration(INA_cal_t INA_cal);
 #endif
\ No newline at end of file
@@ -4,10 +4,14 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "expander_driver.h"
+#include "IO_driver.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/ledc.h"
-#include "stack_usage_queue_handler.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+#include "metrics.h"
 
 static const char *TAG = "IO_Driver";
 
@@ -24,6 +28,7 @@ conf_t config = Default_Config;
 #define GPIO_INPUT_IO_DT    16
 #define GPIO_INPUT_IO_CLK   15
 #define GPIO_OUTPUT_PIN_SEL  ((1ULL<<GPIO_OUTPUT_IO_0) | (1ULL<<GPIO_OUTPUT_IO_1))
+#define GPIO_INPUT_PIN_SEL   ((1ULL<<GPIO_INPUT_IO_DT) | (1ULL<<GPIO_INPUT_IO_CLK))
 
 //Timer for PWM defines
 #define LEDC_LS_TIMER          LEDC_TIMER_0
@@ -41,19 +46,97 @@ ledc_channel_config_t ledc_channel;
 //create Mutex
 SemaphoreHandle_t xIO_Semaphore;
 
-//Initialize Object for stack usage queue
-stack_usage_dataframe_t stack_IO;
-
 //Init Variables
 uint8_t reg_0_val = 0;
 uint8_t return_val = 0;
-uint8_t reg_1_val = 0;
 bool GPIO_0_state = 0;
 bool GPIO_1_state = 0;
 bool GPIO_Buzzer_state = 0;
-int GPIO_DT_state = 0;
-int GPIO_CLK_state = 0;
-int queue_counter_IO = 0;
+uint8_t reg_0_int_stat = 0;
+int64_t reg_0_timestamp = 0;
+
+//Task notified about new input and encoder steps
+static TaskHandle_t input_listener = NULL;
+
+//Set by the expander INT interrupt, cleared when the inputs were read
+static volatile bool expander_int_pending = false;
+
+//Encoder counter, written by IO_ENC_isr and the slow poll under ENC_mux
+static volatile int32_t ENC_count = 0;
+static volatile int64_t ENC_timestamp = 0;
+static volatile uint8_t ENC_CLK_last = 0;
+//guards the encoder decode, taken by the interrupt and by the slow poll
+static portMUX_TYPE ENC_mux = portMUX_INITIALIZER_UNLOCKED;
+
+//ticks between expander reads without an event, longer while the display sleeps
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+#define IO_POLL_TICKS_DEFAULT (CONFIG_EXPANDER_FALLBACK_POLL_MS / portTICK_PERIOD_MS)
+#else
+//at least one tick, otherwise the elevated priority starves the idle task
+#define IO_POLL_TICKS_DEFAULT ((3 / portTICK_PERIOD_MS) ? (3 / portTICK_PERIOD_MS) : 1)
+#endif
+static TickType_t IO_poll_ticks = IO_POLL_TICKS_DEFAULT;
+//slow polling, edges may be missed while the CPU is in light sleep
+static volatile bool IO_poll_slow = false;
+
+/**
+ * Encoder interrupt, runs on every CLK edge and decodes the quadrature signal.
+ * Bounces on CLK produce pairs of opposite steps and cancel out.
+ * @param arg unused
+ * @endcode
+ */
+static void IRAM_ATTR IO_ENC_isr(void *arg)
+{
+	portENTER_CRITICAL_ISR(&ENC_mux);
+	uint32_t levels = REG_READ(GPIO_IN_REG);
+	uint8_t clk = (levels >> GPIO_INPUT_IO_CLK) & 1;
+	uint8_t dt = (levels >> GPIO_INPUT_IO_DT) & 1;
+	int step = IO_ENC_decode(&ENC_CLK_last, clk, dt);
+	if(step != 0)
+	{
+		ENC_count += step;
+		ENC_timestamp = esp_timer_get_time();
+	}
+	portEXIT_CRITICAL_ISR(&ENC_mux);
+	//edge already handled or bounced back
+	if(step == 0) return;
+	//wake the input listener
+	BaseType_t woken = pdFALSE;
+	if(input_listener) vTaskNotifyGiveFromISR(input_listener, &woken);
+	if(woken) portYIELD_FROM_ISR();
+}
+
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+/**
+ * Expander INT interrupt, wakes the IO task to read the inputs.
+ * @param arg unused
+ * @endcode
+ */
+static void IRAM_ATTR IO_expander_isr(void *arg)
+{
+	BaseType_t woken = pdFALSE;
+	expander_int_pending = true;
+	if(IO_task) vTaskNotifyGiveFromISR(IO_task, &woken);
+	if(woken) portYIELD_FROM_ISR();
+}
+#endif
+
+/**
+ * Installs the GPIO interrupt service and enables the encoder and expander interrupts.
+ * Runs in the IO task, so they are allocated on the acquisition core next to their handler.
+ * @endcode
+ */
+static void IO_isr_init(void)
+{
+	gpio_install_isr_service(0);
+	ENC_CLK_last = gpio_get_level(GPIO_INPUT_IO_CLK);
+	gpio_isr_handler_add(GPIO_INPUT_IO_CLK, IO_ENC_isr, NULL);
+	gpio_intr_enable(GPIO_INPUT_IO_CLK);
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+	gpio_isr_handler_add(CONFIG_EXPANDER_INT_GPIO, IO_expander_isr, NULL);
+	gpio_intr_enable(CONFIG_EXPANDER_INT_GPIO);
+#endif
+}
 
 /**
  * Main Task in IO_driver Library. Handles GPIO and Expander Input, Outputs and PWM for Buzzer.
@@ -63,21 +146,43 @@ int queue_counter_IO = 0;
  */
 void IO_handler(void *pvParameters)
 {
+	metrics_task_register(METRIC_TASK_IO);
+	IO_isr_init();
 	while(1)
 	{
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+		//sleep until a pin change, an output change or the fallback poll
+		bool poll = !ulTaskNotifyTake(pdTRUE, IO_poll_ticks);
+#else
+		bool poll = true;
+#endif
 		if( xIO_Semaphore != NULL )
 		{
 			if( xSemaphoreTake( xIO_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
 		    {
-				//Read Register 0 and Write Register 1 (Expander)
-    			read_reg_8(&dev_port_expander, reg_in_port_0, &reg_0_val);
-				write_reg_8(&dev_port_expander, reg_out_port_1, reg_1_val);
+				//Read Register 0 only on an event and Write Register 1 (Expander)
+				if(expander_int_pending || poll)
+				{
+					uint8_t reg_0_new = reg_0_val;
+					expander_int_pending = false;
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+					expander_read_interrupt_port_0(&dev_port_expander, &reg_0_int_stat, &reg_0_new);
+#else
+					read_reg_8(&dev_port_expander, reg_in_port_0, &reg_0_new);
+#endif
+					//timestamp and hand over changed input right away
+					if(reg_0_new != reg_0_val)
+					{
+						reg_0_val = reg_0_new;
+						reg_0_timestamp = esp_timer_get_time();
+						if(input_listener) xTaskNotifyGive(input_listener);
+					}
+				}
+				//write output ports only if a bit changed
+				expander_out_flush(&dev_port_expander);
 				//Set Level of NFON and TC_EN
 				gpio_set_level(GPIO_OUTPUT_IO_0, GPIO_0_state);
 				gpio_set_level(GPIO_OUTPUT_IO_1, GPIO_1_state);
-				//get State of Encoder Pins
-				GPIO_DT_state = gpio_get_level(GPIO_INPUT_IO_DT);
-				GPIO_CLK_state = gpio_get_level(GPIO_INPUT_IO_CLK);
 				xSemaphoreGive( xIO_Semaphore );
 			}
 			else
@@ -85,23 +190,27 @@ void IO_handler(void *pvParameters)
 				ESP_LOGE(TAG, "Could not take Semaphore");
 			}
 		}
-		if(queue_counter_IO > 20)
+		//the GPIO interrupt does not see an encoder edge during light sleep, take it from the level
+		if(IO_poll_slow)
 		{
-			//send free stack of task to queue
-			stack_IO.size = uxTaskGetStackHighWaterMark(IO_task);
-			if(stack_usage_queue)
+			//the CLK interrupt stays armed, decode under its lock so no edge is lost or counted twice
+			portENTER_CRITICAL(&ENC_mux);
+			uint32_t levels = REG_READ(GPIO_IN_REG);
+			int step = IO_ENC_decode(&ENC_CLK_last, (levels >> GPIO_INPUT_IO_CLK) & 1, (levels >> GPIO_INPUT_IO_DT) & 1);
+			if(step != 0)
 			{
-				xQueueSendToBack(stack_usage_queue, &stack_IO, 0);
+				ENC_count += step;
+				ENC_timestamp = esp_timer_get_time();
 			}
-			queue_counter_IO = 0;
+			portEXIT_CRITICAL(&ENC_mux);
+			if(step != 0 && input_listener) xTaskNotifyGive(input_listener);
 		}
+		//update loop period and free stack of task
+		metrics_task_loop(METRIC_TASK_IO);
 
-		else
-		{
-			queue_counter_IO++;
-		}
-		
-		vTaskDelay(3 / portTICK_PERIOD_MS);	
+#if CONFIG_EXPANDER_INT_GPIO < 0
+		vTaskDelay(IO_poll_ticks);
+#endif
 	}
 }
 
@@ -124,9 +233,17 @@ void IO_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO)
 	config.conf_port_1 = 0x00;
 	config.pol_inv_0 = 0xFF;
 	config.pol_inv_1 = 0x00;
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+	//interrupt on any button change, latch short presses until read
+	config.interr_mask_port_0 = 0x00;
+	config.latch_port_0 = 0xFF;
+#endif
 	//Init and configure Expander
     expander_init_desc(&dev_port_expander, expander_addr_low, I2C_PORT, SDA_GPIO, SCL_GPIO);
 	expander_configure(&dev_port_expander, &config);
+	//all outputs of port 1 low
+	expander_out_write_mask(&dev_port_expander, 1, 0xFF, 0x00);
+	expander_out_flush(&dev_port_expander);
 	//change GPIO Config Object
 	xIO_Semaphore = xSemaphoreCreateMutex();
 	io_conf.intr_type = GPIO_INTR_DISABLE;
@@ -137,6 +254,26 @@ void IO_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO)
 	//Init and configure GPIO
 	gpio_config(&io_conf);
 
+	//Encoder inputs, interrupt on every CLK edge
+	io_conf.intr_type = GPIO_INTR_DISABLE;
+	io_conf.mode = GPIO_MODE_INPUT;
+	io_conf.pin_bit_mask = GPIO_INPUT_PIN_SEL;
+	gpio_config(&io_conf);
+	//the interrupt is enabled by the IO task, see IO_isr_init
+	gpio_set_intr_type(GPIO_INPUT_IO_CLK, GPIO_INTR_ANYEDGE);
+	gpio_intr_disable(GPIO_INPUT_IO_CLK);
+
+#if CONFIG_EXPANDER_INT_GPIO >= 0
+	//Expander INT is open drain and active low
+	io_conf.intr_type = GPIO_INTR_DISABLE;
+	io_conf.mode = GPIO_MODE_INPUT;
+	io_conf.pin_bit_mask = (1ULL<<CONFIG_EXPANDER_INT_GPIO);
+	io_conf.pull_up_en = 1;
+	gpio_config(&io_conf);
+	gpio_set_intr_type(CONFIG_EXPANDER_INT_GPIO, GPIO_INTR_NEGEDGE);
+	gpio_intr_disable(CONFIG_EXPANDER_INT_GPIO);
+#endif
+
 	//Init Timer for PWM
     ledc_timer.duty_resolution = LEDC_TIMER_13_BIT; // resolution of PWM duty
     ledc_timer.freq_hz = 500;                      // frequency of PWM signal
@@ -156,62 +293,137 @@ void IO_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO)
 	//write COnfig
 	ledc_channel_config(&ledc_channel);
 
-	//set name of stack queue object
-	if(stack_usage_queue)
-	{
-		stack_IO.task_num = IO_TASK;
-	}
-
 	//Create main Task
-	xTaskCreate(IO_handler, "IO_handler", 1024*4, NULL, 2, IO_task);
+	xTaskCreatePinnedToCore(IO_handler, "IO_handler", 1024*4, NULL, CONFIG_PSU_ACQ_PRIORITY, &IO_task, CONFIG_PSU_ACQ_CORE);
 	ESP_LOGI(TAG, "--> IO_driver initialized successfully");
 }
 
 /**
- * Sets levels of Reg 1.
- * @param write_value Bit Pattern to set Reg 1 to.
- * @return returns state of GPIO as an int
+ * Changes the period of the input polling. A slow poll lets the CPU enter light sleep,
+ * the encoder level is then also checked by the poll.
+ * @param poll_ms period in ms, 0 restores the default period
+ * @endcode
+ */
+void IO_set_poll_period(uint32_t poll_ms)
+{
+	TickType_t ticks = poll_ms / portTICK_PERIOD_MS;
+	if(poll_ms == 0 || ticks < IO_POLL_TICKS_DEFAULT) ticks = IO_POLL_TICKS_DEFAULT;
+	IO_poll_slow = (poll_ms != 0);
+	IO_poll_ticks = ticks;
+	//with an INT pin the task waits for a notification, start the new period right away
+	if(IO_task) xTaskNotifyGive(IO_task);
+}
+
+/**
+ * Changes bits of expander output port 1. The IO task writes them
+ * with the next flush, only if a bit actually changed.
+ * @param mask bits to change
+ * @param value new levels of the bits in mask
+ * @endcode
+ */
+void IO_exp_out_write(uint8_t mask, uint8_t value)
+{
+	//wake the IO task to write the new value
+	if(expander_out_write_mask(&dev_port_expander, 1, mask, value) && IO_task) xTaskNotifyGive(IO_task);
+}
+
+/**
+ * Sets bits of expander output port 1.
+ * @param mask bits to set
+ * @endcode
+ */
+void IO_exp_out_set(uint8_t mask)
+{
+	IO_exp_out_write(mask, 0xFF);
+}
+
+/**
+ * Clears bits of expander output port 1.
+ * @param mask bits to clear
+ * @endcode
+ */
+void IO_exp_out_clear(uint8_t mask)
+{
+	IO_exp_out_write(mask, 0x00);
+}
+
+/**
+ * Toggles bits of expander output port 1.
+ * @param mask bits to toggle
+ * @endcode
+ */
+void IO_exp_out_toggle(uint8_t mask)
+{
+	if(expander_out_toggle(&dev_port_expander, 1, mask) && IO_task) xTaskNotifyGive(IO_task);
+}
+
+/**
+ * Returns the statistics of the expander output engine.
+ * @return bit changes, flushes and I2C writes
+ * @endcode
+ */
+expander_out_stats_t IO_exp_out_get_stats()
+{
+	return dev_port_expander.out_stats;
+}
+
+/**
+ * Gets levels of reg 0
+ * @return returns states of reg 0 as a bit pattern
  * @endcode
  */
-void IO_exp_write_reg_1(uint8_t write_value)
+uint8_t IO_exp_read_reg_0()
 {
 	if( xIO_Semaphore != NULL )
 	{
 		if( xSemaphoreTake( xIO_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
-	    {
-			reg_1_val = write_value;
+        {
+			return_val = reg_0_val;
 			xSemaphoreGive( xIO_Semaphore );
-			//ESP_LOGI(TAG, "reg_1 set to 0x%x", reg_1_val);
+			//ESP_LOGI(TAG, "reg_0 read as 0x%x", return_val);
+			return return_val;
 		}
 		else
 		{
 			ESP_LOGE(TAG, "Could not take Semaphore");
 		}
 	}
+	return 0;
 }
 
 /**
- * Gets levels of reg 0
+ * Gets levels of reg 0 and the time they were read
+ * @param timestamp_us time of the last change of reg 0
  * @return returns states of reg 0 as a bit pattern
  * @endcode
  */
-uint8_t IO_exp_read_reg_0()
+uint8_t IO_exp_get_input(int64_t *timestamp_us)
 {
+	uint8_t value = 0;
 	if( xIO_Semaphore != NULL )
 	{
 		if( xSemaphoreTake( xIO_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
         {
-			return_val = reg_0_val;
+			value = reg_0_val;
+			*timestamp_us = reg_0_timestamp;
 			xSemaphoreGive( xIO_Semaphore );
-			//ESP_LOGI(TAG, "reg_0 read as 0x%x", return_val);
-			return return_val;
 		}
 		else
 		{
 			ESP_LOGE(TAG, "Could not take Semaphore");
 		}
 	}
-	return 0;
+	return value;
+}
+
+/**
+ * Sets the task that is notified when reg 0 changes or the encoder moves.
+ * @param task task handle, NULL to disable
+ * @endcode
+ */
+void IO_set_input_listener(TaskHandle_t task)
+{
+	input_listener = task;
 }
 
 /**
@@ -226,13 +438,15 @@ void IO_GPIO_set(uint8_t GPIO_Num, bool GPIO_state)
 	{
 		if( xSemaphoreTake( xIO_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
 	    {
+			bool changed = false;
 			//set GPIO with the specified Number
-			if(GPIO_Num == 0) GPIO_0_state = GPIO_state;
-			if(GPIO_Num == 1) GPIO_1_state = GPIO_state;
+			if(GPIO_Num == 0) { changed = (GPIO_0_state != GPIO_state); GPIO_0_state = GPIO_state; }
+			if(GPIO_Num == 1) { changed = (GPIO_1_state != GPIO_state); GPIO_1_state = GPIO_state; }
 			if(GPIO_Num == 2) GPIO_Buzzer_state = GPIO_state;
 			else if(GPIO_Num > 2) ESP_LOGE(TAG, "GPIO_set: GPIO_Num ERROR");	
 			xSemaphoreGive( xIO_Semaphore );
-			//ESP_LOGI(TAG, "reg_1 set to 0x%x", reg_1_val);
+			//wake the IO task to apply the new level
+			if(changed && IO_task) xTaskNotifyGive(IO_task);
 		}
 		else
 		{
@@ -250,23 +464,40 @@ void IO_GPIO_set(uint8_t GPIO_Num, bool GPIO_state)
  */
 int IO_GPIO_get(uint8_t GPIO_Num)
 {
-	int GPIO_state = 0;
-	if( xIO_Semaphore != NULL )
+	//Input pins are read directly, no shared state involved
+	if(GPIO_Num == ENC_DT) return gpio_get_level(GPIO_INPUT_IO_DT);
+	if(GPIO_Num == ENC_CLK) return gpio_get_level(GPIO_INPUT_IO_CLK);
+	ESP_LOGE(TAG, "GPIO_get: GPIO_Num ERROR");
+	return 0;
+}
+
+/**
+ * Returns the raw encoder count accumulated by the encoder interrupt.
+ * Lock-free for readers, the counter is a single aligned word.
+ * @return encoder steps since boot
+ * @endcode
+ */
+int32_t IO_ENC_get_count()
+{
+	return ENC_count;
+}
+
+/**
+ * Returns the raw encoder count and the time of the last step.
+ * @param timestamp_us time of the last encoder step
+ * @return encoder steps since boot
+ * @endcode
+ */
+int32_t IO_ENC_get_count_ts(int64_t *timestamp_us)
+{
+	int32_t count;
+	//retry if the ISR ran in between
+	do
 	{
-		if( xSemaphoreTake( xIO_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
-	    {
-			//set GPIO with the specified Number
-			if(GPIO_Num == 3) GPIO_state = GPIO_DT_state;
-			if(GPIO_Num == 4) GPIO_state = GPIO_CLK_state;
-			else if(GPIO_Num > 4 || GPIO_Num < 3) ESP_LOGE(TAG, "GPIO_get: GPIO_Num ERROR");	
-			xSemaphoreGive( xIO_Semaphore );
-		}
-		else
-		{
-			ESP_LOGE(TAG, "Could not take Semaphore");
-		}
-	}
-	return GPIO_state;
+		count = ENC_count;
+		*timestamp_us = ENC_timestamp;
+	} while(count != ENC_count);
+	return count;
 }
 
 /**
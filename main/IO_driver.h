@@ -1,7 +1,10 @@
 #ifndef MAIN_IO_Driver_H_
 #define MAIN_IO_Driver_H_
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "driver/gpio.h"
+#include "expander_driver.h"
 
 #define LED_0   0
 #define OUT_EN   1
@@ -9,12 +12,53 @@
 #define ENC_DT  3
 #define ENC_CLK 4
 
+//expander output port 1 bits
+#define EXP_OUT_TC_EN   0x01
+#define EXP_OUT_TC_NFON 0x02
+
+/**
+ * Quadrature decode step, evaluated on every CLK edge.
+ * @param clk CLK level after the edge
+ * @param dt DT level at the edge
+ * @return +1 or -1 encoder step
+ * @endcode
+ */
+static inline int IO_ENC_step(uint8_t clk, uint8_t dt)
+{
+	return (clk == dt) ? -1 : 1;
+}
+
+/**
+ * Decodes one sample of the encoder lines, used by the interrupt and the slow poll.
+ * A sample without a CLK change was already handled or bounced back and counts nothing.
+ * @param clk_last CLK level of the last counted edge, updated
+ * @param clk CLK level now
+ * @param dt DT level now
+ * @return +1, -1 or 0 encoder steps
+ * @endcode
+ */
+static inline int IO_ENC_decode(volatile uint8_t *clk_last, uint8_t clk, uint8_t dt)
+{
+	if(clk == *clk_last) return 0;
+	*clk_last = clk;
+	return IO_ENC_step(clk, dt);
+}
+
 void IO_handler(void *pvParameters);
 void IO_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO);
-void IO_exp_write_reg_1(uint8_t write_value);
+void IO_exp_out_write(uint8_t mask, uint8_t value);
+void IO_exp_out_set(uint8_t mask);
+void IO_exp_out_clear(uint8_t mask);
+void IO_exp_out_toggle(uint8_t mask);
+expander_out_stats_t IO_exp_out_get_stats();
 uint8_t IO_exp_read_reg_0();
+uint8_t IO_exp_get_input(int64_t *timestamp_us);
+void IO_set_input_listener(TaskHandle_t task);
+void IO_set_poll_period(uint32_t poll_ms);
 void IO_GPIO_set(uint8_t GPIO_Num, bool GPIO_state);
 int IO_GPIO_get(uint8_t GPIO_Num);
+int32_t IO_ENC_get_count();
+int32_t IO_ENC_get_count_ts(int64_t *timestamp_us);
 void IO_Buzzer_PWM(int freq);
 void IO_Buzzer_power(bool power);
 
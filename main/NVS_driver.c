@@ -1,5 +1,6 @@
 #include "stdio.h"
 #include <string.h>
+#include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -9,11 +10,39 @@
 #include "math.h"
 #include "NVS_driver.h"
 #include "esp_log.h"
-
-static const char *TAG = "NVS_Driver";
+#include "esp_timer.h"
+#include "esp32/rom/crc.h"
+#define BLOG_LEVEL CONFIG_PSU_BLOG_LEVEL_NVS
+#include "blog.h"
 
 nvs_handle NVS_config;
 
+//calibration record as stored in NVS, the CRC covers all fields before it
+typedef struct
+{
+    uint16_t version;
+    uint16_t length;
+    INA_cal_t INA_cal;
+    ADC_cal_t ADC_cal;
+    uint32_t crc;
+} NVS_cal_record_t;
+
+//record of version 1, one scale factor in mV per ADC rail
+typedef struct
+{
+    uint16_t version;
+    uint16_t length;
+    INA_cal_t INA_cal;
+    int32_t OUT_cal[ADC_CAL_RAILS];
+    uint32_t crc;
+} NVS_cal_record_v1_t;
+
+//keys of the calibration before the record, version 0
+static const char *NVS_cal_legacy_keys[] = {
+    "INA1_S_val", "INA1_A_val", "INA2_S_val", "INA2_A_val",
+    "OUT24_cal", "OUT5_cal", "OUT33_cal", "OUTvar_cal",
+};
+
 /**
  * Function to read values from NVS
  *
@@ -29,26 +58,23 @@ esp_err_t NVS_read_values(char *NVS_name, int32_t *NVS_value)
     esp_err_t err = 0;
 
     // Open NVS Handle
-    printf("\n");
-    printf("Opening NVS handle... ");
     err = nvs_open("storage", NVS_READWRITE, &NVS_config);
     if (err != ESP_OK) 
 	{
-        printf("Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+        BLOG_E(NVS_OPEN_FAILED, BLOG_STR(esp_err_to_name(err)));
     } else 
 	{
 		// Reading from NVS
-        printf("Reading Value from NVS ... ");
         err = nvs_get_i32(NVS_config, NVS_name, NVS_value);
         switch (err) {
             case ESP_OK:
-                printf("Success! Value = %d\n", *NVS_value);
+                BLOG_I(NVS_READ, BLOG_STR(NVS_name), BLOG_INT(*NVS_value));
                 break;
             case ESP_ERR_NVS_NOT_FOUND:
-                printf("The value is not initialized yet!\n");
+                BLOG_W(NVS_NOT_FOUND, BLOG_STR(NVS_name));
                 break;
             default :
-                printf("Error (%s) reading!\n", esp_err_to_name(err));
+                BLOG_E(NVS_READ_FAILED, BLOG_STR(esp_err_to_name(err)), BLOG_STR(NVS_name));
         }
         nvs_close(NVS_config);
 	}
@@ -69,21 +95,17 @@ esp_err_t NVS_write_values(char *NVS_name, int32_t NVS_value)
 {
     esp_err_t err = 0;
     // Open NVS Handle
-    printf("\n");
-    printf("Opening NVS handle... ");
     err = nvs_open("storage", NVS_READWRITE, &NVS_config);
     if (err != ESP_OK) 
 	{
-        printf("Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+        BLOG_E(NVS_OPEN_FAILED, BLOG_STR(esp_err_to_name(err)));
     } else 
 	{
         err = nvs_set_i32(NVS_config, NVS_name, NVS_value);
-
-	    printf((err != ESP_OK) ? "Failed!\n" : "Done\n");
 	    // Commit written value.
-	    printf("Committing updates in NVS ... ");
-	    err = nvs_commit(NVS_config);
-	    printf((err != ESP_OK) ? "Failed!\n" : "Done\n");
+	    if (err == ESP_OK) err = nvs_commit(NVS_config);
+	    if (err != ESP_OK) BLOG_E(NVS_WRITE_FAILED, BLOG_STR(esp_err_to_name(err)), BLOG_STR(NVS_name));
+	    else BLOG_I(NVS_WRITE, BLOG_STR(NVS_name), BLOG_INT(NVS_value));
         err = 0;
 	    // Close
 	    nvs_close(NVS_config);
@@ -110,4 +132,170 @@ esp_err_t NVS_init()
     }
     ESP_ERROR_CHECK( err );
     return err;
-}
\ No newline at end of file
+}
+
+//the CRC is the last field of all record versions
+static uint32_t NVS_cal_crc(const void *record, size_t length)
+{
+    return crc32_le(0, (const uint8_t *)record, length - sizeof(uint32_t));
+}
+
+static esp_err_t NVS_cal_set(nvs_handle handle, const INA_cal_t *INA_cal, const ADC_cal_t *ADC_cal)
+{
+    NVS_cal_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.version = NVS_CAL_VERSION;
+    record.length = sizeof(record);
+    record.INA_cal = *INA_cal;
+    record.ADC_cal = *ADC_cal;
+    record.crc = NVS_cal_crc(&record, sizeof(record));
+    return nvs_set_blob(handle, NVS_CAL_KEY, &record, sizeof(record));
+}
+
+//writes the migrated calibration as record, erases the legacy keys and commits once
+static void NVS_cal_store_migrated(nvs_handle handle, const INA_cal_t *INA_cal, const ADC_cal_t *ADC_cal, bool erase_keys)
+{
+    esp_err_t err = NVS_cal_set(handle, INA_cal, ADC_cal);
+    for(int i = 0; i < NVS_CAL_LEGACY_KEYS && err == ESP_OK && erase_keys; i++)
+    {
+        err = nvs_erase_key(handle, NVS_cal_legacy_keys[i]);
+        if(err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    }
+    if(err == ESP_OK) err = nvs_commit(handle);
+    if(err != ESP_OK) BLOG_E(NVS_WRITE_FAILED, BLOG_STR(esp_err_to_name(err)), BLOG_STR(NVS_CAL_KEY));
+}
+
+//moves the per key calibration of version 0 into the record
+static esp_err_t NVS_cal_migrate_keys(nvs_handle handle, INA_cal_t *INA_cal, ADC_cal_t *ADC_cal)
+{
+    INA_cal_t INA_legacy = *INA_cal;
+    int32_t *INA_values[] = {&INA_legacy.INA1_S_val, &INA_legacy.INA1_A_val, &INA_legacy.INA2_S_val, &INA_legacy.INA2_A_val};
+    int32_t scale_mV;
+    int found = 0;
+
+    for(int i = 0; i < NVS_CAL_LEGACY_KEYS; i++)
+    {
+        if(i < 4)
+        {
+            if(nvs_get_i32(handle, NVS_cal_legacy_keys[i], INA_values[i]) == ESP_OK) found++;
+        }
+        else if(nvs_get_i32(handle, NVS_cal_legacy_keys[i], &scale_mV) == ESP_OK)
+        {
+            ADCD_cal_set_scale(ADC_cal, i - 4, scale_mV);
+            found++;
+        }
+    }
+    if(found == 0) return ESP_ERR_NVS_NOT_FOUND;
+
+    *INA_cal = INA_legacy;
+    NVS_cal_store_migrated(handle, INA_cal, ADC_cal, true);
+    BLOG_I(NVS_CAL_MIGRATED, BLOG_INT(found), BLOG_INT(NVS_CAL_VERSION));
+    //the values were read even if the record could not be written
+    return ESP_OK;
+}
+
+//checks a record read from NVS and converts older versions
+static esp_err_t NVS_cal_decode(nvs_handle handle, const void *data, size_t length, INA_cal_t *INA_cal, ADC_cal_t *ADC_cal)
+{
+    //version and length are the same in all versions
+    const NVS_cal_record_v1_t *header = data;
+    if(length < sizeof(NVS_cal_record_v1_t) || header->length != length) return ESP_ERR_INVALID_SIZE;
+
+    switch(header->version)
+    {
+        case NVS_CAL_VERSION:
+        {
+            const NVS_cal_record_t *record = data;
+            if(length != sizeof(NVS_cal_record_t)) return ESP_ERR_INVALID_SIZE;
+            if(record->crc != NVS_cal_crc(record, length)) return ESP_ERR_INVALID_CRC;
+            *INA_cal = record->INA_cal;
+            *ADC_cal = record->ADC_cal;
+            return ESP_OK;
+        }
+        case 1:
+        {
+            const NVS_cal_record_v1_t *record = data;
+            if(length != sizeof(NVS_cal_record_v1_t)) return ESP_ERR_INVALID_SIZE;
+            if(record->crc != NVS_cal_crc(record, length)) return ESP_ERR_INVALID_CRC;
+            *INA_cal = record->INA_cal;
+            for(int rail = 0; rail < ADC_CAL_RAILS; rail++) ADCD_cal_set_scale(ADC_cal, rail, record->OUT_cal[rail]);
+            NVS_cal_store_migrated(handle, INA_cal, ADC_cal, false);
+            BLOG_I(NVS_CAL_UPGRADED, BLOG_INT(1), BLOG_INT(NVS_CAL_VERSION));
+            return ESP_OK;
+        }
+        default:
+            return ESP_ERR_INVALID_VERSION;
+    }
+}
+
+/**
+ * Function to read the calibration record from NVS
+ *
+ * NVS must be initialized to use. Records of older versions and the keys of
+ * version 0 are migrated. The values are left unchanged if nothing valid is stored.
+ * @param INA_cal Where the INA calibration should be read to.
+ * @param ADC_cal Where the ADC calibration should be read to.
+ *
+ * @endcode
+ * \ingroup NVS
+ */
+esp_err_t NVS_read_calibration(INA_cal_t *INA_cal, ADC_cal_t *ADC_cal)
+{
+    int64_t start_us = esp_timer_get_time();
+    NVS_cal_record_t record;
+    size_t length = sizeof(record);
+    esp_err_t err = 0;
+
+    err = nvs_open("storage", NVS_READWRITE, &NVS_config);
+    if (err != ESP_OK)
+    {
+        BLOG_E(NVS_OPEN_FAILED, BLOG_STR(esp_err_to_name(err)));
+        return err;
+    }
+    err = nvs_get_blob(NVS_config, NVS_CAL_KEY, &record, &length);
+    if (err == ESP_OK) err = NVS_cal_decode(NVS_config, &record, length, INA_cal, ADC_cal);
+    else if (err == ESP_ERR_NVS_NOT_FOUND) err = NVS_cal_migrate_keys(NVS_config, INA_cal, ADC_cal);
+    //record larger than this version knows
+    else if (err == ESP_ERR_NVS_INVALID_LENGTH) err = ESP_ERR_INVALID_SIZE;
+    nvs_close(NVS_config);
+
+    switch (err) {
+        case ESP_OK:
+            BLOG_I(NVS_CAL_READ, BLOG_INT(NVS_CAL_VERSION), BLOG_INT(esp_timer_get_time() - start_us));
+            break;
+        case ESP_ERR_NVS_NOT_FOUND:
+            BLOG_W(NVS_NOT_FOUND, BLOG_STR(NVS_CAL_KEY));
+            break;
+        default :
+            BLOG_E(NVS_READ_FAILED, BLOG_STR(esp_err_to_name(err)), BLOG_STR(NVS_CAL_KEY));
+    }
+    return err;
+}
+
+/**
+ * Function to write the calibration record to NVS
+ *
+ * NVS must be initialized to use. All values are written with one commit.
+ * @param INA_cal INA calibration which should be written.
+ * @param ADC_cal ADC calibration which should be written.
+ *
+ * @endcode
+ * \ingroup NVS
+ */
+esp_err_t NVS_write_calibration(const INA_cal_t *INA_cal, const ADC_cal_t *ADC_cal)
+{
+    esp_err_t err = 0;
+    // Open NVS Handle
+    err = nvs_open("storage", NVS_READWRITE, &NVS_config);
+    if (err != ESP_OK)
+    {
+        BLOG_E(NVS_OPEN_FAILED, BLOG_STR(esp_err_to_name(err)));
+        return err;
+    }
+    err = NVS_cal_set(NVS_config, INA_cal, ADC_cal);
+    if (err == ESP_OK) err = nvs_commit(NVS_config);
+    if (err != ESP_OK) BLOG_E(NVS_WRITE_FAILED, BLOG_STR(esp_err_to_name(err)), BLOG_STR(NVS_CAL_KEY));
+    else BLOG_I(NVS_CAL_WRITE, BLOG_INT(NVS_CAL_VERSION));
+    nvs_close(NVS_config);
+    return err;
+}
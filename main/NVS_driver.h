@@ -3,9 +3,18 @@
 
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "INA_data_driver.h"
+#include "ADC_data_driver.h"
+
+//key and version of the calibration record, version 0 used one key per value
+#define NVS_CAL_KEY "cal"
+#define NVS_CAL_VERSION 2
+#define NVS_CAL_LEGACY_KEYS 8
 
 esp_err_t NVS_read_values(char *NVS_name, int32_t *NVS_value);
 esp_err_t NVS_write_values(char *NVS_name, int32_t NVS_value);
+esp_err_t NVS_read_calibration(INA_cal_t *INA_cal, ADC_cal_t *ADC_cal);
+esp_err_t NVS_write_calibration(const INA_cal_t *INA_cal, const ADC_cal_t *ADC_cal);
 esp_err_t NVS_init();
 
 #endif
\ No newline at end of file
@@ -6,18 +6,20 @@
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/soc.h"
 #include "ili9340.h"
 #include "dfuncs.h"
 #include "UI_driver.h"
 #include "IO_driver.h"
 #include "Button_driver.h"
 #include "APA102.h"
+#include "profiler.h"
 
 static const char *TAG = "UI_Driver";
 
 //Display Object
 TFT_t dev;
-uint16_t model = 0x7735;
 char file[32];
 uint16_t color;
 char text[40];
@@ -34,10 +36,6 @@ FontxFile fx16M[2];
 FontxFile fx24M[2];
 FontxFile fx32M[2];
 
-//global variables
-uint8_t Reg1_value = 0;
-uint8_t Reg1_value_last = 0;
-
 /**
  * Initializiation function for display, Buttons and RGB LEDs. Starts SPI target for Display. Also draws boot screen
  * Starts Button_init() and APA102_init().
@@ -62,7 +60,7 @@ void UI_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO)
 	//Initialize SPI for Display
     spi_master_init(&dev, CONFIG_CS_GPIO, CONFIG_DC_GPIO, CONFIG_RESET_GPIO, CONFIG_BL_GPIO);
 	//Iniialize Display
-    lcdInit(&dev, model, CONFIG_WIDTH, CONFIG_HEIGHT, CONFIG_OFFSETX, CONFIG_OFFSETY);
+    lcdInit(&dev, CONFIG_WIDTH, CONFIG_HEIGHT, CONFIG_OFFSETX, CONFIG_OFFSETY);
     lcdSetFontDirection(&dev, 0);
 
     DF_print_fill_screen(BLACK);
@@ -142,8 +140,8 @@ void UI_init(int I2C_PORT, int SDA_GPIO, int SCL_GPIO)
 void UI_draw_main_screen(double power_val, double voltage_val, double current_val, bool output_val)
 {
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 40;
@@ -211,8 +209,8 @@ void UI_draw_main_screen(double power_val, double voltage_val, double current_va
 void UI_draw_voltages_screen(double out24_val, double out5_val, double outvar_val, double out33_val, bool output_val)
 {
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 15;
@@ -293,8 +291,8 @@ void UI_draw_voltages_screen(double out24_val, double out5_val, double outvar_va
 void UI_draw_variable_screen(double uset_val, double ueff_val, int select_val, bool output_val)
 {
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 20;
@@ -344,6 +342,7 @@ void UI_draw_variable_screen(double uset_val, double ueff_val, int select_val, b
  * Display must be initialized to use this function. Initialize using UI_init.
  * 
  * @param p_val Array of 100 values, that should be displayed on display. Values need to be scaled from 0-60.
+ * The first 50 are drawn, one column each. Values out of range, like UI_GRAPH_NONE, leave their column empty.
  * @param screen_select Selects between Power, Voltage and Current. Only changes displayed value.
  * @param division_select Selects the value for the divisions.
  * @param select_val Value to select which parameter should be selected. Draws Rectangle around selected Value.
@@ -357,8 +356,8 @@ void UI_draw_statistics_screen(uint16_t p_val[100], int screen_select, int divis
 	//scaling factor for divisions
 	int factor = 1;
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 3;
@@ -469,6 +468,7 @@ void UI_draw_statistics_screen(uint16_t p_val[100], int screen_select, int divis
 	strcpy((char *)ascii, "t");
 	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
 
+	PROF_BEGIN();
 	DF_print_line(15, 70, 15, 130, color);
 	DF_print_line(15, 130, 115, 130, color);
 
@@ -501,6 +501,7 @@ void UI_draw_statistics_screen(uint16_t p_val[100], int screen_select, int divis
 			DF_print_Vpixel((i*2 + 16), (130-(p_val_temp*factor)), color);
 		}
 	}
+	PROF_END(PROF_PRIMITIVES);
 
 	if(!select_val) DF_print_rect(20, 52, 118, 67, color);
 	if(select_val) DF_print_rect(5, 138, 120, 155, color);
@@ -535,8 +536,8 @@ void UI_draw_statistics_screen(uint16_t p_val[100], int screen_select, int divis
 void UI_draw_calibrate_screen_1(double INA1_S, double INA1_A, double INA2_S, double INA2_A, int select_val)
 {
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 10;
@@ -606,25 +607,27 @@ void UI_draw_calibrate_screen_1(double INA1_S, double INA1_A, double INA2_S, dou
 }
 
 /**
- * Function to generate a Calibration Screen 2 for ADC Calibration using the dfuncs library.
- * The values set with the out... Parameters is the value that will be displayed when the ADC Input is at 1V. 
+ * Function to generate a Calibration Screen 2 for the ADC calibration points using the dfuncs library.
+ * The reference voltage is set to the value of a reference meter and captured at the present ADC value of the rail.
  *
  * Display must be initialized to use this function. Initialize using UI_init.
  * 
- * @param out24 Set Calibration Value for 24Vout
- * @param out5 Max Current Value in mA for INA 1.
- * @param out33 The Shunt Value in Ohms for INA 2.
- * @param outvar Max Current Value in mA for INA 2.
+ * @param rail Name of the selected rail.
+ * @param reference Reference voltage in Volts.
+ * @param measured Voltage of the rail with the present calibration in Volts.
+ * @param raw ADC value of the rail without the channel bits.
+ * @param points Number of calibration points of the rail.
+ * @param status Result of the last capture, empty if none.
  * @param select_val Value to select which parameter should be selected. Draws Rectangle around slected Value.
  *  
  * @endcode
  * \ingroup UI_draw
  */
-void UI_draw_calibrate_screen_2(double out24, double out5, double out33, double outvar, int select_val)
+void UI_draw_calibrate_screen_2(const char *rail, double reference, double measured, int raw, int points, const char *status, int select_val)
 {
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 10;
@@ -633,32 +636,44 @@ void UI_draw_calibrate_screen_2(double out24, double out5, double out33, double
 	DF_print_string(&dev, fx24G, xpos, ypos, ascii, color);
 	xpos = 5;
 	ypos = 55;
-	strcpy((char *)ascii, "   24V:");
+	strcpy((char *)ascii, " Rail:");
 	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
 	xpos = 5;
 	ypos = 75;
-	strcpy((char *)ascii, "    5V:");
+	strcpy((char *)ascii, "  Ref:");
 	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
 	xpos = 5;
 	ypos = 95;
-	strcpy((char *)ascii, "  3.3V:");
+	strcpy((char *)ascii, " Meas:");
 	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
 	xpos = 5;
 	ypos = 115;
-	strcpy((char *)ascii, "   Var:");
+	strcpy((char *)ascii, " Capture");
+	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
+	xpos = 5;
+	ypos = 135;
+	strcpy((char *)ascii, " Clear");
 	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
 	xpos = 60;
 	ypos = 55;
-	DF_print_value(&dev, color, fx16G, xpos, ypos, -1, out24);
+	strcpy((char *)ascii, rail);
+	DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
 	xpos = 60;
 	ypos = 75;
-	DF_print_value(&dev, color, fx16G, xpos, ypos, -1, out5);
+	DF_print_value(&dev, color, fx16G, xpos, ypos, -1, reference);
 	xpos = 60;
 	ypos = 95;
-	DF_print_value(&dev, color, fx16G, xpos, ypos, -1, out33);
-	xpos = 60;
+	DF_print_value(&dev, color, fx16G, xpos, ypos, -1, measured);
+	xpos = 75;
 	ypos = 115;
-	DF_print_value(&dev, color, fx16G, xpos, ypos, -1, outvar);
+	DF_print_value(&dev, color, fx16G, xpos, ypos, points, -1);
+	xpos = 75;
+	ypos = 135;
+	DF_print_value(&dev, color, fx16G, xpos, ypos, raw, -1);
+	xpos = 5;
+	ypos = 155;
+	snprintf((char *)ascii, sizeof(ascii), "%.15s", status);
+	DF_print_string(&dev, fx16G, xpos, ypos, ascii, YELLOW);
 
 	switch(select_val)
 	{
@@ -669,10 +684,10 @@ void UI_draw_calibrate_screen_2(double out24, double out5, double out33, double
 			DF_print_rect(5, 58, 127, 77, color);
 		break;
 		case 2:
-			DF_print_rect(5, 78, 127, 97, color);
+			DF_print_rect(5, 98, 127, 117, color);
 		break;
 		case 3:
-			DF_print_rect(5, 98, 127, 117, color);
+			DF_print_rect(5, 118, 127, 137, color);
 		break;
 	}
 	color = WHITE;
@@ -691,8 +706,8 @@ void UI_draw_calibrate_screen_2(double out24, double out5, double out33, double
 void UI_draw_tcbus_screen(bool TC_EN_val, bool TC_NFON_val, bool output_val, int select_val)
 {
 	//getting Background from Spiffs and printing it
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 25;
@@ -761,11 +776,116 @@ void UI_Update()
 	DF_VlcdUpdate(&dev);
 }
 
+/**
+ * Linking Function to ili9340
+ * Sets the brightness of the backlight, does nothing without a backlight pin.
+ * @param percent 0 is off, 100 is full brightness
+ * @endcode
+ */
+void UI_set_backlight(uint8_t percent)
+{
+	lcdBacklightLevel(&dev, percent);
+}
+
+/**
+ * Linking Function to ili9340
+ * Switches display and backlight off or on. The panel keeps its content,
+ * the next UI_Update only sends what changed meanwhile.
+ * @param on 1 = display and backlight on, 0 = off
+ * @endcode
+ */
+void UI_set_display(bool on)
+{
+	if(on)
+	{
+		lcdDisplayOn(&dev);
+		lcdBacklightOn(&dev);
+	}
+	else
+	{
+		lcdBacklightOff(&dev);
+		lcdDisplayOff(&dev);
+	}
+}
+
+//clocks of the SPI benchmark, the first one the panel does not take ends the run
+static const int UI_spi_clocks[] = {SPI_MASTER_FREQ_20M, SPI_MASTER_FREQ_26M, SPI_MASTER_FREQ_40M, SPI_MASTER_FREQ_80M};
+//side of the small rectangle of the SPI benchmark
+#define UI_SPI_BENCH_RECT 16
+
+/**
+ * Internal function, do not use!!
+ * Runs a push of the SPI benchmark until it is on the panel.
+ * @param push 0 = full frame, 1 = single row, 2 = small rectangle
+ * @param iterations pushes to measure
+ * @return average time of one push in us
+ * @endcode
+ */
+static uint32_t UI_spi_bench_push(int push, int iterations)
+{
+	static uint16_t rect[UI_SPI_BENCH_RECT * UI_SPI_BENCH_RECT];
+	int64_t start = esp_timer_get_time();
+	for(int i = 0; i < iterations; i++)
+	{
+		uint16_t color = (i & 1) ? BLACK : WHITE;
+		switch(push)
+		{
+			case 0:
+				lcdDrawFillRect(&dev, 0, 0, CONFIG_WIDTH - 1, CONFIG_HEIGHT - 1, color);
+			break;
+			case 1:
+				lcdDrawFillRect(&dev, 0, i % CONFIG_HEIGHT, CONFIG_WIDTH - 1, i % CONFIG_HEIGHT, color);
+			break;
+			default:
+				for(int p = 0; p < UI_SPI_BENCH_RECT * UI_SPI_BENCH_RECT; p++) rect[p] = color;
+				lcdDrawRectPixels(&dev, 0, 0, UI_SPI_BENCH_RECT - 1, UI_SPI_BENCH_RECT - 1, rect);
+			break;
+		}
+	}
+	spi_master_wait_all(&dev);
+	return (uint32_t)((esp_timer_get_time() - start) / iterations);
+}
+
+/**
+ * Measures full frame, single row and 16x16 rectangle push times at every SPI clock
+ * and logs them. After each clock the current screen is sent again and held for 500 ms,
+ * a garbled screen shows that the panel does not keep up. Restores the clock afterwards.
+ * @param iterations pushes per measurement
+ * @endcode
+ */
+void UI_spi_benchmark(int iterations)
+{
+	static const char *push_names[3] = {"frame", "row", "rect"};
+	const uint32_t push_bytes[3] = {CONFIG_WIDTH * CONFIG_HEIGHT * 2, CONFIG_WIDTH * 2, UI_SPI_BENCH_RECT * UI_SPI_BENCH_RECT * 2};
+	int clock_hz = spi_master_get_clock(&dev);
+	if(iterations < 1) iterations = 1;
+
+	ESP_LOGI(TAG, "SPI benchmark %dx%d, %d pushes each", CONFIG_WIDTH, CONFIG_HEIGHT, iterations);
+	ESP_LOGI(TAG, "clock_MHz  actual_kHz  push   avg_us    kB/s");
+	for(int c = 0; c < sizeof(UI_spi_clocks) / sizeof(UI_spi_clocks[0]); c++)
+	{
+		if(!spi_master_set_clock(&dev, UI_spi_clocks[c])) break;
+		for(int push = 0; push < 3; push++)
+		{
+			uint32_t us = UI_spi_bench_push(push, iterations);
+			ESP_LOGI(TAG, "%9d %11d  %-5s %7u %7u", UI_spi_clocks[c] / 1000000,
+				spi_get_actual_clock(APB_CLK_FREQ, UI_spi_clocks[c], 128) / 1000, push_names[push], us,
+				us ? (uint32_t)(push_bytes[push] * 1000ULL / us) : 0);
+		}
+		//visual check at this clock
+		DF_VlcdInvalidate();
+		DF_VlcdUpdate(&dev);
+		spi_master_wait_all(&dev);
+		vTaskDelay(500 / portTICK_PERIOD_MS);
+	}
+	spi_master_set_clock(&dev, clock_hz);
+	DF_VlcdInvalidate();
+}
 
 void UI_draw_test_screen_1(int ADC1_read, int ADC2_read, int ADC3_read, int ADC4_read, int ADC5_read)
 {
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 40;
@@ -811,8 +931,8 @@ void UI_draw_test_screen_1(int ADC1_read, int ADC2_read, int ADC3_read, int ADC4
 
 void UI_draw_test_screen_2(int master_stack, int ADC_stack, int INA_stack, int button_stack, int IO_stack)
 {
-	strcpy(file, "/spiffs/background.png");
-	DF_print_png(&dev, file, CONFIG_WIDTH, CONFIG_HEIGHT);
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
 
 	color = WHITE;
 	xpos = 40;
@@ -856,6 +976,40 @@ void UI_draw_test_screen_2(int master_stack, int ADC_stack, int INA_stack, int b
 	DF_print_value(&dev, color, fx16G, xpos, ypos, IO_stack, -1);
 }
 
+/**
+ * Draws the profiler debug page, one line per stage with average and p99 time in us.
+ * @param page_name name of the profiled page
+ * @param stage_names short names of the stages
+ * @param avg_us average time of each stage
+ * @param p99_us p99 time of each stage
+ * @param stage_count number of stages, at most 7 fit on the screen
+ * @endcode
+ * \ingroup UI_draw
+ */
+void UI_draw_profiler_screen(const char *page_name, const char *stage_names[], const uint32_t avg_us[], const uint32_t p99_us[], int stage_count)
+{
+	strcpy(file, "/spiffs/background.565");
+	DF_print_image(file, 0, 0);
+
+	color = WHITE;
+	xpos = 40;
+	ypos = 28;
+	strcpy((char *)ascii, "PROF");
+	DF_print_string(&dev, fx24G, xpos, ypos, ascii, color);
+	xpos = 5;
+	ypos = 48;
+	snprintf((char *)ascii, sizeof(ascii), "%.15s", page_name);
+	DF_print_string(&dev, fx16G, xpos, ypos, ascii, YELLOW);
+	if(stage_count > 7) stage_count = 7;
+	for(int i = 0; i < stage_count; i++)
+	{
+		ypos = 63 + i * 15;
+		snprintf((char *)ascii, sizeof(ascii), "%-5.5s%5u%6u", stage_names[i],
+			avg_us[i] > 99999 ? 99999 : avg_us[i], p99_us[i] > 999999 ? 999999 : p99_us[i]);
+		DF_print_string(&dev, fx16G, xpos, ypos, ascii, color);
+	}
+}
+
 /**
  * Linking Function to IO driver
  * Sets level of specified GPIO Pin.
@@ -889,7 +1043,7 @@ int UI_GPIO_get(uint8_t GPIO_Num)
  */
 void UI_exp_write_reg_1(uint8_t write_value)
 {
-	IO_exp_write_reg_1(write_value);
+	IO_exp_out_write(0xFF, write_value);
 }
 
 /**
@@ -905,14 +1059,26 @@ uint8_t UI_exp_read_reg_0()
 
 /**
  * Linking Function to Button driver.
- * get press state of selected button
- * @param button_select Selects which buttons value to return
- * @return returns button state as an int. 0 = no press, 1 = short press, 2 = long press
+ * get next input event
+ * @param event filled with the event
+ * @return returns true if an event was taken from the queue
+ * @endcode
+ */
+bool UI_get_event(button_event_t *event)
+{
+	return Button_get_event(event);
+}
+
+/**
+ * Linking Function to Button driver.
+ * get held state of selected button
+ * @param button_select Selects which buttons state to return
+ * @return returns true while the button is held down
  * @endcode
  */
-int UI_get_press(int button_select)
+bool UI_is_held(int button_select)
 {
-	return Button_get_press(button_select);
+	return Button_is_held(button_select);
 }
 
 /**
@@ -1012,21 +1178,30 @@ void UI_set_LED0(bool value)
  */
 void UI_set_RGB(uint8_t index, int bright, int red, int green, int blue)
 {
+	PROF_BEGIN();
 	setPixel(index, bright, green, blue, red);
 	flush();
+	PROF_END(PROF_LED);
 }
 
+/**
+ * Linking Function to IO driver
+ * Sets the TC_EN output of the expander. Only written to the bus if it changed.
+ * @param value State as a boolean
+ * @endcode
+ */
 void UI_set_TC_EN(bool value)
 {
-	if(value) Reg1_value = (Reg1_value | 0x01);
-	else Reg1_value = (Reg1_value & 0xFE);
-	if(Reg1_value != Reg1_value_last) Button_write_reg_1(Reg1_value);
-	Reg1_value_last = Reg1_value;
+	IO_exp_out_write(EXP_OUT_TC_EN, value ? EXP_OUT_TC_EN : 0);
 }
+
+/**
+ * Linking Function to IO driver
+ * Sets the TC_NFON output of the expander. Only written to the bus if it changed.
+ * @param value State as a boolean
+ * @endcode
+ */
 void UI_set_TC_NFON(bool value)
 {
-	if(value) Reg1_value = (Reg1_value | 0x02);
-	else Reg1_value = (Reg1_value & 0xFD);
-	if(Reg1_value != Reg1_value_last) Button_write_reg_1(Reg1_value);
-	Reg1_value_last = Reg1_value;
+	IO_exp_out_write(EXP_OUT_TC_NFON, value ? EXP_OUT_TC_NFON : 0);
 }
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include "fontx.h"
 #include "ili9340.h"
 #include "pngle.h"
+#include "Button_driver.h"
+
+//statistics graph value that is not drawn
+#define UI_GRAPH_NONE 0xFFFF
 
 //define to convert int into binary
 #define BYTE_TO_BINARY_PATTERN "%c%c%c%c%c%c%c%c"
@@ -32,18 +36,23 @@ void UI_draw_voltages_screen(double out24_val, double out5_val, double outvar_va
 void UI_draw_variable_screen(double uset_val, double ueff_val, int select_val, bool output_val);
 void UI_draw_statistics_screen(uint16_t p_val[100], int screen_select, int division_select, int select_val, bool output_val);
 void UI_draw_calibrate_screen_1(double INA1_S, double INA1_A, double INA2_S, double INA2_A, int select_val);
-void UI_draw_calibrate_screen_2(double out24, double out5, double out33, double outvar, int select_val);
+void UI_draw_calibrate_screen_2(const char *rail, double reference, double measured, int raw, int points, const char *status, int select_val);
 void UI_draw_tcbus_screen(bool TC_EN_val, bool TC_NFON_val, bool output_val, int select_val);
 void UI_draw_test_screen_1(int ADC1_read, int ADC2_read, int ADC3_read, int ADC4_read, int ADC5_read);
 void UI_draw_test_screen_2(int master_stack, int ADC_stack, int INA_stack, int button_stack, int IO_stack);
+void UI_draw_profiler_screen(const char *page_name, const char *stage_names[], const uint32_t avg_us[], const uint32_t p99_us[], int stage_count);
 
 //Linking Functions
 void UI_Update();
+void UI_set_backlight(uint8_t percent);
+void UI_set_display(bool on);
+void UI_spi_benchmark(int iterations);
 void UI_GPIO_set(uint8_t GPIO_Num, bool GPIO_state);
 int UI_GPIO_get(uint8_t GPIO_Num);
 void UI_exp_write_reg_1(uint8_t write_value);
 uint8_t UI_exp_read_reg_0();
-int UI_get_press(int button_select);
+bool UI_get_event(button_event_t *event);
+bool UI_is_held(int button_select);
 void UI_reset_all_states();
 int UI_get_ENC();
 void UI_Buzzer_PWM(int freq);
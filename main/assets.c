@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp32/rom/crc.h"
+#include "assets.h"
+
+static const char *TAG = "Assets";
+
+//partition mapped into the data address space, NULL if there is none
+static const uint8_t *assets_base = NULL;
+static const asset_entry_t *assets_index = NULL;
+static uint16_t assets_count = 0;
+static uint32_t assets_size = 0;
+static spi_flash_mmap_handle_t assets_handle;
+
+/**
+ * Maps the assets partition and checks its index. Fonts and images are then read
+ * from the flash cache, without a file system and without copies in RAM.
+ * @return true if the partition is usable, otherwise everything is read from SPIFFS
+ * @endcode
+ * \ingroup Assets
+ */
+bool assets_init(void)
+{
+	const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSETS_PARTITION);
+	if(partition == NULL)
+	{
+		ESP_LOGW(TAG, "No %s partition, using SPIFFS", ASSETS_PARTITION);
+		return false;
+	}
+	const void *ptr;
+	esp_err_t ret = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &ptr, &assets_handle);
+	if(ret != ESP_OK)
+	{
+		ESP_LOGE(TAG, "Mapping failed (%s)", esp_err_to_name(ret));
+		return false;
+	}
+	assets_header_t header;
+	memcpy(&header, ptr, sizeof(header));
+	if(header.magic != ASSETS_MAGIC || header.version != ASSETS_VERSION || header.size > partition->size ||
+		header.size < sizeof(header) + header.count * sizeof(asset_entry_t) ||
+		crc32_le(0, (const uint8_t *)ptr + sizeof(header), header.size - sizeof(header)) != header.crc)
+	{
+		ESP_LOGE(TAG, "Partition %s not written or broken, using SPIFFS", ASSETS_PARTITION);
+		spi_flash_munmap(assets_handle);
+		return false;
+	}
+	assets_base = ptr;
+	assets_index = (const asset_entry_t *)(assets_base + sizeof(header));
+	assets_count = header.count;
+	assets_size = header.size;
+	ESP_LOGI(TAG, "%u assets, %u bytes mapped", assets_count, header.size);
+	return true;
+}
+
+/**
+ * Looks up an asset, a path like /spiffs/background.565 is looked up by its file name.
+ * @param name file name or path
+ * @param length size of the asset in bytes, may be NULL
+ * @param format format of the asset, may be NULL
+ * @return the asset in the mapped flash, NULL if there is no such asset or no partition
+ * @endcode
+ * \ingroup Assets
+ */
+const uint8_t *assets_find(const char *name, size_t *length, asset_format_t *format)
+{
+	if(assets_base == NULL) return NULL;
+	const char *file = strrchr(name, '/');
+	file = file ? file + 1 : name;
+	for(int i = 0; i < assets_count; i++)
+	{
+		asset_entry_t entry;
+		memcpy(&entry, &assets_index[i], sizeof(entry));
+		if(strncmp(entry.name, file, ASSETS_NAME_LEN) != 0) continue;
+		if(entry.offset > assets_size || entry.length > assets_size - entry.offset) return NULL;
+		if(length) *length = entry.length;
+		if(format) *format = entry.format;
+		return assets_base + entry.offset;
+	}
+	return NULL;
+}
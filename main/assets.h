@@ -0,0 +1,43 @@
+#ifndef MAIN_ASSETS_H_
+#define MAIN_ASSETS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//read-only partition with fonts and images, written by tools/assetpack.py
+//
+//all fields little endian: header, count entries, then the data of the entries.
+//Offsets are from the start of the partition, the CRC covers everything after the header.
+
+#define ASSETS_PARTITION	"assets"
+#define ASSETS_MAGIC		0x41555350	//"PSUA"
+#define ASSETS_VERSION		1
+#define ASSETS_NAME_LEN		24
+
+//format of an entry
+typedef enum {
+	ASSET_FORMAT_RAW,
+	ASSET_FORMAT_FONTX,
+	ASSET_FORMAT_IMAGE565,		//see image565.h
+} asset_format_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	uint32_t size;				//header, index and data
+	uint32_t crc;
+} assets_header_t;
+
+typedef struct __attribute__((packed)) {
+	char name[ASSETS_NAME_LEN];	//file name, zero terminated
+	uint32_t offset;
+	uint32_t length;
+	uint32_t format;
+} asset_entry_t;
+
+bool assets_init(void);
+const uint8_t *assets_find(const char *name, size_t *length, asset_format_t *format);
+
+#endif
@@ -0,0 +1,219 @@
+#include "stdio.h"
+#include <string.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "blog.h"
+
+static const char *TAG = "Blog";
+
+//length of a formatted record
+#define BLOG_LINE_LEN 128
+
+//Create Task Handle
+TaskHandle_t blog_task;
+
+//tag and format of a message
+typedef struct {
+	const char *tag;
+	const char *format;
+} blog_msg_info_t;
+
+static const blog_msg_info_t blog_msgs[BLOG_MSG_COUNT] = {
+#define BLOG_MSG(id, tag, format) [BLOG_##id] = {tag, format},
+#include "blog_msgs.h"
+#undef BLOG_MSG
+};
+
+//binary record, formatting is done by the drain task
+typedef struct {
+	uint32_t time_ms;
+	uint16_t id;
+	uint8_t level;
+	uint8_t argc;
+	blog_arg_t args[BLOG_MAX_ARGS];
+} blog_record_t;
+
+//ring buffer of the records, head and tail run free and are masked on access
+static blog_record_t blog_ring[CONFIG_PSU_BLOG_RING_LEN];
+static uint32_t blog_head = 0;
+static uint32_t blog_tail = 0;
+static uint32_t blog_dropped = 0;
+static uint32_t blog_dropped_reported = 0;
+static portMUX_TYPE blog_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//drain period
+static TickType_t blog_drain_ticks = 1;
+
+/**
+ * Writes a record to the ring buffer. Use the BLOG_E/W/I/D macros instead,
+ * they drop the call at compile time if the level of the module is lower.
+ * Only copies the arguments, the record is dropped if the ring is full.
+ * @param level BLOG_LEVEL_x of the record
+ * @param id message id
+ * @param args arguments in the order of the format
+ * @param argc number of arguments, at most BLOG_MAX_ARGS are kept
+ * @endcode
+ * \ingroup Blog
+ */
+void blog_write(uint8_t level, blog_msg_t id, const blog_arg_t *args, uint32_t argc)
+{
+	if(argc > BLOG_MAX_ARGS) argc = BLOG_MAX_ARGS;
+	uint32_t time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+	portENTER_CRITICAL(&blog_lock);
+	if(blog_head - blog_tail >= CONFIG_PSU_BLOG_RING_LEN)
+	{
+		blog_dropped++;
+		portEXIT_CRITICAL(&blog_lock);
+		return;
+	}
+	blog_record_t *record = &blog_ring[blog_head % CONFIG_PSU_BLOG_RING_LEN];
+	record->time_ms = time_ms;
+	record->id = id;
+	record->level = level;
+	record->argc = argc;
+	memcpy(record->args, args, argc * sizeof(blog_arg_t));
+	blog_head++;
+	portEXIT_CRITICAL(&blog_lock);
+}
+
+/**
+ * Returns the number of records dropped because the ring buffer was full.
+ * @endcode
+ * \ingroup Blog
+ */
+uint32_t blog_get_dropped(void)
+{
+	return blog_dropped;
+}
+
+/**
+ * Internal function, do not use!!
+ * Takes the oldest record out of the ring buffer.
+ * @param record where the record is copied to
+ * @return true if a record was read
+ * @endcode
+ */
+static bool blog_read(blog_record_t *record)
+{
+	bool read = false;
+	portENTER_CRITICAL(&blog_lock);
+	if(blog_tail != blog_head)
+	{
+		*record = blog_ring[blog_tail % CONFIG_PSU_BLOG_RING_LEN];
+		blog_tail++;
+		read = true;
+	}
+	portEXIT_CRITICAL(&blog_lock);
+	return read;
+}
+
+/**
+ * Internal function, do not use!!
+ * Formats a record. Every conversion of the format is printed on its own
+ * with the argument member that matches the conversion character.
+ * @param line output buffer
+ * @param length size of the output buffer
+ * @param format format of the message
+ * @param record record with the arguments
+ * @endcode
+ */
+static void blog_format(char *line, size_t length, const char *format, const blog_record_t *record)
+{
+	size_t pos = 0;
+	int arg = 0;
+	while(*format && pos < length - 1)
+	{
+		if(*format != '%')
+		{
+			line[pos++] = *format++;
+			continue;
+		}
+		if(format[1] == '%')
+		{
+			line[pos++] = '%';
+			format += 2;
+			continue;
+		}
+		//copy one conversion specification, flags, width and precision included
+		char spec[16];
+		size_t spec_len = 0;
+		spec[spec_len++] = *format++;
+		while(*format && strchr("diuxXcfeEgGs", *format) == NULL && spec_len < sizeof(spec) - 2) spec[spec_len++] = *format++;
+		char conversion = *format;
+		if(conversion) spec[spec_len++] = *format++;
+		spec[spec_len] = 0;
+
+		blog_arg_t value = {0};
+		if(arg < record->argc) value = record->args[arg];
+		arg++;
+
+		int written;
+		if(conversion && strchr("feEgG", conversion)) written = snprintf(&line[pos], length - pos, spec, (double)value.f);
+		else if(conversion == 's') written = snprintf(&line[pos], length - pos, spec, value.s ? value.s : "(null)");
+		else written = snprintf(&line[pos], length - pos, spec, value.i);
+		if(written > 0) pos += written;
+		if(pos > length - 1) pos = length - 1;
+	}
+	line[pos] = 0;
+}
+
+/**
+ * Drain task. Formats the records of the ring buffer and prints them on the console.
+ * @param pvParameters unused
+ * @endcode
+ * \ingroup Blog
+ */
+void blog_handler(void *pvParameters)
+{
+	static const char level_char[] = "NEWID";
+	char line[BLOG_LINE_LEN];
+	blog_record_t record;
+	while(1)
+	{
+		while(blog_read(&record))
+		{
+			if(record.id >= BLOG_MSG_COUNT || record.level > BLOG_LEVEL_DEBUG) continue;
+			blog_format(line, sizeof(line), blog_msgs[record.id].format, &record);
+			printf("%c (%u) %s: %s\n", level_char[record.level], record.time_ms, blog_msgs[record.id].tag, line);
+		}
+		uint32_t dropped = blog_dropped;
+		if(dropped != blog_dropped_reported)
+		{
+			ESP_LOGW(TAG, "%u records dropped, ring buffer full", dropped - blog_dropped_reported);
+			blog_dropped_reported = dropped;
+		}
+		vTaskDelay(blog_drain_ticks);
+	}
+}
+
+/**
+ * Starts the drain task on the UI core with the lowest priority.
+ * Records written before are kept and printed when the task starts.
+ * @param drain_ms period at which the ring buffer is emptied
+ * @endcode
+ * \ingroup Blog
+ */
+void blog_init(uint32_t drain_ms)
+{
+	blog_drain_ticks = drain_ms / portTICK_PERIOD_MS;
+	if(blog_drain_ticks == 0) blog_drain_ticks = 1;
+	xTaskCreatePinnedToCore(blog_handler, "blog_handler", 1024*3, NULL, 1, &blog_task, CONFIG_PSU_UI_CORE);
+	ESP_LOGI(TAG, "--> Blog initialized successfully");
+}
+
+/**
+ * Changes the drain period, longer periods let the CPU sleep longer.
+ * The ring buffer has to hold all records written meanwhile.
+ * @param drain_ms period at which the ring buffer is emptied
+ * @endcode
+ * \ingroup Blog
+ */
+void blog_set_drain_period(uint32_t drain_ms)
+{
+	TickType_t ticks = drain_ms / portTICK_PERIOD_MS;
+	blog_drain_ticks = ticks ? ticks : 1;
+}
@@ -0,0 +1,60 @@
+#ifndef MAIN_BLOG_H_
+#define MAIN_BLOG_H_
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+//levels, same order as the ESP log levels
+#define BLOG_LEVEL_NONE     0
+#define BLOG_LEVEL_ERROR    1
+#define BLOG_LEVEL_WARN     2
+#define BLOG_LEVEL_INFO     3
+#define BLOG_LEVEL_DEBUG    4
+
+//level of the including module, define BLOG_LEVEL before including this header to change it
+#ifndef BLOG_LEVEL
+#define BLOG_LEVEL CONFIG_PSU_BLOG_LEVEL
+#endif
+
+//maximum number of arguments of a record
+#define BLOG_MAX_ARGS 6
+
+//message ids, see blog_msgs.h
+typedef enum {
+#define BLOG_MSG(id, tag, format) BLOG_##id,
+#include "blog_msgs.h"
+#undef BLOG_MSG
+	BLOG_MSG_COUNT,
+} blog_msg_t;
+
+//argument of a record, the conversion in the format selects the member
+typedef union {
+	int32_t i;
+	float f;
+	const char *s;
+} blog_arg_t;
+
+#define BLOG_INT(x) ((blog_arg_t){.i = (int32_t)(x)})
+#define BLOG_FLOAT(x) ((blog_arg_t){.f = (float)(x)})
+#define BLOG_STR(x) ((blog_arg_t){.s = (x)})
+
+//the level check is a constant, disabled records and their arguments are removed by the compiler
+#define BLOG_WRITE(level, id, ...) do { \
+	if(BLOG_LEVEL >= (level)) \
+	{ \
+		const blog_arg_t blog_args[] = { {0}, ##__VA_ARGS__ }; \
+		blog_write((level), BLOG_##id, &blog_args[1], sizeof(blog_args) / sizeof(blog_args[0]) - 1); \
+	} \
+} while(0)
+
+#define BLOG_E(id, ...) BLOG_WRITE(BLOG_LEVEL_ERROR, id, ##__VA_ARGS__)
+#define BLOG_W(id, ...) BLOG_WRITE(BLOG_LEVEL_WARN, id, ##__VA_ARGS__)
+#define BLOG_I(id, ...) BLOG_WRITE(BLOG_LEVEL_INFO, id, ##__VA_ARGS__)
+#define BLOG_D(id, ...) BLOG_WRITE(BLOG_LEVEL_DEBUG, id, ##__VA_ARGS__)
+
+void blog_init(uint32_t drain_ms);
+void blog_set_drain_period(uint32_t drain_ms);
+void blog_write(uint8_t level, blog_msg_t id, const blog_arg_t *args, uint32_t argc);
+uint32_t blog_get_dropped(void);
+
+#endif
@@ -0,0 +1,28 @@
+//messages of the deferred log, included by blog.h and blog.c without include guard
+//BLOG_MSG(id, tag, format), the format may use d, i, u, x, X, c, f, e, g and s conversions
+//string arguments are stored as pointers, they must be literals or otherwise static
+
+//dfuncs
+BLOG_MSG(DF_INT, "DF_print_value", "Int Value: %d")
+BLOG_MSG(DF_FLOAT, "DF_print_value", "Float Value: %.2f")
+
+//NVS_driver
+BLOG_MSG(NVS_OPEN_FAILED, "NVS_Driver", "Error (%s) opening NVS handle!")
+BLOG_MSG(NVS_READ, "NVS_Driver", "Read %s = %d")
+BLOG_MSG(NVS_NOT_FOUND, "NVS_Driver", "%s is not initialized yet!")
+BLOG_MSG(NVS_READ_FAILED, "NVS_Driver", "Error (%s) reading %s!")
+BLOG_MSG(NVS_WRITE, "NVS_Driver", "Wrote %s = %d")
+BLOG_MSG(NVS_WRITE_FAILED, "NVS_Driver", "Error (%s) writing %s!")
+BLOG_MSG(NVS_CAL_READ, "NVS_Driver", "Calibration v%d read in %d us")
+BLOG_MSG(NVS_CAL_WRITE, "NVS_Driver", "Calibration v%d written")
+BLOG_MSG(NVS_CAL_MIGRATED, "NVS_Driver", "Migrated %d calibration keys to record v%d")
+BLOG_MSG(NVS_CAL_UPGRADED, "NVS_Driver", "Migrated calibration record v%d to v%d")
+
+//Master_Task
+BLOG_MSG(MASTER_CALIBRATE, "Master_Task", "Calibrate Screen entered")
+BLOG_MSG(MASTER_TEST, "Master_Task", "Test Screen entered")
+BLOG_MSG(MASTER_CAL_FULL, "Master_Task", "Calibration table of %s full, %d points")
+BLOG_MSG(MASTER_CAL_SLOPE, "Master_Task", "Calibration point of %s rejected, slope out of range")
+BLOG_MSG(MASTER_FRAME_STATS, "Master_Task", "FPS: %d.%d, idle: %d%%, free heap: %d")
+BLOG_MSG(MASTER_SAMPLER_STATS, "Master_Task", "Sampler: %d samples, jitter min %d us, max %d us, avg %d us, %d overruns")
+BLOG_MSG(MASTER_INPUT_LATENCY, "Master_Task", "Input latency: last %d us, max %d us")
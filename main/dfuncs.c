@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
@@ -9,23 +10,34 @@
 #include "ili9340.h"
 #include "pngle.h"
 #include "decode_image.h"
+#include "image565.h"
+#include "assets.h"
 #include "dfuncs.h"
+#include "profiler.h"
+#define BLOG_LEVEL CONFIG_PSU_BLOG_LEVEL_DFUNCS
+#include "blog.h"
 
 uint16_t vscreen[128][160]; // [x][y]
+//last screen sent to the display, allocated with the first update
+static uint16_t (*vscreen_sent)[160] = NULL;
+static bool vscreen_sent_valid = false;
+//pixels of one window sent by DF_VlcdUpdate
+#define DF_BAND_PIXELS 2048
+static uint16_t vscreen_band[DF_BAND_PIXELS];
 
 int DF_print_value(TFT_t * dev, uint16_t color, FontxFile font[2], uint16_t xpos, uint16_t ypos, int int_value, float float_value)
 {
-	lcdSetFontDirection(&dev, 0);
+	lcdSetFontDirection(dev, 0);
 	char text[40];
 	uint8_t ascii[40];
 	if(int_value != -1)
 	{
-		ESP_LOGW(__FUNCTION__, "Int Value: %d", int_value);
+		BLOG_D(DF_INT, BLOG_INT(int_value));
 		sprintf(text, "%d", int_value);
 	}
 	if(float_value != -1)
 	{
-		ESP_LOGW(__FUNCTION__, "Float Value: %.2f", float_value);
+		BLOG_D(DF_FLOAT, BLOG_FLOAT(float_value));
 		sprintf(text, "%.2f", float_value);
 	}
 	strcpy((char *)ascii, text);
@@ -34,7 +46,7 @@ int DF_print_value(TFT_t * dev, uint16_t color, FontxFile font[2], uint16_t xpos
 	
 }
 
-int DF_print_string(TFT_t * dev, FontxFile *fx, uint16_t x, uint16_t y, uint8_t * ascii, uint16_t color) {
+static int DF_print_string_fontx(TFT_t * dev, FontxFile *fx, uint16_t x, uint16_t y, uint8_t * ascii, uint16_t color) {
 	int length = strlen((char *)ascii);
 	bool error = 0;
 	//ESP_LOGW(__FUNCTION__,"lcdDrawString length=%d",length);
@@ -62,6 +74,14 @@ int DF_print_string(TFT_t * dev, FontxFile *fx, uint16_t x, uint16_t y, uint8_t
 	return 0;
 }
 
+int DF_print_string(TFT_t * dev, FontxFile *fx, uint16_t x, uint16_t y, uint8_t * ascii, uint16_t color)
+{
+	PROF_BEGIN();
+	int ret = DF_print_string_fontx(dev, fx, x, y, ascii, color);
+	PROF_END(PROF_TEXT);
+	return ret;
+}
+
 int DF_print_char(TFT_t * dev, FontxFile *fxs, uint16_t x, uint16_t y, uint8_t ascii, uint16_t color) {
 	uint16_t xx,yy,bit,ofs;
 	unsigned char fonts[128]; // font pattern
@@ -201,7 +221,7 @@ int DF_print_char(TFT_t * dev, FontxFile *fxs, uint16_t x, uint16_t y, uint8_t a
 	return next;
 }
 
-TickType_t DF_print_png(TFT_t * dev, char * file, int width, int height) {
+static TickType_t DF_print_png_file(TFT_t * dev, char * file, int width, int height) {
 	TickType_t startTick, endTick, diffTick;
 	startTick = xTaskGetTickCount();
 
@@ -224,10 +244,16 @@ TickType_t DF_print_png(TFT_t * dev, char * file, int width, int height) {
 	int len;
 
 	pngle_t *pngle = pngle_new(_width, _height);
+	if (pngle == NULL) {
+		ESP_LOGE(__FUNCTION__, "Out of memory [%s]", file);
+		fclose(fp);
+		return 0;
+	}
 
 	pngle_set_init_callback(pngle, DF_print_png_init);
-	pngle_set_draw_callback(pngle, DF_print_png_draw);
 	pngle_set_done_callback(pngle, DF_print_png_finish);
+	//decoded scanlines go straight into the virtual screen, red and blue swapped for the panel
+	pngle_set_rgb565_output(pngle, &vscreen[0][0], MIN(_width, 128), MIN(_height, 160), 160, 1, true);
 
 	double display_gamma = 3;
 	pngle_set_display_gamma(pngle, display_gamma);
@@ -256,53 +282,22 @@ TickType_t DF_print_png(TFT_t * dev, char * file, int width, int height) {
 	}
 
 	fclose(fp);
-
-	uint16_t pngWidth = width;
-	uint16_t offsetX = 0;
-	if (width > pngle->imageWidth) {
-		pngWidth = pngle->imageWidth;
-		offsetX = (width - pngle->imageWidth) / 2;
-	}
-	ESP_LOGD(__FUNCTION__, "pngWidth=%d offsetX=%d", pngWidth, offsetX);
-
-	uint16_t pngHeight = height;
-	uint16_t offsetY = 0;
-	if (height > pngle->imageHeight) {
-		pngHeight = pngle->imageHeight;
-		offsetY = (height - pngle->imageHeight) / 2;
-	}
-	ESP_LOGD(__FUNCTION__, "pngHeight=%d offsetY=%d", pngHeight, offsetY);
-	uint16_t *colors = (uint16_t*)malloc(sizeof(uint16_t) * pngWidth);
-
-#if 0
-	for(int y = 0; y < pngHeight; y++){
-		for(int x = 0;x < pngWidth; x++){
-			pixel_png pixel = pngle->pixels[y][x];
-			uint16_t color = rgb565_conv(pixel.red, pixel.green, pixel.blue);
-			lcdDrawPixel(dev, x+offsetX, y+offsetY, color);
-		}
-	}
-#endif
-
-	for(int y = 0; y < pngHeight; y++){
-		for(int x = 0;x < pngWidth; x++){
-			pixel_png pixel = pngle->pixels[y][x];
-			colors[x] = rgb565_conv(pixel.blue, pixel.green, pixel.red);
-			//uint16_t color = rgb565_conv(pixel.red, pixel.green, pixel.blue);
-			//colors[x] = ~color;
-			//vscreen[x][y] = colors[x];
-			DF_print_Vpixel(x, y, colors[x]);
-		}
-		//lcdDrawMultiPixels(dev, offsetX, y+offsetY, pngWidth, colors);
-	}
-	free(colors);
-	pngle_destroy(pngle, _width, _height);
+	ESP_LOGD(__FUNCTION__, "imageWidth=%d imageHeight=%d", pngle->imageWidth, pngle->imageHeight);
+	pngle_destroy(pngle);
 	endTick = xTaskGetTickCount();
 	diffTick = endTick - startTick;
 	//ESP_LOGW(__FUNCTION__, "Drawing Image");
 	return diffTick;
 }
 
+TickType_t DF_print_png(TFT_t * dev, char * file, int width, int height)
+{
+	PROF_BEGIN();
+	TickType_t ret = DF_print_png_file(dev, file, width, height);
+	PROF_END(PROF_BACKGROUND);
+	return ret;
+}
+
 void DF_print_png_init(pngle_t *pngle, uint32_t w, uint32_t h)
 {
 	ESP_LOGD(__FUNCTION__, "print_png_init w=%d h=%d", w, h);
@@ -344,9 +339,7 @@ void DF_print_png_draw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint3
 		_y = y * pngle->scale_factor;
 	}
 	if (_y < pngle->screenHeight && _x < pngle->screenWidth) {
-		pngle->pixels[_y][_x].red = rgba[0];
-		pngle->pixels[_y][_x].green = rgba[1];
-		pngle->pixels[_y][_x].blue = rgba[2];
+		DF_print_Vpixel(_x, _y, rgb565_conv(rgba[2], rgba[1], rgba[0]));
 	}
 
 }
@@ -356,25 +349,238 @@ void DF_print_png_finish(pngle_t *pngle)
 	ESP_LOGD(__FUNCTION__, "print_png_finish");
 }
 
+//last image read by DF_print_image, kept for the next frame
+static char image_cache_file[64];
+static uint8_t *image_cache = NULL;
+static size_t image_cache_size = 0;
+
+/**
+ * Internal function, do not use!!
+ * Copies pixels of a column major image into the virtual screen, clipped at its border.
+ * @param x image position
+ * @param y image position
+ * @param height image height
+ * @param index first pixel of the image to write
+ * @param count pixels to write
+ * @param pixels source pixels, NULL to repeat run
+ * @param run pixel repeated if pixels is NULL
+ * @endcode
+ */
+static void DF_put_pixels(uint16_t x, uint16_t y, uint16_t height, uint32_t index, uint32_t count, const uint8_t *pixels, uint16_t run)
+{
+	while(count > 0)
+	{
+		uint32_t column = x + index / height;
+		uint32_t row = index % height;
+		uint32_t n = height - row;
+		if(n > count) n = count;
+		if(column < 128 && y + row < 160)
+		{
+			uint32_t visible = (y + row + n > 160) ? 160 - (y + row) : n;
+			if(pixels) memcpy(&vscreen[column][y + row], pixels, visible * 2);
+			else for(uint32_t i = 0; i < visible; i++) vscreen[column][y + row + i] = run;
+		}
+		if(pixels) pixels += n * 2;
+		index += n;
+		count -= n;
+	}
+}
+
+/**
+ * Draws a converted image (see image565.h) into the virtual screen with straight copies.
+ * @param image header and pixels
+ * @param size size of image in bytes
+ * @param x position of the left column
+ * @param y position of the top row
+ * @return true if drawn, false if the image is broken
+ * @endcode
+ */
+bool DF_print_image565(const uint8_t *image, size_t size, uint16_t x, uint16_t y)
+{
+	image565_header_t header;
+	if(size < sizeof(header)) return false;
+	memcpy(&header, image, sizeof(header));
+	if(header.magic != IMAGE565_MAGIC || header.version != IMAGE565_VERSION || header.height == 0 ||
+		header.data_size > size - sizeof(header)) return false;
+	const uint8_t *data = image + sizeof(header);
+	uint32_t pixels = (uint32_t)header.width * header.height;
+
+	if(!(header.flags & IMAGE565_FLAG_RLE))
+	{
+		if(header.data_size < pixels * 2) return false;
+		DF_put_pixels(x, y, header.height, 0, pixels, data, 0);
+		return true;
+	}
+
+	//packets of a control word and a run or literal pixels
+	uint32_t index = 0;
+	const uint8_t *end = data + header.data_size;
+	while(index < pixels && data + 2 <= end)
+	{
+		uint16_t control = data[0] | (data[1] << 8);
+		data += 2;
+		uint32_t count = control & ~IMAGE565_RLE_RUN;
+		if(count > pixels - index) return false;
+		if(control & IMAGE565_RLE_RUN)
+		{
+			if(data + 2 > end) return false;
+			DF_put_pixels(x, y, header.height, index, count, NULL, data[0] | (data[1] << 8));
+			data += 2;
+		}
+		else
+		{
+			if(data + count * 2 > end) return false;
+			DF_put_pixels(x, y, header.height, index, count, data, 0);
+			data += count * 2;
+		}
+		index += count;
+	}
+	return index == pixels;
+}
+
+/**
+ * Draws a converted image file (see tools/png2rgb565.py) into the virtual screen.
+ * An image of the assets partition is copied straight from flash, from SPIFFS the file
+ * is read once and kept until another one is drawn. No decoding per frame.
+ * @param file path of the image
+ * @param x position of the left column
+ * @param y position of the top row
+ * @return true if drawn
+ * @endcode
+ */
+bool DF_print_image(const char *file, uint16_t x, uint16_t y)
+{
+	PROF_BEGIN();
+	size_t size;
+	asset_format_t format;
+	const uint8_t *image = assets_find(file, &size, &format);
+	if(image != NULL && format == ASSET_FORMAT_IMAGE565)
+	{
+		bool ret = DF_print_image565(image, size, x, y);
+		if(!ret) ESP_LOGW(__FUNCTION__, "Image not drawn [%s]", file);
+		PROF_END(PROF_BACKGROUND);
+		return ret;
+	}
+	if(image_cache == NULL || strcmp(file, image_cache_file) != 0)
+	{
+		free(image_cache);
+		image_cache = NULL;
+		image_cache_size = 0;
+		FILE* fp = fopen(file, "rb");
+		if (fp == NULL) {
+			ESP_LOGW(__FUNCTION__, "File not found [%s]", file);
+			PROF_END(PROF_BACKGROUND);
+			return false;
+		}
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		if(size > 0) image_cache = malloc(size);
+		if(image_cache != NULL && fread(image_cache, 1, size, fp) == (size_t)size)
+		{
+			image_cache_size = size;
+			snprintf(image_cache_file, sizeof(image_cache_file), "%s", file);
+		}
+		else
+		{
+			free(image_cache);
+			image_cache = NULL;
+		}
+		fclose(fp);
+	}
+	bool ret = image_cache != NULL && DF_print_image565(image_cache, image_cache_size, x, y);
+	if(!ret) ESP_LOGW(__FUNCTION__, "Image not drawn [%s]", file);
+	PROF_END(PROF_BACKGROUND);
+	return ret;
+}
+
 /**
- * Updates LCD from Virtual Screen
+ * Internal function, do not use!!
+ * Sends rows y1 to y2 between x1 and x2 as one window and keeps them as sent.
+ * @param dev display
+ * @param x1 first column
+ * @param y1 first row
+ * @param x2 last column
+ * @param y2 last row
+ * @endcode
+ */
+static void DF_flush_band(TFT_t * dev, int x1, int y1, int x2, int y2)
+{
+	int index = 0;
+	for(int y = y1; y <= y2; y++){
+		for(int x = x1; x <= x2; x++){
+			vscreen_band[index++] = vscreen[x][y];
+			if(vscreen_sent != NULL) vscreen_sent[x][y] = vscreen[x][y];
+		}
+	}
+	lcdDrawRectPixels(dev, x1, y1, x2, y2, vscreen_band);
+}
+
+/**
+ * Updates LCD from Virtual Screen, only the changes since the last update are sent.
+ *
+ * The screen is compared with the last sent one, consecutive changed rows are sent as one window
+ * covering their changed columns. Without the copy of the sent screen everything is sent.
+ * @param dev display
  * @endcode
  */
 void DF_VlcdUpdate(TFT_t * dev)
 {
 	uint16_t pngHeight = 160;
 	uint16_t pngWidth = 128;
-	uint16_t offsetX = 0;
-	uint16_t offsetY = 0;
-	uint16_t *colors = (uint16_t*)malloc(sizeof(uint16_t) * pngWidth);
+	PROF_BEGIN();
+	if(vscreen_sent == NULL)
+	{
+		vscreen_sent = malloc(sizeof(vscreen));
+		vscreen_sent_valid = false;
+	}
 
-	for(int y = 0; y < pngHeight; y++){
-		for(int x = 0;x < pngWidth; x++){
-			colors[x] = vscreen[x][y];
+	//open band of changed rows, none while band_y1 is -1
+	int band_y1 = -1;
+	int band_x1 = 0;
+	int band_x2 = 0;
+	for(int y = 0; y <= pngHeight; y++){
+		//changed columns of the row, the row after the last closes the band
+		int x1 = pngWidth;
+		int x2 = -1;
+		if(y < pngHeight){
+			for(int x = 0; x < pngWidth; x++){
+				if(!vscreen_sent_valid || vscreen[x][y] != vscreen_sent[x][y]){
+					if(x < x1) x1 = x;
+					x2 = x;
+				}
+			}
+		}
+		if(band_y1 >= 0){
+			int nx1 = x1 < band_x1 ? x1 : band_x1;
+			int nx2 = x2 > band_x2 ? x2 : band_x2;
+			if(x2 >= 0 && (y - band_y1 + 1) * (nx2 - nx1 + 1) <= DF_BAND_PIXELS){
+				band_x1 = nx1;
+				band_x2 = nx2;
+				continue;
+			}
+			DF_flush_band(dev, band_x1, band_y1, band_x2, y - 1);
+			band_y1 = -1;
+		}
+		if(x2 >= 0){
+			band_y1 = y;
+			band_x1 = x1;
+			band_x2 = x2;
 		}
-		lcdDrawMultiPixels(dev, offsetX, y+offsetY, pngWidth, colors);
 	}
-	free(colors);
+	vscreen_sent_valid = vscreen_sent != NULL;
+	//bands are queued, the frame is done when the last one is on the panel
+	spi_master_wait_all(dev);
+	PROF_END(PROF_FLUSH);
+}
+
+/**
+ * Sends the whole virtual screen with the next update, for when the display lost its content.
+ * @endcode
+ */
+void DF_VlcdInvalidate(void)
+{
+	vscreen_sent_valid = false;
 }
 
 void DF_print_Vpixel(uint16_t x, uint16_t y, uint16_t color)
@@ -383,13 +589,16 @@ void DF_print_Vpixel(uint16_t x, uint16_t y, uint16_t color)
 }
 
 void DF_print_rect(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color) {
+	PROF_BEGIN();
 	DF_print_line(x1, y1, x2, y1, color);
 	DF_print_line(x2, y1, x2, y2, color);
 	DF_print_line(x2, y2, x1, y2, color);
 	DF_print_line(x1, y2, x1, y1, color);
+	PROF_END(PROF_PRIMITIVES);
 }
 
 void DF_print_fill_screen(uint16_t color) {
+	PROF_BEGIN();
 	uint16_t Height = 160;
 	uint16_t Width = 128;
 	for(int x = 0; x < Width; x++)
@@ -399,6 +608,7 @@ void DF_print_fill_screen(uint16_t color) {
 			vscreen[x][y] = color;
 		}
 	}
+	PROF_END(PROF_PRIMITIVES);
 }
 
 
@@ -407,6 +617,7 @@ void DF_print_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t
 	int dx,dy;
 	int sx,sy;
 	int E;
+	PROF_BEGIN();
 
 	/* distance between two points */
 	dx = ( x2 > x1 ) ? x2 - x1 : x1 - x2;
@@ -442,10 +653,12 @@ void DF_print_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t
 			}
 		}
 	}
+	PROF_END(PROF_PRIMITIVES);
 }
 
 void DF_print_triangle(uint16_t xc, uint16_t yc, uint16_t w, uint16_t h, uint16_t angle, uint16_t color) 
 {
+        PROF_BEGIN();
         double xd,yd,rd;
         int x1,y1;
         int x2,y2;
@@ -468,4 +681,5 @@ void DF_print_triangle(uint16_t xc, uint16_t yc, uint16_t w, uint16_t h, uint16_
         DF_print_line(x1, y1, x2, y2, color);
         DF_print_line(x1, y1, x3, y3, color);
         DF_print_line(x2, y2, x3, y3, color);
+        PROF_END(PROF_PRIMITIVES);
 }
\ No newline at end of file
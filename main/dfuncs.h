@@ -29,8 +29,11 @@ TickType_t DF_print_png(TFT_t * dev, char * file, int width, int height);
 void DF_print_png_init(pngle_t *pngle, uint32_t w, uint32_t h);
 void DF_print_png_draw(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint8_t rgba[4]);
 void DF_print_png_finish(pngle_t *pngle);
+bool DF_print_image565(const uint8_t *image, size_t size, uint16_t x, uint16_t y);
+bool DF_print_image(const char *file, uint16_t x, uint16_t y);
 void DF_print_Vpixel(uint16_t x, uint16_t y, uint16_t color);
 void DF_VlcdUpdate(TFT_t * dev);
+void DF_VlcdInvalidate(void);
 void DF_print_rect(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
 void DF_print_fill_screen(uint16_t color);
 void DF_print_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
@@ -8,12 +8,12 @@
 #include "esp_log.h"
 #include "expander_driver.h"
 
-//define I2c Frequency
-#define I2C_FREQ_HZ 400000
-
 //Tag for ESP_LOG functions
 static const char *TAG = "EXPANDER";
 
+//protects the output shadow registers
+static portMUX_TYPE out_lock = portMUX_INITIALIZER_UNLOCKED;
+
 //define Error checking function
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
@@ -81,9 +81,14 @@ esp_err_t expander_init_desc(expander_t *dev, uint8_t addr, i2c_port_t port, gpi
     dev->i2c_dev.cfg.sda_io_num = sda_gpio;
     dev->i2c_dev.cfg.scl_io_num = scl_gpio;
 #if HELPER_TARGET_IS_ESP32
-    dev->i2c_dev.cfg.master.clk_speed = I2C_FREQ_HZ;
+    dev->i2c_dev.cfg.master.clk_speed = EXPANDER_I2C_MAX_FREQ_HZ;
 #endif
 
+    //output registers are 0xFF after power on
+    dev->out_shadow[0] = dev->out_shadow[1] = 0xFF;
+    dev->out_written[0] = dev->out_written[1] = 0xFF;
+    memset(&dev->out_stats, 0, sizeof(expander_out_stats_t));
+
     return i2c_dev_create_mutex(&dev->i2c_dev);
     ESP_LOGI(TAG, "--> Expander initialized successfully");
 }
@@ -94,68 +99,199 @@ esp_err_t expander_configure(expander_t *dev, conf_t *config)
 {
     //set config values with error checking
     esp_err_t error_check = 0;
+    //last failed register, the others are still written
+    esp_err_t result = ESP_OK;
     if(config->conf_port_0 != 0xFF) error_check = config_value(dev, reg_conf_port_0, config->conf_port_0);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->conf_port_1 != 0xFF) error_check = config_value(dev, reg_conf_port_1, config->conf_port_1);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->pol_inv_0   != 0x00) error_check = config_value(dev, reg_polinv_port_0, config->pol_inv_0);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->pol_inv_1   != 0x00) error_check = config_value(dev, reg_polinv_port_1, config->pol_inv_1);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
 
     if(config->drive_port_0 != 0xFF) 
     {
         uint8_t drive_0_low = (uint8_t)(config->drive_port_0 & 0x00FF);
         error_check = config_value(dev, reg_outdr_port_0_low, drive_0_low);
-        if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+        if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
         uint8_t drive_0_high = (uint8_t)(config->drive_port_0 >> 8);
         error_check = config_value(dev, reg_outdr_port_0_high, drive_0_high);
-        if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+        if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     }
     if(config->drive_port_1 != 0xFF) 
     {
         uint8_t drive_1_low = (uint8_t)(config->drive_port_1 & 0x00FF);
         error_check = config_value(dev, reg_outdr_port_1_low, drive_1_low);
-        if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+        if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
         uint8_t drive_1_high = (uint8_t)(config->drive_port_1 >> 8);
         error_check = config_value(dev, reg_outdr_port_1_high, drive_1_high);
-        if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+        if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     }
     if(config->latch_port_0 != 0x00) error_check = config_value(dev, reg_latch_port_0, config->latch_port_0);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->latch_port_1 != 0x00) error_check = config_value(dev, reg_latch_port_1 , config->latch_port_1);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->pull_en_port_0 != 0x00) error_check = config_value(dev, reg_pull_en_port_0, config->pull_en_port_0);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->pull_en_port_1 != 0x00) error_check = config_value(dev, reg_pull_en_port_1, config->pull_en_port_1);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->pull_sel_port_0 != 0xFF) error_check = config_value(dev, reg_pull_select_port_0, config->pull_sel_port_0);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->pull_sel_port_1 != 0xFF) error_check = config_value(dev, reg_pull_select_port_1, config->pull_sel_port_1);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->interr_mask_port_0 != 0xFF) error_check = config_value(dev, reg_interr_mask_port_0, config->interr_mask_port_0);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->interr_mask_port_1 != 0xFF) error_check = config_value(dev, reg_interr_mask_port_1, config->interr_mask_port_1);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
     if(config->out_port_conf != 0x00) error_check = config_value(dev, reg_out_port_conf, config->out_port_conf);
-    if(error_check != 0) ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check);
-    return ESP_OK;
+    if(error_check != 0) { ESP_LOGE(__FUNCTION__, "AN ERROR OCCURED: 0x%x", error_check); result = error_check; error_check = 0; }
+    return result;
 }
 
-//configuration value set (tries 5 times)
+//configuration value set, read back to verify. i2cdev counts failures and recovers the bus, no retries here
 esp_err_t config_value(expander_t *dev, uint8_t reg, uint8_t value)
 {
     uint8_t ref_value = 0;
-    int counter = 5;
-    while(counter > 0)
+    esp_err_t ret = write_reg_8(dev, reg, value);
+    if(ret == ESP_OK) ret = read_reg_8(dev, reg, &ref_value);
+    if(ret == ESP_OK && ref_value != value) ret = ESP_ERR_INVALID_RESPONSE;
+    return ret;
+}
+
+/**
+ * Reads interrupt status and input levels of port 0.
+ * Reading the input register clears the interrupt and releases the INT line.
+ * @param dev expander object
+ * @param status pins that changed since the last read
+ * @param input input levels (latched if latching is enabled)
+ * @return ESP_OK on success
+ * @endcode
+ */
+esp_err_t expander_read_interrupt_port_0(expander_t *dev, uint8_t *status, uint8_t *input)
+{
+    CHECK_ARG(status && input);
+
+    esp_err_t err = read_reg_8(dev, reg_interr_stat_port_0, status);
+    if (err != ESP_OK) return err;
+    return read_reg_8(dev, reg_in_port_0, input);
+}
+
+/**
+ * Changes bits of an output port in the shadow register.
+ * Nothing is written to the chip until expander_out_flush().
+ * @param dev expander object
+ * @param port output port, 0 or 1
+ * @param mask bits to change
+ * @param value new levels of the bits in mask
+ * @return true if the shadow register changed
+ * @endcode
+ */
+bool expander_out_write_mask(expander_t *dev, uint8_t port, uint8_t mask, uint8_t value)
+{
+    if (!dev || port > 1) return false;
+
+    portENTER_CRITICAL(&out_lock);
+    uint8_t old = dev->out_shadow[port];
+    uint8_t updated = (old & ~mask) | (value & mask);
+    dev->out_shadow[port] = updated;
+    dev->out_stats.bit_changes += __builtin_popcount(old ^ updated);
+    portEXIT_CRITICAL(&out_lock);
+
+    return old != updated;
+}
+
+/**
+ * Sets bits of an output port in the shadow register.
+ * @return true if the shadow register changed
+ * @endcode
+ */
+bool expander_out_set(expander_t *dev, uint8_t port, uint8_t mask)
+{
+    return expander_out_write_mask(dev, port, mask, 0xFF);
+}
+
+/**
+ * Clears bits of an output port in the shadow register.
+ * @return true if the shadow register changed
+ * @endcode
+ */
+bool expander_out_clear(expander_t *dev, uint8_t port, uint8_t mask)
+{
+    return expander_out_write_mask(dev, port, mask, 0x00);
+}
+
+/**
+ * Toggles bits of an output port in the shadow register.
+ * @return true, toggling always changes the register
+ * @endcode
+ */
+bool expander_out_toggle(expander_t *dev, uint8_t port, uint8_t mask)
+{
+    if (!dev || port > 1 || !mask) return false;
+
+    portENTER_CRITICAL(&out_lock);
+    dev->out_shadow[port] ^= mask;
+    dev->out_stats.bit_changes += __builtin_popcount(mask);
+    portEXIT_CRITICAL(&out_lock);
+
+    return true;
+}
+
+/**
+ * Returns the shadow register of an output port.
+ * @endcode
+ */
+uint8_t expander_out_get(expander_t *dev, uint8_t port)
+{
+    if (!dev || port > 1) return 0;
+    return dev->out_shadow[port];
+}
+
+/**
+ * Writes the output ports that differ from the chip.
+ * Both ports changed are written in one auto-increment transaction.
+ * Does nothing on the bus if no bit changed since the last flush.
+ * @param dev expander object
+ * @return ESP_OK on success
+ * @endcode
+ */
+esp_err_t expander_out_flush(expander_t *dev)
+{
+    CHECK_ARG(dev);
+
+    uint8_t out[2];
+    portENTER_CRITICAL(&out_lock);
+    out[0] = dev->out_shadow[0];
+    out[1] = dev->out_shadow[1];
+    portEXIT_CRITICAL(&out_lock);
+
+    bool dirty_0 = (out[0] != dev->out_written[0]);
+    bool dirty_1 = (out[1] != dev->out_written[1]);
+    dev->out_stats.flushes++;
+    if (!dirty_0 && !dirty_1) return ESP_OK;
+
+    esp_err_t err;
+    I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
+    if (dirty_0 && dirty_1)
+    {
+        err = i2c_dev_write_reg(&dev->i2c_dev, reg_out_port_0, out, 2);
+        dev->out_stats.coalesced++;
+    }
+    else if (dirty_0)
+        err = i2c_dev_write_reg(&dev->i2c_dev, reg_out_port_0, &out[0], 1);
+    else
+        err = i2c_dev_write_reg(&dev->i2c_dev, reg_out_port_1, &out[1], 1);
+    I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
+
+    dev->out_stats.writes++;
+    if (err != ESP_OK)
     {
-        write_reg_8(dev, reg, value);
-        vTaskDelay(2 / portTICK_PERIOD_MS);
-        read_reg_8(dev, reg, &ref_value); 
-        if(ref_value == value) counter = -1;
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-        counter--;
+        //keep the ports dirty so the next flush retries
+        dev->out_stats.errors++;
+        return err;
     }
-    if(ref_value == value) return ESP_OK;
-    else return ESP_ERR_TIMEOUT;
-}
\ No newline at end of file
+    dev->out_written[0] = out[0];
+    dev->out_written[1] = out[1];
+    return ESP_OK;
+}
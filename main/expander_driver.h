@@ -8,6 +8,9 @@
 #define expander_addr_low 0x20
 #define expander_addr_high 0x21
 
+//Highest I2C clock the expander supports (Fast-mode Plus)
+#define EXPANDER_I2C_MAX_FREQ_HZ 1000000
+
 //Register addresses
 #define reg_in_port_0          0x00
 #define reg_in_port_1          0x01
@@ -72,6 +75,16 @@ typedef struct
     uint8_t out_port_conf;
 } conf_t;
 
+//Output engine statistics
+typedef struct
+{
+    uint32_t bit_changes;   //bits changed by set/clear/toggle/write calls
+    uint32_t flushes;       //calls of expander_out_flush
+    uint32_t writes;        //I2C transactions written
+    uint32_t coalesced;     //transactions that wrote both ports at once
+    uint32_t errors;        //failed writes, retried on the next flush
+} expander_out_stats_t;
+
 //I2C Expander Object
 typedef struct
 {
@@ -79,6 +92,11 @@ typedef struct
 
     uint16_t config;
     float i_lsb, p_lsb;
+
+    //output registers: wanted state and state last written to the chip
+    uint8_t out_shadow[2];
+    uint8_t out_written[2];
+    expander_out_stats_t out_stats;
 } expander_t;
 
 esp_err_t read_reg_8(expander_t *dev, uint8_t reg, uint8_t *val);
@@ -88,5 +106,12 @@ esp_err_t write_reg_16(expander_t *dev, uint8_t reg, uint16_t val);
 esp_err_t expander_init_desc(expander_t *dev, uint8_t addr, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
 esp_err_t expander_configure(expander_t *dev, conf_t *config);
 esp_err_t config_value(expander_t *dev, uint8_t port, uint8_t value);
+esp_err_t expander_read_interrupt_port_0(expander_t *dev, uint8_t *status, uint8_t *input);
+bool expander_out_set(expander_t *dev, uint8_t port, uint8_t mask);
+bool expander_out_clear(expander_t *dev, uint8_t port, uint8_t mask);
+bool expander_out_toggle(expander_t *dev, uint8_t port, uint8_t mask);
+bool expander_out_write_mask(expander_t *dev, uint8_t port, uint8_t mask, uint8_t value);
+uint8_t expander_out_get(expander_t *dev, uint8_t port);
+esp_err_t expander_out_flush(expander_t *dev);
 
 #endif
\ No newline at end of file
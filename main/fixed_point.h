@@ -0,0 +1,90 @@
+#ifndef MAIN_FIXED_POINT_H_
+#define MAIN_FIXED_POINT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Q16 fixed point, 16 fractional bits
+#define Q16_SHIFT 16
+#define Q16_ONE (1 << Q16_SHIFT)
+
+//largest scale in units per count, the Q16 scale is an int32_t
+#define Q16_SCALE_MAX (INT32_MAX / Q16_ONE)
+
+//scale and offset pair, value = (raw * scale + offset) >> 16
+typedef struct
+{
+    int32_t scale;
+    int64_t offset;
+} q16_coef_t;
+
+/**
+ * Checks if a scale of num / den units per count fits the Q16 coefficients.
+ * @param num numerator of the units per count
+ * @param den denominator of the units per count, positive
+ * @return true if q16_coef represents the scale without saturating
+ * @endcode
+ * \ingroup fixed_point
+ */
+static inline bool q16_scale_fits(int64_t num, int64_t den)
+{
+    if(den <= 0) return false;
+    int64_t scale = (num * Q16_ONE + den / 2) / den;
+    return scale >= INT32_MIN && scale <= INT32_MAX;
+}
+
+/**
+ * Builds the coefficients for value = (raw - raw_zero) * num / den, rounded to nearest.
+ *
+ * Only called when the calibration changes, the division is not repeated per sample.
+ * The scale num / den must stay below Q16_SCALE_MAX units per count, check it with
+ * q16_scale_fits. A larger scale saturates instead of wrapping around.
+ * @param num numerator of the units per count
+ * @param den denominator of the units per count, positive
+ * @param raw_zero raw value that converts to 0
+ * @return coefficients for q16_apply
+ * @endcode
+ * \ingroup fixed_point
+ */
+static inline q16_coef_t q16_coef(int64_t num, int64_t den, int32_t raw_zero)
+{
+    q16_coef_t coef;
+    int64_t scale = (num * Q16_ONE + den / 2) / den;
+    if(scale > INT32_MAX) scale = INT32_MAX;
+    if(scale < INT32_MIN) scale = INT32_MIN;
+    coef.scale = (int32_t)scale;
+    coef.offset = (Q16_ONE / 2) - (int64_t)raw_zero * coef.scale;
+    return coef;
+}
+
+/**
+ * Builds the coefficients of the line through two points, for piecewise linear tables.
+ * @param raw0 raw value of the first point
+ * @param value0 value at the first point
+ * @param raw1 raw value of the second point, greater than raw0
+ * @param value1 value at the second point
+ * @return coefficients for q16_apply
+ * @endcode
+ * \ingroup fixed_point
+ */
+static inline q16_coef_t q16_segment(int32_t raw0, int32_t value0, int32_t raw1, int32_t value1)
+{
+    q16_coef_t coef = q16_coef((int64_t)value1 - value0, (int64_t)raw1 - raw0, raw0);
+    coef.offset += (int64_t)value0 * Q16_ONE;
+    return coef;
+}
+
+/**
+ * Converts a raw value with coefficients of q16_coef, one multiply, add and shift.
+ * @param coef coefficients
+ * @param raw raw value
+ * @return value in the units of the coefficients
+ * @endcode
+ * \ingroup fixed_point
+ */
+static inline int32_t q16_apply(const q16_coef_t *coef, int32_t raw)
+{
+    return (int32_t)(((int64_t)raw * coef->scale + coef->offset) >> Q16_SHIFT);
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include "esp_spiffs.h"
 
 #include "fontx.h"
+#include "assets.h"
 
 #define FontxDebug 0 // for Debug
 
@@ -31,21 +32,33 @@ bool OpenFontx(FontxFile *fx)
 	FILE *f;
 	if(!fx->opened){
 		if(FontxDebug)printf("[openFont]fx->path=[%s]\n",fx->path);
-		f = fopen(fx->path, "r");
-		if(FontxDebug)printf("[openFont]fopen=%p\n",f);
-		if (f == NULL) {
-			fx->valid = false;
-			printf("Fontx:%s not found.\n",fx->path);
-			return fx->valid ;
-		}
-		fx->opened = true;
-		fx->file = f;
 		char buf[18];
-		if (fread(buf, 1, sizeof(buf), fx->file) != sizeof(buf)) {
-			fx->valid = false;
-			printf("Fontx:%s not FONTX format.\n",fx->path);
-			fclose(fx->file);
-			return fx->valid ;
+		size_t size;
+		asset_format_t format;
+		// mapped font, glyphs are read straight from flash
+		fx->data = assets_find(fx->path, &size, &format);
+		if (fx->data != NULL && (format != ASSET_FORMAT_FONTX || size < sizeof(buf))) fx->data = NULL;
+		if (fx->data != NULL) {
+			fx->opened = true;
+			fx->file = NULL;
+			fx->size = size;
+			memcpy(buf, fx->data, sizeof(buf));
+		} else {
+			f = fopen(fx->path, "r");
+			if(FontxDebug)printf("[openFont]fopen=%p\n",f);
+			if (f == NULL) {
+				fx->valid = false;
+				printf("Fontx:%s not found.\n",fx->path);
+				return fx->valid ;
+			}
+			fx->opened = true;
+			fx->file = f;
+			if (fread(buf, 1, sizeof(buf), fx->file) != sizeof(buf)) {
+				fx->valid = false;
+				printf("Fontx:%s not FONTX format.\n",fx->path);
+				fclose(fx->file);
+				return fx->valid ;
+			}
 		}
 
 		if(FontxDebug) {
@@ -62,7 +75,7 @@ bool OpenFontx(FontxFile *fx)
 		if(fx->fsz > FontxGlyphBufSize){
 			printf("Fontx:%s is too big font size.\n",fx->path);
 			fx->valid = false;
-			fclose(fx->file);
+			if(fx->file) fclose(fx->file);
 			return fx->valid ;
 		}
 		fx->valid = true;
@@ -74,7 +87,7 @@ bool OpenFontx(FontxFile *fx)
 void CloseFontx(FontxFile *fx)
 {
 	if(fx->opened){
-		fclose(fx->file);
+		if(fx->file) fclose(fx->file);
 		fx->opened = false;
 	}
 }
@@ -213,6 +226,16 @@ bool GetFontx(FontxFile *fxs, uint8_t ascii , uint8_t *pGlyph, uint8_t *pw, uint
 if(FontxDebug)printf("[GetFontx]fxs.is_ank fxs.fsz=%d\n",fxs[i].fsz);
 				offset = 17 + ascii * fxs[i].fsz;
 if(FontxDebug)printf("[GetFontx]offset=%d\n",offset);
+				if(fxs[i].data) {
+					if(offset + fxs[i].fsz > fxs[i].size) {
+						printf("Fontx:offset(%u) out of font.\n",offset);
+						return false;
+					}
+					memcpy(pGlyph, fxs[i].data + offset, fxs[i].fsz);
+					if(pw) *pw = fxs[i].w;
+					if(ph) *ph = fxs[i].h;
+					return true;
+				}
 				if(fseek(fxs[i].file, offset, SEEK_SET)) {
 					printf("Fontx:seek(%u) failed.\n",offset);
 					return false;
@@ -13,6 +13,8 @@ typedef struct {
 	uint16_t fsz;
 	uint8_t bc;
 	FILE *file;
+	const uint8_t *data;	// mapped from the assets partition, file is not used
+	uint32_t size;
 } FontxFile;
 
 void AaddFontx(FontxFile *fx, const char *path);
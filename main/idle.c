@@ -0,0 +1,201 @@
+#include "stdio.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+#include "esp_pm.h"
+#endif
+#include "UI_driver.h"
+#include "IO_driver.h"
+#include "ADC_data_driver.h"
+#include "blog.h"
+#include "master_events.h"
+#include "page_engine.h"
+#include "idle.h"
+
+static const char *TAG = "Idle";
+
+static const char *idle_state_names[IDLE_STATE_COUNT] = {"active", "dim", "sleep"};
+
+static idle_state_t idle_state = IDLE_ACTIVE;
+static int64_t idle_last_activity_us = 0;
+static int64_t idle_state_start_us = 0;
+static idle_stats_t idle_stats;
+//state requested by the console, applied by the next idle_update
+static volatile int idle_requested = -1;
+
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+//held while the display is on, released in IDLE_SLEEP
+static esp_pm_lock_handle_t idle_pm_lock = NULL;
+#endif
+
+/**
+ * Internal function, do not use!!
+ * Changes the state and sets display, refresh rate, input polling and light sleep.
+ * @param state new state
+ * @endcode
+ */
+static void idle_enter(idle_state_t state)
+{
+	if(state == idle_state) return;
+	int64_t now = esp_timer_get_time();
+	idle_stats.time_us[idle_state] += now - idle_state_start_us;
+	idle_state_start_us = now;
+
+	//CPU, inputs and display back before the page is drawn again
+	if(idle_state == IDLE_SLEEP)
+	{
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+		if(idle_pm_lock) esp_pm_lock_acquire(idle_pm_lock);
+#endif
+		IO_set_poll_period(0);
+		ADCD_set_period(0);
+		blog_set_drain_period(CONFIG_PSU_BLOG_DRAIN_MS);
+		UI_set_display(1);
+		page_engine_invalidate();
+		idle_stats.wakes++;
+	}
+	switch(state)
+	{
+		case IDLE_ACTIVE:
+			UI_set_backlight(100);
+			master_events_set_refresh(CONFIG_PSU_REFRESH_MS);
+			page_engine_set_min_refresh(0);
+		break;
+		case IDLE_DIM:
+			UI_set_backlight(CONFIG_PSU_IDLE_DIM_PERCENT);
+			master_events_set_refresh(CONFIG_PSU_IDLE_REFRESH_MS);
+			page_engine_set_min_refresh(CONFIG_PSU_IDLE_REFRESH_MS);
+		break;
+		case IDLE_SLEEP:
+			master_events_set_refresh(0);
+			UI_set_display(0);
+			IO_set_poll_period(CONFIG_PSU_IDLE_POLL_MS);
+			//the rails are not shown, the INA task keeps checking the limits
+			ADCD_set_period(CONFIG_PSU_IDLE_REFRESH_MS);
+			blog_set_drain_period(CONFIG_PSU_IDLE_REFRESH_MS);
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+			if(idle_pm_lock) esp_pm_lock_release(idle_pm_lock);
+#endif
+		break;
+		default:
+		break;
+	}
+	idle_state = state;
+	ESP_LOGI(TAG, "Display %s", idle_state_names[state]);
+}
+
+/**
+ * Starts in IDLE_ACTIVE and enables automatic light sleep, which is blocked until IDLE_SLEEP.
+ * Call after UI_init.
+ * @endcode
+ * \ingroup Idle
+ */
+void idle_init(void)
+{
+	memset(&idle_stats, 0, sizeof(idle_stats));
+	idle_state = IDLE_ACTIVE;
+	idle_last_activity_us = esp_timer_get_time();
+	idle_state_start_us = idle_last_activity_us;
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+	//no frequency scaling, the CPU only sleeps when no task is ready
+	esp_pm_config_esp32_t pm_config = {
+		.max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+		.min_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+		.light_sleep_enable = true,
+	};
+	esp_err_t ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "idle", &idle_pm_lock);
+	if(ret == ESP_OK) ret = esp_pm_lock_acquire(idle_pm_lock);
+	if(ret == ESP_OK) ret = esp_pm_configure(&pm_config);
+	if(ret != ESP_OK) ESP_LOGE(TAG, "Light sleep not enabled (%s)", esp_err_to_name(ret));
+#endif
+}
+
+/**
+ * Reports input, an alarm or a significant change of the output and returns to IDLE_ACTIVE.
+ * @return true if the display was off, the input that woke it should be dropped
+ * @endcode
+ * \ingroup Idle
+ */
+bool idle_activity(void)
+{
+	bool was_sleeping = (idle_state == IDLE_SLEEP);
+	idle_last_activity_us = esp_timer_get_time();
+	idle_enter(IDLE_ACTIVE);
+	return was_sleeping;
+}
+
+/**
+ * Enters IDLE_DIM and IDLE_SLEEP when their time without activity is over.
+ * Called by the Master_Task every frame.
+ * @endcode
+ * \ingroup Idle
+ */
+void idle_update(void)
+{
+	int requested = idle_requested;
+	if(requested >= 0)
+	{
+		idle_requested = -1;
+		if(requested == IDLE_ACTIVE) idle_activity();
+		else idle_enter((idle_state_t)requested);
+		return;
+	}
+	int64_t idle_us = esp_timer_get_time() - idle_last_activity_us;
+	if(CONFIG_PSU_IDLE_SLEEP_S > 0 && idle_us >= CONFIG_PSU_IDLE_SLEEP_S * 1000000LL)
+	{
+		idle_enter(IDLE_SLEEP);
+	}
+	else if(CONFIG_PSU_IDLE_DIM_S > 0 && idle_us >= CONFIG_PSU_IDLE_DIM_S * 1000000LL && idle_state == IDLE_ACTIVE)
+	{
+		idle_enter(IDLE_DIM);
+	}
+}
+
+/**
+ * Requests a state from another task, e.g. to measure the current draw of every state.
+ * The Master_Task applies it with the next frame.
+ * @param state requested state, IDLE_ACTIVE counts as activity
+ * @endcode
+ * \ingroup Idle
+ */
+void idle_request(idle_state_t state)
+{
+	if(state >= IDLE_STATE_COUNT) return;
+	idle_requested = state;
+	master_events_set(EVT_REFRESH);
+}
+
+/**
+ * @return current state
+ * @endcode
+ * \ingroup Idle
+ */
+idle_state_t idle_get_state(void)
+{
+	return idle_state;
+}
+
+/**
+ * @param state state
+ * @return name of the state
+ * @endcode
+ * \ingroup Idle
+ */
+const char *idle_get_state_name(idle_state_t state)
+{
+	return state < IDLE_STATE_COUNT ? idle_state_names[state] : "?";
+}
+
+/**
+ * Returns the time spent in every state including the current one and the wakes from IDLE_SLEEP.
+ * @param stats filled with the statistics
+ * @endcode
+ * \ingroup Idle
+ */
+void idle_get_stats(idle_stats_t *stats)
+{
+	*stats = idle_stats;
+	stats->time_us[idle_state] += esp_timer_get_time() - idle_state_start_us;
+}
@@ -0,0 +1,29 @@
+#ifndef MAIN_IDLE_H_
+#define MAIN_IDLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//power states of the display, entered after a time without activity
+typedef enum {
+	IDLE_ACTIVE,	//full brightness and refresh rate
+	IDLE_DIM,		//dimmed backlight, slow refresh
+	IDLE_SLEEP,		//display off, nothing drawn, light sleep
+	IDLE_STATE_COUNT,
+} idle_state_t;
+
+//time spent in every state and wakes from IDLE_SLEEP
+typedef struct {
+	int64_t time_us[IDLE_STATE_COUNT];
+	uint32_t wakes;
+} idle_stats_t;
+
+void idle_init(void);
+bool idle_activity(void);
+void idle_update(void);
+void idle_request(idle_state_t state);
+idle_state_t idle_get_state(void);
+const char *idle_get_state_name(idle_state_t state);
+void idle_get_stats(idle_stats_t *stats);
+
+#endif
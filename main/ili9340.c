@@ -6,9 +6,13 @@
 
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
+#include <driver/ledc.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 #include "ili9340.h"
+#include "metrics.h"
 
 #define TAG "ILI9340"
 #define	_DEBUG_ 0
@@ -23,6 +27,36 @@ static const int SPI_Data_Mode = 1;
 static const int SPI_Frequency = SPI_MASTER_FREQ_40M;
 ////static const int SPI_Frequency = SPI_MASTER_FREQ_80M;
 
+//backlight PWM, timer 0 and channel 0 drive the buzzer
+#define BL_LEDC_MODE		LEDC_LOW_SPEED_MODE
+#define BL_LEDC_TIMER		LEDC_TIMER_1
+#define BL_LEDC_CHANNEL		LEDC_CHANNEL_1
+#define BL_LEDC_RESOLUTION	LEDC_TIMER_10_BIT
+#define BL_LEDC_MAX_DUTY	((1 << BL_LEDC_RESOLUTION) - 1)
+#define BL_LEDC_FREQ_HZ		5000
+
+static void spi_master_pre_transfer(spi_transaction_t *t);
+
+// Adds the panel to the bus with the given clock
+static esp_err_t spi_master_add_device(TFT_t * dev, int clock_hz)
+{
+	spi_device_interface_config_t devcfg={
+		.clock_speed_hz = clock_hz,
+		.spics_io_num = dev->_cs,
+		.queue_size = SPI_QUEUE_SIZE,
+		.flags = SPI_DEVICE_NO_DUMMY,
+		.pre_cb = spi_master_pre_transfer,
+	};
+
+	spi_device_handle_t handle;
+	esp_err_t ret = spi_bus_add_device( HSPI_HOST, &devcfg, &handle);
+	ESP_LOGD(TAG, "spi_bus_add_device=%d",ret);
+	if (ret != ESP_OK) return ret;
+	dev->_SPIHandle = handle;
+	dev->_clock_hz = clock_hz;
+	return ESP_OK;
+}
+
 
 void spi_master_init(TFT_t * dev, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO_RESET, int16_t GPIO_BL)
 {
@@ -49,9 +83,24 @@ void spi_master_init(TFT_t * dev, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO
 
 	ESP_LOGI(TAG, "GPIO_BL=%d",GPIO_BL);
 	if ( GPIO_BL >= 0 ) {
-		gpio_pad_select_gpio( GPIO_BL );
-		gpio_set_direction( GPIO_BL, GPIO_MODE_OUTPUT );
-		gpio_set_level( GPIO_BL, 0 );
+		//PWM dimmable, off until lcdInit is done
+		ledc_timer_config_t bl_timer = {
+			.speed_mode = BL_LEDC_MODE,
+			.duty_resolution = BL_LEDC_RESOLUTION,
+			.timer_num = BL_LEDC_TIMER,
+			.freq_hz = BL_LEDC_FREQ_HZ,
+			.clk_cfg = LEDC_AUTO_CLK,
+		};
+		ledc_timer_config(&bl_timer);
+		ledc_channel_config_t bl_channel = {
+			.gpio_num = GPIO_BL,
+			.speed_mode = BL_LEDC_MODE,
+			.channel = BL_LEDC_CHANNEL,
+			.timer_sel = BL_LEDC_TIMER,
+			.duty = 0,
+			.hpoint = 0,
+		};
+		ledc_channel_config(&bl_channel);
 	}
 
 	spi_bus_config_t buscfg = {
@@ -59,121 +108,208 @@ void spi_master_init(TFT_t * dev, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO
 		.mosi_io_num = GPIO_MOSI,
 		.miso_io_num = -1,
 		.quadwp_io_num = -1,
-		.quadhd_io_num = -1
+		.quadhd_io_num = -1,
+		.max_transfer_sz = SPI_DMA_BUFFER_SIZE
 	};
 
 	ret = spi_bus_initialize( HSPI_HOST, &buscfg, 1 );
 	ESP_LOGD(TAG, "spi_bus_initialize=%d",ret);
 	assert(ret==ESP_OK);
 
-	spi_device_interface_config_t devcfg={
-		.clock_speed_hz = SPI_Frequency,
-		.spics_io_num = GPIO_CS,
-		.queue_size = 7,
-		.flags = SPI_DEVICE_NO_DUMMY,
-	};
-
-	spi_device_handle_t handle;
-	ret = spi_bus_add_device( HSPI_HOST, &devcfg, &handle);
-	ESP_LOGD(TAG, "spi_bus_add_device=%d",ret);
-	assert(ret==ESP_OK);
+	dev->_cs = GPIO_CS;
 	dev->_dc = GPIO_DC;
 	dev->_bl = GPIO_BL;
-	dev->_SPIHandle = handle;
+	dev->_dc_level = -1;
+	ret = spi_master_add_device(dev, SPI_Frequency);
+	assert(ret==ESP_OK);
+
+	dev->_trans_next = 0;
+	dev->_trans_queued = 0;
+	dev->_trans_done = 0;
+	dev->_dma_next = 0;
+	for(int i=0;i<SPI_DMA_BUFFERS;i++) {
+		dev->_dma_buffer[i] = heap_caps_malloc(SPI_DMA_BUFFER_SIZE, MALLOC_CAP_DMA);
+		assert(dev->_dma_buffer[i] != NULL);
+		dev->_dma_seq[i] = 0;
+	}
 }
 
+// DC pin and level of a transaction, kept in its user field
+#define SPI_USER(dev, mode) ((void *)(intptr_t)(((dev)->_dc << 1) | (mode)))
 
-bool spi_master_write_byte(spi_device_handle_t SPIHandle, const uint8_t* Data, size_t DataLength)
+// Sets DC right before the transaction goes out, so queued commands and data keep their level
+static void IRAM_ATTR spi_master_pre_transfer(spi_transaction_t *t)
 {
-	spi_transaction_t SPITransaction;
-	esp_err_t ret;
+	int user = (int)(intptr_t)t->user;
+	gpio_set_level( user >> 1, user & 1 );
+}
 
-	if ( DataLength > 0 ) {
-		memset( &SPITransaction, 0, sizeof( spi_transaction_t ) );
-		SPITransaction.length = DataLength * 8;
-		SPITransaction.tx_buffer = Data;
-#if 1
-		ret = spi_device_transmit( SPIHandle, &SPITransaction );
-#endif
-#if 0
-		ret = spi_device_polling_transmit( SPIHandle, &SPITransaction );
-#endif
-		assert(ret==ESP_OK); 
+// Fetches the result of the oldest queued transaction
+static void spi_master_wait_one(TFT_t * dev)
+{
+	spi_transaction_t *done;
+	int64_t start = esp_timer_get_time();
+	esp_err_t ret = spi_device_get_trans_result( dev->_SPIHandle, &done, portMAX_DELAY );
+	assert(ret==ESP_OK);
+	dev->_trans_done++;
+	metrics_counter_add(METRIC_SPI_LCD_BLOCKED_US, (uint32_t)(esp_timer_get_time() - start));
+}
+
+// Waits until all queued transactions are on the panel
+void spi_master_wait_all(TFT_t * dev)
+{
+	while(dev->_trans_done != dev->_trans_queued) {
+		spi_master_wait_one(dev);
+	}
+}
+
+// Queues a transaction behind the ones in flight, up to 4 bytes are copied into the transaction.
+// Longer data must stay valid until the transaction is done, see spi_master_get_buffer.
+static bool spi_master_queue(TFT_t * dev, int mode, const uint8_t* Data, size_t DataLength)
+{
+	if ( DataLength == 0 ) return true;
+	if (dev->_trans_queued - dev->_trans_done >= SPI_QUEUE_SIZE) {
+		spi_master_wait_one(dev);
+	}
+
+	spi_transaction_t *t = &dev->_trans[dev->_trans_next];
+	dev->_trans_next = (dev->_trans_next + 1) % SPI_QUEUE_SIZE;
+	memset( t, 0, sizeof( spi_transaction_t ) );
+	t->length = DataLength * 8;
+	t->user = SPI_USER(dev, mode);
+	if (DataLength <= sizeof(t->tx_data)) {
+		t->flags = SPI_TRANS_USE_TXDATA;
+		memcpy( t->tx_data, Data, DataLength );
+	} else {
+		t->tx_buffer = Data;
+	}
+	esp_err_t ret = spi_device_queue_trans( dev->_SPIHandle, t, portMAX_DELAY );
+	assert(ret==ESP_OK);
+	dev->_trans_queued++;
+	metrics_counter_add(METRIC_SPI_LCD_TRANSACTIONS, 1);
+	metrics_counter_add(METRIC_SPI_LCD_BYTES, DataLength);
+	if (mode != dev->_dc_level) {
+		metrics_counter_add(METRIC_SPI_LCD_DC_TOGGLES, 1);
+		dev->_dc_level = mode;
+	}
+	return true;
+}
+
+// Current SPI clock of the panel in Hz
+int spi_master_get_clock(TFT_t * dev)
+{
+	return dev->_clock_hz;
+}
+
+// Changes the SPI clock of the panel, e.g. SPI_MASTER_FREQ_26M. Waits for the queued transactions
+// and adds the panel again, on failure it keeps the old clock and returns false.
+bool spi_master_set_clock(TFT_t * dev, int clock_hz)
+{
+	if (clock_hz == dev->_clock_hz) return true;
+	spi_master_wait_all(dev);
+	int old_hz = dev->_clock_hz;
+	esp_err_t ret = spi_bus_remove_device(dev->_SPIHandle);
+	if (ret != ESP_OK) return false;
+	ret = spi_master_add_device(dev, clock_hz);
+	if (ret != ESP_OK) {
+		ESP_LOGW(TAG, "SPI clock %d Hz not accepted (%s)", clock_hz, esp_err_to_name(ret));
+		ret = spi_master_add_device(dev, old_hz);
+		assert(ret==ESP_OK);
+		return false;
+	}
+	return true;
+}
+
+// Next DMA buffer, waits until the transaction that last used it is done
+static uint8_t *spi_master_get_buffer(TFT_t * dev)
+{
+	int i = dev->_dma_next;
+	while((int32_t)(dev->_trans_done - dev->_dma_seq[i]) < 0) {
+		spi_master_wait_one(dev);
 	}
+	return dev->_dma_buffer[i];
+}
 
+// Queues the buffer of spi_master_get_buffer as pixel data
+static bool spi_master_queue_buffer(TFT_t * dev, size_t DataLength)
+{
+	int i = dev->_dma_next;
+	spi_master_queue(dev, SPI_Data_Mode, dev->_dma_buffer[i], DataLength);
+	dev->_dma_seq[i] = dev->_trans_queued;
+	dev->_dma_next = (i + 1) % SPI_DMA_BUFFERS;
 	return true;
 }
 
 bool spi_master_write_comm_byte(TFT_t * dev, uint8_t cmd)
 {
-	static uint8_t Byte = 0;
-	Byte = cmd;
-	gpio_set_level( dev->_dc, SPI_Command_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, &Byte, 1 );
+	return spi_master_queue( dev, SPI_Command_Mode, &cmd, 1 );
 }
 
 bool spi_master_write_comm_word(TFT_t * dev, uint16_t cmd)
 {
-	static uint8_t Byte[2];
+	uint8_t Byte[2];
 	Byte[0] = (cmd >> 8) & 0xFF;
 	Byte[1] = cmd & 0xFF;
-	gpio_set_level( dev->_dc, SPI_Command_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, Byte, 2 );
+	return spi_master_queue( dev, SPI_Command_Mode, Byte, 2 );
 }
 
 
 bool spi_master_write_data_byte(TFT_t * dev, uint8_t data)
 {
-	static uint8_t Byte = 0;
-	Byte = data;
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, &Byte, 1 );
+	return spi_master_queue( dev, SPI_Data_Mode, &data, 1 );
 }
 
 
 bool spi_master_write_data_word(TFT_t * dev, uint16_t data)
 {
-	static uint8_t Byte[2];
+	uint8_t Byte[2];
 	Byte[0] = (data >> 8) & 0xFF;
 	Byte[1] = data & 0xFF;
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, Byte, 2);
+	return spi_master_queue( dev, SPI_Data_Mode, Byte, 2 );
 }
 
 bool spi_master_write_addr(TFT_t * dev, uint16_t addr1, uint16_t addr2)
 {
-	static uint8_t Byte[4];
+	uint8_t Byte[4];
 	Byte[0] = (addr1 >> 8) & 0xFF;
 	Byte[1] = addr1 & 0xFF;
 	Byte[2] = (addr2 >> 8) & 0xFF;
 	Byte[3] = addr2 & 0xFF;
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, Byte, 4);
+	return spi_master_queue( dev, SPI_Data_Mode, Byte, 4 );
 }
 
 bool spi_master_write_color(TFT_t * dev, uint16_t color, uint16_t size)
 {
-	static uint8_t Byte[1024];
-	int index = 0;
-	for(int i=0;i<size;i++) {
-		Byte[index++] = (color >> 8) & 0xFF;
-		Byte[index++] = color & 0xFF;
+	while(size > 0) {
+		uint16_t count = size < SPI_DMA_BUFFER_SIZE / 2 ? size : SPI_DMA_BUFFER_SIZE / 2;
+		uint8_t *Byte = spi_master_get_buffer(dev);
+		int index = 0;
+		for(int i=0;i<count;i++) {
+			Byte[index++] = (color >> 8) & 0xFF;
+			Byte[index++] = color & 0xFF;
+		}
+		spi_master_queue_buffer(dev, count*2);
+		size -= count;
 	}
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, Byte, size*2);
+	return true;
 }
 
 // Add 202001
 bool spi_master_write_colors(TFT_t * dev, uint16_t * colors, uint16_t size)
 {
-	static uint8_t Byte[1024];
-	int index = 0;
-	for(int i=0;i<size;i++) {
-		Byte[index++] = (colors[i] >> 8) & 0xFF;
-		Byte[index++] = colors[i] & 0xFF;
+	while(size > 0) {
+		uint16_t count = size < SPI_DMA_BUFFER_SIZE / 2 ? size : SPI_DMA_BUFFER_SIZE / 2;
+		uint8_t *Byte = spi_master_get_buffer(dev);
+		int index = 0;
+		for(int i=0;i<count;i++) {
+			Byte[index++] = (colors[i] >> 8) & 0xFF;
+			Byte[index++] = colors[i] & 0xFF;
+		}
+		spi_master_queue_buffer(dev, count*2);
+		colors += count;
+		size -= count;
 	}
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_byte( dev->_SPIHandle, Byte, size*2);
+	return true;
 }
 
 
@@ -200,9 +336,9 @@ void lcdWriteRegisterByte(TFT_t * dev, uint8_t addr, uint16_t data)
 
 
 
-void lcdInit(TFT_t * dev, uint16_t model, int width, int height, int offsetx, int offsety)
+void lcdInit(TFT_t * dev, int width, int height, int offsetx, int offsety)
 {
-	dev->_model = model;
+	dev->_model = LCD_MODEL;
 	dev->_width = width;
 	dev->_height = height;
 	dev->_offsetx = offsetx;
@@ -211,259 +347,244 @@ void lcdInit(TFT_t * dev, uint16_t model, int width, int height, int offsetx, in
 	dev->_font_fill = false;
 	dev->_font_underline = false;
 
-	if (dev->_model == 0x7796) {
-		ESP_LOGI(TAG,"Your TFT is ST7796");
-		ESP_LOGI(TAG,"Screen width:%d",width);
-		ESP_LOGI(TAG,"Screen height:%d",height);
-		spi_master_write_comm_byte(dev, 0xC0);	//Power Control 1
-		spi_master_write_data_byte(dev, 0x10);
-		spi_master_write_data_byte(dev, 0x10);
+	ESP_LOGI(TAG,"Your TFT is %s",LCD_MODEL_NAME);
+	ESP_LOGI(TAG,"Screen width:%d",width);
+	ESP_LOGI(TAG,"Screen height:%d",height);
 
-		spi_master_write_comm_byte(dev, 0xC1);	//Power Control 2
-		spi_master_write_data_byte(dev, 0x41);
+#if LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0xC0);	//Power Control 1
+	spi_master_write_data_byte(dev, 0x10);
+	spi_master_write_data_byte(dev, 0x10);
+
+	spi_master_write_comm_byte(dev, 0xC1);	//Power Control 2
+	spi_master_write_data_byte(dev, 0x41);
 	
-		spi_master_write_comm_byte(dev, 0xC5);	//VCOM Control 1
-		spi_master_write_data_byte(dev, 0x00);
-		spi_master_write_data_byte(dev, 0x22);
-		spi_master_write_data_byte(dev, 0x80);
-		spi_master_write_data_byte(dev, 0x40);
-
-		spi_master_write_comm_byte(dev, 0x36);	//Memory Access Control
-		spi_master_write_data_byte(dev, 0x48);	//Right top start, BGR color filter panel
-		//spi_master_write_data_byte(dev, 0x68);	//Right top start, BGR color filter panel
-
-		spi_master_write_comm_byte(dev, 0xB0);	//Interface Mode Control
-		spi_master_write_data_byte(dev, 0x00);
-
-		spi_master_write_comm_byte(dev, 0xB1);	//Frame Rate Control
-		spi_master_write_data_byte(dev, 0xB0);
-		spi_master_write_data_byte(dev, 0x11);
-
-		spi_master_write_comm_byte(dev, 0xB4);	//Display Inversion Control
-		spi_master_write_data_byte(dev, 0x02);
-
-		spi_master_write_comm_byte(dev, 0xB6);	//Display Function Control
-		spi_master_write_data_byte(dev, 0x02);
-		spi_master_write_data_byte(dev, 0x02);
-		spi_master_write_data_byte(dev, 0x3B);
-
-		spi_master_write_comm_byte(dev, 0xB7);	//Entry Mode Set
-		spi_master_write_data_byte(dev, 0xC6);
-
-		spi_master_write_comm_byte(dev, 0x3A);	//Interface Pixel Format
-		spi_master_write_data_byte(dev, 0x55);
-
-		spi_master_write_comm_byte(dev, 0xF7);	//Adjust Control 3
-		spi_master_write_data_byte(dev, 0xA9);
-		spi_master_write_data_byte(dev, 0x51);
-		spi_master_write_data_byte(dev, 0x2C);
-		spi_master_write_data_byte(dev, 0x82);
-
-		spi_master_write_comm_byte(dev, 0x11);	//Sleep Out
-		delayMS(120);
-
-		spi_master_write_comm_byte(dev, 0x29);	//Display ON
-	} // endif 0x7796
-
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7735) {
-		if (dev->_model == 0x9340)
-			ESP_LOGI(TAG,"Your TFT is ILI9340");
-		if (dev->_model == 0x9341)
-			ESP_LOGI(TAG,"Your TFT is ILI9341");
-		if (dev->_model == 0x7735)
-			ESP_LOGI(TAG,"Your TFT is ST7735");
-		ESP_LOGI(TAG,"Screen width:%d",width);
-		ESP_LOGI(TAG,"Screen height:%d",height);
-		spi_master_write_comm_byte(dev, 0xC0);	//Power Control 1
-		spi_master_write_data_byte(dev, 0x23);
-
-		spi_master_write_comm_byte(dev, 0xC1);	//Power Control 2
-		spi_master_write_data_byte(dev, 0x10);
+	spi_master_write_comm_byte(dev, 0xC5);	//VCOM Control 1
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x22);
+	spi_master_write_data_byte(dev, 0x80);
+	spi_master_write_data_byte(dev, 0x40);
+
+	spi_master_write_comm_byte(dev, 0x36);	//Memory Access Control
+	spi_master_write_data_byte(dev, 0x48);	//Right top start, BGR color filter panel
+	//spi_master_write_data_byte(dev, 0x68);	//Right top start, BGR color filter panel
+
+	spi_master_write_comm_byte(dev, 0xB0);	//Interface Mode Control
+	spi_master_write_data_byte(dev, 0x00);
+
+	spi_master_write_comm_byte(dev, 0xB1);	//Frame Rate Control
+	spi_master_write_data_byte(dev, 0xB0);
+	spi_master_write_data_byte(dev, 0x11);
+
+	spi_master_write_comm_byte(dev, 0xB4);	//Display Inversion Control
+	spi_master_write_data_byte(dev, 0x02);
+
+	spi_master_write_comm_byte(dev, 0xB6);	//Display Function Control
+	spi_master_write_data_byte(dev, 0x02);
+	spi_master_write_data_byte(dev, 0x02);
+	spi_master_write_data_byte(dev, 0x3B);
+
+	spi_master_write_comm_byte(dev, 0xB7);	//Entry Mode Set
+	spi_master_write_data_byte(dev, 0xC6);
+
+	spi_master_write_comm_byte(dev, 0x3A);	//Interface Pixel Format
+	spi_master_write_data_byte(dev, 0x55);
+
+	spi_master_write_comm_byte(dev, 0xF7);	//Adjust Control 3
+	spi_master_write_data_byte(dev, 0xA9);
+	spi_master_write_data_byte(dev, 0x51);
+	spi_master_write_data_byte(dev, 0x2C);
+	spi_master_write_data_byte(dev, 0x82);
+
+	spi_master_write_comm_byte(dev, 0x11);	//Sleep Out
+	delayMS(120);
+
+	spi_master_write_comm_byte(dev, 0x29);	//Display ON
+#endif // 0x7796
+
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735
+	spi_master_write_comm_byte(dev, 0xC0);	//Power Control 1
+	spi_master_write_data_byte(dev, 0x23);
+
+	spi_master_write_comm_byte(dev, 0xC1);	//Power Control 2
+	spi_master_write_data_byte(dev, 0x10);
 	
-		spi_master_write_comm_byte(dev, 0xC5);	//VCOM Control 1
-		spi_master_write_data_byte(dev, 0x3E);
-		spi_master_write_data_byte(dev, 0x28);
+	spi_master_write_comm_byte(dev, 0xC5);	//VCOM Control 1
+	spi_master_write_data_byte(dev, 0x3E);
+	spi_master_write_data_byte(dev, 0x28);
 	
-		spi_master_write_comm_byte(dev, 0xC7);	//VCOM Control 2
-		spi_master_write_data_byte(dev, 0x86);
-
-		spi_master_write_comm_byte(dev, 0x36);	//Memory Access Control
-		spi_master_write_data_byte(dev, 0x08);	//Right top start, BGR color filter panel
-		//spi_master_write_data_byte(dev, 0x00);//Right top start, RGB color filter panel
-
-		spi_master_write_comm_byte(dev, 0x3A);	//Pixel Format Set
-		spi_master_write_data_byte(dev, 0x55);	//65K color: 16-bit/pixel
-
-		spi_master_write_comm_byte(dev, 0x20);	//Display Inversion OFF
-
-		spi_master_write_comm_byte(dev, 0xB1);	//Frame Rate Control
-		spi_master_write_data_byte(dev, 0x00);
-		spi_master_write_data_byte(dev, 0x18);
-
-		spi_master_write_comm_byte(dev, 0xB6);	//Display Function Control
-		spi_master_write_data_byte(dev, 0x08);
-		spi_master_write_data_byte(dev, 0xA2);	// REV:1 GS:0 SS:0 SM:0
-		spi_master_write_data_byte(dev, 0x27);
-		spi_master_write_data_byte(dev, 0x00);
-
-		spi_master_write_comm_byte(dev, 0x26);	//Gamma Set
-		spi_master_write_data_byte(dev, 0x01);
-
-		spi_master_write_comm_byte(dev, 0xE0);	//Positive Gamma Correction
-		spi_master_write_data_byte(dev, 0x0F);
-		spi_master_write_data_byte(dev, 0x31);
-		spi_master_write_data_byte(dev, 0x2B);
-		spi_master_write_data_byte(dev, 0x0C);
-		spi_master_write_data_byte(dev, 0x0E);
-		spi_master_write_data_byte(dev, 0x08);
-		spi_master_write_data_byte(dev, 0x4E);
-		spi_master_write_data_byte(dev, 0xF1);
-		spi_master_write_data_byte(dev, 0x37);
-		spi_master_write_data_byte(dev, 0x07);
-		spi_master_write_data_byte(dev, 0x10);
-		spi_master_write_data_byte(dev, 0x03);
-		spi_master_write_data_byte(dev, 0x0E);
-		spi_master_write_data_byte(dev, 0x09);
-		spi_master_write_data_byte(dev, 0x00);
-
-		spi_master_write_comm_byte(dev, 0xE1);	//Negative Gamma Correction
-		spi_master_write_data_byte(dev, 0x00);
-		spi_master_write_data_byte(dev, 0x0E);
-		spi_master_write_data_byte(dev, 0x14);
-		spi_master_write_data_byte(dev, 0x03);
-		spi_master_write_data_byte(dev, 0x11);
-		spi_master_write_data_byte(dev, 0x07);
-		spi_master_write_data_byte(dev, 0x31);
-		spi_master_write_data_byte(dev, 0xC1);
-		spi_master_write_data_byte(dev, 0x48);
-		spi_master_write_data_byte(dev, 0x08);
-		spi_master_write_data_byte(dev, 0x0F);
-		spi_master_write_data_byte(dev, 0x0C);
-		spi_master_write_data_byte(dev, 0x31);
-		spi_master_write_data_byte(dev, 0x36);
-		spi_master_write_data_byte(dev, 0x0F);
-
-		spi_master_write_comm_byte(dev, 0x11);	//Sleep Out
-		delayMS(120);
-
-		spi_master_write_comm_byte(dev, 0x29);	//Display ON
-	} // endif 0x9340/0x9341/0x7735
-
-	if (dev->_model == 0x9225) {
-		ESP_LOGI(TAG,"Your TFT is ILI9225");
-		ESP_LOGI(TAG,"Screen width:%d",width);
-		ESP_LOGI(TAG,"Screen height:%d",height);
-		lcdWriteRegisterByte(dev, 0x10, 0x0000); // Set SAP,DSTB,STB
-		lcdWriteRegisterByte(dev, 0x11, 0x0000); // Set APON,PON,AON,VCI1EN,VC
-		lcdWriteRegisterByte(dev, 0x12, 0x0000); // Set BT,DC1,DC2,DC3
-		lcdWriteRegisterByte(dev, 0x13, 0x0000); // Set GVDD
-		lcdWriteRegisterByte(dev, 0x14, 0x0000); // Set VCOMH/VCOML voltage
-		delayMS(40);
-
-		// Power-on sequence
-		lcdWriteRegisterByte(dev, 0x11, 0x0018); // Set APON,PON,AON,VCI1EN,VC
-		lcdWriteRegisterByte(dev, 0x12, 0x6121); // Set BT,DC1,DC2,DC3
-		lcdWriteRegisterByte(dev, 0x13, 0x006F); // Set GVDD
-		lcdWriteRegisterByte(dev, 0x14, 0x495F); // Set VCOMH/VCOML voltage
-		lcdWriteRegisterByte(dev, 0x10, 0x0800); // Set SAP,DSTB,STB
-		delayMS(10);
-		lcdWriteRegisterByte(dev, 0x11, 0x103B); // Set APON,PON,AON,VCI1EN,VC
-		delayMS(50);
-
-		lcdWriteRegisterByte(dev, 0x01, 0x011C); // set the display line number and display direction
-		lcdWriteRegisterByte(dev, 0x02, 0x0100); // set 1 line inversion
-		lcdWriteRegisterByte(dev, 0x03, 0x1030); // set GRAM write direction and BGR=1.
-		lcdWriteRegisterByte(dev, 0x07, 0x0000); // Display off
-		lcdWriteRegisterByte(dev, 0x08, 0x0808); // set the back porch and front porch
-		lcdWriteRegisterByte(dev, 0x0B, 0x1100); // set the clocks number per line
-		lcdWriteRegisterByte(dev, 0x0C, 0x0000); // CPU interface
-		//lcdWriteRegisterByte(dev, 0x0F, 0x0D01); // Set Osc
-		lcdWriteRegisterByte(dev, 0x0F, 0x0801); // Set Osc
-		lcdWriteRegisterByte(dev, 0x15, 0x0020); // Set VCI recycling
-		lcdWriteRegisterByte(dev, 0x20, 0x0000); // RAM Address
-		lcdWriteRegisterByte(dev, 0x21, 0x0000); // RAM Address
-
-		// Set GRAM area
-		lcdWriteRegisterByte(dev, 0x30, 0x0000);
-		lcdWriteRegisterByte(dev, 0x31, 0x00DB);
-		lcdWriteRegisterByte(dev, 0x32, 0x0000);
-		lcdWriteRegisterByte(dev, 0x33, 0x0000);
-		lcdWriteRegisterByte(dev, 0x34, 0x00DB);
-		lcdWriteRegisterByte(dev, 0x35, 0x0000);
-		lcdWriteRegisterByte(dev, 0x36, 0x00AF);
-		lcdWriteRegisterByte(dev, 0x37, 0x0000);
-		lcdWriteRegisterByte(dev, 0x38, 0x00DB);
-		lcdWriteRegisterByte(dev, 0x39, 0x0000);
-
-		// Adjust GAMMA Curve
-		lcdWriteRegisterByte(dev, 0x50, 0x0000);
-		lcdWriteRegisterByte(dev, 0x51, 0x0808);
-		lcdWriteRegisterByte(dev, 0x52, 0x080A);
-		lcdWriteRegisterByte(dev, 0x53, 0x000A);
-		lcdWriteRegisterByte(dev, 0x54, 0x0A08);
-		lcdWriteRegisterByte(dev, 0x55, 0x0808);
-		lcdWriteRegisterByte(dev, 0x56, 0x0000);
-		lcdWriteRegisterByte(dev, 0x57, 0x0A00);
-		lcdWriteRegisterByte(dev, 0x58, 0x0710);
-		lcdWriteRegisterByte(dev, 0x59, 0x0710);
-
-		lcdWriteRegisterByte(dev, 0x07, 0x0012);
-		delayMS(50); // Delay 50ms
-		lcdWriteRegisterByte(dev, 0x07, 0x1017);
-	} // endif 0x9225
-
-	if (dev->_model == 0x9226) {
-		ESP_LOGI(TAG,"Your TFT is ILI9225G");
-		ESP_LOGI(TAG,"Screen width:%d",width);
-		ESP_LOGI(TAG,"Screen height:%d",height);
-		//lcdWriteRegisterByte(dev, 0x01, 0x011c);
-		lcdWriteRegisterByte(dev, 0x01, 0x021c);
-		lcdWriteRegisterByte(dev, 0x02, 0x0100);
-		lcdWriteRegisterByte(dev, 0x03, 0x1030);
-		lcdWriteRegisterByte(dev, 0x08, 0x0808); // set BP and FP
-		lcdWriteRegisterByte(dev, 0x0B, 0x1100); // frame cycle
-		lcdWriteRegisterByte(dev, 0x0C, 0x0000); // RGB interface setting R0Ch=0x0110 for RGB 18Bit and R0Ch=0111for RGB16Bit
-		lcdWriteRegisterByte(dev, 0x0F, 0x1401); // Set frame rate----0801
-		lcdWriteRegisterByte(dev, 0x15, 0x0000); // set system interface
-		lcdWriteRegisterByte(dev, 0x20, 0x0000); // Set GRAM Address
-		lcdWriteRegisterByte(dev, 0x21, 0x0000); // Set GRAM Address
-		//*************Power On sequence ****************//
-		delayMS(50);
-		lcdWriteRegisterByte(dev, 0x10, 0x0800); // Set SAP,DSTB,STB----0A00
-		lcdWriteRegisterByte(dev, 0x11, 0x1F3F); // Set APON,PON,AON,VCI1EN,VC----1038
-		delayMS(50);
-		lcdWriteRegisterByte(dev, 0x12, 0x0121); // Internal reference voltage= Vci;----1121
-		lcdWriteRegisterByte(dev, 0x13, 0x006F); // Set GVDD----0066
-		lcdWriteRegisterByte(dev, 0x14, 0x4349); // Set VCOMH/VCOML voltage----5F60
-		//-------------- Set GRAM area -----------------//
-		lcdWriteRegisterByte(dev, 0x30, 0x0000);
-		lcdWriteRegisterByte(dev, 0x31, 0x00DB);
-		lcdWriteRegisterByte(dev, 0x32, 0x0000);
-		lcdWriteRegisterByte(dev, 0x33, 0x0000);
-		lcdWriteRegisterByte(dev, 0x34, 0x00DB);
-		lcdWriteRegisterByte(dev, 0x35, 0x0000);
-		lcdWriteRegisterByte(dev, 0x36, 0x00AF);
-		lcdWriteRegisterByte(dev, 0x37, 0x0000);
-		lcdWriteRegisterByte(dev, 0x38, 0x00DB);
-		lcdWriteRegisterByte(dev, 0x39, 0x0000);
-		// ----------- Adjust the Gamma Curve ----------//
-		lcdWriteRegisterByte(dev, 0x50, 0x0001);
-		lcdWriteRegisterByte(dev, 0x51, 0x200B);
-		lcdWriteRegisterByte(dev, 0x52, 0x0000);
-		lcdWriteRegisterByte(dev, 0x53, 0x0404);
-		lcdWriteRegisterByte(dev, 0x54, 0x0C0C);
-		lcdWriteRegisterByte(dev, 0x55, 0x000C);
-		lcdWriteRegisterByte(dev, 0x56, 0x0101);
-		lcdWriteRegisterByte(dev, 0x57, 0x0400);
-		lcdWriteRegisterByte(dev, 0x58, 0x1108);
-		lcdWriteRegisterByte(dev, 0x59, 0x050C);
-		delayMS(50);
-		lcdWriteRegisterByte(dev, 0x07,0x1017);
-	} // endif 0x9226
-
-	if(dev->_bl >= 0) {
-		gpio_set_level( dev->_bl, 1 );
-	}
+	spi_master_write_comm_byte(dev, 0xC7);	//VCOM Control 2
+	spi_master_write_data_byte(dev, 0x86);
+
+	spi_master_write_comm_byte(dev, 0x36);	//Memory Access Control
+	spi_master_write_data_byte(dev, 0x08);	//Right top start, BGR color filter panel
+	//spi_master_write_data_byte(dev, 0x00);//Right top start, RGB color filter panel
+
+	spi_master_write_comm_byte(dev, 0x3A);	//Pixel Format Set
+	spi_master_write_data_byte(dev, 0x55);	//65K color: 16-bit/pixel
+
+	spi_master_write_comm_byte(dev, 0x20);	//Display Inversion OFF
+
+	spi_master_write_comm_byte(dev, 0xB1);	//Frame Rate Control
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x18);
+
+	spi_master_write_comm_byte(dev, 0xB6);	//Display Function Control
+	spi_master_write_data_byte(dev, 0x08);
+	spi_master_write_data_byte(dev, 0xA2);	// REV:1 GS:0 SS:0 SM:0
+	spi_master_write_data_byte(dev, 0x27);
+	spi_master_write_data_byte(dev, 0x00);
+
+	spi_master_write_comm_byte(dev, 0x26);	//Gamma Set
+	spi_master_write_data_byte(dev, 0x01);
+
+	spi_master_write_comm_byte(dev, 0xE0);	//Positive Gamma Correction
+	spi_master_write_data_byte(dev, 0x0F);
+	spi_master_write_data_byte(dev, 0x31);
+	spi_master_write_data_byte(dev, 0x2B);
+	spi_master_write_data_byte(dev, 0x0C);
+	spi_master_write_data_byte(dev, 0x0E);
+	spi_master_write_data_byte(dev, 0x08);
+	spi_master_write_data_byte(dev, 0x4E);
+	spi_master_write_data_byte(dev, 0xF1);
+	spi_master_write_data_byte(dev, 0x37);
+	spi_master_write_data_byte(dev, 0x07);
+	spi_master_write_data_byte(dev, 0x10);
+	spi_master_write_data_byte(dev, 0x03);
+	spi_master_write_data_byte(dev, 0x0E);
+	spi_master_write_data_byte(dev, 0x09);
+	spi_master_write_data_byte(dev, 0x00);
+
+	spi_master_write_comm_byte(dev, 0xE1);	//Negative Gamma Correction
+	spi_master_write_data_byte(dev, 0x00);
+	spi_master_write_data_byte(dev, 0x0E);
+	spi_master_write_data_byte(dev, 0x14);
+	spi_master_write_data_byte(dev, 0x03);
+	spi_master_write_data_byte(dev, 0x11);
+	spi_master_write_data_byte(dev, 0x07);
+	spi_master_write_data_byte(dev, 0x31);
+	spi_master_write_data_byte(dev, 0xC1);
+	spi_master_write_data_byte(dev, 0x48);
+	spi_master_write_data_byte(dev, 0x08);
+	spi_master_write_data_byte(dev, 0x0F);
+	spi_master_write_data_byte(dev, 0x0C);
+	spi_master_write_data_byte(dev, 0x31);
+	spi_master_write_data_byte(dev, 0x36);
+	spi_master_write_data_byte(dev, 0x0F);
+
+	spi_master_write_comm_byte(dev, 0x11);	//Sleep Out
+	delayMS(120);
+
+	spi_master_write_comm_byte(dev, 0x29);	//Display ON
+#endif // 0x9340/0x9341/0x7735
+
+#if LCD_MODEL == 0x9225
+	lcdWriteRegisterByte(dev, 0x10, 0x0000); // Set SAP,DSTB,STB
+	lcdWriteRegisterByte(dev, 0x11, 0x0000); // Set APON,PON,AON,VCI1EN,VC
+	lcdWriteRegisterByte(dev, 0x12, 0x0000); // Set BT,DC1,DC2,DC3
+	lcdWriteRegisterByte(dev, 0x13, 0x0000); // Set GVDD
+	lcdWriteRegisterByte(dev, 0x14, 0x0000); // Set VCOMH/VCOML voltage
+	delayMS(40);
+
+	// Power-on sequence
+	lcdWriteRegisterByte(dev, 0x11, 0x0018); // Set APON,PON,AON,VCI1EN,VC
+	lcdWriteRegisterByte(dev, 0x12, 0x6121); // Set BT,DC1,DC2,DC3
+	lcdWriteRegisterByte(dev, 0x13, 0x006F); // Set GVDD
+	lcdWriteRegisterByte(dev, 0x14, 0x495F); // Set VCOMH/VCOML voltage
+	lcdWriteRegisterByte(dev, 0x10, 0x0800); // Set SAP,DSTB,STB
+	delayMS(10);
+	lcdWriteRegisterByte(dev, 0x11, 0x103B); // Set APON,PON,AON,VCI1EN,VC
+	delayMS(50);
+
+	lcdWriteRegisterByte(dev, 0x01, 0x011C); // set the display line number and display direction
+	lcdWriteRegisterByte(dev, 0x02, 0x0100); // set 1 line inversion
+	lcdWriteRegisterByte(dev, 0x03, 0x1030); // set GRAM write direction and BGR=1.
+	lcdWriteRegisterByte(dev, 0x07, 0x0000); // Display off
+	lcdWriteRegisterByte(dev, 0x08, 0x0808); // set the back porch and front porch
+	lcdWriteRegisterByte(dev, 0x0B, 0x1100); // set the clocks number per line
+	lcdWriteRegisterByte(dev, 0x0C, 0x0000); // CPU interface
+	//lcdWriteRegisterByte(dev, 0x0F, 0x0D01); // Set Osc
+	lcdWriteRegisterByte(dev, 0x0F, 0x0801); // Set Osc
+	lcdWriteRegisterByte(dev, 0x15, 0x0020); // Set VCI recycling
+	lcdWriteRegisterByte(dev, 0x20, 0x0000); // RAM Address
+	lcdWriteRegisterByte(dev, 0x21, 0x0000); // RAM Address
+
+	// Set GRAM area
+	lcdWriteRegisterByte(dev, 0x30, 0x0000);
+	lcdWriteRegisterByte(dev, 0x31, 0x00DB);
+	lcdWriteRegisterByte(dev, 0x32, 0x0000);
+	lcdWriteRegisterByte(dev, 0x33, 0x0000);
+	lcdWriteRegisterByte(dev, 0x34, 0x00DB);
+	lcdWriteRegisterByte(dev, 0x35, 0x0000);
+	lcdWriteRegisterByte(dev, 0x36, 0x00AF);
+	lcdWriteRegisterByte(dev, 0x37, 0x0000);
+	lcdWriteRegisterByte(dev, 0x38, 0x00DB);
+	lcdWriteRegisterByte(dev, 0x39, 0x0000);
+
+	// Adjust GAMMA Curve
+	lcdWriteRegisterByte(dev, 0x50, 0x0000);
+	lcdWriteRegisterByte(dev, 0x51, 0x0808);
+	lcdWriteRegisterByte(dev, 0x52, 0x080A);
+	lcdWriteRegisterByte(dev, 0x53, 0x000A);
+	lcdWriteRegisterByte(dev, 0x54, 0x0A08);
+	lcdWriteRegisterByte(dev, 0x55, 0x0808);
+	lcdWriteRegisterByte(dev, 0x56, 0x0000);
+	lcdWriteRegisterByte(dev, 0x57, 0x0A00);
+	lcdWriteRegisterByte(dev, 0x58, 0x0710);
+	lcdWriteRegisterByte(dev, 0x59, 0x0710);
+
+	lcdWriteRegisterByte(dev, 0x07, 0x0012);
+	delayMS(50); // Delay 50ms
+	lcdWriteRegisterByte(dev, 0x07, 0x1017);
+#endif // 0x9225
+
+#if LCD_MODEL == 0x9226
+	//lcdWriteRegisterByte(dev, 0x01, 0x011c);
+	lcdWriteRegisterByte(dev, 0x01, 0x021c);
+	lcdWriteRegisterByte(dev, 0x02, 0x0100);
+	lcdWriteRegisterByte(dev, 0x03, 0x1030);
+	lcdWriteRegisterByte(dev, 0x08, 0x0808); // set BP and FP
+	lcdWriteRegisterByte(dev, 0x0B, 0x1100); // frame cycle
+	lcdWriteRegisterByte(dev, 0x0C, 0x0000); // RGB interface setting R0Ch=0x0110 for RGB 18Bit and R0Ch=0111for RGB16Bit
+	lcdWriteRegisterByte(dev, 0x0F, 0x1401); // Set frame rate----0801
+	lcdWriteRegisterByte(dev, 0x15, 0x0000); // set system interface
+	lcdWriteRegisterByte(dev, 0x20, 0x0000); // Set GRAM Address
+	lcdWriteRegisterByte(dev, 0x21, 0x0000); // Set GRAM Address
+	//*************Power On sequence ****************//
+	delayMS(50);
+	lcdWriteRegisterByte(dev, 0x10, 0x0800); // Set SAP,DSTB,STB----0A00
+	lcdWriteRegisterByte(dev, 0x11, 0x1F3F); // Set APON,PON,AON,VCI1EN,VC----1038
+	delayMS(50);
+	lcdWriteRegisterByte(dev, 0x12, 0x0121); // Internal reference voltage= Vci;----1121
+	lcdWriteRegisterByte(dev, 0x13, 0x006F); // Set GVDD----0066
+	lcdWriteRegisterByte(dev, 0x14, 0x4349); // Set VCOMH/VCOML voltage----5F60
+	//-------------- Set GRAM area -----------------//
+	lcdWriteRegisterByte(dev, 0x30, 0x0000);
+	lcdWriteRegisterByte(dev, 0x31, 0x00DB);
+	lcdWriteRegisterByte(dev, 0x32, 0x0000);
+	lcdWriteRegisterByte(dev, 0x33, 0x0000);
+	lcdWriteRegisterByte(dev, 0x34, 0x00DB);
+	lcdWriteRegisterByte(dev, 0x35, 0x0000);
+	lcdWriteRegisterByte(dev, 0x36, 0x00AF);
+	lcdWriteRegisterByte(dev, 0x37, 0x0000);
+	lcdWriteRegisterByte(dev, 0x38, 0x00DB);
+	lcdWriteRegisterByte(dev, 0x39, 0x0000);
+	// ----------- Adjust the Gamma Curve ----------//
+	lcdWriteRegisterByte(dev, 0x50, 0x0001);
+	lcdWriteRegisterByte(dev, 0x51, 0x200B);
+	lcdWriteRegisterByte(dev, 0x52, 0x0000);
+	lcdWriteRegisterByte(dev, 0x53, 0x0404);
+	lcdWriteRegisterByte(dev, 0x54, 0x0C0C);
+	lcdWriteRegisterByte(dev, 0x55, 0x000C);
+	lcdWriteRegisterByte(dev, 0x56, 0x0101);
+	lcdWriteRegisterByte(dev, 0x57, 0x0400);
+	lcdWriteRegisterByte(dev, 0x58, 0x1108);
+	lcdWriteRegisterByte(dev, 0x59, 0x050C);
+	delayMS(50);
+	lcdWriteRegisterByte(dev, 0x07,0x1017);
+#endif // 0x9226
+
+	lcdBacklightOn(dev);
 }
 
 
@@ -478,43 +599,32 @@ void lcdDrawPixel(TFT_t * dev, uint16_t x, uint16_t y, uint16_t color){
 	uint16_t _x = x + dev->_offsetx;
 	uint16_t _y = y + dev->_offsety;
 
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
-		spi_master_write_addr(dev, _x, _x);
-		spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
-		spi_master_write_addr(dev, _y, _y);
-		spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
-		spi_master_write_data_word(dev, color);
-	} // endif 0x9340/0x9341/0x7796
-
-	if (dev->_model == 0x7735) {
-		spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
-		spi_master_write_data_word(dev, _x);
-		spi_master_write_data_word(dev, _x);
-		spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
-		spi_master_write_data_word(dev, _y);
-		spi_master_write_data_word(dev, _y);
-		spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
-		spi_master_write_data_word(dev, color);
-	} // endif 0x7735
-
-	if (dev->_model == 0x9225) {
-		lcdWriteRegisterByte(dev, 0x20, _x);
-		lcdWriteRegisterByte(dev, 0x21, _y);
-		spi_master_write_comm_byte(dev, 0x22);	// Memory Write
-		spi_master_write_data_word(dev, color);
-	} // endif 0x9225
-
-	if (dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x36, _x);
-		lcdWriteRegisterByte(dev, 0x37, _x);
-		lcdWriteRegisterByte(dev, 0x38, _y);
-		lcdWriteRegisterByte(dev, 0x39, _y);
-		lcdWriteRegisterByte(dev, 0x20, _x);
-		lcdWriteRegisterByte(dev, 0x21, _y); 
-		spi_master_write_comm_byte(dev, 0x22);             
-		spi_master_write_data_word(dev, color);
-	} // endif 0x9226
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
+	spi_master_write_addr(dev, _x, _x);
+	spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
+	spi_master_write_addr(dev, _y, _y);
+	spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
+	spi_master_write_data_word(dev, color);
+#endif // 0x9340/0x9341/0x7735/0x7796
+
+#if LCD_MODEL == 0x9225
+	lcdWriteRegisterByte(dev, 0x20, _x);
+	lcdWriteRegisterByte(dev, 0x21, _y);
+	spi_master_write_comm_byte(dev, 0x22);	// Memory Write
+	spi_master_write_data_word(dev, color);
+#endif // 0x9225
+
+#if LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x36, _x);
+	lcdWriteRegisterByte(dev, 0x37, _x);
+	lcdWriteRegisterByte(dev, 0x38, _y);
+	lcdWriteRegisterByte(dev, 0x39, _y);
+	lcdWriteRegisterByte(dev, 0x20, _x);
+	lcdWriteRegisterByte(dev, 0x21, _y); 
+	spi_master_write_comm_byte(dev, 0x22);             
+	spi_master_write_data_word(dev, color);
+#endif // 0x9226
 }
 
 // Add 202001
@@ -534,52 +644,75 @@ void lcdDrawMultiPixels(TFT_t * dev, uint16_t x, uint16_t y, uint16_t size, uint
     uint16_t _y2 = _y1;
     ESP_LOGD(TAG,"_x1=%d _x2=%d _y1=%d _y2=%d",_x1, _x2, _y1, _y2);
 
-    if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7796) {
-        spi_master_write_comm_byte(dev, 0x2A);  // set column(x) address
-        spi_master_write_addr(dev, _x1, _x2);
-        spi_master_write_comm_byte(dev, 0x2B);  // set Page(y) address
-        spi_master_write_addr(dev, _y1, _y2);
-        spi_master_write_comm_byte(dev, 0x2C);  //  Memory Write
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+    spi_master_write_comm_byte(dev, 0x2A);  // set column(x) address
+    spi_master_write_addr(dev, _x1, _x2);
+    spi_master_write_comm_byte(dev, 0x2B);  // set Page(y) address
+    spi_master_write_addr(dev, _y1, _y2);
+    spi_master_write_comm_byte(dev, 0x2C);  //  Memory Write
+    spi_master_write_colors(dev, colors, size);
+#endif // 0x9340/0x9341/0x7735/0x7796
+
+#if LCD_MODEL == 0x9225
+    for(int j=_y1;j<=_y2;j++){
+        lcdWriteRegisterByte(dev, 0x20, _x1);
+        lcdWriteRegisterByte(dev, 0x21, j);
+        spi_master_write_comm_byte(dev, 0x22);  // Memory Write
         spi_master_write_colors(dev, colors, size);
-    } // endif 0x9340/0x9341/0x7796
-
-    if (dev->_model == 0x7735) {
-        spi_master_write_comm_byte(dev, 0x2A);  // set column(x) address
-        spi_master_write_data_word(dev, _x1);
-        spi_master_write_data_word(dev, _x2);
-        spi_master_write_comm_byte(dev, 0x2B);  // set Page(y) address
-        spi_master_write_data_word(dev, _y1);
-        spi_master_write_data_word(dev, _y2);
-        spi_master_write_comm_byte(dev, 0x2C);  //  Memory Write
+    }
+#endif // 0x9225
+
+#if LCD_MODEL == 0x9226
+    for(int j=_x1;j<=_x2;j++) {
+        lcdWriteRegisterByte(dev, 0x36, j);
+        lcdWriteRegisterByte(dev, 0x37, j);
+        lcdWriteRegisterByte(dev, 0x38, _y2);
+        lcdWriteRegisterByte(dev, 0x39, _y1);
+        lcdWriteRegisterByte(dev, 0x20, j);
+        lcdWriteRegisterByte(dev, 0x21, _y1);
+        spi_master_write_comm_byte(dev, 0x22);
         spi_master_write_colors(dev, colors, size);
-    } // 0x7735
-
-    if (dev->_model == 0x9225) {
-        for(int j=_y1;j<=_y2;j++){
-            lcdWriteRegisterByte(dev, 0x20, _x1);
-            lcdWriteRegisterByte(dev, 0x21, j);
-            spi_master_write_comm_byte(dev, 0x22);  // Memory Write
-            spi_master_write_colors(dev, colors, size);
-        }
-    } // endif 0x9225
-
-    if (dev->_model == 0x9226) {
-        for(int j=_x1;j<=_x2;j++) {
-            lcdWriteRegisterByte(dev, 0x36, j);
-            lcdWriteRegisterByte(dev, 0x37, j);
-            lcdWriteRegisterByte(dev, 0x38, _y2);
-            lcdWriteRegisterByte(dev, 0x39, _y1);
-            lcdWriteRegisterByte(dev, 0x20, j);
-            lcdWriteRegisterByte(dev, 0x21, _y1);
-            spi_master_write_comm_byte(dev, 0x22);
-            spi_master_write_colors(dev, colors, size);
-        }
-    } // endif 0x9226
+    }
+#endif // 0x9226
 
 }
 
 
 
+// Draw pixels of a rectangle
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// colors:colors row by row
+void lcdDrawRectPixels(TFT_t * dev, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t * colors) {
+	if (x2 >= dev->_width) return;
+	if (y2 >= dev->_height) return;
+	if (x1 > x2 || y1 > y2) return;
+
+	uint16_t width = x2-x1+1;
+
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	uint16_t _x1 = x1 + dev->_offsetx;
+	uint16_t _x2 = x2 + dev->_offsetx;
+	uint16_t _y1 = y1 + dev->_offsety;
+	uint16_t _y2 = y2 + dev->_offsety;
+	spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
+	spi_master_write_addr(dev, _x1, _x2);
+	spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
+	spi_master_write_addr(dev, _y1, _y2);
+	spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
+	spi_master_write_colors(dev, colors, width*(y2-y1+1));
+#endif // 0x9340/0x9341/0x7735/0x7796
+
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	for(int y=y1;y<=y2;y++) {
+		lcdDrawMultiPixels(dev, x1, y, width, colors);
+		colors += width;
+	}
+#endif // 0x9225/0x9226
+}
+
 // Draw rectangle of filling
 // x1:Start X coordinate
 // y1:Start Y coordinate
@@ -598,119 +731,105 @@ void lcdDrawFillRect(TFT_t * dev, uint16_t x1, uint16_t y1, uint16_t x2, uint16_
 	uint16_t _y1 = y1 + dev->_offsety;
 	uint16_t _y2 = y2 + dev->_offsety;
 
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
-		for(int i=_x1;i<=_x2;i++) {
-			uint16_t size = _y2-_y1+1;
-			spi_master_write_color(dev, color, size);
-		}
-	} // endif 0x9340/0x9341/0x7796
-
-	if (dev->_model == 0x7735) {
-		spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
-		spi_master_write_data_word(dev, _x1);
-		spi_master_write_data_word(dev, _x2);
-		spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
-		spi_master_write_data_word(dev, _y1);
-		spi_master_write_data_word(dev, _y2);
-		spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
-		for(int i=_x1;i<=_x2;i++) {
-			uint16_t size = _y2-_y1+1;
-			spi_master_write_color(dev, color, size);
-		}
-	} // 0x7735
-
-	if (dev->_model == 0x9225) {
-		for(int j=_y1;j<=_y2;j++){
-			lcdWriteRegisterByte(dev, 0x20, _x1);
-			lcdWriteRegisterByte(dev, 0x21, j);
-			spi_master_write_comm_byte(dev, 0x22);	// Memory Write
-			uint16_t size = _x2-_x1+1;
-			spi_master_write_color(dev, color, size);
-		}
-	} // endif 0x9225
-
-	if (dev->_model == 0x9226) {
-		for(int j=_x1;j<=_x2;j++) {
-			lcdWriteRegisterByte(dev, 0x36, j);
-			lcdWriteRegisterByte(dev, 0x37, j);
-			lcdWriteRegisterByte(dev, 0x38, _y2);
-			lcdWriteRegisterByte(dev, 0x39, _y1);
-			lcdWriteRegisterByte(dev, 0x20, j);
-			lcdWriteRegisterByte(dev, 0x21, _y1); 
-			spi_master_write_comm_byte(dev, 0x22);             
-			uint16_t size = _y2-_y1+1;
-			spi_master_write_color(dev, color, size);
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x2A);	// set column(x) address
+	spi_master_write_addr(dev, _x1, _x2);
+	spi_master_write_comm_byte(dev, 0x2B);	// set Page(y) address
+	spi_master_write_addr(dev, _y1, _y2);
+	spi_master_write_comm_byte(dev, 0x2C);	//  Memory Write
+	for(int i=_x1;i<=_x2;i++) {
+		uint16_t size = _y2-_y1+1;
+		spi_master_write_color(dev, color, size);
+	}
+#endif // 0x9340/0x9341/0x7735/0x7796
+
+#if LCD_MODEL == 0x9225
+	for(int j=_y1;j<=_y2;j++){
+		lcdWriteRegisterByte(dev, 0x20, _x1);
+		lcdWriteRegisterByte(dev, 0x21, j);
+		spi_master_write_comm_byte(dev, 0x22);	// Memory Write
+		uint16_t size = _x2-_x1+1;
+		spi_master_write_color(dev, color, size);
+	}
+#endif // 0x9225
+
+#if LCD_MODEL == 0x9226
+	for(int j=_x1;j<=_x2;j++) {
+		lcdWriteRegisterByte(dev, 0x36, j);
+		lcdWriteRegisterByte(dev, 0x37, j);
+		lcdWriteRegisterByte(dev, 0x38, _y2);
+		lcdWriteRegisterByte(dev, 0x39, _y1);
+		lcdWriteRegisterByte(dev, 0x20, j);
+		lcdWriteRegisterByte(dev, 0x21, _y1); 
+		spi_master_write_comm_byte(dev, 0x22);             
+		uint16_t size = _y2-_y1+1;
+		spi_master_write_color(dev, color, size);
 #if 0
-			for(int i=_y1;i<=_y2;i++) {
-				spi_master_write_data_word(dev, color);
-			}
-#endif
+		for(int i=_y1;i<=_y2;i++) {
+			spi_master_write_data_word(dev, color);
 		}
-	} // endif 0x9226
+#endif
+	}
+#endif // 0x9226
 
 }
 
 // Display OFF
 void lcdDisplayOff(TFT_t * dev) {
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7735 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x28);
-	} // endif 0x9340/0x9341/0x7735/0x7796
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x28);
+#endif // 0x9340/0x9341/0x7735/0x7796
 
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x07, 0x1014);
-	} // endif 0x9225/0x9226
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x07, 0x1014);
+#endif // 0x9225/0x9226
 
 }
  
 // Display ON
 void lcdDisplayOn(TFT_t * dev) {
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7735 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x29);
-	} // endif 0x9340/0x9341/0x7735/0x7796
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x29);
+#endif // 0x9340/0x9341/0x7735/0x7796
 
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x07, 0x1017);
-	} // endif 0x9225/0x9226
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x07, 0x1017);
+#endif // 0x9225/0x9226
 
 }
 
 // Display Inversion OFF
 void lcdInversionOff(TFT_t * dev) {
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7735 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x20);
-	} // endif 0x9340/0x9341/0x7735/0x7796
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x20);
+#endif // 0x9340/0x9341/0x7735/0x7796
 
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x07, 0x1017);
-	} // endif 0x9225/0x9226
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x07, 0x1017);
+#endif // 0x9225/0x9226
 }
 
 // Display Inversion ON
 void lcdInversionOn(TFT_t * dev) {
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7735 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x21);
-	} // endif 0x9340/0x9341/0x7735/0x7796
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x21);
+#endif // 0x9340/0x9341/0x7735/0x7796
 
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x07, 0x1013);
-	} // endif 0x9225/0x9226
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x07, 0x1013);
+#endif // 0x9225/0x9226
 }
 
 // Change Memory Access Control
 void lcdBGRFilter(TFT_t * dev) {
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7735 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x36);	//Memory Access Control
-		spi_master_write_data_byte(dev, 0x00);	//Right top start, RGB color filter panel
-	} // endif 0x9340/0x9341/0x7735/0x7796
-
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x03, 0x0030); // set GRAM write direction and BGR=0.
-	} // endif 0x9225/0x9226
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7735 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x36);	//Memory Access Control
+	spi_master_write_data_byte(dev, 0x00);	//Right top start, RGB color filter panel
+#endif // 0x9340/0x9341/0x7735/0x7796
+
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x03, 0x0030); // set GRAM write direction and BGR=0.
+#endif // 0x9225/0x9226
 }
 // Fill screen
 // color:color
@@ -1377,15 +1496,21 @@ void lcdUnsetFontUnderLine(TFT_t * dev) {
 
 // Backlight OFF
 void lcdBacklightOff(TFT_t * dev) {
-	if(dev->_bl >= 0) {
-		gpio_set_level( dev->_bl, 0 );
-	}
+	lcdBacklightLevel(dev, 0);
 }
 
 // Backlight ON
 void lcdBacklightOn(TFT_t * dev) {
+	lcdBacklightLevel(dev, 100);
+}
+
+// Backlight brightness
+// percent:0 is off, 100 is full brightness
+void lcdBacklightLevel(TFT_t * dev, uint8_t percent) {
 	if(dev->_bl >= 0) {
-		gpio_set_level( dev->_bl, 1 );
+		if (percent > 100) percent = 100;
+		ledc_set_duty(BL_LEDC_MODE, BL_LEDC_CHANNEL, (uint32_t)percent * BL_LEDC_MAX_DUTY / 100);
+		ledc_update_duty(BL_LEDC_MODE, BL_LEDC_CHANNEL);
 	}
 }
 
@@ -1394,57 +1519,57 @@ void lcdBacklightOn(TFT_t * dev) {
 // vsa:Vertical Scrolling Area
 // bfa:Bottom Fixed Area
 void lcdSetScrollArea(TFT_t * dev, uint16_t tfa, uint16_t vsa, uint16_t bfa){
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x33);	// Vertical Scrolling Definition
-		spi_master_write_data_word(dev, tfa);
-		spi_master_write_data_word(dev, vsa);
-		spi_master_write_data_word(dev, bfa);
-		//spi_master_write_comm_byte(dev, 0x12);	// Partial Mode ON
-	} // endif 0x9340/0x9341/0x7796
-
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x31, vsa);	// Specify scroll end and step at the scroll display
-		lcdWriteRegisterByte(dev, 0x32, tfa);	// Specify scroll start and step at the scroll display
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x33);	// Vertical Scrolling Definition
+	spi_master_write_data_word(dev, tfa);
+	spi_master_write_data_word(dev, vsa);
+	spi_master_write_data_word(dev, bfa);
+	//spi_master_write_comm_byte(dev, 0x12);	// Partial Mode ON
+#endif // 0x9340/0x9341/0x7796
+
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x31, vsa);	// Specify scroll end and step at the scroll display
+	lcdWriteRegisterByte(dev, 0x32, tfa);	// Specify scroll start and step at the scroll display
 #if 0
-		spi_master_write_comm_byte(dev, 0x31);	// Specify scroll end address at the scroll display
-		spi_master_write_data_word(dev, vsa);
-		spi_master_write_comm_byte(dev, 0x32);	// Specify scroll start address at the scroll display
-		spi_master_write_data_word(dev, tfa);
+	spi_master_write_comm_byte(dev, 0x31);	// Specify scroll end address at the scroll display
+	spi_master_write_data_word(dev, vsa);
+	spi_master_write_comm_byte(dev, 0x32);	// Specify scroll start address at the scroll display
+	spi_master_write_data_word(dev, tfa);
 #endif
-	} // endif 0x9225/0x9226
+#endif // 0x9225/0x9226
 }
 
 void lcdResetScrollArea(TFT_t * dev, uint16_t vsa){
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x33);	// Vertical Scrolling Definition
-		spi_master_write_data_word(dev, 0);
-		//spi_master_write_data_word(dev, 0x140);
-		spi_master_write_data_word(dev, vsa);
-		spi_master_write_data_word(dev, 0);
-	} // endif 0x9340/0x9341/0x7796
-
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x31, 0x0);	// Specify scroll end and step at the scroll display
-		lcdWriteRegisterByte(dev, 0x32, 0x0);	// Specify scroll start and step at the scroll display
-		//lcdWriteRegisterByte(dev, 0x31, vsa);	// Specify scroll end and step at the scroll display
-		//lcdWriteRegisterByte(dev, 0x32, tfa);	// Specify scroll start and step at the scroll display
-	} // endif 0x9225/0x9226
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x33);	// Vertical Scrolling Definition
+	spi_master_write_data_word(dev, 0);
+	//spi_master_write_data_word(dev, 0x140);
+	spi_master_write_data_word(dev, vsa);
+	spi_master_write_data_word(dev, 0);
+#endif // 0x9340/0x9341/0x7796
+
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x31, 0x0);	// Specify scroll end and step at the scroll display
+	lcdWriteRegisterByte(dev, 0x32, 0x0);	// Specify scroll start and step at the scroll display
+	//lcdWriteRegisterByte(dev, 0x31, vsa);	// Specify scroll end and step at the scroll display
+	//lcdWriteRegisterByte(dev, 0x32, tfa);	// Specify scroll start and step at the scroll display
+#endif // 0x9225/0x9226
 }
 
 // Vertical Scrolling Start Address
 // vsp:Vertical Scrolling Start Address
 void lcdScroll(TFT_t * dev, uint16_t vsp){
-	if (dev->_model == 0x9340 || dev->_model == 0x9341 || dev->_model == 0x7796) {
-		spi_master_write_comm_byte(dev, 0x37);	// Vertical Scrolling Start Address
-		spi_master_write_data_word(dev, vsp);
-	} // endif 0x9340/0x9341/0x7796
+#if LCD_MODEL == 0x9340 || LCD_MODEL == 0x9341 || LCD_MODEL == 0x7796
+	spi_master_write_comm_byte(dev, 0x37);	// Vertical Scrolling Start Address
+	spi_master_write_data_word(dev, vsp);
+#endif // 0x9340/0x9341/0x7796
 
-	if (dev->_model == 0x9225 || dev->_model == 0x9226) {
-		lcdWriteRegisterByte(dev, 0x33, vsp);	// Vertical Scrolling Start Address
+#if LCD_MODEL == 0x9225 || LCD_MODEL == 0x9226
+	lcdWriteRegisterByte(dev, 0x33, vsp);	// Vertical Scrolling Start Address
 #if 0
-		spi_master_write_comm_byte(dev, 0x33);	// Vertical Scrolling Start Address
-		spi_master_write_data_word(dev, vsp);
+	spi_master_write_comm_byte(dev, 0x33);	// Vertical Scrolling Start Address
+	spi_master_write_data_word(dev, vsp);
 #endif
-	} // endif 0x9225/0x9226
+#endif // 0x9225/0x9226
 }
 
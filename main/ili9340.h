@@ -1,9 +1,33 @@
 #ifndef MAIN_ILI9340_H_
 #define MAIN_ILI9340_H_
 
+#include "sdkconfig.h"
 #include "driver/spi_master.h"
 #include "fontx.h"
 
+//controller selected in menuconfig, only its code is built into the driver
+#if CONFIG_ILI9225
+#define LCD_MODEL		0x9225
+#define LCD_MODEL_NAME	"ILI9225"
+#elif CONFIG_ILI9225G
+#define LCD_MODEL		0x9226
+#define LCD_MODEL_NAME	"ILI9225G"
+#elif CONFIG_ILI9340
+#define LCD_MODEL		0x9340
+#define LCD_MODEL_NAME	"ILI9340"
+#elif CONFIG_ILI9341
+#define LCD_MODEL		0x9341
+#define LCD_MODEL_NAME	"ILI9341"
+#elif CONFIG_ST7735
+#define LCD_MODEL		0x7735
+#define LCD_MODEL_NAME	"ST7735"
+#elif CONFIG_ST7796
+#define LCD_MODEL		0x7796
+#define LCD_MODEL_NAME	"ST7796"
+#else
+#error "No display driver selected"
+#endif
+
 #define RED				0xf800
 #define GREEN			0x07e0
 #define BLUE			0x001f
@@ -20,6 +44,10 @@
 #define DIRECTION180		2
 #define DIRECTION270		3
 
+#define SPI_QUEUE_SIZE		7		// transactions in flight
+#define SPI_DMA_BUFFERS		2		// pixel buffers, one is filled while the other is sent
+#define SPI_DMA_BUFFER_SIZE	1024
+
 typedef struct {
 	uint16_t _model;
 	uint16_t _width;
@@ -31,13 +59,25 @@ typedef struct {
 	uint16_t _font_fill_color;
 	uint16_t _font_underline;
 	uint16_t _font_underline_color;
+	int16_t _cs;
 	int16_t _dc;
 	int16_t _bl;
+	int _dc_level;							// DC of the last queued transaction, -1 before the first
+	int _clock_hz;
 	spi_device_handle_t _SPIHandle;
+	spi_transaction_t _trans[SPI_QUEUE_SIZE];
+	int _trans_next;
+	uint32_t _trans_queued;
+	uint32_t _trans_done;
+	uint8_t *_dma_buffer[SPI_DMA_BUFFERS];
+	uint32_t _dma_seq[SPI_DMA_BUFFERS];		// done when _trans_done reaches it
+	int _dma_next;
 } TFT_t;
 
 void spi_master_init(TFT_t * dev, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO_RESET, int16_t GPIO_BL);
-bool spi_master_write_byte(spi_device_handle_t SPIHandle, const uint8_t* Data, size_t DataLength);
+void spi_master_wait_all(TFT_t * dev);
+int spi_master_get_clock(TFT_t * dev);
+bool spi_master_set_clock(TFT_t * dev, int clock_hz);
 bool spi_master_write_comm_byte(TFT_t * dev, uint8_t cmd);
 bool spi_master_write_comm_word(TFT_t * dev, uint16_t cmd);
 bool spi_master_write_data_byte(TFT_t * dev, uint8_t data);
@@ -49,9 +89,10 @@ bool spi_master_write_colors(TFT_t * dev, uint16_t * colors, uint16_t size);
 void delayMS(int ms);
 void lcdWriteRegisterWord(TFT_t * dev, uint16_t addr, uint16_t data);
 void lcdWriteRegisterByte(TFT_t * dev, uint8_t addr, uint16_t data);
-void lcdInit(TFT_t * dev, uint16_t model, int width, int height, int offsetx, int offsety);
+void lcdInit(TFT_t * dev, int width, int height, int offsetx, int offsety);
 void lcdDrawPixel(TFT_t * dev, uint16_t x, uint16_t y, uint16_t color);
 void lcdDrawMultiPixels(TFT_t * dev, uint16_t x, uint16_t y, uint16_t size, uint16_t * colors);
+void lcdDrawRectPixels(TFT_t * dev, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t * colors);
 void lcdDrawFillRect(TFT_t * dev, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
 void lcdDisplayOff(TFT_t * dev);
 void lcdDisplayOn(TFT_t * dev);
@@ -81,6 +122,7 @@ void lcdSetFontUnderLine(TFT_t * dev, uint16_t color);
 void lcdUnsetFontUnderLine(TFT_t * dev);
 void lcdBacklightOff(TFT_t * dev);
 void lcdBacklightOn(TFT_t * dev);
+void lcdBacklightLevel(TFT_t * dev, uint8_t percent);
 void lcdSetScrollArea(TFT_t * dev, uint16_t tfa, uint16_t vsa, uint16_t bfa);
 void lcdResetScrollArea(TFT_t * dev, uint16_t vsa);
 void lcdScroll(TFT_t * dev, uint16_t vsp);
@@ -0,0 +1,28 @@
+#ifndef MAIN_IMAGE565_H_
+#define MAIN_IMAGE565_H_
+
+#include <stdint.h>
+
+//converted image, written by tools/png2rgb565.py and blitted by DF_print_image
+//
+//all fields little endian, the header is followed by data_size bytes of pixels.
+//Pixels are RGB565 words as held by the virtual screen, column by column like vscreen[x][y].
+//With IMAGE565_FLAG_RLE the pixels are packets of a control word and its pixels:
+//bit 15 set: (control & 0x7FFF) times the following pixel, clear: control pixels follow
+
+#define IMAGE565_MAGIC		0x35363552	//"R565"
+#define IMAGE565_VERSION	1
+#define IMAGE565_FLAG_RLE	0x01
+#define IMAGE565_RLE_RUN	0x8000
+
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint16_t width;
+	uint16_t height;
+	uint8_t flags;
+	uint8_t version;
+	uint16_t reserved;
+	uint32_t data_size;
+} image565_header_t;
+
+#endif
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
@@ -11,12 +13,22 @@
 #include "esp_vfs.h"
 #include "esp_spiffs.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "UI_driver.h"
 #include "NVS_driver.h"
 #include "Button_driver.h"
 #include "INA_data_driver.h"
 #include "ADC_data_driver.h"
-#include "stack_usage_queue_handler.h"
+#include "metrics.h"
+#include "serial_cmd.h"
+#include "profiler.h"
+#include "master_events.h"
+#include "page_engine.h"
+#include "sampler.h"
+#include "idle.h"
+#include "assets.h"
+#define BLOG_LEVEL CONFIG_PSU_BLOG_LEVEL_MASTER
+#include "blog.h"
 
 //Tag for ESP_LOG functions
 static const char *TAG = "Master_Task";
@@ -31,39 +43,28 @@ static const char *TAG = "Master_Task";
 #define SDA_GPIO 21
 #define SCL_GPIO 22
 
-//define Button directions
-#define up      0
-#define down    1
-#define left    2
-#define right   3
-#define sel     4
-
-//define screens for switch case
-#define calibrate_1 	0
-#define calibrate_2 	1
-#define main 			2
-#define voltage 		3
-#define variable 		4
-#define statistics_p 	5
-#define statistics_u 	6
-#define statistics_i 	7
-#define tcbus			8
-#define test_1			9
-#define test_2			10
-
-//Subtask Functions
-void calibrate_1_func(void);
-void calibrate_2_func(void);
-void main_func(void);
-void voltages_func(void);
-void variable_func(void);
-void statistics_p_func(void);
-void statistics_u_func(void);
-void statistics_i_func(void);
-void tcbus_func(void);
-void test_func_1(void);
-void test_func_2(void);
-void house_keeping(void);
+//pages of the page table
+typedef enum {
+	PAGE_CALIBRATE_1,
+	PAGE_CALIBRATE_2,
+	PAGE_MAIN,
+	PAGE_VOLTAGE,
+	PAGE_VARIABLE,
+	PAGE_STATISTICS_P,
+	PAGE_STATISTICS_U,
+	PAGE_STATISTICS_I,
+	PAGE_TCBUS,
+	PAGE_TEST_1,
+	PAGE_TEST_2,
+	PAGE_PROFILER,
+	PAGE_COUNT,
+} page_id_t;
+
+//interval of the frame statistics log
+#define FRAME_STATS_INTERVAL_US 5000000
+
+void house_keeping(bool rendered);
+void house_keeping_events(void);
 
 //Function for Spiffs
 static void SPIFFS_Directory(char * path) {
@@ -72,24 +73,76 @@ static void SPIFFS_Directory(char * path) {
 	while (true) {
 		struct dirent*pe = readdir(dir);
 		if (!pe) break;
-		ESP_LOGI(__FUNCTION__,"d_name=%s d_ino=%d d_type=%x", pe->d_name,pe->d_ino, pe->d_type);
+		ESP_LOGI(__FUNCTION__,"d_name=%s d_ino=%d d_type=%x", pe->d_name,(int)pe->d_ino, pe->d_type);
 	}
 	closedir(dir);
 }
 
+#if CONFIG_PSU_TASK_STATS
+//serial command: task list with core affinity and run time statistics.
+//Walks all tasks with the scheduler suspended, only on request and never from the render loop
+static void task_stats_cmd(const char *args)
+{
+	char *buffer = malloc(uxTaskGetNumberOfTasks() * 50 + 1);
+	if(buffer == NULL) return;
+	vTaskList(buffer);
+	ESP_LOGI(TAG, "Task\t\tState\tPrio\tStack\tNum\tCore\n%s", buffer);
+	vTaskGetRunTimeStats(buffer);
+	ESP_LOGI(TAG, "Task\t\tRun time\tLoad\n%s", buffer);
+	free(buffer);
+}
+#endif
+
+//serial command for the metrics registry
+static void metrics_cmd(const char *args)
+{
+	metrics_dump();
+}
+
+//serial command for the frame profiler
+static void prof_cmd(const char *args);
+
+//serial command for the I2C statistics
+static void i2c_stats_cmd(const char *args)
+{
+	i2cdev_stats_dump(I2C_PORT);
+}
+
+//serial command for the SPI statistics
+static void spi_stats_cmd(const char *args)
+{
+	metrics_spi_dump();
+}
+
+//pushes per measurement of a requested SPI benchmark, run by the Master_Task
+static volatile int spi_bench_iterations = 0;
+
+//serial command for the SPI benchmark, spibench [pushes]
+static void spi_bench_cmd(const char *args)
+{
+	int iterations = atoi(args);
+	spi_bench_iterations = iterations > 0 ? iterations : 20;
+	master_events_set(EVT_REFRESH);
+}
+
 //Init internal variables
 TaskHandle_t master_task;
-int page_select = main;
-int page_select_last = main;
-int value_select = 0;
-int ENC_count = 0;
-int ENC_count_last = 0;
-int up_press = 0;
-int down_press = 0;
-int left_press = 0;
-int right_press = 0;
-int select_press = 0;
+int page_select_last = PAGE_MAIN;
+//input of the current frame
+page_input_t page_input;
 bool siren_toggle = 0;
+//input latency from reading the input to handling it in a frame
+int64_t input_latency_last_us = 0;
+int64_t input_latency_max_us = 0;
+//events that woke the current frame
+EventBits_t frame_events = 0;
+//frame statistics
+uint32_t frame_count = 0;
+int64_t frame_busy_us = 0;
+int64_t frame_stats_start_us = 0;
+//output values at the last activity, a bigger change wakes the display
+double idle_voltage_ref = 0;
+double idle_current_ref = 0;
 
 
 nvs_handle INA_config_NVS;
@@ -97,22 +150,31 @@ esp_err_t err;
 INA_cal_t INA_cal;
 ADC_cal_t ADC_cal;
 
-stack_usage_dataframe_t stack_temp;
-uint32_t stack_master_size = 0;
-uint32_t stack_ADC_size = 0;
-uint32_t stack_INA_size = 0;
-uint32_t stack_button_size = 0;
-uint32_t stack_IO_size = 0;
+//free stack of the tasks, read from the metrics registry
+uint32_t stack_size[METRIC_TASK_COUNT];
+//page shown on the profiler page and its stage times
+int prof_page_select = PAGE_MAIN;
+const char *prof_names[PROF_STAGE_COUNT];
+uint32_t prof_avg_us[PROF_STAGE_COUNT];
+uint32_t prof_p99_us[PROF_STAGE_COUNT];
 //INA calibration variables
 double INA1_S_val = 0;
 double INA1_A_val = 0;
 double INA2_S_val = 0;
 double INA2_A_val = 0;
-//ADC calibration variables
-double out24_cal = 24;
-double out5_cal = 5;
-double out33_cal = 3.3;
-double outvar_cal = 26;
+//ADC calibration capture, rail, reference voltage and actions
+static const char *cal_rail_names[ADC_CAL_RAILS] = {"24V", "5V", "3.3V", "Var"};
+int cal_rail = 0;
+double cal_reference = 24;
+bool cal_capture = 0;
+bool cal_clear = 0;
+double cal_measured = 0;
+int cal_raw = 0;
+//result of the last capture shown on the page
+static const char *cal_status = "";
+//the reference follows the measured value until it is edited
+int cal_rail_last = -1;
+double cal_reference_set = 0;
 //INA value variables
 double power_val = 0;
 double voltage_val = 0;
@@ -138,58 +200,296 @@ bool TC_EN_val = 0;
 bool TC_NFON_val = 0;
 APA102_t RGB_0;
 APA102_t RGB_1;
+APA102_t RGB_0_last;
+APA102_t RGB_1_last;
 uint16_t p_val[100];
 uint16_t u_val[100];
 uint16_t i_val[100];
 
+//save calibration values to NVS
+static void calibrate_save(void)
+{
+	INA_cal.INA1_S_val = (int32_t)INA1_S_val;
+	INA_cal.INA1_A_val = (int32_t)(INA1_A_val*1000);
+	INA_cal.INA2_S_val = (int32_t)INA2_S_val;
+	INA_cal.INA2_A_val = (int32_t)(INA2_A_val*1000);
+
+	NVS_write_calibration(&INA_cal, &ADC_cal);
+	//rebuild the conversion coefficients, the new calibration applies without restart
+	INAD_set_calibration(INA_cal);
+	ADCD_set_calibration(&ADC_cal);
+}
+
+
+//update functions, read the data a page shows
+static void voltages_update(void)
+{
+	out24_val = ADCD_get_volt(1);
+	out5_val = ADCD_get_volt(2);
+	out33_val = ADCD_get_volt(3);
+	outvar_val = ADCD_get_volt(4);
+}
+//copy the sampler history to the graphs as a sweep, every sample keeps its column and the
+//column after the newest stays empty, so a new sample only changes two columns on the display
+static void statistics_update(void)
+{
+	sample_t history[SAMPLER_HISTORY_LEN];
+	int count = sampler_get_history(history, SAMPLER_HISTORY_LEN);
+	for(int i = 0; i < SAMPLER_HISTORY_LEN; i++)
+	{
+		p_val[i] = UI_GRAPH_NONE;
+		u_val[i] = UI_GRAPH_NONE;
+		i_val[i] = UI_GRAPH_NONE;
+	}
+	//with a full history the oldest sample is in the gap column
+	for(int i = (count == SAMPLER_HISTORY_LEN); i < count; i++)
+	{
+		int column = history[i].seq % SAMPLER_HISTORY_LEN;
+		p_val[column] = history[i].power_mW/Max_P_mW*60;
+		u_val[column] = history[i].vshunt_mV/Max_U_mV*60;
+		i_val[column] = history[i].current_mA/Max_I_mA*60;
+	}
+}
+//capture or clear calibration points of the selected rail, applied right away
+static void calibrate_2_update(void)
+{
+	if(cal_capture)
+	{
+		cal_capture = 0;
+		switch(ADCD_cal_capture(&ADC_cal, cal_rail, (int32_t)(cal_reference * 1000000)))
+		{
+			case ESP_OK:
+				ADCD_set_calibration(&ADC_cal);
+				cal_status = "";
+			break;
+			case ESP_ERR_NO_MEM:
+				BLOG_W(MASTER_CAL_FULL, BLOG_STR(cal_rail_names[cal_rail]), BLOG_INT(ADC_CAL_MAX_POINTS));
+				cal_status = "Table full";
+			break;
+			default:
+				BLOG_W(MASTER_CAL_SLOPE, BLOG_STR(cal_rail_names[cal_rail]));
+				cal_status = "Slope too steep";
+			break;
+		}
+		cal_rail_last = -1;
+	}
+	if(cal_clear)
+	{
+		cal_clear = 0;
+		ADCD_cal_clear(&ADC_cal, cal_rail);
+		ADCD_set_calibration(&ADC_cal);
+		cal_status = "";
+		cal_rail_last = -1;
+	}
+	cal_measured = ADCD_get_volt(cal_rail + 1);
+	cal_raw = ADCD_get(cal_rail + 1) & 0x0FFF;
+	if(cal_rail != cal_rail_last || cal_reference == cal_reference_set)
+	{
+		if(cal_rail != cal_rail_last && cal_rail_last != -1) cal_status = "";
+		cal_reference = round(cal_measured * 100) / 100;
+		cal_reference_set = cal_reference;
+		cal_rail_last = cal_rail;
+	}
+}
+static void test_1_update(void)
+{
+	adc1_read = ADCD_get(1);
+	adc2_read = ADCD_get(2);
+	adc3_read = ADCD_get(3);
+	adc4_read = ADCD_get(4);
+	adc5_read = ADCD_get(5);
+}
+static void test_2_update(void)
+{
+	metric_task_t task;
+	for(int id = 0; id < METRIC_TASK_COUNT; id++)
+	{
+		stack_size[id] = metrics_get_task(id, &task) ? task.stack_hwm : 0;
+	}
+}
+static void profiler_update(void)
+{
+	prof_result_t result;
+	for(int stage = 0; stage < PROF_STAGE_COUNT; stage++)
+	{
+		profiler_get(prof_page_select, stage, &result);
+		prof_names[stage] = profiler_stage_name(stage);
+		prof_avg_us[stage] = result.avg_us;
+		prof_p99_us[stage] = result.p99_us;
+	}
+}
+
+//draw functions
+static void calibrate_1_draw(int sel) { UI_draw_calibrate_screen_1(INA1_S_val, INA1_A_val, INA2_S_val, INA2_A_val, sel); }
+static void calibrate_2_draw(int sel) { UI_draw_calibrate_screen_2(cal_rail_names[cal_rail], cal_reference, cal_measured, cal_raw, ADC_cal.rail[cal_rail].count, cal_status, sel); }
+static void main_draw(int sel) { UI_draw_main_screen(power_val, voltage_val, current_val, output_val); }
+static void voltages_draw(int sel) { UI_draw_voltages_screen(out24_val, out5_val, outvar_val, out33_val, output_val); }
+static void variable_draw(int sel) { UI_draw_variable_screen(uset_val, ueff_val, sel, output_val); }
+static void statistics_p_draw(int sel) { UI_draw_statistics_screen(p_val, 0, division_select, sel, output_val); }
+static void statistics_u_draw(int sel) { UI_draw_statistics_screen(u_val, 1, division_select, sel, output_val); }
+static void statistics_i_draw(int sel) { UI_draw_statistics_screen(i_val, 2, division_select, sel, output_val); }
+static void tcbus_draw(int sel) { UI_draw_tcbus_screen(TC_EN_val, TC_NFON_val, output_val, sel); }
+static void test_1_draw(int sel) { UI_draw_test_screen_1(adc1_read, adc2_read, adc3_read, adc4_read, adc5_read); }
+static void profiler_draw(int sel);
+static void test_2_draw(int sel) { UI_draw_test_screen_2(stack_size[METRIC_TASK_MASTER], stack_size[METRIC_TASK_ADC], stack_size[METRIC_TASK_INA], stack_size[METRIC_TASK_BUTTON], stack_size[METRIC_TASK_IO]); }
+
+//editable fields of the pages
+static const page_field_t calibrate_1_fields[] = {
+	{FIELD_DOUBLE, &INA1_S_val, 1, 100000, 1},
+	{FIELD_DOUBLE, &INA1_A_val, 0, INA220_MAX_CURRENT_A, 0.1},
+	{FIELD_DOUBLE, &INA2_S_val, 1, 100000, 1},
+	{FIELD_DOUBLE, &INA2_A_val, 0, INA220_MAX_CURRENT_A, 0.1},
+};
+static const page_field_t calibrate_2_fields[] = {
+	{FIELD_INT, &cal_rail, 0, ADC_CAL_RAILS - 1, 1},
+	{FIELD_DOUBLE, &cal_reference, 0, 100, 0.01},
+	{FIELD_TOGGLE, &cal_capture},
+	{FIELD_TOGGLE, &cal_clear},
+};
+static const page_field_t output_fields[] = {
+	{FIELD_TOGGLE, &output_val},
+};
+static const page_field_t variable_fields[] = {
+	{FIELD_DOUBLE, &uset_val, 0, 30, 0.1},
+	{FIELD_TOGGLE, &output_val},
+};
+static const page_field_t statistics_fields[] = {
+	{FIELD_INT, &division_select, 0, 3, 1},
+	{FIELD_TOGGLE, &output_val},
+};
+static const page_field_t profiler_fields[] = {
+	{FIELD_INT, &prof_page_select, 0, PAGE_COUNT - 1, 1},
+};
+static const page_field_t tcbus_fields[] = {
+	{FIELD_TOGGLE, &TC_EN_val},
+	{FIELD_TOGGLE, &TC_NFON_val},
+	{FIELD_TOGGLE, &output_val},
+};
+
+#define FIELDS(f) f, sizeof(f) / sizeof(f[0])
+
+//page table, left is prev and right is next
+static const page_t pages[PAGE_COUNT] = {
+	[PAGE_CALIBRATE_1] = {"calibrate_1", PAGE_CALIBRATE_2, PAGE_CALIBRATE_2, PAGE_MAIN, calibrate_save, NULL, calibrate_1_draw, FIELDS(calibrate_1_fields), 0, 0},
+	[PAGE_CALIBRATE_2] = {"calibrate_2", PAGE_CALIBRATE_1, PAGE_CALIBRATE_1, PAGE_MAIN, calibrate_save, calibrate_2_update, calibrate_2_draw, FIELDS(calibrate_2_fields), 200, EVT_ADC_DATA | EVT_INPUT},
+	[PAGE_MAIN] = {"main", PAGE_TCBUS, PAGE_VOLTAGE, PAGE_NONE, NULL, NULL, main_draw, FIELDS(output_fields), 100, EVT_INA_DATA},
+	[PAGE_VOLTAGE] = {"voltage", PAGE_MAIN, PAGE_VARIABLE, PAGE_NONE, NULL, voltages_update, voltages_draw, FIELDS(output_fields), 200, EVT_ADC_DATA},
+	[PAGE_VARIABLE] = {"variable", PAGE_VOLTAGE, PAGE_STATISTICS_P, PAGE_NONE, NULL, NULL, variable_draw, FIELDS(variable_fields), 0, 0},
+	[PAGE_STATISTICS_P] = {"statistics_p", PAGE_VARIABLE, PAGE_STATISTICS_U, PAGE_NONE, NULL, statistics_update, statistics_p_draw, FIELDS(statistics_fields), 100, EVT_SAMPLE},
+	[PAGE_STATISTICS_U] = {"statistics_u", PAGE_STATISTICS_P, PAGE_STATISTICS_I, PAGE_NONE, NULL, statistics_update, statistics_u_draw, FIELDS(statistics_fields), 100, EVT_SAMPLE},
+	[PAGE_STATISTICS_I] = {"statistics_i", PAGE_STATISTICS_U, PAGE_TCBUS, PAGE_NONE, NULL, statistics_update, statistics_i_draw, FIELDS(statistics_fields), 100, EVT_SAMPLE},
+	[PAGE_TCBUS] = {"tcbus", PAGE_STATISTICS_I, PAGE_MAIN, PAGE_NONE, NULL, NULL, tcbus_draw, FIELDS(tcbus_fields), 0, 0},
+	[PAGE_TEST_1] = {"test_1", PAGE_PROFILER, PAGE_TEST_2, PAGE_MAIN, NULL, test_1_update, test_1_draw, NULL, 0, 200, EVT_ADC_DATA},
+	[PAGE_TEST_2] = {"test_2", PAGE_TEST_1, PAGE_PROFILER, PAGE_MAIN, NULL, test_2_update, test_2_draw, NULL, 0, 500, EVT_REFRESH},
+	[PAGE_PROFILER] = {"profiler", PAGE_TEST_2, PAGE_TEST_1, PAGE_MAIN, NULL, profiler_update, profiler_draw, FIELDS(profiler_fields), 1000, EVT_REFRESH},
+};
+
+static void profiler_draw(int sel) { UI_draw_profiler_screen(pages[prof_page_select].name, prof_names, prof_avg_us, prof_p99_us, PROF_STAGE_COUNT); }
+
+//time per display state, idle active/dim/sleep forces a state to measure its current draw
+static void idle_cmd(const char *args)
+{
+	for(int state = 0; state < IDLE_STATE_COUNT; state++)
+	{
+		if(strcmp(args, idle_get_state_name(state)) == 0)
+		{
+			idle_request(state);
+			return;
+		}
+	}
+	idle_stats_t stats;
+	idle_get_stats(&stats);
+	ESP_LOGI(TAG, "display %s, active %" PRId64 " s, dim %" PRId64 " s, sleep %" PRId64 " s, %u wakes", idle_get_state_name(idle_get_state()),
+		stats.time_us[IDLE_ACTIVE] / 1000000, stats.time_us[IDLE_DIM] / 1000000, stats.time_us[IDLE_SLEEP] / 1000000, stats.wakes);
+}
+
+static void prof_cmd(const char *args)
+{
+	if(strcmp(args, "reset") == 0)
+	{
+		profiler_reset();
+		return;
+	}
+	for(int page = 0; page < PAGE_COUNT; page++)
+	{
+		if(args[0] == 0 || strcmp(args, pages[page].name) == 0) profiler_dump_page(page, pages[page].name);
+	}
+}
+
+//calibration tables of the ADC rails
+static void cal_cmd(const char *args)
+{
+	for(int rail = 0; rail < ADC_CAL_RAILS; rail++)
+	{
+		const ADC_cal_table_t *table = &ADC_cal.rail[rail];
+		char line[ADC_CAL_MAX_POINTS * 20 + 8];
+		int len = snprintf(line, sizeof(line), "%-4s", cal_rail_names[rail]);
+		for(int i = 0; i < table->count; i++) len += snprintf(line + len, sizeof(line) - len, " %d:%d", table->raw[i], table->uV[i]);
+		ESP_LOGI(TAG, "%s", line);
+	}
+}
+
 //main Task
 void Master_Task(void *pvParameters)
 {
+	//event group has to exist before the drivers start publishing
+	master_events_init(CONFIG_PSU_REFRESH_MS);
+	//deferred log, records written before are kept
+	blog_init(CONFIG_PSU_BLOG_DRAIN_MS);
 	// Initialize NVS
     NVS_init();
-	//Read calibration values from NVS
-	NVS_read_values("INA1_A_val", &INA_cal.INA1_A_val);
-	NVS_read_values("INA1_S_val", &INA_cal.INA1_S_val);
-	NVS_read_values("INA2_A_val", &INA_cal.INA2_A_val);
-	NVS_read_values("INA2_S_val", &INA_cal.INA2_S_val);
-
-	NVS_read_values("OUT24_cal", &ADC_cal.OUT24_cal);
-	NVS_read_values("OUT5_cal", &ADC_cal.OUT5_cal);
-	NVS_read_values("OUT33_cal", &ADC_cal.OUT33_cal);
-	NVS_read_values("OUTvar_cal", &ADC_cal.OUTvar_cal);
+	//Read calibration values from NVS, the ADC rails keep their nominal scale if none are stored
+	ADCD_cal_default(&ADC_cal);
+	NVS_read_calibration(&INA_cal, &ADC_cal);
 
 	//convert to doubles
 	INA1_S_val = (double)INA_cal.INA1_S_val;
 	INA1_A_val = ((double)INA_cal.INA1_A_val / 1000);
 	INA2_S_val = (double)INA_cal.INA2_S_val;
 	INA2_A_val = ((double)INA_cal.INA2_A_val / 1000);
-
-	out24_cal = ((double)ADC_cal.OUT24_cal / 1000);
-	out5_cal = ((double)ADC_cal.OUT5_cal / 1000);
-	out33_cal = ((double)ADC_cal.OUT33_cal / 1000);
-	outvar_cal = ((double)ADC_cal.OUTvar_cal / 1000);
 	
-	//initialize queue
-	stack_usage_queue = xQueueCreate( 10, sizeof( stack_usage_dataframe_t ) );
+	metrics_task_register(METRIC_TASK_MASTER);
+
+	//commands on the serial console
+	serial_cmd_register("metrics", "task, heap, I2C and SPI metrics", metrics_cmd);
+#if CONFIG_PSU_TASK_STATS
+	serial_cmd_register("tasks", "task list with core and run time statistics", task_stats_cmd);
+#endif
+	serial_cmd_register("i2c", "I2C statistics per device", i2c_stats_cmd);
+	serial_cmd_register("spi", "SPI statistics per device", spi_stats_cmd);
+	serial_cmd_register("spibench", "panel push times per SPI clock, spibench [pushes]", spi_bench_cmd);
+	serial_cmd_register("cal", "ADC calibration points per rail, raw:uV", cal_cmd);
+	serial_cmd_register("prof", "frame profile per page, prof [page] or prof reset", prof_cmd);
+	serial_cmd_register("idle", "display state times, idle active/dim/sleep forces a state", idle_cmd);
+	serial_cmd_init();
 
-	//check if queue is initialized
-	if(stack_usage_queue == NULL)
-	{
-		ESP_LOGW(TAG, "Stack queue was not created!");
-	}
-	if(stack_usage_queue)
-	{
-		ESP_LOGI(TAG, "Stack queue was created successfully!");
-	}
-    
 	//Init: Display, Buttons, IO and Buzzer
 	UI_init(I2C_PORT, SDA_GPIO, SCL_GPIO);	
+	//dim and switch off the display without activity
+	idle_init();
 
 	//Init INAs
 	INAD_init(I2C_PORT, SDA_GPIO, SCL_GPIO, INA_cal);
+	//wake the Master_Task as soon as a limit is exceeded
+	INAD_set_limits(Max_U_mV, Max_I_mA);
+
+	//Init sampler for the statistics pages
+	sampler_init(CONFIG_PSU_SAMPLE_PERIOD_MS);
 
 	//Init ADC
-	ADCD_init(I2C_PORT, SDA_GPIO, SCL_GPIO, ADC_cal);
+	ADCD_init(I2C_PORT, SDA_GPIO, SCL_GPIO, &ADC_cal);
+
+#if CONFIG_PSU_I2C_THROUGHPUT_TEST
+	//measure bus throughput at the port clock plan
+	i2cdev_throughput_test_all(I2C_PORT, CONFIG_PSU_I2C_THROUGHPUT_ITERATIONS);
+	i2cdev_stats_dump(I2C_PORT);
+#endif
+
+#if CONFIG_PSU_SPI_BENCHMARK
+	//measure panel push times at every SPI clock
+	UI_spi_benchmark(CONFIG_PSU_SPI_BENCHMARK_ITERATIONS);
+	metrics_spi_dump();
+#endif
 
 	//set all elements of arrays to 0
 	for(int i = 0; i < 100; i++)
@@ -205,21 +505,22 @@ void Master_Task(void *pvParameters)
 		i_val[i] = 0; 
 	}
 
-	//check sel press for calibrate screen
-	if(UI_get_press(sel)) 
+	page_engine_init(pages, PAGE_COUNT, PAGE_MAIN);
+
+	//check sel held for calibrate screen
+	if(UI_is_held(btn_sel)) 
 	{
-		page_select = calibrate_1;
-		page_select_last = calibrate_1;
-		ESP_LOGI(TAG, "Calibrate Screen entered");
+		page_engine_set_page(PAGE_CALIBRATE_1);
+		BLOG_I(MASTER_CALIBRATE);
 	}
 
-	//check sel press for calibrate screen
-	if(UI_get_press(left) && UI_get_press(right)) 
+	//check left and right held for test screen
+	if(UI_is_held(btn_left) && UI_is_held(btn_right)) 
 	{
-		page_select = test_1;
-		page_select_last = test_1;
-		ESP_LOGI(TAG, "Test Screen entered");
+		page_engine_set_page(PAGE_TEST_1);
+		BLOG_I(MASTER_TEST);
 	}
+	page_select_last = page_engine_get_page();
 
 	//set RGB_led values to zero
 	RGB_0.bright = 0;
@@ -232,580 +533,112 @@ void Master_Task(void *pvParameters)
 	RGB_1.blue = 0;
 
 	UI_reset_all_states();
+	//force the first frame and invalidate the LED state
+	RGB_0_last.bright = -1;
+	RGB_1_last.bright = -1;
+	master_events_set(EVT_INPUT);
+	frame_stats_start_us = esp_timer_get_time();
 
 	while(1) 
 	{
+		//sleep until a driver, the input or the refresh timer has something new
+		frame_events = master_events_wait(EVT_ALL, portMAX_DELAY);
+		int64_t frame_start_us = esp_timer_get_time();
+		profiler_frame_begin();
+
 		//measure values for overcurrent and overvoltage detection
 		power_val = INAD_getPower_mW(INA1);
 		voltage_val = INAD_getVShunt_mv(INA1);
 		current_val = INAD_getCurrent_mA(INA1);
 
-		switch(page_select)
+		//update button values from the input events
+		if(frame_events & EVT_INPUT) house_keeping_events();
+
+		//input, alarms and significant output changes keep the display on
+		bool alarm = voltage_val > Max_U_mV || current_val > Max_I_mA;
+		if((frame_events & (EVT_INPUT | EVT_ALARM)) || alarm ||
+			fabs(voltage_val - idle_voltage_ref) >= Max_U_mV * CONFIG_PSU_IDLE_WAKE_PERCENT / 100.0 ||
+			fabs(current_val - idle_current_ref) >= Max_I_mA * CONFIG_PSU_IDLE_WAKE_PERCENT / 100.0)
 		{
-			case calibrate_1:
-				calibrate_1_func();
-			break;
-			case calibrate_2:
-				calibrate_2_func();
-			break;
-			case main:
-				main_func();
-			break;	
-			case voltage:
-				voltages_func();
-			break;
-			case variable:
-				variable_func();
-			break;
-			case statistics_p:
-				statistics_p_func();
-			break;
-			case statistics_u:
-				statistics_u_func();
-			break;
-			case statistics_i:
-				statistics_i_func();
-			break;
-			case tcbus:
-				tcbus_func();
-			break;
-			case test_1:
-				test_func_1();
-			break;
-			case test_2:
-				test_func_2();
-			break;
+			//the input that wakes the display is not handled by the page
+			if(idle_activity()) memset(&page_input, 0, sizeof(page_input));
+			idle_voltage_ref = voltage_val;
+			idle_current_ref = current_val;
 		}
-		//do everything that needs to be done every loop (including the delay)
-		house_keeping();
-	}
+		idle_update();
 
-	// never reach
-	while (1) {
-		vTaskDelay(2000 / portTICK_PERIOD_MS);
-	}
-}
-
-void calibrate_1_func(void)
-{
-	//value selection up
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		if(value_select > 0) value_select--;
-		else if(value_select == 0) value_select = 3;
-	}
-	//value selection down
-	if(down_press)
-	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		if(value_select < 3) value_select++;
-		else if(value_select == 3) value_select = 0;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//save difference in temporary variable
-		double diff_count_temp = ENC_count - ENC_count_last;
-		//add difference to selected value
-		switch(value_select)
+		//SPI benchmark from the console, wakes the display for the visual check
+		if(spi_bench_iterations)
 		{
-			case 0: 
-				if((INA1_S_val + diff_count_temp) > 0) INA1_S_val += diff_count_temp; 
-			break;
-			case 1: 
-				if((INA1_A_val + diff_count_temp) > -1) INA1_A_val += diff_count_temp / 10; 
-			break;
-			case 2: 
-				if((INA2_S_val + diff_count_temp) > 0) INA2_S_val += diff_count_temp; 
-			break;
-			case 3:
-				if((INA2_A_val + diff_count_temp) > -1) INA2_A_val += diff_count_temp / 10; 
-			break;
+			int iterations = spi_bench_iterations;
+			spi_bench_iterations = 0;
+			idle_activity();
+			UI_spi_benchmark(iterations);
+			metrics_spi_dump();
+			page_engine_invalidate();
 		}
-	}
-	//exit page
-	if(select_press > 1)
-	{
-		INA_cal.INA1_S_val = (int32_t)INA1_S_val;
-		INA_cal.INA1_A_val = (int32_t)(INA1_A_val*1000);
-		INA_cal.INA2_S_val = (int32_t)INA2_S_val;
-		INA_cal.INA2_A_val = (int32_t)(INA2_A_val*1000);
-
-		ADC_cal.OUT24_cal = (int32_t)(out24_cal * 1000);
-		ADC_cal.OUT5_cal = (int32_t)(out5_cal * 1000);
-		ADC_cal.OUT33_cal = (int32_t)(out33_cal * 1000);
-		ADC_cal.OUTvar_cal = (int32_t)(outvar_cal * 1000);
-
-		UI_Buzzer_beep();
 
-		NVS_write_values("INA1_S_val", INA_cal.INA1_S_val);
-		NVS_write_values("INA1_A_val", INA_cal.INA1_A_val);
-		NVS_write_values("INA2_S_val", INA_cal.INA2_S_val);
-		NVS_write_values("INA2_A_val", INA_cal.INA2_A_val);
+		//handle input, update and draw the current page, nothing is drawn while the display sleeps
+		bool rendered = 0;
+		if(idle_get_state() != IDLE_SLEEP) rendered = page_engine_run(frame_events, &page_input);
 
-		NVS_write_values("OUT24_cal", ADC_cal.OUT24_cal);
-		NVS_write_values("OUT5_cal", ADC_cal.OUT5_cal);
-		NVS_write_values("OUT33_cal", ADC_cal.OUT33_cal);
-		NVS_write_values("OUTvar_cal", ADC_cal.OUTvar_cal);
+		//do everything that needs to be done every loop
+		house_keeping(rendered);
+		if(rendered) profiler_frame_end(page_engine_get_page());
 
-		page_select = main;
-	}
-
-	if(left_press || right_press)
-	{
-		page_select = calibrate_2;
-	}
-	//draw Screen
-	UI_draw_calibrate_screen_1(INA1_S_val, INA1_A_val, INA2_S_val, INA2_A_val, value_select);
-}
-void calibrate_2_func(void)
-{
-	//value selection up
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		if(value_select > 0) value_select--;
-		else if(value_select == 0) value_select = 3;
-	}
-	//value selection down
-	if(down_press)
-	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		if(value_select < 3) value_select++;
-		else if(value_select == 3) value_select = 0;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//save difference in temporary variable
-		double diff_count_temp = ((double)(ENC_count - ENC_count_last)) / 100;
-		ESP_LOGE(TAG, "-------> %f", diff_count_temp);
-		//add difference to selected value
-		switch(value_select)
+		//log frame rate, idle time and free heap every few seconds
+		int64_t now = esp_timer_get_time();
+		frame_busy_us += now - frame_start_us;
+		if(now - frame_stats_start_us >= FRAME_STATS_INTERVAL_US)
 		{
-			case 0: 
-				if((out24_cal + diff_count_temp) > -1) out24_cal += diff_count_temp; 
-			break;
-			case 1: 
-				if((out5_cal + diff_count_temp) > -1) out5_cal += diff_count_temp; 
-			break;
-			case 2: 
-				if((out33_cal + diff_count_temp) > -1) out33_cal += diff_count_temp; 
-			break;
-			case 3:
-				if((outvar_cal + diff_count_temp) > -1) outvar_cal += diff_count_temp; 
-			break;
+			int64_t period_us = now - frame_stats_start_us;
+			BLOG_I(MASTER_FRAME_STATS, BLOG_INT(frame_count * 1000000LL / period_us), BLOG_INT((frame_count * 10000000LL / period_us) % 10),
+				BLOG_INT(100 - frame_busy_us * 100 / period_us), BLOG_INT(xPortGetFreeHeapSize()));
+			sampler_stats_t sampler_stats;
+			sampler_get_stats(&sampler_stats);
+			BLOG_I(MASTER_SAMPLER_STATS, BLOG_INT(sampler_stats.samples), BLOG_INT(sampler_stats.jitter_min_us),
+				BLOG_INT(sampler_stats.jitter_max_us), BLOG_INT(sampler_stats.jitter_avg_us), BLOG_INT(sampler_stats.overruns));
+			frame_count = 0;
+			frame_busy_us = 0;
+			frame_stats_start_us = now;
 		}
 	}
-	//exit page
-	if(select_press > 1)
-	{
-		INA_cal.INA1_S_val = (uint32_t)INA1_S_val;
-		INA_cal.INA1_A_val = (uint32_t)(INA1_A_val*1000);
-		INA_cal.INA2_S_val = (uint32_t)INA2_S_val;
-		INA_cal.INA2_A_val = (uint32_t)(INA2_A_val*1000);
-
-		ADC_cal.OUT24_cal = (int32_t)(out24_cal * 1000);
-		ADC_cal.OUT5_cal = (int32_t)(out5_cal * 1000);
-		ADC_cal.OUT33_cal = (int32_t)(out33_cal * 1000);
-		ADC_cal.OUTvar_cal = (int32_t)(outvar_cal * 1000);
-
-		UI_Buzzer_beep();
-		NVS_write_values("INA1_S_val", INA_cal.INA1_S_val);
-		NVS_write_values("INA1_A_val", INA_cal.INA1_A_val);
-		NVS_write_values("INA2_S_val", INA_cal.INA2_S_val);
-		NVS_write_values("INA2_A_val", INA_cal.INA2_A_val);
-
-		NVS_write_values("OUT24_cal", ADC_cal.OUT24_cal);
-		NVS_write_values("OUT5_cal", ADC_cal.OUT5_cal);
-		NVS_write_values("OUT33_cal", ADC_cal.OUT33_cal);
-		NVS_write_values("OUTvar_cal", ADC_cal.OUTvar_cal);
-		page_select = main;
-	}
 
-	if(left_press || right_press)
-	{
-		page_select = calibrate_1;
-	}
-	//draw Screen
-	UI_draw_calibrate_screen_2(out24_cal, out5_cal, out33_cal, outvar_cal, value_select);
-}
-void main_func(void)
-{
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		output_val = !output_val;
-	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = tcbus;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = voltage;
+	// never reach
+	while (1) {
+		vTaskDelay(2000 / portTICK_PERIOD_MS);
 	}
-	//draw Screen
-	UI_draw_main_screen(power_val, voltage_val, current_val, output_val);
 }
-void voltages_func(void)
-{
-	out24_val = ADCD_get_volt(1);
-	out5_val = ADCD_get_volt(2);
-	out33_val = ADCD_get_volt(3);
-	outvar_val = ADCD_get_volt(4);
 
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		output_val = !output_val;
-	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = main;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = variable;
-	}
-	//draw Screen
-	UI_draw_voltages_screen(out24_val, out5_val, outvar_val, out33_val, output_val);
-}
-void variable_func(void)
-{
-	//value selection up
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		value_select = !value_select;
-	}
-	//value selection down
-	if(down_press)
-	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		value_select = !value_select;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//save difference in temporary variable
-		double diff_count_temp = ENC_count - ENC_count_last;
-		//add difference to selected value
-		switch(value_select)
-		{
-			case 0: 
-				diff_count_temp = diff_count_temp / 10;
-				if((uset_val + diff_count_temp) >= 0) uset_val += diff_count_temp; 
-			break;
-			case 1: 
-				output_val = !output_val;
-			break;
-		}
-	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = voltage;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = statistics_p;
-	}
-	//draw Screen
-	UI_draw_variable_screen(uset_val, ueff_val, value_select, output_val);
-}
-void statistics_p_func(void)
-{
-	//get values for p_val
-	for(int i = 0; i < 50; i++)
-	{
-		p_val[i] = p_val[i+1]; 
-	}
-	p_val[49] = (power_val/Max_P_mW*60);
-	//value selection up
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		value_select = !value_select;
-	}
-	//value selection down
-	if(down_press)
-	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		value_select = !value_select;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//save difference in temporary variable
-		double diff_count_temp = ENC_count - ENC_count_last;
-		//add difference to selected value
-		switch(value_select)
-		{
-			case 0: 
-				if((division_select + diff_count_temp) >= 0 && (division_select + diff_count_temp) < 4) division_select += diff_count_temp; 
-			break;
-			case 1: 
-				output_val = !output_val;
-			break;
-		}
-	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = variable;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = statistics_u;
-	}
-	//draw Screen
-	UI_draw_statistics_screen(p_val, 0, division_select, value_select, output_val);
-}
-void statistics_u_func(void)
-{
-	//get values for p_val
-	for(int i = 0; i < 50; i++)
-	{
-		u_val[i] = u_val[i+1]; 
-	}
-	u_val[49] = (voltage_val/Max_U_mV*60);
-	//value selection up
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		value_select = !value_select;
-	}
-	//value selection down
-	if(down_press)
-	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		value_select = !value_select;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//save difference in temporary variable
-		double diff_count_temp = ENC_count - ENC_count_last;
-		//add difference to selected value
-		switch(value_select)
-		{
-			case 0: 
-				if((division_select + diff_count_temp) >= 0 && (division_select + diff_count_temp) < 4) division_select += diff_count_temp; 
-			break;
-			case 1: 
-				output_val = !output_val;
-			break;
-		}
-	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = statistics_p;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = statistics_i;
-	}
-	//draw Screen
-	UI_draw_statistics_screen(u_val, 1, division_select, value_select, output_val);
-}
-void statistics_i_func(void)
+void house_keeping_events(void)
 {
-	//get values for p_val
-	for(int i = 0; i < 50; i++)
-	{
-		i_val[i] = i_val[i+1]; 
-	}
-	i_val[49] = (current_val/Max_I_mA*60);
-	//value selection up+
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		value_select = !value_select;
-	}
-	//value selection down
-	if(down_press)
+	PROF_BEGIN();
+	button_event_t event;
+	int64_t now = esp_timer_get_time();
+	//drain all events since the last frame
+	while(UI_get_event(&event))
 	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		value_select = !value_select;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//save difference in temporary variable
-		double diff_count_temp = ENC_count - ENC_count_last;
-		//add difference to selected value
-		switch(value_select)
+		switch(event.type)
 		{
-			case 0: 
-				if((division_select + diff_count_temp) >= 0 && (division_select + diff_count_temp) < 4) division_select += diff_count_temp; 
-			break;
-			case 1: 
-				output_val = !output_val;
+			case BTN_EVT_SHORT:
+				if(page_input.press[event.button] == 0) page_input.press[event.button] = 1;
 			break;
-		}
-	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = statistics_u;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = tcbus;
-	}
-	//draw Screen
-	UI_draw_statistics_screen(i_val, 2, division_select, value_select, output_val);
-}
-void tcbus_func(void)
-{
-	//value selection up
-	if(up_press)
-	{
-		UI_Buzzer_beep();
-		up_press = 0;
-		if(value_select > 0) value_select--;
-		else if(value_select == 0) value_select = 3;
-	}
-	//value selection down
-	if(down_press)
-	{
-		UI_Buzzer_beep();
-		down_press = 0;
-		if(value_select < 2) value_select++;
-		else if(value_select == 2) value_select = 0;
-	}
-	//change value
-	if(ENC_count != ENC_count_last)
-	{
-		UI_Buzzer_beep();
-		//add difference to selected value
-		switch(value_select)
-		{
-			case 0: 
-				TC_EN_val = !TC_EN_val;
+			case BTN_EVT_LONG:
+				page_input.press[event.button] = 2;
 			break;
-			case 1: 
-				TC_NFON_val = !TC_NFON_val;
+			case BTN_EVT_ENC:
+				page_input.enc_diff += event.delta;
 			break;
-			case 2: 
-				output_val = !output_val;
+			default:
 			break;
 		}
+		//end-to-end latency from input read to this frame
+		input_latency_last_us = now - event.timestamp_us;
+		if(input_latency_last_us > input_latency_max_us) input_latency_max_us = input_latency_last_us;
 	}
-	//change page -
-	if(left_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = statistics_i;
-	}
-	//change page +
-	if(right_press > 0)
-	{
-		UI_Buzzer_beep();
-		page_select = main;
-	}
-	//draw Screen
-	UI_draw_tcbus_screen(TC_EN_val, TC_NFON_val, output_val, value_select);
-}
-void test_func_1(void)
-{
-	adc1_read = ADCD_get(1);
-	adc2_read = ADCD_get(2);
-	adc3_read = ADCD_get(3);
-	adc4_read = ADCD_get(4);
-	adc5_read = ADCD_get(5);
-	//change page +
-	if(select_press > 1)
-	{
-		UI_Buzzer_beep();
-		page_select = main;
-	}
-	if(right_press || left_press)
-	{
-		UI_Buzzer_beep();
-		page_select = test_2;
-	}
-	//draw Screen
-	UI_draw_test_screen_1(adc1_read, adc2_read, adc3_read, adc4_read, adc5_read);
-}
-void test_func_2(void)
-{
-	xQueueReceive(stack_usage_queue, &stack_temp, 0);
-	switch(stack_temp.task_num)
-	{
-		break;
-		case ADC_TASK:
-			stack_ADC_size = stack_temp.size;
-		break;
-		case INA_TASK:
-			stack_INA_size = stack_temp.size;
-		break;
-		case BUTTON_TASK:
-			stack_button_size = stack_temp.size;
-		break;
-		case IO_TASK:
-			stack_IO_size = stack_temp.size;
-		break;
-	}
-
-	//change page +
-	if(select_press > 1)
-	{
-		UI_Buzzer_beep();
-		page_select = main;
-	}
-	if(right_press || left_press)
-	{
-		UI_Buzzer_beep();
-		page_select = test_1;
-	}
-	//draw Screen
-	UI_draw_test_screen_2(stack_master_size, stack_ADC_size, stack_INA_size, stack_button_size, stack_IO_size);
+	PROF_END(PROF_INPUT);
 }
-void house_keeping(void)
+void house_keeping(bool rendered)
 {
 	//set Expander value for TC_NFON anf TC_EN
 	if(TC_EN_val) UI_set_TC_EN(1);
@@ -817,8 +650,8 @@ void house_keeping(void)
 	{
 		//Buzzer on
 		UI_Buzzer_power(1);
-		//toggle Siren mode
-		siren_toggle = !siren_toggle;
+		//toggle Siren mode with the refresh period
+		if(frame_events & EVT_REFRESH) siren_toggle = !siren_toggle;
 
 		//RGB0 red and low tone
 		if(siren_toggle)
@@ -878,49 +711,40 @@ void house_keeping(void)
 			RGB_1.blue = 200; 
 		}
 	}
-	//update RGB LEDs
-	UI_set_RGB(0, RGB_0.bright, RGB_0.red, RGB_0.green, RGB_0.blue);
-	UI_set_RGB(1, RGB_1.bright, RGB_1.red, RGB_1.green, RGB_1.blue);
+	//update RGB LEDs only if they changed
+	if(memcmp(&RGB_0, &RGB_0_last, sizeof(APA102_t)) || memcmp(&RGB_1, &RGB_1_last, sizeof(APA102_t)))
+	{
+		UI_set_RGB(0, RGB_0.bright, RGB_0.red, RGB_0.green, RGB_0.blue);
+		UI_set_RGB(1, RGB_1.bright, RGB_1.red, RGB_1.green, RGB_1.blue);
+		RGB_0_last = RGB_0;
+		RGB_1_last = RGB_1;
+	}
 	//update Display
-	UI_Update();
-	//write last state for detecting change
-	ENC_count_last = ENC_count;
-	//if page is the same, update button values
-	if(page_select == page_select_last)
+	if(rendered)
 	{
-		up_press = UI_get_press(up); 
-		down_press = UI_get_press(down);
-		left_press = UI_get_press(left);
-		right_press = UI_get_press(right);
-		select_press = UI_get_press(sel);
-		ENC_count = UI_get_ENC();
+		UI_Update();
+		frame_count++;
 	}
+	//input is consumed by the page
+	memset(&page_input, 0, sizeof(page_input));
 	//if state changed, reset all Buttons
-	if(page_select != page_select_last)
+	if(page_engine_get_page() != page_select_last)
 	{
+		BLOG_D(MASTER_INPUT_LATENCY, BLOG_INT(input_latency_last_us), BLOG_INT(input_latency_max_us));
 		UI_reset_all_states();
-		up_press = 0;
-		down_press = 0;
-		left_press = 0;
-		right_press = 0;
-		select_press = 0;
-		value_select = 0;
 		division_select = 0;
-		ENC_count = 0;
-		ENC_count_last = 0;
 	}
 	//write last state for detecting change
-	page_select_last = page_select;
-	//Display free Heap size
-	ESP_LOGI(__FUNCTION__, "Free Heap size: %d\n", xPortGetFreeHeapSize());
-	//send free stack of task to queue
-	stack_master_size = uxTaskGetStackHighWaterMark(master_task);
-	
-	vTaskDelay(3 / portTICK_PERIOD_MS);
+	page_select_last = page_engine_get_page();
+	//update loop period and free stack of task
+	metrics_task_loop(METRIC_TASK_MASTER);
 }
 
 void app_main(void)
 {
+	//fonts and images mapped from flash, SPIFFS is the fallback
+	bool assets = assets_init();
+
 	ESP_LOGI(TAG, "Initializing SPIFFS");
 	//Initialize Spiffs
 	esp_vfs_spiffs_conf_t conf = {
@@ -946,19 +770,21 @@ void app_main(void)
 		} else {
 			ESP_LOGE(TAG, "Failed to initialize SPIFFS (%s)",esp_err_to_name(ret));
 		}
-		return;
-	}
-	//Display Spiff Information
-	size_t total = 0, used = 0;
-	ret = esp_spiffs_info(NULL, &total,&used);
-	if (ret != ESP_OK) {
-		ESP_LOGE(TAG,"Failed to get SPIFFS partition information (%s)",esp_err_to_name(ret));
+		//nothing to draw with
+		if(!assets) return;
 	} else {
-		ESP_LOGI(TAG,"Partition size: total: %d, used: %d", total, used);
+		//Display Spiff Information
+		size_t total = 0, used = 0;
+		ret = esp_spiffs_info(NULL, &total,&used);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG,"Failed to get SPIFFS partition information (%s)",esp_err_to_name(ret));
+		} else {
+			ESP_LOGI(TAG,"Partition size: total: %zu, used: %zu", total, used);
+		}
+		//Define SPiff Directories as /spiffs/...
+		SPIFFS_Directory("/spiffs/");
 	}
-	//Define SPiff Directories as /spiffs/...
-	SPIFFS_Directory("/spiffs/");
 
 	//Create Main Task
-	xTaskCreate(Master_Task, "Master_Task", 1024*8, NULL, 2, master_task);
+	xTaskCreatePinnedToCore(Master_Task, "Master_Task", 1024*8, NULL, CONFIG_PSU_UI_PRIORITY, &master_task, CONFIG_PSU_UI_CORE);
 }
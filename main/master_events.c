@@ -0,0 +1,90 @@
+#include "stdio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/timers.h"
+#include "esp_log.h"
+#include "master_events.h"
+
+static const char *TAG = "Master_Events";
+
+//Event group shared by the drivers and the Master_Task
+static EventGroupHandle_t master_event_group = NULL;
+
+//Timer for periodic page refresh
+static TimerHandle_t refresh_timer = NULL;
+
+/**
+ * Internal function, do not use!!
+ * Refresh timer callback, sets the refresh bit.
+ * @param timer unused
+ * @endcode
+ */
+static void master_events_refresh(TimerHandle_t timer)
+{
+	xEventGroupSetBits(master_event_group, EVT_REFRESH);
+}
+
+/**
+ * Creates the event group and starts the page refresh timer.
+ * Must be called before the driver tasks are created.
+ * @param refresh_ms period of the refresh bit in ms
+ * @endcode
+ * \ingroup Master_Events
+ */
+void master_events_init(uint32_t refresh_ms)
+{
+	master_event_group = xEventGroupCreate();
+	if(master_event_group == NULL)
+	{
+		ESP_LOGE(TAG, "Event group was not created!");
+		return;
+	}
+	refresh_timer = xTimerCreate("refresh", refresh_ms / portTICK_PERIOD_MS, pdTRUE, NULL, master_events_refresh);
+	if(refresh_timer == NULL || xTimerStart(refresh_timer, 0) != pdPASS)
+	{
+		ESP_LOGE(TAG, "Refresh timer was not started!");
+	}
+}
+
+/**
+ * Changes the period of the refresh bit, the idle manager slows it down.
+ * @param refresh_ms new period in ms, 0 stops the refresh bit
+ * @endcode
+ * \ingroup Master_Events
+ */
+void master_events_set_refresh(uint32_t refresh_ms)
+{
+	if(refresh_timer == NULL) return;
+	if(refresh_ms == 0)
+	{
+		xTimerStop(refresh_timer, portMAX_DELAY);
+		return;
+	}
+	//also starts a stopped timer
+	xTimerChangePeriod(refresh_timer, refresh_ms / portTICK_PERIOD_MS, portMAX_DELAY);
+}
+
+/**
+ * Sets event bits and wakes the Master_Task. Does nothing before master_events_init().
+ * @param bits event bits to set
+ * @endcode
+ * \ingroup Master_Events
+ */
+void master_events_set(EventBits_t bits)
+{
+	if(master_event_group) xEventGroupSetBits(master_event_group, bits);
+}
+
+/**
+ * Waits until one of the event bits is set and clears them.
+ * @param bits event bits to wait for
+ * @param timeout ticks to wait at most
+ * @return event bits that were set, 0 on timeout
+ * @endcode
+ * \ingroup Master_Events
+ */
+EventBits_t master_events_wait(EventBits_t bits, TickType_t timeout)
+{
+	if(master_event_group == NULL) return bits;
+	return xEventGroupWaitBits(master_event_group, bits, pdTRUE, pdFALSE, timeout) & bits;
+}
@@ -0,0 +1,21 @@
+#ifndef MAIN_MASTER_EVENTS_H_
+#define MAIN_MASTER_EVENTS_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+//event bits that wake the Master_Task
+#define EVT_INA_DATA    (1 << 0)
+#define EVT_ADC_DATA    (1 << 1)
+#define EVT_INPUT       (1 << 2)
+#define EVT_ALARM       (1 << 3)
+#define EVT_REFRESH     (1 << 4)
+#define EVT_SAMPLE      (1 << 5)
+#define EVT_ALL         (EVT_INA_DATA | EVT_ADC_DATA | EVT_INPUT | EVT_ALARM | EVT_REFRESH | EVT_SAMPLE)
+
+void master_events_init(uint32_t refresh_ms);
+void master_events_set_refresh(uint32_t refresh_ms);
+void master_events_set(EventBits_t bits);
+EventBits_t master_events_wait(EventBits_t bits, TickType_t timeout);
+
+#endif
@@ -0,0 +1,204 @@
+#include "stdio.h"
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "i2cdev.h"
+#include "metrics.h"
+
+static const char *TAG = "Metrics";
+
+//I2C port of the PSU bus
+#define METRICS_I2C_PORT 0
+
+//stack high water mark is measured every n loops, it scans the stack
+#define METRICS_STACK_INTERVAL 16
+
+//names of the task slots
+static const char *metric_task_names[METRIC_TASK_COUNT] = {
+	[METRIC_TASK_MASTER] = "Master_Task",
+	[METRIC_TASK_ADC] = "ADCD_handler",
+	[METRIC_TASK_INA] = "INAD_handler",
+	[METRIC_TASK_BUTTON] = "Button_handler",
+	[METRIC_TASK_IO] = "IO_handler",
+	[METRIC_TASK_SAMPLER] = "sampler_handler",
+};
+
+//names of the counter slots
+static const char *metric_counter_names[METRIC_COUNTER_COUNT] = {
+	[METRIC_SPI_LCD_TRANSACTIONS] = "SPI LCD transactions",
+	[METRIC_SPI_LCD_BYTES] = "SPI LCD bytes",
+	[METRIC_SPI_LCD_BLOCKED_US] = "SPI LCD blocked us",
+	[METRIC_SPI_LCD_DC_TOGGLES] = "SPI LCD DC toggles",
+	[METRIC_SPI_LED_TRANSACTIONS] = "SPI LED transactions",
+	[METRIC_SPI_LED_BYTES] = "SPI LED bytes",
+	[METRIC_SPI_LED_BLOCKED_US] = "SPI LED blocked us",
+};
+
+//registry, slots are written without locks by their owner
+static metric_task_t metric_tasks[METRIC_TASK_COUNT];
+static volatile uint32_t metric_counters[METRIC_COUNTER_COUNT];
+
+//run time of the last cpu update
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static uint32_t metric_runtime_last[METRIC_TASK_COUNT];
+static uint32_t metric_total_last = 0;
+#endif
+
+/**
+ * Registers the calling task in its slot. Must be called by the task itself.
+ * @param id slot of the task
+ * @endcode
+ * \ingroup Metrics
+ */
+void metrics_task_register(metric_task_id_t id)
+{
+	if(id >= METRIC_TASK_COUNT) return;
+	metric_tasks[id].handle = xTaskGetCurrentTaskHandle();
+	metric_tasks[id].stack_hwm = uxTaskGetStackHighWaterMark(NULL);
+	metric_tasks[id].last_us = esp_timer_get_time();
+}
+
+/**
+ * Updates loop count, loop period and stack high water mark of a task.
+ * Call once per loop from the task itself, no lock is taken.
+ * @param id slot of the task
+ * @endcode
+ * \ingroup Metrics
+ */
+void metrics_task_loop(metric_task_id_t id)
+{
+	if(id >= METRIC_TASK_COUNT) return;
+	metric_task_t *task = &metric_tasks[id];
+	int64_t now = esp_timer_get_time();
+	uint32_t period = (uint32_t)(now - task->last_us);
+	task->last_us = now;
+	task->period_us = period;
+	if(period > task->period_max_us) task->period_max_us = period;
+	if((task->loops++ % METRICS_STACK_INTERVAL) == 0) task->stack_hwm = uxTaskGetStackHighWaterMark(NULL);
+}
+
+/**
+ * Adds to a counter. No lock is taken, the caller must be the only writer at a time.
+ * @param id slot of the counter
+ * @param value value to add
+ * @endcode
+ * \ingroup Metrics
+ */
+void metrics_counter_add(metric_counter_id_t id, uint32_t value)
+{
+	if(id >= METRIC_COUNTER_COUNT) return;
+	metric_counters[id] += value;
+}
+
+/**
+ * Copies the metrics of a task. Values are 32bit words, so each one is consistent on its own.
+ * @param id slot of the task
+ * @param task struct to copy to
+ * @return false if the task was not registered
+ * @endcode
+ * \ingroup Metrics
+ */
+bool metrics_get_task(metric_task_id_t id, metric_task_t *task)
+{
+	if(id >= METRIC_TASK_COUNT) return 0;
+	*task = metric_tasks[id];
+	return task->handle != NULL;
+}
+
+/**
+ * @param id slot of the counter
+ * @return value of the counter
+ * @endcode
+ * \ingroup Metrics
+ */
+uint32_t metrics_get_counter(metric_counter_id_t id)
+{
+	if(id >= METRIC_COUNTER_COUNT) return 0;
+	return metric_counters[id];
+}
+
+/**
+ * Updates the cpu load of all registered tasks since the last call.
+ * Needs the FreeRTOS trace facility and run time statistics, otherwise the load stays 0.
+ * @endcode
+ * \ingroup Metrics
+ */
+void metrics_update_cpu(void)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+	UBaseType_t count = uxTaskGetNumberOfTasks();
+	TaskStatus_t *status = malloc(count * sizeof(TaskStatus_t));
+	if(status == NULL) return;
+	uint32_t total = 0;
+	count = uxTaskGetSystemState(status, count, &total);
+	uint32_t total_diff = total - metric_total_last;
+	metric_total_last = total;
+	for(int id = 0; id < METRIC_TASK_COUNT; id++)
+	{
+		for(int i = 0; i < count; i++)
+		{
+			if(status[i].xHandle != metric_tasks[id].handle || metric_tasks[id].handle == NULL) continue;
+			uint32_t diff = status[i].ulRunTimeCounter - metric_runtime_last[id];
+			metric_runtime_last[id] = status[i].ulRunTimeCounter;
+			//load of one core
+			metric_tasks[id].cpu_percent = total_diff ? (uint32_t)((uint64_t)diff * 100 / total_diff) : 0;
+		}
+	}
+	free(status);
+#endif
+}
+
+/**
+ * Logs the whole registry: tasks, heap, I2C and SPI counters.
+ * @endcode
+ * \ingroup Metrics
+ */
+void metrics_dump(void)
+{
+	metric_task_t task;
+	metrics_update_cpu();
+	ESP_LOGI(TAG, "Task             stack   loops  period_us  max_us  cpu");
+	for(int id = 0; id < METRIC_TASK_COUNT; id++)
+	{
+		if(!metrics_get_task(id, &task)) continue;
+		ESP_LOGI(TAG, "%-16s %5u %7u %10u %7u %3u%%", metric_task_names[id], task.stack_hwm, task.loops,
+			task.period_us, task.period_max_us, task.cpu_percent);
+	}
+	ESP_LOGI(TAG, "Heap free %u, minimum %u, DMA free %zu", esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+		heap_caps_get_free_size(MALLOC_CAP_DMA));
+
+	i2c_dev_stats_t i2c;
+	if(i2cdev_get_port_stats(METRICS_I2C_PORT, &i2c) == ESP_OK)
+	{
+		ESP_LOGI(TAG, "I2C transactions %u, errors %u, recoveries %u, p99 %u us", i2c.transactions, i2c.errors,
+			i2c.recoveries, i2c_dev_stats_percentile(&i2c, 99));
+	}
+	for(int id = 0; id < METRIC_COUNTER_COUNT; id++)
+	{
+		ESP_LOGI(TAG, "%s %u", metric_counter_names[id], metrics_get_counter(id));
+	}
+}
+
+/**
+ * Logs the SPI counters per device. Blocked is the time the writing task waited
+ * for the bus, DC toggles are command/data changes between LCD transactions.
+ * @endcode
+ * \ingroup Metrics
+ */
+void metrics_spi_dump(void)
+{
+	uint32_t lcd_trans = metrics_get_counter(METRIC_SPI_LCD_TRANSACTIONS);
+	uint32_t led_trans = metrics_get_counter(METRIC_SPI_LED_TRANSACTIONS);
+	ESP_LOGI(TAG, "SPI  transactions      bytes  bytes/trans  blocked_ms  dc_toggles");
+	ESP_LOGI(TAG, "LCD  %12u %10u %12u %11u %11u", lcd_trans, metrics_get_counter(METRIC_SPI_LCD_BYTES),
+		lcd_trans ? metrics_get_counter(METRIC_SPI_LCD_BYTES) / lcd_trans : 0,
+		metrics_get_counter(METRIC_SPI_LCD_BLOCKED_US) / 1000, metrics_get_counter(METRIC_SPI_LCD_DC_TOGGLES));
+	ESP_LOGI(TAG, "LED  %12u %10u %12u %11u %11s", led_trans, metrics_get_counter(METRIC_SPI_LED_BYTES),
+		led_trans ? metrics_get_counter(METRIC_SPI_LED_BYTES) / led_trans : 0,
+		metrics_get_counter(METRIC_SPI_LED_BLOCKED_US) / 1000, "-");
+}
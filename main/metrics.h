@@ -0,0 +1,52 @@
+#ifndef MAIN_METRICS_H_
+#define MAIN_METRICS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+//fixed task slots of the registry
+typedef enum {
+	METRIC_TASK_MASTER,
+	METRIC_TASK_ADC,
+	METRIC_TASK_INA,
+	METRIC_TASK_BUTTON,
+	METRIC_TASK_IO,
+	METRIC_TASK_SAMPLER,
+	METRIC_TASK_COUNT,
+} metric_task_id_t;
+
+//fixed counter slots of the registry, each counter has one writer at a time
+typedef enum {
+	METRIC_SPI_LCD_TRANSACTIONS,
+	METRIC_SPI_LCD_BYTES,
+	METRIC_SPI_LCD_BLOCKED_US,
+	METRIC_SPI_LCD_DC_TOGGLES,
+	METRIC_SPI_LED_TRANSACTIONS,
+	METRIC_SPI_LED_BYTES,
+	METRIC_SPI_LED_BLOCKED_US,
+	METRIC_COUNTER_COUNT,
+} metric_counter_id_t;
+
+//metrics of one task, only written by the task itself
+typedef struct {
+	TaskHandle_t handle;
+	uint32_t stack_hwm;
+	uint32_t loops;
+	uint32_t period_us;
+	uint32_t period_max_us;
+	int64_t last_us;
+	uint32_t cpu_percent;
+} metric_task_t;
+
+void metrics_task_register(metric_task_id_t id);
+void metrics_task_loop(metric_task_id_t id);
+void metrics_counter_add(metric_counter_id_t id, uint32_t value);
+bool metrics_get_task(metric_task_id_t id, metric_task_t *task);
+uint32_t metrics_get_counter(metric_counter_id_t id);
+void metrics_update_cpu(void);
+void metrics_dump(void);
+void metrics_spi_dump(void);
+
+#endif
@@ -0,0 +1,222 @@
+#include "stdio.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "UI_driver.h"
+#include "Button_driver.h"
+#include "master_events.h"
+#include "page_engine.h"
+
+static const char *TAG = "Page_Engine";
+
+//page table and state of the engine
+static const page_t *page_table = NULL;
+static int page_table_count = 0;
+static int page_current = 0;
+static int page_value_select = 0;
+//page was entered and has not been drawn yet
+static bool page_entered = 0;
+//data of the page changed since the last draw
+static bool page_data_pending = 0;
+static int64_t page_last_draw_us = 0;
+//lower bound of the refresh period of all pages, raised while the unit is idle
+static uint32_t page_min_refresh_ms = 0;
+
+/**
+ * Internal function, do not use!!
+ * Changes a field by a number of encoder steps and limits it to its range.
+ * @param field field to change
+ * @param diff encoder steps since the last frame
+ * @endcode
+ */
+static void page_engine_edit(const page_field_t *field, int32_t diff)
+{
+	double temp;
+	switch(field->type)
+	{
+		case FIELD_DOUBLE:
+			temp = *(double *)field->value + diff * field->step;
+			if(temp < field->min) temp = field->min;
+			if(temp > field->max) temp = field->max;
+			*(double *)field->value = temp;
+		break;
+		case FIELD_INT:
+			temp = *(int *)field->value + diff * field->step;
+			if(temp < field->min) temp = field->min;
+			if(temp > field->max) temp = field->max;
+			*(int *)field->value = (int)temp;
+		break;
+		case FIELD_TOGGLE:
+			*(bool *)field->value = !*(bool *)field->value;
+		break;
+	}
+}
+
+/**
+ * Internal function, do not use!!
+ * Handles the input of one frame on the current page.
+ * @param page current page
+ * @param input presses and encoder steps of the frame
+ * @endcode
+ */
+static void page_engine_input(const page_t *page, const page_input_t *input)
+{
+	//value selection up, wraps around
+	if(input->press[btn_up] && page->field_count > 1)
+	{
+		UI_Buzzer_beep();
+		if(page_value_select > 0) page_value_select--;
+		else page_value_select = page->field_count - 1;
+	}
+	//value selection down, wraps around
+	if(input->press[btn_down] && page->field_count > 1)
+	{
+		UI_Buzzer_beep();
+		if(page_value_select < page->field_count - 1) page_value_select++;
+		else page_value_select = 0;
+	}
+	//change selected value
+	if(input->enc_diff != 0 && page->field_count > 0)
+	{
+		UI_Buzzer_beep();
+		page_engine_edit(&page->fields[page_value_select], input->enc_diff);
+	}
+	//exit page on long select
+	if(input->press[btn_sel] > 1 && page->select_long != PAGE_NONE)
+	{
+		UI_Buzzer_beep();
+		if(page->on_select_long) page->on_select_long();
+		page_engine_set_page(page->select_long);
+		return;
+	}
+	//change page -
+	if(input->press[btn_left] && page->prev != PAGE_NONE)
+	{
+		UI_Buzzer_beep();
+		page_engine_set_page(page->prev);
+		return;
+	}
+	//change page +
+	if(input->press[btn_right] && page->next != PAGE_NONE)
+	{
+		UI_Buzzer_beep();
+		page_engine_set_page(page->next);
+	}
+}
+
+/**
+ * Sets the page table and the first page.
+ * @param pages const page table
+ * @param page_count number of pages in the table
+ * @param start_page index of the first page
+ * @endcode
+ * \ingroup Page_Engine
+ */
+void page_engine_init(const page_t *pages, int page_count, int start_page)
+{
+	page_table = pages;
+	page_table_count = page_count;
+	page_engine_set_page(start_page);
+}
+
+/**
+ * Runs one frame: handles the input, updates the page data and draws the page if needed.
+ * Input and alarms draw right away, data events draw at most every refresh_ms of the page.
+ * @param events event bits that woke the frame
+ * @param input presses and encoder steps of the frame
+ * @return true if the page was drawn
+ * @endcode
+ * \ingroup Page_Engine
+ */
+bool page_engine_run(EventBits_t events, const page_input_t *input)
+{
+	if(page_table == NULL) return 0;
+	const page_t *page = &page_table[page_current];
+	bool redraw = 0;
+
+	if(events & EVT_INPUT) page_engine_input(page, input);
+	if(events & (EVT_INPUT | EVT_ALARM)) redraw = 1;
+
+	//page was changed by the input
+	page = &page_table[page_current];
+	if(page_entered || (events & page->data_events))
+	{
+		if(page->update) page->update();
+		page_data_pending = 1;
+	}
+
+	int64_t now = esp_timer_get_time();
+	uint32_t refresh_ms = page->refresh_ms > page_min_refresh_ms ? page->refresh_ms : page_min_refresh_ms;
+	if(page_data_pending && (now - page_last_draw_us) >= (int64_t)refresh_ms * 1000) redraw = 1;
+	if(page_entered) redraw = 1;
+
+	if(redraw)
+	{
+		page->draw(page_value_select);
+		page_last_draw_us = now;
+		page_data_pending = 0;
+		page_entered = 0;
+	}
+	return redraw;
+}
+
+/**
+ * @return index of the current page
+ * @endcode
+ * \ingroup Page_Engine
+ */
+int page_engine_get_page(void)
+{
+	return page_current;
+}
+
+/**
+ * Changes the page, the new page is drawn by the next page_engine_run().
+ * @param page index of the page
+ * @endcode
+ * \ingroup Page_Engine
+ */
+void page_engine_set_page(int page)
+{
+	if(page < 0 || page >= page_table_count)
+	{
+		ESP_LOGE(TAG, "Page %d does not exist", page);
+		return;
+	}
+	page_current = page;
+	page_value_select = 0;
+	page_entered = 1;
+	ESP_LOGD(TAG, "Page %s entered", page_table[page].name);
+}
+
+/**
+ * Sets a lower bound for the refresh period of all pages.
+ * Input and alarms still draw right away.
+ * @param refresh_ms minimum period in ms, 0 uses the period of the page
+ * @endcode
+ * \ingroup Page_Engine
+ */
+void page_engine_set_min_refresh(uint32_t refresh_ms)
+{
+	page_min_refresh_ms = refresh_ms;
+}
+
+/**
+ * Draws the current page with the next page_engine_run(), the selected field is kept.
+ * @endcode
+ * \ingroup Page_Engine
+ */
+void page_engine_invalidate(void)
+{
+	page_entered = 1;
+}
+
+/**
+ * @return selected field of the current page
+ * @endcode
+ * \ingroup Page_Engine
+ */
+int page_engine_get_value_select(void)
+{
+	return page_value_select;
+}
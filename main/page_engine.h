@@ -0,0 +1,57 @@
+#ifndef MAIN_PAGE_ENGINE_H_
+#define MAIN_PAGE_ENGINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+//no page linked
+#define PAGE_NONE -1
+
+//types of editable fields
+typedef enum {
+	FIELD_DOUBLE,
+	FIELD_INT,
+	FIELD_TOGGLE,
+} page_field_type_t;
+
+//editable field, value points to a double, int or bool depending on type
+typedef struct {
+	page_field_type_t type;
+	void *value;
+	double min;
+	double max;
+	double step;
+} page_field_t;
+
+//page descriptor, kept const in flash
+typedef struct {
+	const char *name;
+	int8_t prev;
+	int8_t next;
+	int8_t select_long;
+	void (*on_select_long)(void);
+	void (*update)(void);
+	void (*draw)(int value_select);
+	const page_field_t *fields;
+	uint8_t field_count;
+	uint16_t refresh_ms;
+	EventBits_t data_events;
+} page_t;
+
+//input of one frame, press is 1 for a short and 2 for a long press
+typedef struct {
+	int press[5];
+	int32_t enc_diff;
+} page_input_t;
+
+void page_engine_init(const page_t *pages, int page_count, int start_page);
+bool page_engine_run(EventBits_t events, const page_input_t *input);
+int page_engine_get_page(void);
+void page_engine_set_page(int page);
+int page_engine_get_value_select(void);
+void page_engine_set_min_refresh(uint32_t refresh_ms);
+void page_engine_invalidate(void);
+
+#endif
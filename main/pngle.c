@@ -107,48 +107,14 @@ pngle_t *pngle_new(uint16_t width, uint16_t height)
 
 	pngle_reset(pngle);
 
-	pngle->pixels = NULL;
-
-    //Alocate pixel memory. Each line is an array of IMAGE_W 16-bit pixels; the `*pixels` array itself contains pointers to these lines.
-    pngle->pixels = calloc(height, sizeof(pixel_png *));
-    if (pngle->pixels == NULL) {
-        ESP_LOGE(__FUNCTION__, "Error allocating memory for lines");
-        //ret = ESP_ERR_NO_MEM;
-        goto err;
-    }
-    for (int i = 0; i < height; i++) {
-        (pngle->pixels)[i] = malloc(width * sizeof(pixel_png));
-        if ((pngle->pixels)[i] == NULL) {
-            ESP_LOGE(__FUNCTION__, "Error allocating memory for line %d", i);
-            //ret = ESP_ERR_NO_MEM;
-            goto err;
-        }
-    }
-
 	pngle->screenWidth = width;
 	pngle->screenHeight = height;
 	return pngle;
-
-    err:
-    //Something went wrong! Exit cleanly, de-allocating everything we allocated.
-    if (pngle->pixels != NULL) {
-        for (int i = 0; i < height; i++) {
-            free((pngle->pixels)[i]);
-        }
-        free(pngle->pixels);
-    }
-	return NULL;
 }
 
-void pngle_destroy(pngle_t *pngle, uint16_t width, uint16_t height)
+void pngle_destroy(pngle_t *pngle)
 {
 	if (pngle) {
-    	if (pngle->pixels != NULL) {
-       		for (int i = 0; i < height; i++) {
-            	free((pngle->pixels)[i]);
-       		}
-        	free(pngle->pixels);
-    	}
 		pngle_reset(pngle);
 		free(pngle);
 	}
@@ -230,6 +196,21 @@ static inline uint16_t get_value(pngle_t *pngle, size_t *ridx, int *bitcount, in
 	return 0;
 }
 
+static inline void pngle_put_rgb565(pngle_t *pngle, const uint8_t rgba[4])
+{
+	uint32_t x = pngle->drawing_x;
+	uint32_t y = pngle->drawing_y;
+	if (pngle->reduction) {
+		x = x * pngle->scale_factor;
+		y = y * pngle->scale_factor;
+	}
+	if (x >= pngle->rgb565_width || y >= pngle->rgb565_height) return;
+
+	uint8_t r = pngle->rgb565_swap_rb ? rgba[2] : rgba[0];
+	uint8_t b = pngle->rgb565_swap_rb ? rgba[0] : rgba[2];
+	pngle->rgb565_dst[x * pngle->rgb565_x_stride + y * pngle->rgb565_y_stride] = ((r & 0xF8) << 8) | ((rgba[1] & 0xFC) << 3) | (b >> 3);
+}
+
 static int pngle_draw_pixels(pngle_t *pngle, size_t scanline_ringbuf_xidx)
 {
 	uint16_t v[4]; // MAX_CHANNELS
@@ -276,7 +257,7 @@ static int pngle_draw_pixels(pngle_t *pngle, size_t scanline_ringbuf_xidx)
 			v[1] = v[2] = v[0];
 		}
 
-		if (pngle->draw_callback) {
+		if (pngle->draw_callback || pngle->rgb565_dst) {
 			uint8_t rgba[4] = {
 				(v[0] * 255 + maxval / 2) / maxval,
 				(v[1] * 255 + maxval / 2) / maxval,
@@ -292,6 +273,11 @@ static int pngle_draw_pixels(pngle_t *pngle, size_t scanline_ringbuf_xidx)
 			}
 #endif
 
+			if (pngle->rgb565_dst) {
+				pngle_put_rgb565(pngle, rgba);
+				continue;
+			}
+
 			pngle->draw_callback(pngle, pngle->drawing_x, pngle->drawing_y
 				, MIN(interlace_div_x[pngle->interlace_pass] - interlace_off_x[pngle->interlace_pass], pngle->hdr.width  - pngle->drawing_x)
 				, MIN(interlace_div_y[pngle->interlace_pass] - interlace_off_y[pngle->interlace_pass], pngle->hdr.height - pngle->drawing_y)
@@ -812,6 +798,17 @@ void pngle_set_done_callback(pngle_t *pngle, pngle_done_callback_t callback)
 	pngle->done_callback = callback;
 }
 
+void pngle_set_rgb565_output(pngle_t *pngle, uint16_t *dst, uint16_t width, uint16_t height, size_t x_stride, size_t y_stride, bool swap_rb)
+{
+	if (!pngle) return ;
+	pngle->rgb565_dst = dst;
+	pngle->rgb565_width = width;
+	pngle->rgb565_height = height;
+	pngle->rgb565_x_stride = x_stride;
+	pngle->rgb565_y_stride = y_stride;
+	pngle->rgb565_swap_rb = swap_rb;
+}
+
 void pngle_set_user_data(pngle_t *pngle, void *user_data)
 {
 	if (!pngle) return ;
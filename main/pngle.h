@@ -26,6 +26,8 @@
 #define __PNGLE_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp32/rom/miniz.h"
 
 #ifdef __cplusplus
@@ -44,12 +46,6 @@ extern "C" {
 
 //#define PNGLE_NO_GAMMA_CORRECTION
 
-typedef struct __attribute__((__packed__)) {
-    uint8_t red;
-    uint8_t green;
-    uint8_t blue;
-} pixel_png;
-
 typedef enum {
     PNGLE_STATE_ERROR = -2,
     PNGLE_STATE_EOF = -1,
@@ -144,9 +140,16 @@ struct pngle {
 	uint16_t screenHeight;
 	uint16_t imageWidth;
 	uint16_t imageHeight;
-	pixel_png **pixels;
 	bool reduction;
 	double scale_factor;
+
+	//RGB565 output, see pngle_set_rgb565_output
+	uint16_t *rgb565_dst;
+	uint16_t rgb565_width;
+	uint16_t rgb565_height;
+	size_t rgb565_x_stride;
+	size_t rgb565_y_stride;
+	bool rgb565_swap_rb;
 };
 
 
@@ -154,7 +157,7 @@ struct pngle {
 // Basic interfaces
 // ----------------
 pngle_t *pngle_new(uint16_t width, uint16_t height);
-void pngle_destroy(pngle_t *pngle, uint16_t width, uint16_t height);
+void pngle_destroy(pngle_t *pngle);
 void pngle_reset(pngle_t *pngle); // clear its internal state (not applied to pngle_set_* functions)
 const char *pngle_error(pngle_t *pngle);
 int pngle_feed(pngle_t *pngle, const void *buf, size_t len); // returns -1: On error, 0: Need more data, n: n bytes eaten
@@ -165,6 +168,7 @@ uint32_t pngle_get_height(pngle_t *pngle);
 void pngle_set_init_callback(pngle_t *png, pngle_init_callback_t callback);
 void pngle_set_draw_callback(pngle_t *png, pngle_draw_callback_t callback);
 void pngle_set_done_callback(pngle_t *png, pngle_done_callback_t callback);
+void pngle_set_rgb565_output(pngle_t *pngle, uint16_t *dst, uint16_t width, uint16_t height, size_t x_stride, size_t y_stride, bool swap_rb); // converts the scanlines straight into a framebuffer instead of calling the draw callback
 
 void pngle_set_display_gamma(pngle_t *pngle, double display_gamma); // enables gamma correction by specifying display gamma, typically 2.2. No effect when gAMA chunk is missing
 
@@ -0,0 +1,211 @@
+#include "stdio.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "profiler.h"
+
+static const char *TAG = "Profiler";
+
+//rolling statistics of one stage on one page
+typedef struct {
+	uint16_t hist[PROF_BUCKETS];
+	uint32_t count;
+	uint32_t sum_us;
+	uint32_t min_us;
+	uint32_t max_us;
+} prof_slot_t;
+
+static const char *prof_stage_names[PROF_STAGE_COUNT] = {
+	[PROF_BACKGROUND] = "bg",
+	[PROF_TEXT] = "text",
+	[PROF_PRIMITIVES] = "prim",
+	[PROF_LED] = "led",
+	[PROF_FLUSH] = "flush",
+	[PROF_INPUT] = "input",
+	[PROF_FRAME] = "frame",
+};
+
+//only the Master_Task writes, readers may see a slot mid update
+static prof_slot_t prof_slots[PROF_MAX_PAGES][PROF_STAGE_COUNT];
+//time of each stage in the current frame
+static uint32_t prof_frame_us[PROF_STAGE_COUNT];
+static uint32_t prof_frame_used = 0;
+static int64_t prof_frame_start = 0;
+static int prof_depth = 0;
+
+/**
+ * Internal function, do not use!!
+ * @param us duration
+ * @return log2 bucket of the duration
+ * @endcode
+ */
+static int profiler_bucket(uint32_t us)
+{
+	int bucket = 0;
+	while(us > 1 && bucket < PROF_BUCKETS - 1)
+	{
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/**
+ * Internal function, do not use!!
+ * Adds one sample to a slot, halves the window when it is full.
+ * @param slot slot of the stage
+ * @param us duration
+ * @endcode
+ */
+static void profiler_account(prof_slot_t *slot, uint32_t us)
+{
+	if(slot->count >= PROF_WINDOW)
+	{
+		for(int i = 0; i < PROF_BUCKETS; i++) slot->hist[i] >>= 1;
+		slot->sum_us >>= 1;
+		slot->count >>= 1;
+		//min and max restart with the window
+		slot->min_us = us;
+		slot->max_us = us;
+	}
+	if(slot->count == 0 || us < slot->min_us) slot->min_us = us;
+	if(us > slot->max_us) slot->max_us = us;
+	slot->hist[profiler_bucket(us)]++;
+	slot->sum_us += us;
+	slot->count++;
+}
+
+/**
+ * Starts a scope, use PROF_BEGIN().
+ * @return start time, 0 if the scope is nested in another one
+ * @endcode
+ * \ingroup Profiler
+ */
+int64_t profiler_begin(void)
+{
+	if(prof_depth++ > 0) return 0;
+	return esp_timer_get_time();
+}
+
+/**
+ * Ends a scope and adds its time to the stage of the current frame, use PROF_END().
+ * @param stage stage of the scope
+ * @param start start time from profiler_begin()
+ * @endcode
+ * \ingroup Profiler
+ */
+void profiler_end(prof_stage_t stage, int64_t start)
+{
+	if(prof_depth > 0) prof_depth--;
+	if(start == 0 || stage >= PROF_STAGE_COUNT) return;
+	prof_frame_us[stage] += (uint32_t)(esp_timer_get_time() - start);
+	prof_frame_used |= 1 << stage;
+}
+
+/**
+ * Starts a frame, clears the stage times.
+ * @endcode
+ * \ingroup Profiler
+ */
+void profiler_frame_begin(void)
+{
+	memset(prof_frame_us, 0, sizeof(prof_frame_us));
+	prof_frame_used = 0;
+	prof_frame_start = esp_timer_get_time();
+}
+
+/**
+ * Ends a frame and adds the time of every stage that ran to the statistics of the page.
+ * @param page page the frame was drawn for
+ * @endcode
+ * \ingroup Profiler
+ */
+void profiler_frame_end(int page)
+{
+	if(page < 0 || page >= PROF_MAX_PAGES) return;
+	prof_frame_us[PROF_FRAME] = (uint32_t)(esp_timer_get_time() - prof_frame_start);
+	prof_frame_used |= 1 << PROF_FRAME;
+	for(int stage = 0; stage < PROF_STAGE_COUNT; stage++)
+	{
+		if(prof_frame_used & (1 << stage)) profiler_account(&prof_slots[page][stage], prof_frame_us[stage]);
+	}
+}
+
+/**
+ * Gets the rolling statistics of a stage on a page.
+ * p99 is the upper edge of its log2 bucket, limited to the maximum.
+ * @param page page index
+ * @param stage stage
+ * @param result struct to copy to
+ * @return false if there are no samples
+ * @endcode
+ * \ingroup Profiler
+ */
+bool profiler_get(int page, prof_stage_t stage, prof_result_t *result)
+{
+	memset(result, 0, sizeof(prof_result_t));
+	if(page < 0 || page >= PROF_MAX_PAGES || stage >= PROF_STAGE_COUNT) return 0;
+	prof_slot_t slot = prof_slots[page][stage];
+	if(slot.count == 0) return 0;
+
+	result->count = slot.count;
+	result->min_us = slot.min_us;
+	result->avg_us = slot.sum_us / slot.count;
+	result->max_us = slot.max_us;
+	uint32_t target = (slot.count * 99 + 99) / 100;
+	uint32_t seen = 0;
+	result->p99_us = slot.max_us;
+	for(int i = 0; i < PROF_BUCKETS; i++)
+	{
+		seen += slot.hist[i];
+		if(seen >= target)
+		{
+			uint32_t edge = (2UL << i) - 1;
+			if(edge < result->p99_us) result->p99_us = edge;
+			break;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @param stage stage
+ * @return short name of the stage
+ * @endcode
+ * \ingroup Profiler
+ */
+const char *profiler_stage_name(prof_stage_t stage)
+{
+	if(stage >= PROF_STAGE_COUNT) return "?";
+	return prof_stage_names[stage];
+}
+
+/**
+ * Logs the statistics of all stages of a page, if it has any.
+ * @param page page index
+ * @param name page name for the log
+ * @endcode
+ * \ingroup Profiler
+ */
+void profiler_dump_page(int page, const char *name)
+{
+	prof_result_t result;
+	if(!profiler_get(page, PROF_FRAME, &result)) return;
+	ESP_LOGI(TAG, "Page %s, %u frames", name, result.count);
+	ESP_LOGI(TAG, " stage   min_us  avg_us  max_us  p99_us");
+	for(int stage = 0; stage < PROF_STAGE_COUNT; stage++)
+	{
+		if(!profiler_get(page, stage, &result)) continue;
+		ESP_LOGI(TAG, " %-6s %7u %7u %7u %7u", prof_stage_names[stage], result.min_us, result.avg_us, result.max_us, result.p99_us);
+	}
+}
+
+/**
+ * Clears the statistics of all pages.
+ * @endcode
+ * \ingroup Profiler
+ */
+void profiler_reset(void)
+{
+	memset(prof_slots, 0, sizeof(prof_slots));
+}
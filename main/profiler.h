@@ -0,0 +1,54 @@
+#ifndef MAIN_PROFILER_H_
+#define MAIN_PROFILER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+//stages of a frame
+typedef enum {
+	PROF_BACKGROUND,
+	PROF_TEXT,
+	PROF_PRIMITIVES,
+	PROF_LED,
+	PROF_FLUSH,
+	PROF_INPUT,
+	PROF_FRAME,
+	PROF_STAGE_COUNT,
+} prof_stage_t;
+
+//pages the profiler keeps statistics for
+#define PROF_MAX_PAGES 16
+//log2 histogram buckets, the last one is up to 1s
+#define PROF_BUCKETS 20
+//the window is halved after this many frames, so the statistics roll
+#define PROF_WINDOW 256
+
+//statistics of one stage on one page
+typedef struct {
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t avg_us;
+	uint32_t max_us;
+	uint32_t p99_us;
+} prof_result_t;
+
+//scope macros, one scope per function. Nested scopes are accounted to the outer one.
+#if CONFIG_PSU_PROFILER
+#define PROF_BEGIN() int64_t prof_start = profiler_begin()
+#define PROF_END(stage) profiler_end(stage, prof_start)
+#else
+#define PROF_BEGIN()
+#define PROF_END(stage)
+#endif
+
+int64_t profiler_begin(void);
+void profiler_end(prof_stage_t stage, int64_t start);
+void profiler_frame_begin(void);
+void profiler_frame_end(int page);
+bool profiler_get(int page, prof_stage_t stage, prof_result_t *result);
+const char *profiler_stage_name(prof_stage_t stage);
+void profiler_dump_page(int page, const char *name);
+void profiler_reset(void);
+
+#endif
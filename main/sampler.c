@@ -0,0 +1,192 @@
+#include "stdio.h"
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "INA_data_driver.h"
+#include "master_events.h"
+#include "metrics.h"
+#include "sampler.h"
+
+static const char *TAG = "Sampler";
+
+//Create Task Handle
+TaskHandle_t sampler_task;
+
+//initialize Mutex Handle
+SemaphoreHandle_t xSampler_Semaphore;
+
+//ring buffer of the history, sampler_head is the next sample to write
+static sample_t sampler_history[SAMPLER_HISTORY_LEN];
+static int sampler_head = 0;
+static int sampler_count = 0;
+
+//timing
+static TickType_t sampler_period_ticks = 0;
+static sampler_stats_t sampler_stats;
+static int64_t sampler_jitter_sum_us = 0;
+
+/**
+ * Internal function, do not use!!
+ * Updates the jitter statistics with the interval between two samples.
+ * @param interval_us measured interval
+ * @endcode
+ */
+static void sampler_account(int64_t interval_us)
+{
+	int32_t jitter = (int32_t)(interval_us - sampler_stats.period_us);
+	if(sampler_stats.samples == 0 || jitter < sampler_stats.jitter_min_us) sampler_stats.jitter_min_us = jitter;
+	if(sampler_stats.samples == 0 || jitter > sampler_stats.jitter_max_us) sampler_stats.jitter_max_us = jitter;
+	//a whole period was missed
+	if(jitter >= (int32_t)sampler_stats.period_us) sampler_stats.overruns++;
+	sampler_jitter_sum_us += abs(jitter);
+	sampler_stats.samples++;
+	sampler_stats.jitter_avg_us = sampler_jitter_sum_us / sampler_stats.samples;
+}
+
+/**
+ * Sampler task. Captures the INA values at a fixed period, independent of the render loop.
+ * @param pvParameters unused
+ * @endcode
+ * \ingroup Sampler
+ */
+void sampler_handler(void *pvParameters)
+{
+	TickType_t wake_time = xTaskGetTickCount();
+	int64_t last_us = 0;
+	sample_t sample;
+	sample.seq = 0;
+	metrics_task_register(METRIC_TASK_SAMPLER);
+	while(1)
+	{
+		vTaskDelayUntil(&wake_time, sampler_period_ticks);
+
+		sample.timestamp_us = esp_timer_get_time();
+		sample.power_mW = INAD_getPower_mW(INA1);
+		sample.vshunt_mV = INAD_getVShunt_mv(INA1);
+		sample.current_mA = INAD_getCurrent_mA(INA1);
+
+		//If semaphore is initialized
+		if( xSampler_Semaphore != NULL )
+		{
+			//If able, take semaphore, otherwise try again for 10 Ticks
+			if( xSemaphoreTake( xSampler_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+			{
+				sampler_history[sampler_head] = sample;
+				sample.seq++;
+				sampler_head = (sampler_head + 1) % SAMPLER_HISTORY_LEN;
+				if(sampler_count < SAMPLER_HISTORY_LEN) sampler_count++;
+				if(last_us) sampler_account(sample.timestamp_us - last_us);
+				xSemaphoreGive( xSampler_Semaphore );
+			}
+			else
+			{
+				ESP_LOGE(TAG, "Could not take Semaphore");
+			}
+		}
+		last_us = sample.timestamp_us;
+		master_events_set(EVT_SAMPLE);
+		metrics_task_loop(METRIC_TASK_SAMPLER);
+	}
+}
+
+/**
+ * Starts the sampler task.
+ * @param period_ms sample period in ms, rounded to ticks
+ * @endcode
+ * \ingroup Sampler
+ */
+void sampler_init(uint32_t period_ms)
+{
+	sampler_period_ticks = period_ms / portTICK_PERIOD_MS;
+	if(sampler_period_ticks == 0) sampler_period_ticks = 1;
+	memset(&sampler_stats, 0, sizeof(sampler_stats));
+	sampler_stats.period_us = sampler_period_ticks * portTICK_PERIOD_MS * 1000;
+	//Create Mutex
+	xSampler_Semaphore = xSemaphoreCreateMutex();
+	//Create Handler Task
+	xTaskCreatePinnedToCore(sampler_handler, "sampler_handler", 1024*3, NULL, CONFIG_PSU_ACQ_PRIORITY, &sampler_task, CONFIG_PSU_ACQ_CORE);
+	ESP_LOGI(TAG, "--> Sampler initialized with %d ms period", sampler_period_ticks * portTICK_PERIOD_MS);
+}
+
+/**
+ * Copies the history, oldest sample first.
+ * @param history array to copy to
+ * @param count size of the array
+ * @return number of samples copied
+ * @endcode
+ * \ingroup Sampler
+ */
+int sampler_get_history(sample_t *history, int count)
+{
+	int copied = 0;
+	if( xSampler_Semaphore != NULL )
+	{
+		if( xSemaphoreTake( xSampler_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+		{
+			if(count > sampler_count) count = sampler_count;
+			//oldest of the requested samples
+			int index = (sampler_head - count + SAMPLER_HISTORY_LEN) % SAMPLER_HISTORY_LEN;
+			for(copied = 0; copied < count; copied++)
+			{
+				history[copied] = sampler_history[index];
+				index = (index + 1) % SAMPLER_HISTORY_LEN;
+			}
+			xSemaphoreGive( xSampler_Semaphore );
+		}
+		else
+		{
+			ESP_LOGE(TAG, "Could not take Semaphore");
+		}
+	}
+	return copied;
+}
+
+/**
+ * Copies the timing statistics of the sampler.
+ * @param stats struct to copy to
+ * @endcode
+ * \ingroup Sampler
+ */
+void sampler_get_stats(sampler_stats_t *stats)
+{
+	if( xSampler_Semaphore != NULL )
+	{
+		if( xSemaphoreTake( xSampler_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+		{
+			*stats = sampler_stats;
+			xSemaphoreGive( xSampler_Semaphore );
+		}
+		else
+		{
+			ESP_LOGE(TAG, "Could not take Semaphore");
+		}
+	}
+}
+
+/**
+ * Resets the timing statistics, the history is kept.
+ * @endcode
+ * \ingroup Sampler
+ */
+void sampler_reset_stats(void)
+{
+	if( xSampler_Semaphore != NULL )
+	{
+		if( xSemaphoreTake( xSampler_Semaphore, ( TickType_t ) 10 ) == pdTRUE )
+		{
+			uint32_t period_us = sampler_stats.period_us;
+			memset(&sampler_stats, 0, sizeof(sampler_stats));
+			sampler_stats.period_us = period_us;
+			sampler_jitter_sum_us = 0;
+			xSemaphoreGive( xSampler_Semaphore );
+		}
+		else
+		{
+			ESP_LOGE(TAG, "Could not take Semaphore");
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef MAIN_SAMPLER_H_
+#define MAIN_SAMPLER_H_
+
+#include <stdint.h>
+
+//number of samples kept in the history
+#define SAMPLER_HISTORY_LEN 50
+
+//one sample of the INA values
+typedef struct {
+	double power_mW;
+	double vshunt_mV;
+	double current_mA;
+	int64_t timestamp_us;
+	uint32_t seq;			//counts up with every sample
+} sample_t;
+
+//timing of the sampler, jitter is the difference of the measured to the set period
+typedef struct {
+	uint32_t samples;
+	uint32_t overruns;
+	uint32_t period_us;
+	int32_t jitter_min_us;
+	int32_t jitter_max_us;
+	int32_t jitter_avg_us;
+} sampler_stats_t;
+
+void sampler_init(uint32_t period_ms);
+int sampler_get_history(sample_t *history, int count);
+void sampler_get_stats(sampler_stats_t *stats);
+void sampler_reset_stats(void);
+
+#endif
@@ -0,0 +1,128 @@
+#include "stdio.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+#include "esp_sleep.h"
+#endif
+#include "esp_log.h"
+#include "serial_cmd.h"
+
+static const char *TAG = "Serial_Cmd";
+
+//console UART and line length
+#define SERIAL_CMD_UART CONFIG_ESP_CONSOLE_UART_NUM
+#define SERIAL_CMD_LINE_LEN 64
+
+//Create Task Handle
+TaskHandle_t serial_cmd_task;
+
+//registered commands
+typedef struct {
+	const char *name;
+	const char *help;
+	serial_cmd_func_t func;
+} serial_cmd_t;
+
+static serial_cmd_t serial_cmds[SERIAL_CMD_MAX];
+static int serial_cmd_count = 0;
+
+/**
+ * Internal function, do not use!!
+ * Looks up the command of a line and runs it.
+ * @param line line without line ending
+ * @endcode
+ */
+static void serial_cmd_execute(char *line)
+{
+	//split command name and arguments
+	char *args = strchr(line, ' ');
+	if(args) *args++ = 0;
+	else args = "";
+	if(line[0] == 0) return;
+
+	for(int i = 0; i < serial_cmd_count; i++)
+	{
+		if(strcmp(line, serial_cmds[i].name) == 0)
+		{
+			serial_cmds[i].func(args);
+			return;
+		}
+	}
+	if(strcmp(line, "help") != 0) ESP_LOGW(TAG, "Unknown command: %s", line);
+	for(int i = 0; i < serial_cmd_count; i++)
+	{
+		ESP_LOGI(TAG, "%-10s %s", serial_cmds[i].name, serial_cmds[i].help);
+	}
+}
+
+/**
+ * Serial command task. Reads lines from the console UART and runs the matching command.
+ * @param pvParameters unused
+ * @endcode
+ * \ingroup Serial_Cmd
+ */
+void serial_cmd_handler(void *pvParameters)
+{
+	char line[SERIAL_CMD_LINE_LEN];
+	int length = 0;
+	uint8_t c;
+	while(1)
+	{
+		if(uart_read_bytes(SERIAL_CMD_UART, &c, 1, portMAX_DELAY) != 1) continue;
+		if(c == '\r' || c == '\n')
+		{
+			line[length] = 0;
+			serial_cmd_execute(line);
+			length = 0;
+		}
+		else if(length < SERIAL_CMD_LINE_LEN - 1)
+		{
+			line[length++] = c;
+		}
+	}
+}
+
+/**
+ * Registers a command. Must be called before serial_cmd_init().
+ * @param name command name, first word of the line
+ * @param help one line description for the help command
+ * @param func function called with the rest of the line
+ * @endcode
+ * \ingroup Serial_Cmd
+ */
+void serial_cmd_register(const char *name, const char *help, serial_cmd_func_t func)
+{
+	if(serial_cmd_count >= SERIAL_CMD_MAX)
+	{
+		ESP_LOGE(TAG, "Command %s not registered, table full", name);
+		return;
+	}
+	serial_cmds[serial_cmd_count].name = name;
+	serial_cmds[serial_cmd_count].help = help;
+	serial_cmds[serial_cmd_count].func = func;
+	serial_cmd_count++;
+}
+
+/**
+ * Installs the UART driver of the console and starts the command task on the UI core.
+ * @endcode
+ * \ingroup Serial_Cmd
+ */
+void serial_cmd_init(void)
+{
+	esp_err_t ret = uart_driver_install(SERIAL_CMD_UART, 256, 0, 0, NULL, 0);
+	if(ret != ESP_OK)
+	{
+		ESP_LOGE(TAG, "UART driver not installed (%s)", esp_err_to_name(ret));
+		return;
+	}
+#if CONFIG_PSU_IDLE_LIGHT_SLEEP
+	//RX edges wake the CPU from light sleep, the characters that woke it are lost
+	uart_set_wakeup_threshold(SERIAL_CMD_UART, 3);
+	esp_sleep_enable_uart_wakeup(SERIAL_CMD_UART);
+#endif
+	xTaskCreatePinnedToCore(serial_cmd_handler, "serial_cmd", 1024*3, NULL, 1, &serial_cmd_task, CONFIG_PSU_UI_CORE);
+	ESP_LOGI(TAG, "--> Serial commands initialized, type help");
+}
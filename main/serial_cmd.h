@@ -0,0 +1,13 @@
+#ifndef MAIN_SERIAL_CMD_H_
+#define MAIN_SERIAL_CMD_H_
+
+//maximum number of commands
+#define SERIAL_CMD_MAX 12
+
+//command function, args is the rest of the line after the command name
+typedef void (*serial_cmd_func_t)(const char *args);
+
+void serial_cmd_register(const char *name, const char *help, serial_cmd_func_t func);
+void serial_cmd_init(void);
+
+#endif
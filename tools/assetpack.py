@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Packs fonts and images into the image of the assets partition, see main/assets.h.
+# Usage: assetpack.py -o <assets.bin> [--size N] <files...>
+#        assetpack.py --list <assets.bin>
+#
+# PNG files are converted like png2rgb565.py --rle and stored as <name>.565, .565
+# files are stored as they are, FONTX files are recognized by their signature,
+# everything else is stored as raw data. Entries are found by their file name.
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+import png2rgb565
+
+ASSETS_MAGIC = 0x41555350  # "PSUA"
+ASSETS_VERSION = 1
+ASSETS_NAME_LEN = 24
+ASSETS_ALIGN = 4
+HEADER = struct.Struct('<IHHII')
+ENTRY = struct.Struct('<%dsIII' % ASSETS_NAME_LEN)
+
+ASSET_FORMAT_RAW = 0
+ASSET_FORMAT_FONTX = 1
+ASSET_FORMAT_IMAGE565 = 2
+FORMAT_NAMES = {ASSET_FORMAT_RAW: 'raw', ASSET_FORMAT_FONTX: 'fontx', ASSET_FORMAT_IMAGE565: 'image565'}
+
+
+def load(path):
+    """Returns name, format and data of one entry."""
+    name = os.path.basename(path)
+    base, ext = os.path.splitext(name)
+    if ext.lower() == '.png':
+        data = png2rgb565.convert(path, True, 3.0)[0]
+        return base + '.565', ASSET_FORMAT_IMAGE565, data
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] == struct.pack('<I', png2rgb565.IMAGE565_MAGIC):
+        return name, ASSET_FORMAT_IMAGE565, data
+    if data[:6] == b'FONTX2':
+        return name, ASSET_FORMAT_FONTX, data
+    return name, ASSET_FORMAT_RAW, data
+
+
+def pack(paths):
+    entries = [load(path) for path in paths]
+    names = [entry[0] for entry in entries]
+    for name in names:
+        if len(name.encode()) >= ASSETS_NAME_LEN:
+            raise ValueError('%s: name longer than %d characters' % (name, ASSETS_NAME_LEN - 1))
+        if names.count(name) > 1:
+            raise ValueError('%s: packed twice' % name)
+
+    offset = HEADER.size + ENTRY.size * len(entries)
+    index = b''
+    body = b''
+    for name, fmt, data in entries:
+        pad = -offset % ASSETS_ALIGN
+        body += b'\xff' * pad
+        offset += pad
+        index += ENTRY.pack(name.encode(), offset, len(data), fmt)
+        body += data
+        offset += len(data)
+    size = HEADER.size + len(index) + len(body)
+    crc = zlib.crc32(index + body) & 0xFFFFFFFF
+    return HEADER.pack(ASSETS_MAGIC, ASSETS_VERSION, len(entries), size, crc) + index + body
+
+
+def list_image(path):
+    with open(path, 'rb') as f:
+        image = f.read()
+    magic, version, count, size, crc = HEADER.unpack_from(image)
+    if magic != ASSETS_MAGIC or version != ASSETS_VERSION:
+        raise ValueError('%s: not an assets image' % path)
+    valid = size <= len(image) and zlib.crc32(image[HEADER.size:size]) & 0xFFFFFFFF == crc
+    print('%s: %d entries, %d bytes, CRC %s' % (path, count, size, 'ok' if valid else 'BAD'))
+    for i in range(count):
+        name, offset, length, fmt = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        print('  %-24s %8d %8d  %s' % (name.rstrip(b'\0').decode(), offset, length, FORMAT_NAMES.get(fmt, fmt)))
+    return 0 if valid else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack fonts and images into the assets partition.')
+    parser.add_argument('files', nargs='+', help='files to pack, or the image with --list')
+    parser.add_argument('-o', '--output', help='partition image')
+    parser.add_argument('--size', type=lambda s: int(s, 0), default=0, help='partition size, fails if exceeded')
+    parser.add_argument('--list', action='store_true', help='print the index of an image')
+    args = parser.parse_args()
+    try:
+        if args.list:
+            return list_image(args.files[0])
+        if not args.output:
+            parser.error('-o is required')
+        image = pack(args.files)
+        if args.size and len(image) > args.size:
+            raise ValueError('%d bytes do not fit the partition of %d bytes' % (len(image), args.size))
+    except (ValueError, OSError, zlib.error) as e:
+        sys.stderr.write('assetpack: %s\n' % e)
+        return 1
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    print('%s: %d entries, %d bytes' % (args.output, len(args.files), len(image)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+# Converts a PNG into the raw RGB565 image of main/image565.h.
+# Usage: png2rgb565.py [--rle] [--display-gamma G] <in.png> <out.565>
+#
+# The pixels are the values DF_print_png used to put into the virtual screen:
+# gamma corrected like pngle with the display gamma of DF_print_png, red and blue
+# swapped for the BGR order of the panels, column by column. Alpha is ignored.
+# Only needs the standard library, the build runs it with the Python of ESP-IDF.
+
+import argparse
+import math
+import struct
+import sys
+import zlib
+
+IMAGE565_MAGIC = 0x35363552
+IMAGE565_VERSION = 1
+IMAGE565_FLAG_RLE = 0x01
+IMAGE565_RLE_RUN = 0x8000
+IMAGE565_RLE_MAX = 0x7FFF
+
+PNG_SIGNATURE = b'\x89PNG\r\n\x1a\n'
+
+
+def png_error(message):
+    raise ValueError(message)
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    if pb <= pc:
+        return b
+    return c
+
+
+def png_read(path):
+    """Returns width, height, rows of (r, g, b) samples and the gAMA value or 0."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != PNG_SIGNATURE:
+        png_error('%s: not a PNG' % path)
+    pos = 8
+    header = None
+    palette = None
+    gamma = 0
+    idat = b''
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b'IHDR':
+            header = struct.unpack('>IIBBBBB', chunk)
+        elif kind == b'PLTE':
+            palette = [tuple(chunk[i:i + 3]) for i in range(0, len(chunk), 3)]
+        elif kind == b'gAMA':
+            gamma = struct.unpack('>I', chunk)[0]
+        elif kind == b'IDAT':
+            idat += chunk
+        elif kind == b'IEND':
+            break
+    if header is None:
+        png_error('%s: no IHDR' % path)
+    width, height, depth, color_type, _, _, interlace = header
+    if depth != 8:
+        png_error('%s: bit depth %d, only 8 is supported' % (path, depth))
+    if interlace:
+        png_error('%s: interlaced images are not supported' % path)
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color_type)
+    if channels is None:
+        png_error('%s: color type %d' % (path, color_type))
+    if color_type == 3 and palette is None:
+        png_error('%s: no palette' % path)
+
+    raw = zlib.decompress(idat)
+    stride = width * channels
+    rows = []
+    prev = bytearray(stride)
+    pos = 0
+    for _ in range(height):
+        kind = raw[pos]
+        line = bytearray(raw[pos + 1:pos + 1 + stride])
+        pos += 1 + stride
+        for i in range(stride):
+            a = line[i - channels] if i >= channels else 0
+            b = prev[i]
+            c = prev[i - channels] if i >= channels else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                line[i] = (line[i] + paeth(a, b, c)) & 0xFF
+            elif kind != 0:
+                png_error('%s: filter %d' % (path, kind))
+        prev = line
+        row = []
+        for x in range(width):
+            px = line[x * channels:(x + 1) * channels]
+            if color_type == 3:
+                row.append(palette[px[0]])
+            elif color_type in (0, 4):
+                row.append((px[0], px[0], px[0]))
+            else:
+                row.append((px[0], px[1], px[2]))
+        rows.append(row)
+    return width, height, rows, gamma
+
+
+def gamma_table(png_gamma, display_gamma):
+    """Same table as setup_gamma_table of pngle.c, None without correction."""
+    if display_gamma <= 0 or png_gamma == 0:
+        return None
+    return [int(math.floor(math.pow(i / 255.0, 100000.0 / png_gamma / display_gamma) * 255.0 + 0.5))
+            for i in range(256)]
+
+
+def rgb565(r, g, b):
+    """rgb565_conv of ili9340.c"""
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
+
+
+def rle_encode(pixels):
+    words = []
+    literal = []
+    i = 0
+    while i < len(pixels):
+        run = 1
+        while i + run < len(pixels) and run < IMAGE565_RLE_MAX and pixels[i + run] == pixels[i]:
+            run += 1
+        # a run of two costs as much as two literals
+        if run >= 3:
+            if literal:
+                words.append(len(literal))
+                words.extend(literal)
+                literal = []
+            words.append(IMAGE565_RLE_RUN | run)
+            words.append(pixels[i])
+            i += run
+        else:
+            literal.append(pixels[i])
+            i += 1
+            if len(literal) == IMAGE565_RLE_MAX:
+                words.append(len(literal))
+                words.extend(literal)
+                literal = []
+    if literal:
+        words.append(len(literal))
+        words.extend(literal)
+    return words
+
+
+def rle_decode(words):
+    pixels = []
+    i = 0
+    while i < len(words):
+        control = words[i]
+        if control & IMAGE565_RLE_RUN:
+            pixels.extend([words[i + 1]] * (control & IMAGE565_RLE_MAX))
+            i += 2
+        else:
+            pixels.extend(words[i + 1:i + 1 + control])
+            i += 1 + control
+    return pixels
+
+
+def convert(png_path, rle, display_gamma):
+    width, height, rows, png_gamma = png_read(png_path)
+    if width > 0xFFFF or height > 0xFFFF:
+        png_error('%s: too large' % png_path)
+    table = gamma_table(png_gamma, display_gamma)
+    pixels = []
+    for x in range(width):
+        for y in range(height):
+            r, g, b = rows[y][x]
+            if table:
+                r, g, b = table[r], table[g], table[b]
+            pixels.append(rgb565(b, g, r))
+
+    flags = 0
+    words = pixels
+    if rle:
+        encoded = rle_encode(pixels)
+        if rle_decode(encoded) != pixels:
+            png_error('%s: RLE round trip failed' % png_path)
+        # keep the raw pixels if the image does not compress
+        if len(encoded) < len(pixels):
+            flags |= IMAGE565_FLAG_RLE
+            words = encoded
+    data = struct.pack('<%dH' % len(words), *words)
+    header = struct.pack('<IHHBBHI', IMAGE565_MAGIC, width, height, flags, IMAGE565_VERSION, 0, len(data))
+    return header + data, width, height, flags
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a PNG into a raw RGB565 image for DF_print_image.')
+    parser.add_argument('input', help='PNG file')
+    parser.add_argument('output', help='converted image')
+    parser.add_argument('--rle', action='store_true', help='run length encode if it makes the image smaller')
+    parser.add_argument('--display-gamma', type=float, default=3.0, help='display gamma of DF_print_png (default 3)')
+    args = parser.parse_args()
+    try:
+        image, width, height, flags = convert(args.input, args.rle, args.display_gamma)
+    except (ValueError, OSError, zlib.error) as e:
+        sys.stderr.write('png2rgb565: %s\n' % e)
+        return 1
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    print('%s: %dx%d, %d bytes%s' % (args.output, width, height, len(image),
+                                     ', RLE' if flags & IMAGE565_FLAG_RLE else ''))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())